@@ -0,0 +1,142 @@
+#include "assembly_classifier.h"
+
+#include <algorithm>
+
+#include "dd_profiler_constants.h"
+
+namespace trace
+{
+
+namespace
+{
+    bool EndsWith(const WCHAR* value, size_t length, const WCHAR* suffix, size_t suffix_length)
+    {
+        return length >= suffix_length &&
+               std::equal(suffix, suffix + suffix_length, value + length - suffix_length);
+    }
+} // namespace
+
+uint32_t AssemblyClassifier::Insert(const WSTRING& name)
+{
+    uint32_t current = 0;
+    for (const auto c : name)
+    {
+        auto& children = nodes_[current].children;
+        const auto found = std::lower_bound(children.begin(), children.end(), c,
+                                            [](const std::pair<WCHAR, uint32_t>& child, WCHAR value) {
+                                                return child.first < value;
+                                            });
+        if (found != children.end() && found->first == c)
+        {
+            current = found->second;
+            continue;
+        }
+
+        const auto next = (uint32_t) nodes_.size();
+        children.insert(found, {c, next});
+        nodes_.emplace_back();
+        current = next;
+    }
+    return current;
+}
+
+void AssemblyClassifier::AddSkippedPrefix(const WSTRING& prefix)
+{
+    if (prefix.empty())
+    {
+        return;
+    }
+    nodes_[Insert(prefix)].skipped_prefix = true;
+}
+
+void AssemblyClassifier::Add(const WSTRING& name, AssemblyKind kind)
+{
+    auto& node = nodes_[Insert(name)];
+    if (node.kind != AssemblyKind::Skipped)
+    {
+        node.kind = kind;
+    }
+}
+
+void AssemblyClassifier::AddSkippedPatterns(const std::vector<WSTRING>& patterns)
+{
+    for (const auto& pattern : patterns)
+    {
+        if (!pattern.empty() && pattern.back() == WStr('*'))
+        {
+            AddSkippedPrefix(pattern.substr(0, pattern.size() - 1));
+        }
+        else if (!pattern.empty())
+        {
+            Add(pattern, AssemblyKind::Skipped);
+        }
+    }
+}
+
+AssemblyKind AssemblyClassifier::Classify(const WCHAR* name, size_t length) const
+{
+    uint32_t current = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        const auto& children = nodes_[current].children;
+        const auto found = std::lower_bound(children.begin(), children.end(), name[i],
+                                            [](const std::pair<WCHAR, uint32_t>& child, WCHAR value) {
+                                                return child.first < value;
+                                            });
+        if (found == children.end() || found->first != name[i])
+        {
+            return AssemblyKind::Other;
+        }
+
+        current = found->second;
+        if (nodes_[current].skipped_prefix)
+        {
+            return AssemblyKind::Skipped;
+        }
+    }
+    return nodes_[current].kind;
+}
+
+AssemblyClassifier CreateDefaultAssemblyClassifier()
+{
+    AssemblyClassifier classifier;
+    for (const auto& prefix : skip_assembly_prefixes)
+    {
+        classifier.AddSkippedPrefix(prefix);
+    }
+    for (const auto& name : skip_assemblies)
+    {
+        classifier.Add(name, AssemblyKind::Skipped);
+    }
+    classifier.Add(managed_profiler_name, AssemblyKind::Profiler);
+    classifier.Add(managed_loader_name, AssemblyKind::Profiler);
+    return classifier;
+}
+
+const WCHAR* GetAssemblyNameFromPath(const WCHAR* path, size_t* length)
+{
+    const WCHAR* name = path;
+    const WCHAR* end = path;
+    for (; *end != 0; end++)
+    {
+        if (*end == WStr('/') || *end == WStr('\\'))
+        {
+            name = end + 1;
+        }
+    }
+
+    size_t name_length = end - name;
+    if (EndsWith(name, name_length, WStr(".ni.dll"), 7))
+    {
+        name_length -= 7;
+    }
+    else if (EndsWith(name, name_length, WStr(".dll"), 4))
+    {
+        name_length -= 4;
+    }
+
+    *length = name_length;
+    return name;
+}
+
+} // namespace trace
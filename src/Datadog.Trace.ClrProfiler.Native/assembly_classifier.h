@@ -0,0 +1,72 @@
+#ifndef DD_CLR_PROFILER_ASSEMBLY_CLASSIFIER_H_
+#define DD_CLR_PROFILER_ASSEMBLY_CLASSIFIER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "string.h"
+
+namespace trace
+{
+
+enum class AssemblyKind : uint8_t
+{
+    // any other assembly
+    Other = 0,
+    // a framework or third party assembly the profiler never instruments
+    Skipped,
+    // the target assembly of an integration
+    IntegrationTarget,
+    // an assembly of the tracer itself
+    Profiler,
+};
+
+// AssemblyClassifier tells how the profiler treats an assembly from its name, in a single pass over the name and
+// without allocating. It is a trie over the UTF-16 names, built once and read without locks afterwards.
+//
+// A skipped prefix wins over any other kind, then an exact skipped name, then the kind of the exact name.
+class AssemblyClassifier
+{
+private:
+    struct Node
+    {
+        // children sorted by character
+        std::vector<std::pair<WCHAR, uint32_t>> children;
+        AssemblyKind kind = AssemblyKind::Other;
+        bool skipped_prefix = false;
+    };
+
+    // nodes_[0] is the root
+    std::vector<Node> nodes_ = std::vector<Node>(1);
+
+    uint32_t Insert(const WSTRING& name);
+
+public:
+    // Adds every assembly name starting with the prefix as skipped
+    void AddSkippedPrefix(const WSTRING& prefix);
+
+    // Sets the kind of an assembly name. Skipped names stay skipped.
+    void Add(const WSTRING& name, AssemblyKind kind);
+
+    // Adds user patterns: an entry ending with '*' is a skipped prefix, any other entry a skipped name
+    void AddSkippedPatterns(const std::vector<WSTRING>& patterns);
+
+    AssemblyKind Classify(const WCHAR* name, size_t length) const;
+
+    AssemblyKind Classify(const WSTRING& name) const
+    {
+        return Classify(name.data(), name.size());
+    }
+};
+
+// Returns the default classifier of the profiler: the known framework assemblies are skipped and the
+// tracer assemblies are Profiler. Integration targets and user patterns are added on top of it.
+AssemblyClassifier CreateDefaultAssemblyClassifier();
+
+// Returns the assembly name of a path to an assembly file, <assembly_name>.ni.dll or <assembly_name>.dll, as a
+// pointer into the path
+const WCHAR* GetAssemblyNameFromPath(const WCHAR* path, size_t* length);
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_ASSEMBLY_CLASSIFIER_H_
@@ -0,0 +1,308 @@
+#include "callback_trace.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "clr_helpers.h"
+#include "com_ptr.h"
+#include "logging.h"
+
+namespace trace
+{
+
+namespace
+{
+    const uint32_t kCallbackTraceMagic = 0x54434444; // "DDCT"
+    const uint32_t kCallbackTraceVersion = 1;
+
+    // events are written to the file once this much is buffered, or when the trace is flushed
+    const size_t kFlushThreshold = 64 * 1024;
+
+    // longer names or paths are treated as corrupted
+    const uint32_t kMaxStringLength = 32 * 1024;
+
+    uint32_t GetTraceThread()
+    {
+        static std::atomic<uint32_t> next_thread{1};
+        thread_local const uint32_t thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+        return thread;
+    }
+
+    template <typename T>
+    void Append(std::vector<char>& buffer, const T& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void AppendString(std::vector<char>& buffer, const WSTRING& value)
+    {
+        // WCHAR is 16 bits on every platform, so the file is portable between them
+        Append(buffer, (uint32_t) value.size());
+        const char* bytes = reinterpret_cast<const char*>(value.data());
+        buffer.insert(buffer.end(), bytes, bytes + value.size() * sizeof(WCHAR));
+    }
+
+    template <typename T>
+    bool Read(std::istream& stream, T& value)
+    {
+        return (bool) stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    bool ReadString(std::istream& stream, WSTRING& value)
+    {
+        uint32_t length;
+        if (!Read(stream, length) || length > kMaxStringLength)
+        {
+            return false;
+        }
+
+        value.resize(length);
+        return length == 0 || (bool) stream.read(reinterpret_cast<char*>(&value[0]), length * sizeof(WCHAR));
+    }
+
+    bool ReadEvent(std::istream& stream, CallbackTraceEvent& event)
+    {
+        uint8_t type;
+        if (!Read(stream, type) || !Read(stream, event.thread) || !Read(stream, event.timestamp))
+        {
+            return false;
+        }
+
+        event.type = (CallbackTraceEventType) type;
+        switch (event.type)
+        {
+            case CallbackTraceEventType::ModuleLoadFinished:
+                return Read(stream, event.module_id) && Read(stream, event.hr_status) &&
+                       Read(stream, event.app_domain_id) && Read(stream, event.assembly_version) &&
+                       Read(stream, event.module_version_id) && ReadString(stream, event.assembly_name) &&
+                       ReadString(stream, event.module_path);
+            case CallbackTraceEventType::AssemblyLoadFinished:
+                return Read(stream, event.assembly_id) && Read(stream, event.hr_status) &&
+                       Read(stream, event.module_id);
+            case CallbackTraceEventType::JITCompilationStarted:
+                return Read(stream, event.function_id) && Read(stream, event.module_id) &&
+                       Read(stream, event.token) && Read(stream, event.is_safe_to_block);
+            case CallbackTraceEventType::GetReJITParameters:
+                return Read(stream, event.module_id) && Read(stream, event.token);
+            case CallbackTraceEventType::JITInlining:
+                return Read(stream, event.function_id) && Read(stream, event.module_id) &&
+                       Read(stream, event.token) && Read(stream, event.callee_function_id) &&
+                       Read(stream, event.callee_module_id) && Read(stream, event.callee_token);
+            default:
+                return false;
+        }
+    }
+} // namespace
+
+CallbackTraceWriter::CallbackTraceWriter(const WSTRING& path) :
+    stream_(ToString(path), std::ios::binary | std::ios::trunc), start_(std::chrono::steady_clock::now())
+{
+    if (!stream_.is_open())
+    {
+        Warn("Unable to create the callback trace file ", path);
+        return;
+    }
+
+    buffer_.reserve(kFlushThreshold * 2);
+    Append(buffer_, kCallbackTraceMagic);
+    Append(buffer_, kCallbackTraceVersion);
+}
+
+CallbackTraceWriter::~CallbackTraceWriter()
+{
+    Flush();
+}
+
+void CallbackTraceWriter::Write(const CallbackTraceEvent& event)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!stream_.is_open())
+    {
+        return;
+    }
+
+    // the timestamp is taken under the lock, so timestamps grow in the order of the file
+    const uint64_t timestamp =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+
+    Append(buffer_, (uint8_t) event.type);
+    Append(buffer_, event.thread);
+    Append(buffer_, timestamp);
+
+    switch (event.type)
+    {
+        case CallbackTraceEventType::ModuleLoadFinished:
+            Append(buffer_, event.module_id);
+            Append(buffer_, event.hr_status);
+            Append(buffer_, event.app_domain_id);
+            Append(buffer_, event.assembly_version);
+            Append(buffer_, event.module_version_id);
+            AppendString(buffer_, event.assembly_name);
+            AppendString(buffer_, event.module_path);
+            break;
+        case CallbackTraceEventType::AssemblyLoadFinished:
+            Append(buffer_, event.assembly_id);
+            Append(buffer_, event.hr_status);
+            Append(buffer_, event.module_id);
+            break;
+        case CallbackTraceEventType::JITCompilationStarted:
+            Append(buffer_, event.function_id);
+            Append(buffer_, event.module_id);
+            Append(buffer_, event.token);
+            Append(buffer_, event.is_safe_to_block);
+            break;
+        case CallbackTraceEventType::GetReJITParameters:
+            Append(buffer_, event.module_id);
+            Append(buffer_, event.token);
+            break;
+        case CallbackTraceEventType::JITInlining:
+            Append(buffer_, event.function_id);
+            Append(buffer_, event.module_id);
+            Append(buffer_, event.token);
+            Append(buffer_, event.callee_function_id);
+            Append(buffer_, event.callee_module_id);
+            Append(buffer_, event.callee_token);
+            break;
+    }
+
+    if (buffer_.size() >= kFlushThreshold)
+    {
+        stream_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+}
+
+void CallbackTraceWriter::RecordModuleLoadFinished(ICorProfilerInfo4* info, ModuleID module_id, HRESULT hr_status)
+{
+    CallbackTraceEvent event;
+    event.type = CallbackTraceEventType::ModuleLoadFinished;
+    event.thread = GetTraceThread();
+    event.module_id = module_id;
+    event.hr_status = hr_status;
+
+    const auto module_info = SUCCEEDED(hr_status) ? GetModuleInfo(info, module_id) : ModuleInfo();
+    if (module_info.IsValid())
+    {
+        event.app_domain_id = module_info.assembly.app_domain_id;
+        event.assembly_name = module_info.assembly.name;
+        event.module_path = module_info.path;
+
+        ComPtr<IUnknown> metadata_interfaces;
+        if (SUCCEEDED(info->GetModuleMetaData(module_id, ofRead, IID_IMetaDataImport2,
+                                              metadata_interfaces.GetAddressOf())))
+        {
+            const auto metadata_import = metadata_interfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
+            metadata_import->GetScopeProps(nullptr, 0, nullptr, &event.module_version_id);
+
+            const auto assembly_import = metadata_interfaces.As<IMetaDataAssemblyImport>(IID_IMetaDataAssemblyImport);
+            const auto assembly_metadata = GetAssemblyImportMetadata(assembly_import);
+            event.assembly_version[0] = assembly_metadata.version.major;
+            event.assembly_version[1] = assembly_metadata.version.minor;
+            event.assembly_version[2] = assembly_metadata.version.build;
+            event.assembly_version[3] = assembly_metadata.version.revision;
+        }
+    }
+
+    Write(event);
+}
+
+void CallbackTraceWriter::RecordAssemblyLoadFinished(ICorProfilerInfo4* info, AssemblyID assembly_id,
+                                                     HRESULT hr_status)
+{
+    CallbackTraceEvent event;
+    event.type = CallbackTraceEventType::AssemblyLoadFinished;
+    event.thread = GetTraceThread();
+    event.assembly_id = assembly_id;
+    event.hr_status = hr_status;
+
+    if (SUCCEEDED(hr_status))
+    {
+        event.module_id = GetAssemblyInfo(info, assembly_id).manifest_module_id;
+    }
+
+    Write(event);
+}
+
+void CallbackTraceWriter::RecordJITCompilationStarted(ICorProfilerInfo4* info, FunctionID function_id,
+                                                      BOOL is_safe_to_block)
+{
+    CallbackTraceEvent event;
+    event.type = CallbackTraceEventType::JITCompilationStarted;
+    event.thread = GetTraceThread();
+    event.function_id = function_id;
+    event.is_safe_to_block = is_safe_to_block;
+    info->GetFunctionInfo(function_id, nullptr, &event.module_id, &event.token);
+
+    Write(event);
+}
+
+void CallbackTraceWriter::RecordGetReJITParameters(ModuleID module_id, mdMethodDef method_def)
+{
+    CallbackTraceEvent event;
+    event.type = CallbackTraceEventType::GetReJITParameters;
+    event.thread = GetTraceThread();
+    event.module_id = module_id;
+    event.token = method_def;
+
+    Write(event);
+}
+
+void CallbackTraceWriter::RecordJITInlining(ICorProfilerInfo4* info, FunctionID caller_id, FunctionID callee_id)
+{
+    CallbackTraceEvent event;
+    event.type = CallbackTraceEventType::JITInlining;
+    event.thread = GetTraceThread();
+    event.function_id = caller_id;
+    event.callee_function_id = callee_id;
+    info->GetFunctionInfo(caller_id, nullptr, &event.module_id, &event.token);
+    info->GetFunctionInfo(callee_id, nullptr, &event.callee_module_id, &event.callee_token);
+
+    Write(event);
+}
+
+void CallbackTraceWriter::Flush()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!stream_.is_open())
+    {
+        return;
+    }
+
+    stream_.write(buffer_.data(), buffer_.size());
+    stream_.flush();
+    buffer_.clear();
+}
+
+bool ReadCallbackTrace(const WSTRING& path, std::vector<CallbackTraceEvent>& events)
+{
+    std::ifstream stream(ToString(path), std::ios::binary);
+    if (!stream.is_open())
+    {
+        return false;
+    }
+
+    uint32_t magic;
+    uint32_t version;
+    if (!Read(stream, magic) || !Read(stream, version) || magic != kCallbackTraceMagic ||
+        version != kCallbackTraceVersion)
+    {
+        return false;
+    }
+
+    CallbackTraceEvent event;
+    while (stream.peek() != std::char_traits<char>::eof())
+    {
+        if (!ReadEvent(stream, event))
+        {
+            // the rest of a file truncated while writing is dropped, anything else is a corrupted file
+            return stream.eof();
+        }
+        events.push_back(event);
+        event = {};
+    }
+
+    return true;
+}
+
+} // namespace trace
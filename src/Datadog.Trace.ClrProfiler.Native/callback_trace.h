@@ -0,0 +1,98 @@
+#ifndef DD_CLR_PROFILER_CALLBACK_TRACE_H_
+#define DD_CLR_PROFILER_CALLBACK_TRACE_H_
+
+#include <corhlpr.h>
+#include <corprof.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "string.h"
+#include "util.h"
+
+namespace trace
+{
+
+enum class CallbackTraceEventType : uint8_t
+{
+    ModuleLoadFinished = 1,
+    AssemblyLoadFinished,
+    JITCompilationStarted,
+    GetReJITParameters,
+    JITInlining,
+};
+
+// A recorded profiler callback. Only the fields of its type are set:
+// - ModuleLoadFinished: module_id, hr_status and the identity of the module (app domain, assembly, MVID, path)
+// - AssemblyLoadFinished: assembly_id, hr_status and module_id, the manifest module of the assembly
+// - JITCompilationStarted: function_id, module_id, token and is_safe_to_block
+// - GetReJITParameters: module_id and token
+// - JITInlining: function_id, module_id and token of the caller, callee_* of the callee
+struct CallbackTraceEvent
+{
+    CallbackTraceEventType type = CallbackTraceEventType::ModuleLoadFinished;
+    uint32_t thread = 0;    // small number assigned to each thread in the order they first record an event
+    uint64_t timestamp = 0; // nanoseconds since the trace was created
+    HRESULT hr_status = S_OK;
+
+    ModuleID module_id = 0;
+    AppDomainID app_domain_id = 0;
+    AssemblyID assembly_id = 0;
+    FunctionID function_id = 0;
+    mdToken token = mdTokenNil;
+    BOOL is_safe_to_block = FALSE;
+
+    FunctionID callee_function_id = 0;
+    ModuleID callee_module_id = 0;
+    mdToken callee_token = mdTokenNil;
+
+    WSTRING assembly_name;
+    USHORT assembly_version[4]{};
+    GUID module_version_id{};
+    WSTRING module_path;
+};
+
+// CallbackTraceWriter records the profiler callbacks of a process into a binary file, so the same sequence can
+// be replayed later against the native library without a runtime.
+//
+// The callbacks are written in the order they are recorded, from any thread. Ids are the ones of the recorded
+// process, modules carry their path and MVID so a replay can find their metadata again.
+class CallbackTraceWriter : public UnCopyable
+{
+private:
+    std::mutex lock_;
+    std::ofstream stream_;
+    std::vector<char> buffer_;
+    const std::chrono::steady_clock::time_point start_;
+
+    void Write(const CallbackTraceEvent& event);
+
+public:
+    explicit CallbackTraceWriter(const WSTRING& path);
+    ~CallbackTraceWriter();
+
+    bool IsOpen() const
+    {
+        return stream_.is_open();
+    }
+
+    void RecordModuleLoadFinished(ICorProfilerInfo4* info, ModuleID module_id, HRESULT hr_status);
+    void RecordAssemblyLoadFinished(ICorProfilerInfo4* info, AssemblyID assembly_id, HRESULT hr_status);
+    void RecordJITCompilationStarted(ICorProfilerInfo4* info, FunctionID function_id, BOOL is_safe_to_block);
+    void RecordGetReJITParameters(ModuleID module_id, mdMethodDef method_def);
+    void RecordJITInlining(ICorProfilerInfo4* info, FunctionID caller_id, FunctionID callee_id);
+
+    // Writes the buffered events to the file
+    void Flush();
+};
+
+// Reads a file written by CallbackTraceWriter. Returns false if the file can't be read or is corrupted,
+// a file truncated by a crash returns the events before the truncated one.
+bool ReadCallbackTrace(const WSTRING& path, std::vector<CallbackTraceEvent>& events);
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_CALLBACK_TRACE_H_
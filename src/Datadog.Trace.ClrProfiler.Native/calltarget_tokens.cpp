@@ -480,17 +480,20 @@ mdToken CallTargetTokens::GetCurrentTypeRef(const TypeInfo* currentType, bool& i
     }
     else
     {
+        ModuleMetadata* module_metadata = GetMetadata();
 
-        TypeInfo* cType = const_cast<TypeInfo*>(currentType);
+        const TypeInfo* cType = currentType;
+        std::shared_ptr<const TypeInfo> parentType;
         while (!cType->isGeneric)
         {
-
-            if (cType->parent_type == nullptr)
+            // keeps the enclosing type alive while we walk up
+            parentType = module_metadata->metadata_cache.GetParentType(*cType);
+            if (parentType == nullptr)
             {
                 return cType->id;
             }
 
-            cType = const_cast<TypeInfo*>(cType->parent_type.get());
+            cType = parentType.get();
         }
 
         isValueType = false;
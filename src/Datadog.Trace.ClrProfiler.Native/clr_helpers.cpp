@@ -10,6 +10,7 @@
 #include "sig_helpers.h"
 #include <set>
 #include <stack>
+#include <unordered_map>
 
 namespace trace
 {
@@ -206,15 +207,40 @@ ModuleInfo GetModuleInfo(ICorProfilerInfo4* info, const ModuleID& module_id)
     return {module_id, WSTRING(module_path), GetAssemblyInfo(info, assembly_id), module_flags};
 }
 
+// Returns the name of a TypeDef or TypeRef without resolving anything else about the type
+static WSTRING GetTypeName(const ComPtr<IMetaDataImport2>& metadata_import, const mdToken& token)
+{
+    WCHAR type_name[kNameMaxSize]{};
+    DWORD type_name_len = 0;
+    DWORD type_flags;
+    mdToken unused_token = mdTokenNil;
+    HRESULT hr = E_FAIL;
+
+    switch (TypeFromToken(token))
+    {
+        case mdtTypeDef:
+            hr = metadata_import->GetTypeDefProps(token, type_name, kNameMaxSize, &type_name_len, &type_flags,
+                                                  &unused_token);
+            break;
+        case mdtTypeRef:
+            hr = metadata_import->GetTypeRefProps(token, &unused_token, type_name, kNameMaxSize, &type_name_len);
+            break;
+    }
+
+    if (FAILED(hr) || type_name_len == 0)
+    {
+        return WStr("");
+    }
+    return WSTRING(type_name);
+}
+
 TypeInfo GetTypeInfo(const ComPtr<IMetaDataImport2>& metadata_import, const mdToken& token)
 {
     mdToken parent_token = mdTokenNil;
-    std::shared_ptr<TypeInfo> parentTypeInfo = nullptr;
     mdToken parent_type_token = mdTokenNil;
     WCHAR type_name[kNameMaxSize]{};
     DWORD type_name_len = 0;
     DWORD type_flags;
-    std::shared_ptr<TypeInfo> extendsInfo = nullptr;
     mdToken type_extends = mdTokenNil;
     bool type_valueType = false;
     bool type_isGeneric = false;
@@ -229,16 +255,12 @@ TypeInfo GetTypeInfo(const ComPtr<IMetaDataImport2>& metadata_import, const mdTo
                                                   &type_extends);
 
             metadata_import->GetNestedClassProps(token, &parent_type_token);
-            if (parent_type_token != mdTokenNil)
-            {
-                parentTypeInfo = std::make_shared<TypeInfo>(GetTypeInfo(metadata_import, parent_type_token));
-            }
 
+            // only the name of the base type is needed here, the rest of the hierarchy is resolved on demand
             if (type_extends != mdTokenNil)
             {
-                extendsInfo = std::make_shared<TypeInfo>(GetTypeInfo(metadata_import, type_extends));
-                type_valueType =
-                    extendsInfo->name == WStr("System.ValueType") || extendsInfo->name == WStr("System.Enum");
+                const auto extends_name = GetTypeName(metadata_import, type_extends);
+                type_valueType = extends_name == WStr("System.ValueType") || extends_name == WStr("System.Enum");
             }
             break;
         case mdtTypeRef:
@@ -261,9 +283,9 @@ TypeInfo GetTypeInfo(const ComPtr<IMetaDataImport2>& metadata_import, const mdTo
                 mdToken type_token;
                 CorSigUncompressToken(&signature[2], &type_token);
                 const auto baseType = GetTypeInfo(metadata_import, type_token);
-                return {baseType.id,        baseType.name,        token,
-                        token_type,         baseType.extend_from, baseType.valueType,
-                        baseType.isGeneric, baseType.parent_type};
+                return {baseType.id,        baseType.name,              token,
+                        token_type,         baseType.extend_from_token, baseType.valueType,
+                        baseType.isGeneric, baseType.parent_type_token};
             }
         }
         break;
@@ -290,8 +312,8 @@ TypeInfo GetTypeInfo(const ComPtr<IMetaDataImport2>& metadata_import, const mdTo
         type_isGeneric = idxFromRight == 1 || idxFromRight == 2;
     }
 
-    return {token,       type_name_string, mdTypeSpecNil,  token_type,
-            extendsInfo, type_valueType,   type_isGeneric, parentTypeInfo};
+    return {token,        type_name_string, mdTypeSpecNil,  token_type,
+            type_extends, type_valueType,   type_isGeneric, parent_type_token};
 }
 
 mdAssemblyRef FindAssemblyRef(const ComPtr<IMetaDataAssemblyImport>& assembly_import, const WSTRING& assembly_name)
@@ -358,26 +380,26 @@ std::vector<IntegrationMethod> FlattenIntegrations(const std::vector<Integration
     return flattened;
 }
 
-std::vector<IntegrationMethod> FilterIntegrationsByCaller(const std::vector<IntegrationMethod>& integration_methods,
-                                                          const AssemblyInfo assembly)
+std::vector<const IntegrationMethod*>
+FilterIntegrationsByCaller(const std::vector<IntegrationMethod>& integration_methods, const AssemblyInfo assembly)
 {
-    std::vector<IntegrationMethod> enabled;
+    std::vector<const IntegrationMethod*> enabled;
 
     for (auto& i : integration_methods)
     {
         if (i.replacement.caller_method.assembly.name.empty() ||
             i.replacement.caller_method.assembly.name == assembly.name)
         {
-            enabled.push_back(i);
+            enabled.push_back(&i);
         }
     }
 
     return enabled;
 }
 
-bool AssemblyMeetsIntegrationRequirements(const AssemblyMetadata metadata, const MethodReplacement method_replacement)
+bool AssemblyMeetsIntegrationRequirements(const AssemblyMetadata& metadata, const MethodReplacement& method_replacement)
 {
-    const auto target = method_replacement.target_method;
+    const auto& target = method_replacement.target_method;
 
     if (target.assembly.name != metadata.name)
     {
@@ -398,37 +420,41 @@ bool AssemblyMeetsIntegrationRequirements(const AssemblyMetadata metadata, const
     return true;
 }
 
-std::vector<IntegrationMethod> FilterIntegrationsByTarget(const std::vector<IntegrationMethod>& integration_methods,
-                                                          const ComPtr<IMetaDataAssemblyImport>& assembly_import)
+std::vector<const IntegrationMethod*>
+FilterIntegrationsByTarget(const std::vector<const IntegrationMethod*>& integration_methods,
+                           const ComPtr<IMetaDataAssemblyImport>& assembly_import)
 {
-    std::vector<IntegrationMethod> enabled;
+    std::vector<const IntegrationMethod*> enabled;
+
+    // The assembly itself and its references are read once, the integrations are then matched by target name.
+    // A name can be referenced more than once, with different versions.
+    std::unordered_map<WSTRING, std::vector<AssemblyMetadata>> assemblies;
 
     const auto assembly_metadata = GetAssemblyImportMetadata(assembly_import);
+    assemblies[assembly_metadata.name].push_back(assembly_metadata);
 
-    for (auto& i : integration_methods)
+    for (auto& assembly_ref : EnumAssemblyRefs(assembly_import))
+    {
+        const auto metadata_ref = GetReferencedAssemblyMetadata(assembly_import, assembly_ref);
+        assemblies[metadata_ref.name].push_back(metadata_ref);
+    }
+
+    for (auto i : integration_methods)
     {
-        bool found = false;
-        if (AssemblyMeetsIntegrationRequirements(assembly_metadata, i.replacement))
+        const auto found = assemblies.find(i->replacement.target_method.assembly.name);
+        if (found == assemblies.end())
         {
-            found = true;
+            continue;
         }
-        else
+
+        for (const auto& metadata : found->second)
         {
-            for (auto& assembly_ref : EnumAssemblyRefs(assembly_import))
+            if (AssemblyMeetsIntegrationRequirements(metadata, i->replacement))
             {
-                const auto metadata_ref = GetReferencedAssemblyMetadata(assembly_import, assembly_ref);
-                if (AssemblyMeetsIntegrationRequirements(metadata_ref, i.replacement))
-                {
-                    found = true;
-                    break;
-                }
+                enabled.push_back(i);
+                break;
             }
         }
-
-        if (found)
-        {
-            enabled.push_back(i);
-        }
     }
 
     return enabled;
@@ -338,32 +338,33 @@ struct TypeInfo
     const WSTRING name;
     const mdTypeSpec type_spec;
     const ULONG32 token_type;
-    std::shared_ptr<TypeInfo> extend_from;
+    // the base type and the enclosing type are resolved on demand, see MetadataCache
+    const mdToken extend_from_token;
     const bool valueType;
     const bool isGeneric;
-    std::shared_ptr<TypeInfo> parent_type;
+    const mdToken parent_type_token;
 
     TypeInfo() :
         id(0),
         name(WStr("")),
         type_spec(0),
         token_type(0),
-        extend_from(nullptr),
+        extend_from_token(mdTokenNil),
         valueType(false),
         isGeneric(false),
-        parent_type(nullptr)
+        parent_type_token(mdTokenNil)
     {
     }
-    TypeInfo(mdToken id, WSTRING name, mdTypeSpec type_spec, ULONG32 token_type, std::shared_ptr<TypeInfo> extend_from,
-             bool valueType, bool isGeneric, std::shared_ptr<TypeInfo> parent_type) :
+    TypeInfo(mdToken id, WSTRING name, mdTypeSpec type_spec, ULONG32 token_type, mdToken extend_from_token,
+             bool valueType, bool isGeneric, mdToken parent_type_token) :
         id(id),
         name(name),
         type_spec(type_spec),
         token_type(token_type),
-        extend_from(extend_from),
+        extend_from_token(extend_from_token),
         valueType(valueType),
         isGeneric(isGeneric),
-        parent_type(parent_type)
+        parent_type_token(parent_type_token)
     {
     }
 
@@ -521,14 +522,15 @@ std::vector<IntegrationMethod> FlattenIntegrations(const std::vector<Integration
                                                    bool is_calltarget_enabled);
 
 // FilterIntegrationsByCaller removes any integrations which have a caller and
-// its not set to the module
-std::vector<IntegrationMethod> FilterIntegrationsByCaller(const std::vector<IntegrationMethod>& integration_methods,
-                                                          const AssemblyInfo assembly);
+// its not set to the module. The result points into integration_methods.
+std::vector<const IntegrationMethod*>
+FilterIntegrationsByCaller(const std::vector<IntegrationMethod>& integration_methods, const AssemblyInfo assembly);
 
 // FilterIntegrationsByTarget removes any integrations which have a target not
 // referenced by the module's assembly import
-std::vector<IntegrationMethod> FilterIntegrationsByTarget(const std::vector<IntegrationMethod>& integration_methods,
-                                                          const ComPtr<IMetaDataAssemblyImport>& assembly_import);
+std::vector<const IntegrationMethod*>
+FilterIntegrationsByTarget(const std::vector<const IntegrationMethod*>& integration_methods,
+                           const ComPtr<IMetaDataAssemblyImport>& assembly_import);
 
 // FilterIntegrationsByTargetAssemblyName removes any integrations which target any
 // of the specified assemblies
@@ -541,6 +543,7 @@ mdMethodSpec DefineMethodSpec(const ComPtr<IMetaDataEmit2>& metadata_emit, const
 
 bool DisableOptimizations();
 bool EnableInlining(bool defaultValue);
+bool IsNGENEnabled();
 bool IsCallTargetEnabled(bool defaultValue);
 
 bool TryParseSignatureTypes(const ComPtr<IMetaDataImport2>& metadata_import, const FunctionInfo& function_info,
@@ -557,6 +560,15 @@ bool ReturnTypeIsValueTypeOrGeneric(const ComPtr<IMetaDataImport2>& metadata_imp
 
 bool FindTypeDefByName(const trace::WSTRING instrumentationTargetMethodTypeName, const trace::WSTRING assemblyName,
                        const ComPtr<IMetaDataImport2>& metadata_import, mdTypeDef& typeDef);
+
+// Signature blob parsing, each function moves pbCur past what it read and fails at pbEnd
+bool ParseByte(PCCOR_SIGNATURE& pbCur, PCCOR_SIGNATURE pbEnd, unsigned char* pbOut);
+bool ParseNumber(PCCOR_SIGNATURE& pbCur, PCCOR_SIGNATURE pbEnd, unsigned* pOut);
+bool ParseParam(PCCOR_SIGNATURE& pbCur, PCCOR_SIGNATURE pbEnd);
+bool ParseRetType(PCCOR_SIGNATURE& pbCur, PCCOR_SIGNATURE pbEnd);
+
+// Returns the type name of the type at pbCur, in the format of the integration signature types
+WSTRING GetSigTypeTokName(PCCOR_SIGNATURE& pbCur, const ComPtr<IMetaDataImport2>& pImport);
 } // namespace trace
 
 #endif // DD_CLR_PROFILER_CLR_HELPERS_H_
@@ -2,6 +2,7 @@
 
 #include "corhlpr.h"
 #include <corprof.h>
+#include <algorithm>
 #include <string>
 
 #include "clr_helpers.h"
@@ -11,6 +12,8 @@
 #include "environment_variables_util.h"
 #include "il_rewriter.h"
 #include "il_rewriter_wrapper.h"
+#include "integration_catalog.h"
+#include "integration_index.h"
 #include "integration_loader.h"
 #include "logging.h"
 #include "metadata_builder.h"
@@ -18,6 +21,7 @@
 #include "pal.h"
 #include "resource.h"
 #include "sig_helpers.h"
+#include "signature_matcher.h"
 #include "stats.h"
 #include "util.h"
 #include "version.h"
@@ -146,10 +150,16 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
         }
     }
 
-    // get path to integration definition JSON files
+    // get the integration catalog compiled into the profiler at build time
+    const BYTE* integrations_catalog = nullptr;
+    size_t integrations_catalog_size = 0;
+    const bool has_integrations_catalog =
+        GetIntegrationCatalogBytes(&integrations_catalog, &integrations_catalog_size);
+
+    // get path to integration definition JSON files, only required when there is no embedded catalog
     const WSTRING integrations_paths = GetEnvironmentValue(environment::integrations_path);
 
-    if (integrations_paths.empty())
+    if (integrations_paths.empty() && !has_integrations_catalog)
     {
         Warn("DATADOG TRACER DIAGNOSTICS - Profiler disabled: ", environment::integrations_path,
              " environment variable not set.");
@@ -161,18 +171,36 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
     // Initialize ReJIT handler and define the Rewriter Callback
     if (is_calltarget_enabled)
     {
-        rejit_handler =
-            new RejitHandler(this->info_, [this](RejitHandlerModule* mod, RejitHandlerModuleMethod* method) {
+        rejit_handler = new RejitHandler(
+            this->info_,
+            [this](RejitHandlerModule* mod, RejitHandlerModuleMethod* method) {
                 return this->CallTarget_RewriterCallback(mod, method);
-            });
+            },
+            GetRejitBatchWindowMilliseconds(), GetRejitBatchMaxMethods());
+
+        const auto module_analysis_threads = GetModuleAnalysisThreads();
+        Info("Modules are analyzed by ", module_analysis_threads, " threads.");
+        module_analysis_pool_ = std::make_unique<ModuleAnalysisPool>(
+            module_analysis_threads, [this](ModuleID module_id) { this->CallTarget_AnalyzeModule(module_id); });
     }
     else
     {
         rejit_handler = nullptr;
     }
 
-    // load all available integrations from JSON files
-    const std::vector<Integration> all_integrations = LoadIntegrationsFromEnvironment();
+    // load all available integrations from the embedded catalog
+    std::vector<Integration> all_integrations;
+    if (has_integrations_catalog)
+    {
+        all_integrations = LoadIntegrationsFromCatalog(integrations_catalog, integrations_catalog_size);
+        Debug("Loaded ", all_integrations.size(), " integrations from the embedded catalog.");
+    }
+
+    // integrations from JSON files override the ones with the same name in the catalog
+    if (!integrations_paths.empty())
+    {
+        all_integrations = ApplyIntegrationOverrides(all_integrations, LoadIntegrationsFromEnvironment());
+    }
 
     // get list of disabled integration names
     const std::vector<WSTRING> disabled_integration_names = GetEnvironmentValues(environment::disabled_integrations);
@@ -181,17 +209,17 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
     const std::vector<Integration> integrations =
         FilterIntegrationsByName(all_integrations, disabled_integration_names);
 
-    integration_methods_ = FlattenIntegrations(integrations, is_calltarget_enabled);
+    std::vector<IntegrationMethod> integration_methods = FlattenIntegrations(integrations, is_calltarget_enabled);
 
     // check if there are any enabled integrations left
-    if (integration_methods_.empty())
+    if (integration_methods.empty())
     {
         Warn("DATADOG TRACER DIAGNOSTICS - Profiler disabled: no enabled integrations found.");
         return E_FAIL;
     }
     else
     {
-        Debug("Number of Integrations loaded: ", integration_methods_.size());
+        Debug("Number of Integrations loaded: ", integration_methods.size());
     }
 
     // temporarily skip the calls into netstandard.dll that were added in
@@ -200,11 +228,78 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
     // variable DD_TRACE_NETSTANDARD_ENABLED
     if (!IsNetstandardEnabled())
     {
-        integration_methods_ = FilterIntegrationsByTargetAssemblyName(integration_methods_, {WStr("netstandard")});
+        integration_methods = FilterIntegrationsByTargetAssemblyName(integration_methods, {WStr("netstandard")});
+    }
+
+    // every module shares this set instead of keeping its own copy of the integrations
+    integration_methods_ = std::make_shared<const std::vector<IntegrationMethod>>(std::move(integration_methods));
+    Stats::Instance()->AddIntegrationBytesRetained(GetRetainedBytes(*integration_methods_));
+
+    // index the integrations by target assembly so modules without integrations are skipped quickly
+    integration_index_ = IntegrationIndex(integration_methods_);
+
+    assembly_classifier_ = CreateDefaultAssemblyClassifier();
+    assembly_classifier_.AddSkippedPatterns(GetEnvironmentValues(environment::additional_skip_assemblies));
+    for (const auto& integration_method : *integration_methods_)
+    {
+        assembly_classifier_.Add(integration_method.replacement.target_method.assembly.name,
+                                 AssemblyKind::IntegrationTarget);
+    }
+
+    if (is_calltarget_enabled)
+    {
+        const WSTRING rejit_plan_cache_directory = GetEnvironmentValue(environment::rejit_plan_cache_directory);
+        if (!rejit_plan_cache_directory.empty())
+        {
+            Info("ReJIT plan cache is enabled: ", rejit_plan_cache_directory);
+            rejit_plan_cache_ = std::make_unique<RejitPlanCache>(rejit_plan_cache_directory,
+                                                                 GetIntegrationMethodsHash(*integration_methods_));
+        }
+    }
+
+    if (IsStatsFileEnabled())
+    {
+        const WSTRING stats_file_path = DatadogStatsFilePath();
+        if (Stats::Instance()->ExportToFile(stats_file_path))
+        {
+            Info("Profiler stats are exported to ", stats_file_path);
+        }
+        else
+        {
+            Warn("Unable to create the profiler stats file ", stats_file_path);
+        }
+    }
+
+    const WSTRING callback_trace_path = GetEnvironmentValue(environment::callback_trace_path);
+    if (!callback_trace_path.empty())
+    {
+        callback_trace_ = std::make_unique<CallbackTraceWriter>(callback_trace_path);
+        if (callback_trace_->IsOpen())
+        {
+            Info("Profiler callbacks are recorded to ", callback_trace_path);
+        }
+        else
+        {
+            callback_trace_ = nullptr;
+        }
     }
 
     DWORD event_mask = COR_PRF_MONITOR_JIT_COMPILATION | COR_PRF_DISABLE_TRANSPARENCY_CHECKS_UNDER_FULL_TRUST |
-                       COR_PRF_MONITOR_MODULE_LOADS | COR_PRF_MONITOR_ASSEMBLY_LOADS | COR_PRF_DISABLE_ALL_NGEN_IMAGES;
+                       COR_PRF_MONITOR_MODULE_LOADS | COR_PRF_MONITOR_ASSEMBLY_LOADS;
+
+    // CallTarget rewrites the target methods with ReJIT, which works on precompiled code. The call-site
+    // instrumentation needs every caller to be JIT compiled from IL.
+    if (is_calltarget_enabled && IsNGENEnabled())
+    {
+        Info("ReadyToRun and NGEN images are enabled.");
+        // the first method run in an AppDomain is JIT compiled to insert the startup hook
+        event_mask |= COR_PRF_MONITOR_CACHE_SEARCHES;
+    }
+    else
+    {
+        Info("ReadyToRun and NGEN images are disabled.");
+        event_mask |= COR_PRF_DISABLE_ALL_NGEN_IMAGES;
+    }
 
     if (is_calltarget_enabled)
     {
@@ -232,6 +327,29 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
         event_mask |= COR_PRF_DISABLE_OPTIMIZATIONS;
     }
 
+    if (is_calltarget_enabled)
+    {
+        if (rejit_handler->TracksInliners())
+        {
+            Info("ReJIT requests include the inliners of the instrumented methods.");
+        }
+
+        // JITInlining needs the JIT compilation events to keep the instrumented methods from being inlined, unless
+        // the runtime tracks the inliners. The callback trace records them.
+        const bool needs_jit_inlining =
+            (event_mask & COR_PRF_DISABLE_INLINING) == 0 && !rejit_handler->TracksInliners();
+        if (!needs_jit_inlining && callback_trace_ == nullptr)
+        {
+            startup_hook_events_ |= COR_PRF_MONITOR_JIT_COMPILATION;
+        }
+        startup_hook_events_ |= event_mask & COR_PRF_MONITOR_CACHE_SEARCHES;
+    }
+    if (startup_hook_events_ != 0)
+    {
+        // a new AppDomain needs the startup hook
+        event_mask |= COR_PRF_MONITOR_APPDOMAIN_LOADS;
+    }
+
     const WSTRING domain_neutral_instrumentation = GetEnvironmentValue(environment::domain_neutral_instrumentation);
 
     if (domain_neutral_instrumentation == WStr("1") || domain_neutral_instrumentation == WStr("true"))
@@ -293,10 +411,40 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
     return S_OK;
 }
 
+HRESULT STDMETHODCALLTYPE CorProfiler::AppDomainCreationStarted(AppDomainID app_domain_id)
+{
+    Debug("AppDomainCreationStarted: ", app_domain_id);
+
+    if (!is_attached_)
+    {
+        return S_OK;
+    }
+
+    // the startup hook is injected in the first method JIT compiled in the new AppDomain
+    std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
+    SetStartupHookEvents(true);
+    return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::AppDomainShutdownStarted(AppDomainID app_domain_id)
+{
+    Debug("AppDomainShutdownStarted: ", app_domain_id);
+
+    // an AppDomain unloaded before running any code doesn't need the startup hook anymore
+    std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
+    startup_hook_pending_app_domains_.erase(app_domain_id);
+    return S_OK;
+}
+
 HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyLoadFinished(AssemblyID assembly_id, HRESULT hr_status)
 {
     auto _ = trace::Stats::Instance()->AssemblyLoadFinishedMeasure();
 
+    if (callback_trace_ != nullptr)
+    {
+        callback_trace_->RecordAssemblyLoadFinished(this->info_, assembly_id, hr_status);
+    }
+
     if (FAILED(hr_status))
     {
         // if assembly failed to load, skip it entirely,
@@ -305,9 +453,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyLoadFinished(AssemblyID assembly_
         return S_OK;
     }
 
-    // keep this lock until we are done using the module,
-    // to prevent it from unloading while in use
-    std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+    // keep the registry pinned until we are done,
+    // so shutdown waits for this callback to complete
+    ModuleRegistry::ReadGuard guard(module_registry_);
 
     // double check if is_attached_ has changed to avoid possible race condition with shutdown function
     if (!is_attached_)
@@ -366,13 +514,15 @@ HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyLoadFinished(AssemblyID assembly_
             {
                 Info("AssemblyLoadFinished: Datadog.Trace.ClrProfiler.Managed v", assembly_version,
                      " matched profiler version v", PROFILER_VERSION);
+
+                std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
                 managed_profiler_loaded_app_domains.insert(assembly_info.app_domain_id);
 
-                if (runtime_information_.is_desktop() && corlib_module_loaded)
+                if (runtime_information_.is_desktop() && corlib_module_loaded.load(std::memory_order_acquire))
                 {
                     // Set the managed_profiler_loaded_domain_neutral flag whenever the
                     // managed profiler is loaded shared
-                    if (assembly_info.app_domain_id == corlib_app_domain_id)
+                    if (assembly_info.app_domain_id == corlib_app_domain_id.load(std::memory_order_relaxed))
                     {
                         Info("AssemblyLoadFinished: Datadog.Trace.ClrProfiler.Managed was loaded domain-neutral");
                         managed_profiler_loaded_domain_neutral = true;
@@ -396,7 +546,12 @@ HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyLoadFinished(AssemblyID assembly_
 
 HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HRESULT hr_status)
 {
-    auto _ = trace::Stats::Instance()->ModuleLoadFinishedMeasure();
+    auto measure = trace::Stats::Instance()->ModuleLoadFinishedMeasure();
+
+    if (callback_trace_ != nullptr)
+    {
+        callback_trace_->RecordModuleLoadFinished(this->info_, module_id, hr_status);
+    }
 
     if (FAILED(hr_status))
     {
@@ -411,9 +566,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         return S_OK;
     }
 
-    // keep this lock until we are done using the module,
-    // to prevent it from unloading while in use
-    std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+    // keep the registry pinned until we are done using the module metadata,
+    // to prevent it from being freed while in use
+    ModuleRegistry::ReadGuard guard(module_registry_);
 
     // double check if is_attached_ has changed to avoid possible race condition with shutdown function
     if (!is_attached_)
@@ -427,6 +582,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         return S_OK;
     }
 
+    // module_info goes away before the measure ends
+    const auto measure_name = measure.SetScopedName(module_info.assembly.name);
+
     if (debug_logging_enabled)
     {
         Debug("ModuleLoadFinished: ", module_id, " ", module_info.assembly.name, " AppDomain ",
@@ -437,11 +595,12 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
 
     // Identify the AppDomain ID of mscorlib which will be the Shared Domain
     // because mscorlib is always a domain-neutral assembly
-    if (!corlib_module_loaded &&
+    std::unique_lock<std::mutex> app_domains_guard(app_domains_lock_);
+    if (!corlib_module_loaded.load(std::memory_order_relaxed) &&
         (module_info.assembly.name == WStr("mscorlib") || module_info.assembly.name == WStr("System.Private.CoreLib")))
     {
-        corlib_module_loaded = true;
-        corlib_app_domain_id = app_domain_id;
+        corlib_app_domain_id.store(app_domain_id, std::memory_order_relaxed);
+        corlib_module_loaded.store(true, std::memory_order_release);
 
         ComPtr<IUnknown> metadata_interfaces;
         auto hr = this->info_->GetModuleMetaData(module_id, ofRead | ofWrite, IID_IMetaDataImport2,
@@ -474,14 +633,19 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
     // but the Datadog.Trace.ClrProfiler.Managed.Loader assembly that the startup hook loads from a
     // byte array will be loaded into a non-shared AppDomain.
     // In this case, do not insert another startup hook into that non-shared AppDomain
-    if (module_info.assembly.name == WStr("Datadog.Trace.ClrProfiler.Managed.Loader"))
+    if (module_info.assembly.name == managed_loader_name)
     {
         Info("ModuleLoadFinished: Datadog.Trace.ClrProfiler.Managed.Loader loaded into AppDomain ", app_domain_id, " ",
              module_info.assembly.app_domain_name);
         first_jit_compilation_app_domains.insert(app_domain_id);
+        startup_hook_pending_app_domains_.erase(app_domain_id);
         return S_OK;
     }
 
+    const bool has_loader_injected_in_appdomain =
+        first_jit_compilation_app_domains.find(app_domain_id) != first_jit_compilation_app_domains.end();
+    app_domains_guard.unlock();
+
     if (module_info.IsWindowsRuntime())
     {
         // We cannot obtain writable metadata interfaces on Windows Runtime modules
@@ -490,32 +654,50 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         return S_OK;
     }
 
-    for (auto&& skip_assembly_pattern : skip_assembly_prefixes)
+    const auto assembly_kind = assembly_classifier_.Classify(module_info.assembly.name);
+    if (assembly_kind == AssemblyKind::Skipped)
     {
-        if (module_info.assembly.name.rfind(skip_assembly_pattern, 0) == 0)
-        {
-            Debug("ModuleLoadFinished skipping module by pattern: ", module_id, " ", module_info.assembly.name);
-            return S_OK;
-        }
+        Debug("ModuleLoadFinished skipping known module: ", module_id, " ", module_info.assembly.name);
+        return S_OK;
     }
 
-    for (auto&& skip_assembly : skip_assemblies)
+    const bool is_calltarget_enabled = IsCallTargetEnabled(is_net46_or_greater);
+
+    std::vector<const IntegrationMethod*> filtered_integrations;
+
+    if (is_calltarget_enabled)
     {
-        if (module_info.assembly.name == skip_assembly)
+        // In CallTarget mode we only need the metadata of modules targeted by an integration. Any other module is
+        // only used to inject the startup hook, so once the loader is in its AppDomain there is nothing to do.
+        if (assembly_kind == AssemblyKind::Other && has_loader_injected_in_appdomain)
         {
-            Debug("ModuleLoadFinished skipping known module: ", module_id, " ", module_info.assembly.name);
+            Debug("ModuleLoadFinished skipping module (not an integration target): ", module_id, " ",
+                  module_info.assembly.name);
             return S_OK;
         }
-    }
-
-  std::vector<IntegrationMethod> filtered_integrations = IsCallTargetEnabled(is_net46_or_greater) ?
-      integration_methods_ : FilterIntegrationsByCaller(integration_methods_, module_info.assembly);
 
-    if (filtered_integrations.empty())
+        if (!has_loader_injected_in_appdomain)
+        {
+            // the startup hook events may have been dropped before this AppDomain ran any code
+            std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
+            if (first_jit_compilation_app_domains.find(app_domain_id) == first_jit_compilation_app_domains.end())
+            {
+                startup_hook_pending_app_domains_.insert(app_domain_id);
+                SetStartupHookEvents(true);
+            }
+        }
+    }
+    else
     {
-        // we don't need to instrument anything in this module, skip it
-        Debug("ModuleLoadFinished skipping module (filtered by caller): ", module_id, " ", module_info.assembly.name);
-        return S_OK;
+        filtered_integrations = FilterIntegrationsByCaller(*integration_methods_, module_info.assembly);
+
+        if (filtered_integrations.empty())
+        {
+            // we don't need to instrument anything in this module, skip it
+            Debug("ModuleLoadFinished skipping module (filtered by caller): ", module_id, " ",
+                  module_info.assembly.name);
+            return S_OK;
+        }
     }
 
     ComPtr<IUnknown> metadata_interfaces;
@@ -538,7 +720,7 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
     // don't skip Dapper: it makes ADO.NET calls even though it doesn't reference
     // System.Data or System.Data.Common
     if (module_info.assembly.name != WStr("Microsoft.AspNetCore.Hosting") &&
-        module_info.assembly.name != WStr("Dapper") && !IsCallTargetEnabled(is_net46_or_greater))
+        module_info.assembly.name != WStr("Dapper") && !is_calltarget_enabled)
     {
         filtered_integrations = FilterIntegrationsByTarget(filtered_integrations, assembly_import);
 
@@ -551,6 +733,13 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         }
     }
 
+    if (is_calltarget_enabled && assembly_kind == AssemblyKind::IntegrationTarget)
+    {
+        const auto assembly_metadata = GetAssemblyImportMetadata(assembly_import);
+        filtered_integrations =
+            integration_index_.GetIntegrationsForTarget(module_info.assembly.name, assembly_metadata.version);
+    }
+
     mdModule module;
     hr = metadata_import->GetModuleFromScope(&module);
     if (FAILED(hr))
@@ -569,18 +758,28 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
 
     ModuleMetadata* module_metadata =
         new ModuleMetadata(metadata_import, metadata_emit, assembly_import, assembly_emit, module_info.assembly.name,
-                           app_domain_id, module_version_id, filtered_integrations, &corAssemblyProperty);
+                           app_domain_id, module_version_id, integration_methods_, std::move(filtered_integrations),
+                           &corAssemblyProperty);
+
+    // The module is analyzed and the ReJIT of the integrations defined in it requested on the analysis pool.
+    const bool needs_analysis = is_calltarget_enabled && !module_metadata->integrations.empty();
+    if (needs_analysis)
+    {
+        // published with the module, so the inlining callback never sees it before the flag
+        module_metadata->analysis_pending.store(true, std::memory_order_relaxed);
+    }
 
     // store module info for later lookup
-    module_id_to_info_map_[module_id] = module_metadata;
+    module_registry_.Add(module_id, module_metadata);
+    Stats::Instance()->AddModulesTracked(1);
+    Stats::Instance()->AddIntegrationBytesRetained(module_metadata->GetRetainedBytes());
 
     Debug("ModuleLoadFinished stored metadata for ", module_id, " ", module_info.assembly.name, " AppDomain ",
           module_info.assembly.app_domain_id, " ", module_info.assembly.app_domain_name);
 
-    // We call the function to analyze the module and request the ReJIT of integrations defined in this module.
-    if (IsCallTargetEnabled(is_net46_or_greater))
+    if (needs_analysis)
     {
-        CallTarget_RequestRejitForModule(module_id, module_metadata, filtered_integrations);
+        module_analysis_pool_->Enqueue(module_id);
     }
 
 #ifndef _WIN32
@@ -690,9 +889,15 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadStarted(ModuleID module_id)
         }
     }
 
-    // take this lock so we block until the
-    // module metadata is not longer being used
-    std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+    // a module is not analyzed after it starts unloading, so its ReJIT handler isn't added back
+    if (module_analysis_pool_ != nullptr)
+    {
+        module_analysis_pool_->Cancel(module_id);
+    }
+
+    // the metadata removed from the registry is freed once
+    // no other callback can be using it anymore
+    ModuleRegistry::ReadGuard guard(module_registry_);
 
     // double check if is_attached_ has changed to avoid possible race condition with shutdown function
     if (!is_attached_)
@@ -700,26 +905,25 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadStarted(ModuleID module_id)
         return S_OK;
     }
 
-    // remove module metadata from map
-    auto findRes = module_id_to_info_map_.find(module_id);
-    if (findRes != module_id_to_info_map_.end())
+    // remove module metadata from the registry
+    ModuleMetadata* metadata = module_registry_.Remove(module_id);
+    if (metadata != nullptr)
     {
-        ModuleMetadata* metadata = findRes->second;
-
         // remove appdomain id from managed_profiler_loaded_app_domains set
-        if (managed_profiler_loaded_app_domains.find(metadata->app_domain_id) !=
-            managed_profiler_loaded_app_domains.end())
         {
+            std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
             managed_profiler_loaded_app_domains.erase(metadata->app_domain_id);
         }
 
-        module_id_to_info_map_.erase(module_id);
-
         if (rejit_handler != nullptr)
         {
             rejit_handler->RemoveModule(module_id);
         }
-        delete metadata;
+
+        // the metadata itself is freed once no reader can see it anymore, but its cached tokens are dead now
+        metadata->metadata_cache.Clear();
+        Stats::Instance()->AddModulesTracked(-1);
+        Stats::Instance()->AddIntegrationBytesRetained(-(long long) metadata->GetRetainedBytes());
     }
 
     return S_OK;
@@ -729,9 +933,14 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Shutdown()
 {
     CorProfilerBase::Shutdown();
 
-    // keep this lock until we are done using the module,
-    // to prevent it from unloading while in use
-    std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+    // stop accepting callbacks and wait for the ones in flight,
+    // so nothing uses the ReJIT handler or module metadata while we tear down
+    is_attached_.store(false);
+    if (module_analysis_pool_ != nullptr)
+    {
+        module_analysis_pool_->Shutdown();
+    }
+    module_registry_.Synchronize();
 
     if (rejit_handler != nullptr)
     {
@@ -739,8 +948,15 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Shutdown()
         delete rejit_handler;
         rejit_handler = nullptr;
     }
+
+    if (callback_trace_ != nullptr)
+    {
+        callback_trace_->Flush();
+    }
+
+    Stats::Instance()->Stop();
     Warn("Exiting. Stats: ", Stats::Instance()->ToString());
-    is_attached_.store(false);
+    Stats::Instance()->CloseFile();
     Logger::Shutdown();
     return S_OK;
 }
@@ -753,34 +969,37 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ProfilerDetachSucceeded()
     }
     CorProfilerBase::ProfilerDetachSucceeded();
 
-    // keep this lock until we are done using the module,
-    // to prevent it from unloading while in use
-    std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
-
     // double check if is_attached_ has changed to avoid possible race condition with shutdown function
-    if (!is_attached_)
+    if (!is_attached_.exchange(false))
     {
         return S_OK;
     }
 
+    // wait for the callbacks still using the module metadata
+    module_registry_.Synchronize();
+
     Warn("Detaching profiler.");
     Logger::Instance()->Flush();
-    is_attached_.store(false);
     return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function_id, BOOL is_safe_to_block)
 {
-    auto _ = trace::Stats::Instance()->JITCompilationStartedMeasure();
+    auto measure = trace::Stats::Instance()->JITCompilationStartedMeasure();
+
+    if (callback_trace_ != nullptr)
+    {
+        callback_trace_->RecordJITCompilationStarted(this->info_, function_id, is_safe_to_block);
+    }
 
     if (!is_attached_ || !is_safe_to_block)
     {
         return S_OK;
     }
 
-    // keep this lock until we are done using the module,
-    // to prevent it from unloading while in use
-    std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
+    // keep the registry pinned until we are done using the module metadata,
+    // to prevent it from being freed while in use
+    ModuleRegistry::ReadGuard guard(module_registry_);
 
     // double check if is_attached_ has changed to avoid possible race condition with shutdown function
     if (!is_attached_)
@@ -800,14 +1019,7 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
     }
 
     // Verify that we have the metadata for this module
-    ModuleMetadata* module_metadata = nullptr;
-
-    auto findRes = module_id_to_info_map_.find(module_id);
-    if (findRes != module_id_to_info_map_.end())
-    {
-        module_metadata = findRes->second;
-    }
-
+    ModuleMetadata* module_metadata = module_registry_.Get(module_id);
     if (module_metadata == nullptr)
     {
         // we haven't stored a ModuleMetadata for this module,
@@ -815,11 +1027,20 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
         return S_OK;
     }
 
-  // We check if we are in CallTarget mode and the loader was already injected.
-  const bool is_calltarget_enabled = IsCallTargetEnabled(is_net46_or_greater);
-  const bool has_loader_injected_in_appdomain =
-      first_jit_compilation_app_domains.find(module_metadata->app_domain_id) !=
-      first_jit_compilation_app_domains.end();
+    // We check if we are in CallTarget mode and the loader was already injected.
+    const bool is_calltarget_enabled = IsCallTargetEnabled(is_net46_or_greater);
+    bool has_loader_injected_in_appdomain;
+    {
+        std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
+        has_loader_injected_in_appdomain = first_jit_compilation_app_domains.find(module_metadata->app_domain_id) !=
+                                           first_jit_compilation_app_domains.end();
+
+        if (is_calltarget_enabled && has_loader_injected_in_appdomain && startup_hook_pending_app_domains_.empty())
+        {
+            // every AppDomain has the startup hook, stop paying for this callback
+            SetStartupHookEvents(false);
+        }
+    }
 
     if (is_calltarget_enabled && has_loader_injected_in_appdomain)
     {
@@ -834,32 +1055,16 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
         return S_OK;
     }
 
+    // caller goes away before the measure ends
+    const auto measure_name = measure.SetScopedName(caller.type.name, caller.name);
+
     if (debug_logging_enabled)
     {
         Debug("JITCompilationStarted: function_id=", function_id, " token=", function_token, " name=", caller.type.name,
               ".", caller.name, "()");
     }
 
-    // IIS: Ensure that the startup hook is inserted into System.Web.Compilation.BuildManager.InvokePreStartInitMethods.
-    // This will be the first call-site considered for the startup hook injection,
-    // which correctly loads Datadog.Trace.ClrProfiler.Managed.Loader into the application's
-    // own AppDomain because at this point in the code path, the ApplicationImpersonationContext
-    // has been started.
-    //
-    // Note: This check must only run on desktop because it is possible (and the default) to host
-    // ASP.NET Core in-process, so a new .NET Core runtime is instantiated and run in the same w3wp.exe process
-    auto valid_startup_hook_callsite = true;
-    if (is_desktop_iis)
-    {
-        valid_startup_hook_callsite = module_metadata->assemblyName == WStr("System.Web") &&
-                                      caller.type.name == WStr("System.Web.Compilation.BuildManager") &&
-                                      caller.name == WStr("InvokePreStartInitMethods");
-    }
-    else if (module_metadata->assemblyName == WStr("System") ||
-             module_metadata->assemblyName == WStr("System.Net.Http"))
-    {
-        valid_startup_hook_callsite = false;
-    }
+    const auto valid_startup_hook_callsite = IsStartupHookCallsite(module_metadata, caller);
 
     // The first time a method is JIT compiled in an AppDomain, insert our startup
     // hook which, at a minimum, must add an AssemblyResolve event so we can find
@@ -867,14 +1072,20 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
     // is no longer provided in a NuGet package
     if (valid_startup_hook_callsite && !has_loader_injected_in_appdomain)
     {
-        bool domain_neutral_assembly = runtime_information_.is_desktop() && corlib_module_loaded &&
-                                       module_metadata->app_domain_id == corlib_app_domain_id;
+        // another thread may have injected the startup hook since we checked
+        std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
+        has_loader_injected_in_appdomain =
+            !first_jit_compilation_app_domains.insert(module_metadata->app_domain_id).second;
+        startup_hook_pending_app_domains_.erase(module_metadata->app_domain_id);
+    }
+
+    if (valid_startup_hook_callsite && !has_loader_injected_in_appdomain)
+    {
+        bool domain_neutral_assembly = IsDomainNeutralAppDomain(module_metadata->app_domain_id);
         Info("JITCompilationStarted: Startup hook registered in function_id=", function_id, " token=", function_token,
              " name=", caller.type.name, ".", caller.name, "(), assembly_name=", module_metadata->assemblyName,
              " app_domain_id=", module_metadata->app_domain_id, " domain_neutral=", domain_neutral_assembly);
 
-        first_jit_compilation_app_domains.insert(module_metadata->app_domain_id);
-
         hr = RunILStartupHook(module_metadata->metadata_emit, module_id, function_token);
 
         if (FAILED(hr))
@@ -913,6 +1124,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
             return S_OK;
         }
 
+        // only one method of a module can be rewritten at a time, the rewrites share the module wrapper caches
+        std::lock_guard<std::mutex> rewrite_guard(module_metadata->rewrite_lock);
+
         // Perform method insertion calls
         hr =
             ProcessInsertionCalls(module_metadata, function_id, module_id, function_token, caller, method_replacements);
@@ -943,7 +1157,13 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITInlining(FunctionID callerId, Function
 {
     auto _ = trace::Stats::Instance()->JITInliningMeasure();
 
-    if (!is_attached_ || rejit_handler == nullptr)
+    if (callback_trace_ != nullptr)
+    {
+        callback_trace_->RecordJITInlining(this->info_, callerId, calleeId);
+    }
+
+    // the runtime keeps the instrumented methods from being inlined when it tracks the inliners
+    if (!is_attached_ || rejit_handler == nullptr || rejit_handler->TracksInliners())
     {
         return S_OK;
     }
@@ -960,19 +1180,79 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITInlining(FunctionID callerId, Function
         return S_OK;
     }
 
+    // the registry lookup and the instrumented methods check are lock-free,
+    // this callback runs for every inlining candidate
+    ModuleRegistry::ReadGuard guard(module_registry_);
+
+    const ModuleMetadata* module_metadata = module_registry_.Get(calleeModuleId);
+    if (module_metadata == nullptr)
+    {
+        return S_OK;
+    }
+
+    // the instrumented methods of the callee module are only known once it has been analyzed, until then none of
+    // its methods is inlined rather than blocking the JIT on the analysis
+    if (module_metadata->analysis_pending.load(std::memory_order_acquire))
+    {
+        *pfShouldInline = false;
+        return S_OK;
+    }
+
+    if (module_metadata->IsInstrumentedMethod(calleFunctionToken))
+    {
+        Debug("*** JITInlining: Inlining disabled for [ModuleId=", calleeModuleId,
+              ", MethodDef=", TokenStr(&calleFunctionToken), "]");
+        *pfShouldInline = false;
+        return S_OK;
+    }
 
-    RejitHandlerModule* handlerModule = nullptr;
-    if (rejit_handler->TryGetModule(calleeModuleId, &handlerModule))
+    return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::JITCachedFunctionSearchStarted(FunctionID function_id,
+                                                                      BOOL* use_cached_function)
+{
+    if (!is_attached_ || use_cached_function == nullptr || !*use_cached_function)
     {
-        if (handlerModule->ContainsMethod(calleFunctionToken))
+        return S_OK;
+    }
+
+    // keep the registry pinned until we are done using the module metadata,
+    // to prevent it from being freed while in use
+    ModuleRegistry::ReadGuard guard(module_registry_);
+
+    ModuleID module_id;
+    mdToken function_token = mdTokenNil;
+    if (FAILED(this->info_->GetFunctionInfo(function_id, nullptr, &module_id, &function_token)))
+    {
+        return S_OK;
+    }
+
+    const ModuleMetadata* module_metadata = module_registry_.Get(module_id);
+    if (module_metadata == nullptr)
+    {
+        return S_OK;
+    }
+
+    {
+        std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
+        if (first_jit_compilation_app_domains.find(module_metadata->app_domain_id) !=
+            first_jit_compilation_app_domains.end())
         {
-            Debug("*** JITInlining: Inlining disabled for [ModuleId=", calleeModuleId,
-                  ", MethodDef=", TokenStr(&calleFunctionToken), "]");
-            *pfShouldInline = false;
             return S_OK;
         }
     }
 
+    const auto caller = GetFunctionInfo(module_metadata->metadata_import, function_token);
+    if (!caller.IsValid() || !IsStartupHookCallsite(module_metadata, caller))
+    {
+        return S_OK;
+    }
+
+    // the precompiled code can't be rewritten, JITCompilationStarted inserts the startup hook in the IL instead
+    Debug("JITCachedFunctionSearchStarted: JIT compiling ", caller.type.name, ".", caller.name,
+          "() to insert the startup hook, app_domain_id=", module_metadata->app_domain_id);
+    *use_cached_function = FALSE;
     return S_OK;
 }
 
@@ -992,41 +1272,19 @@ HRESULT STDMETHODCALLTYPE CorProfiler::GetAssemblyReferences(const WCHAR* wszAss
 
     // Convert the assembly path to the assembly name, assuming the assembly name
     // is either <assembly_name.ni.dll> or <assembly_name>.dll
-    auto assemblyPathString = ToString(wszAssemblyPath);
-    auto filename = assemblyPathString.substr(assemblyPathString.find_last_of("\\/") + 1);
-    auto lastNiDllPeriodIndex = filename.rfind(".ni.dll");
-    auto lastDllPeriodIndex = filename.rfind(".dll");
-    if (lastNiDllPeriodIndex != std::string::npos)
-    {
-        filename.erase(lastNiDllPeriodIndex, 7);
-    }
-    else if (lastDllPeriodIndex != std::string::npos)
-    {
-        filename.erase(lastDllPeriodIndex, 4);
-    }
-
-    const WSTRING assembly_name = ToWSTRING(filename);
+    size_t assembly_name_length;
+    const WCHAR* assembly_name_start = GetAssemblyNameFromPath(wszAssemblyPath, &assembly_name_length);
 
     // Skip known framework assemblies that we will not instrument and,
     // as a result, will not need an assembly reference to the
     // managed profiler
-    for (auto&& skip_assembly_pattern : skip_assembly_prefixes)
+    if (assembly_classifier_.Classify(assembly_name_start, assembly_name_length) == AssemblyKind::Skipped)
     {
-        if (assembly_name.rfind(skip_assembly_pattern, 0) == 0)
-        {
-            Debug("GetAssemblyReferences skipping module by pattern: Name=", assembly_name, " Path=", wszAssemblyPath);
-            return S_OK;
-        }
+        Debug("GetAssemblyReferences skipping known assembly: Path=", wszAssemblyPath);
+        return S_OK;
     }
 
-    for (auto&& skip_assembly : skip_assemblies)
-    {
-        if (assembly_name == skip_assembly)
-        {
-            Debug("GetAssemblyReferences skipping known assembly: Name=", assembly_name, " Path=", wszAssemblyPath);
-            return S_OK;
-        }
-    }
+    const WSTRING assembly_name(assembly_name_start, assembly_name_length);
 
     // Construct an ASSEMBLYMETADATA structure for the managed profiler that can
     // be consumed by the runtime
@@ -1110,11 +1368,158 @@ WSTRING CorProfiler::GetCoreCLRProfilerPath()
     return native_profiler_file;
 }
 
+const std::vector<const MethodReplacement*>& CorProfiler::GetCallSiteReplacements(ModuleMetadata* module_metadata,
+                                                                                   mdToken target_token)
+{
+    const std::vector<const MethodReplacement*>* resolved;
+    if (module_metadata->TryGetCallSiteReplacements(target_token, &resolved))
+    {
+        return *resolved;
+    }
+
+    std::vector<const MethodReplacement*> target_replacements;
+
+    // get the target function info, no replacement matches if it's invalid
+    const auto target_info = module_metadata->metadata_cache.GetFunctionInfo(target_token);
+    const auto& target = *target_info;
+    if (!target.IsValid())
+    {
+        return module_metadata->AddCallSiteReplacements(target_token, std::move(target_replacements));
+    }
+
+    for (const auto integration : module_metadata->integrations)
+    {
+        const auto& method_replacement = integration->replacement;
+
+        // only the method replacements that are actually doing a replacement
+        if (method_replacement.wrapper_method.action != WStr("ReplaceTargetMethod"))
+        {
+            continue;
+        }
+
+        // make sure the type and method names match
+        if (method_replacement.target_method.type_name != target.type.name ||
+            method_replacement.target_method.method_name != target.name)
+        {
+            continue;
+        }
+
+        // we add 3 parameters to every wrapper method: opcode, mdToken, and
+        // module_version_id
+        const short added_parameters_count = 3;
+
+        auto wrapper_method_signature_size = method_replacement.wrapper_method.method_signature.data.size();
+
+        if (wrapper_method_signature_size < (added_parameters_count + 3))
+        {
+            // wrapper signature must have at least 6 bytes
+            // 0:{CallingConvention}|1:{ParamCount}|2:{ReturnType}|3:{OpCode}|4:{mdToken}|5:{ModuleVersionId}
+            if (debug_logging_enabled)
+            {
+                Debug("JITCompilationStarted skipping function call: wrapper signature too short. target_token=",
+                      target_token, " wrapper_method=", method_replacement.wrapper_method.type_name, ".",
+                      method_replacement.wrapper_method.method_name,
+                      "() wrapper_method_signature_size=", wrapper_method_signature_size);
+            }
+
+            continue;
+        }
+
+        auto expected_number_args = method_replacement.wrapper_method.method_signature.NumberOfArguments();
+
+        // subtract the last arguments we add to every wrapper
+        expected_number_args = expected_number_args - added_parameters_count;
+
+        if (target.signature.IsInstanceMethod())
+        {
+            // We always pass the instance as the first argument
+            expected_number_args--;
+        }
+
+        auto target_arg_count = target.signature.NumberOfArguments();
+
+        if (expected_number_args != target_arg_count)
+        {
+            // Number of arguments does not match our wrapper method
+            if (debug_logging_enabled)
+            {
+                Debug("JITCompilationStarted skipping function call: argument counts don't match. target_token=",
+                      target_token, " target_name=", target.type.name, ".", target.name,
+                      "() expected_number_args=", expected_number_args, " target_arg_count=", target_arg_count);
+            }
+
+            continue;
+        }
+
+        if (target.is_generic && target.signature.NumberOfTypeArguments() !=
+                                     method_replacement.wrapper_method.method_signature.NumberOfTypeArguments())
+        {
+            // Number of generic arguments does not match our wrapper method
+            continue;
+        }
+
+        std::vector<WSTRING> actual_sig;
+        const auto successfully_parsed_signature =
+            TryParseSignatureTypes(module_metadata->metadata_import, target, actual_sig);
+        const auto& expected_sig = method_replacement.target_method.signature_types;
+
+        if (!successfully_parsed_signature || actual_sig.size() != expected_sig.size())
+        {
+            // we can't safely assume our wrapper methods handle the types
+            if (debug_logging_enabled)
+            {
+                Debug("JITCompilationStarted skipping function call: failed to parse signature or unexpected type "
+                      "count. target_token=",
+                      target_token, " target_name=", target.type.name, ".", target.name,
+                      "() successfully_parsed_signature=", successfully_parsed_signature,
+                      " sig_types.size()=", actual_sig.size(), " expected_sig_types.size()=", expected_sig.size());
+            }
+
+            continue;
+        }
+
+        auto is_match = true;
+        for (size_t i = 0; i < expected_sig.size(); i++)
+        {
+            // "_" means we are supposed to ignore this index
+            if (expected_sig[i] != WStr("_") && expected_sig[i] != actual_sig[i])
+            {
+                // we have a type mismatch, drop out
+                if (debug_logging_enabled)
+                {
+                    Debug("JITCompilationStarted skipping function call: types don't match. target_token=",
+                          target_token, " target_name=", target.type.name, ".", target.name, "() actual[", i,
+                          "]=", actual_sig[i], ", expected[", i, "]=", expected_sig[i]);
+                }
+
+                is_match = false;
+                break;
+            }
+        }
+
+        if (is_match)
+        {
+            target_replacements.push_back(&method_replacement);
+        }
+    }
+
+    return module_metadata->AddCallSiteReplacements(target_token, std::move(target_replacements));
+}
+
 HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, const FunctionID function_id,
                                              const ModuleID module_id, const mdToken function_token,
                                              const FunctionInfo& caller,
-                                             const std::vector<MethodReplacement> method_replacements)
+                                             const std::vector<const MethodReplacement*>& method_replacements)
 {
+    // nothing to do unless one of the replacements enabled for this caller replaces its target
+    if (std::none_of(method_replacements.begin(), method_replacements.end(),
+                     [](const MethodReplacement* method_replacement) {
+                         return method_replacement->wrapper_method.action == WStr("ReplaceTargetMethod");
+                     }))
+    {
+        return S_OK;
+    }
+
     ILRewriter rewriter(this->info_, nullptr, module_id, function_token);
     bool modified = false;
     auto hr = rewriter.Import();
@@ -1131,92 +1536,40 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
         original_code = GetILCodes("***   IL original code for caller: ", &rewriter, caller, module_metadata);
     }
 
-    // Perform method call replacements
-    for (auto& method_replacement : method_replacements)
+    // Perform method call replacements, in a single pass over the IL
+    for (ILInstr* pInstr = rewriter.GetILList()->m_pNext; pInstr != rewriter.GetILList(); pInstr = pInstr->m_pNext)
     {
-        // Exit early if the method replacement isn't actually doing a replacement
-        if (method_replacement.wrapper_method.action != WStr("ReplaceTargetMethod"))
+        // only CALL or CALLVIRT
+        if (pInstr->m_opcode != CEE_CALL && pInstr->m_opcode != CEE_CALLVIRT)
         {
             continue;
         }
 
-        const auto& wrapper_method_key = method_replacement.wrapper_method.get_method_cache_key();
-        // Exit early if we previously failed to store the method ref for this wrapper_method
-        if (module_metadata->IsFailedWrapperMemberKey(wrapper_method_key))
+        // the replacements whose target matches the call, a single lookup once the token has been seen
+        const auto& target_replacements = GetCallSiteReplacements(module_metadata, pInstr->m_Arg32);
+        if (target_replacements.empty())
         {
             continue;
         }
 
-        // for each IL instruction
-        for (ILInstr* pInstr = rewriter.GetILList()->m_pNext; pInstr != rewriter.GetILList(); pInstr = pInstr->m_pNext)
-        {
-            // only CALL or CALLVIRT
-            if (pInstr->m_opcode != CEE_CALL && pInstr->m_opcode != CEE_CALLVIRT)
-            {
-                continue;
-            }
-
-            // get the target function info, continue if its invalid
-            auto target = GetFunctionInfo(module_metadata->metadata_import, pInstr->m_Arg32);
-            if (!target.IsValid())
-            {
-                continue;
-            }
-
-            // make sure the type and method names match
-            if (method_replacement.target_method.type_name != target.type.name ||
-                method_replacement.target_method.method_name != target.name)
-            {
-                continue;
-            }
-
-            // we add 3 parameters to every wrapper method: opcode, mdToken, and
-            // module_version_id
-            const short added_parameters_count = 3;
+        const auto target_info = module_metadata->metadata_cache.GetFunctionInfo(pInstr->m_Arg32);
+        const auto& target = *target_info;
 
-            auto wrapper_method_signature_size = method_replacement.wrapper_method.method_signature.data.size();
+        // the first replacement enabled for this caller that can be applied wins
+        for (auto method_replacement_ptr : target_replacements)
+        {
+            const auto& method_replacement = *method_replacement_ptr;
 
-            if (wrapper_method_signature_size < (added_parameters_count + 3))
+            if (std::find(method_replacements.begin(), method_replacements.end(), method_replacement_ptr) ==
+                method_replacements.end())
             {
-                // wrapper signature must have at least 6 bytes
-                // 0:{CallingConvention}|1:{ParamCount}|2:{ReturnType}|3:{OpCode}|4:{mdToken}|5:{ModuleVersionId}
-                if (debug_logging_enabled)
-                {
-                    Debug("JITCompilationStarted skipping function call: wrapper signature "
-                          "too short. function_id=",
-                          function_id, " token=", function_token,
-                          " wrapper_method=", method_replacement.wrapper_method.type_name, ".",
-                          method_replacement.wrapper_method.method_name,
-                          "() wrapper_method_signature_size=", wrapper_method_signature_size);
-                }
-
                 continue;
             }
 
-            auto expected_number_args = method_replacement.wrapper_method.method_signature.NumberOfArguments();
-
-            // subtract the last arguments we add to every wrapper
-            expected_number_args = expected_number_args - added_parameters_count;
-
-            if (target.signature.IsInstanceMethod())
-            {
-                // We always pass the instance as the first argument
-                expected_number_args--;
-            }
-
-            auto target_arg_count = target.signature.NumberOfArguments();
-
-            if (expected_number_args != target_arg_count)
+            const auto& wrapper_method_key = method_replacement.wrapper_method.get_method_cache_key();
+            // Exit early if we previously failed to store the method ref for this wrapper_method
+            if (module_metadata->IsFailedWrapperMemberKey(wrapper_method_key))
             {
-                // Number of arguments does not match our wrapper method
-                if (debug_logging_enabled)
-                {
-                    Debug("JITCompilationStarted skipping function call: argument counts "
-                          "don't match. function_id=",
-                          function_id, " token=", function_token, " target_name=", target.type.name, ".", target.name,
-                          "() expected_number_args=", expected_number_args, " target_arg_count=", target_arg_count);
-                }
-
                 continue;
             }
 
@@ -1240,84 +1593,12 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
 
             if (target.is_generic)
             {
-                if (target.signature.NumberOfTypeArguments() !=
-                    method_replacement.wrapper_method.method_signature.NumberOfTypeArguments())
-                {
-                    // Number of generic arguments does not match our wrapper method
-                    continue;
-                }
-
                 // we need to emit a method spec to populate the generic arguments
                 wrapper_method_ref = DefineMethodSpec(module_metadata->metadata_emit, wrapper_method_ref,
                                                       target.function_spec_signature);
                 method_def_md_token = target.method_def_id;
             }
 
-            std::vector<WSTRING> actual_sig;
-            const auto successfully_parsed_signature =
-                TryParseSignatureTypes(module_metadata->metadata_import, target, actual_sig);
-            auto expected_sig = method_replacement.target_method.signature_types;
-
-            if (!successfully_parsed_signature)
-            {
-                if (debug_logging_enabled)
-                {
-                    Debug("JITCompilationStarted skipping function call: failed to parse "
-                          "signature. function_id=",
-                          function_id, " token=", function_token, " target_name=", target.type.name, ".", target.name,
-                          "()", " successfully_parsed_signature=", successfully_parsed_signature,
-                          " sig_types.size()=", actual_sig.size(), " expected_sig_types.size()=", expected_sig.size());
-                }
-
-                continue;
-            }
-
-            if (actual_sig.size() != expected_sig.size())
-            {
-                // we can't safely assume our wrapper methods handle the types
-                if (debug_logging_enabled)
-                {
-                    Debug("JITCompilationStarted skipping function call: unexpected type "
-                          "count. function_id=",
-                          function_id, " token=", function_token, " target_name=", target.type.name, ".", target.name,
-                          "() successfully_parsed_signature=", successfully_parsed_signature,
-                          " sig_types.size()=", actual_sig.size(), " expected_sig_types.size()=", expected_sig.size());
-                }
-
-                continue;
-            }
-
-            auto is_match = true;
-            for (size_t i = 0; i < expected_sig.size(); i++)
-            {
-                if (expected_sig[i] == WStr("_"))
-                {
-                    // We are supposed to ignore this index
-                    continue;
-                }
-                if (expected_sig[i] != actual_sig[i])
-                {
-                    // we have a type mismatch, drop out
-                    if (debug_logging_enabled)
-                    {
-                        Debug("JITCompilationStarted skipping function call: types don't "
-                              "match. function_id=",
-                              function_id, " token=", function_token, " target_name=", target.type.name, ".",
-                              target.name, "() actual[", i, "]=", actual_sig[i], ", expected[", i,
-                              "]=", expected_sig[i]);
-                    }
-
-                    is_match = false;
-                    break;
-                }
-            }
-
-            if (!is_match)
-            {
-                // signatures don't match
-                continue;
-            }
-
             // At this point we know we've hit a match. Error out if
             //   1) The managed profiler has not been loaded yet
             //   2) The caller is domain-neutral AND we do not want to instrument domain-neutral assemblies
@@ -1337,8 +1618,7 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
             }
 
             //   2) The caller is domain-neutral AND we do not want to instrument domain-neutral assemblies
-            bool caller_assembly_is_domain_neutral = runtime_information_.is_desktop() && corlib_module_loaded &&
-                                                     module_metadata->app_domain_id == corlib_app_domain_id;
+            bool caller_assembly_is_domain_neutral = IsDomainNeutralAppDomain(module_metadata->app_domain_id);
 
             if (caller_assembly_is_domain_neutral && !instrument_domain_neutral_assemblies)
             {
@@ -1447,7 +1727,7 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
 
                 // Currently, we only expect to see `System.Threading.CancellationToken` as a valuetype in this position
                 // If we expand this to a general case, we would always perform the boxing regardless of type
-                if (GetTypeInfo(module_metadata->metadata_import, valuetype_type_token).name ==
+                if (module_metadata->metadata_cache.GetTypeInfo(valuetype_type_token)->name ==
                     WStr("System.Threading.CancellationToken"))
                 {
                     rewriter_wrapper.Box(valuetype_type_token);
@@ -1470,7 +1750,7 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
                     // `System.ReadOnlyMemory<T>` as a valuetype in this
                     // position If we expand this to a general case, we would always
                     // perform the boxing regardless of type
-                    if (GetTypeInfo(module_metadata->metadata_import, valuetype_type_token).name ==
+                    if (module_metadata->metadata_cache.GetTypeInfo(valuetype_type_token)->name ==
                             WStr("System.ReadOnlyMemory`1") &&
                         ParseType(&p_end_byte))
                     {
@@ -1530,6 +1810,11 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
                  method_replacement.target_method.type_name, ".", method_replacement.target_method.method_name, "() ",
                  original_argument, " with calls to ", method_replacement.wrapper_method.type_name, ".",
                  method_replacement.wrapper_method.method_name, "() ", wrapper_method_ref);
+
+            // pInstr moved to the instruction after the original call, step back to the last inserted instruction
+            // so the loop doesn't skip it
+            pInstr = pInstr->m_pPrev;
+            break;
         }
     }
 
@@ -1557,7 +1842,7 @@ HRESULT CorProfiler::ProcessReplacementCalls(ModuleMetadata* module_metadata, co
 HRESULT CorProfiler::ProcessInsertionCalls(ModuleMetadata* module_metadata, const FunctionID function_id,
                                            const ModuleID module_id, const mdToken function_token,
                                            const FunctionInfo& caller,
-                                           const std::vector<MethodReplacement> method_replacements)
+                                           const std::vector<const MethodReplacement*>& method_replacements)
 {
 
     ILRewriter rewriter(this->info_, nullptr, module_id, function_token);
@@ -1575,8 +1860,10 @@ HRESULT CorProfiler::ProcessInsertionCalls(ModuleMetadata* module_metadata, cons
     ILInstr* firstInstr = rewriter.GetILList()->m_pNext;
     ILInstr* lastInstr = rewriter.GetILList()->m_pPrev; // Should be a 'ret' instruction
 
-    for (auto& method_replacement : method_replacements)
+    for (auto method_replacement_ptr : method_replacements)
     {
+        const auto& method_replacement = *method_replacement_ptr;
+
         if (method_replacement.wrapper_method.action == WStr("ReplaceTargetMethod"))
         {
             continue;
@@ -1698,10 +1985,83 @@ bool CorProfiler::GetWrapperMethodRef(ModuleMetadata* module_metadata, ModuleID
 
 bool CorProfiler::ProfilerAssemblyIsLoadedIntoAppDomain(AppDomainID app_domain_id)
 {
+    std::lock_guard<std::mutex> app_domains_guard(app_domains_lock_);
     return managed_profiler_loaded_domain_neutral ||
            managed_profiler_loaded_app_domains.find(app_domain_id) != managed_profiler_loaded_app_domains.end();
 }
 
+bool CorProfiler::IsDomainNeutralAppDomain(AppDomainID app_domain_id) const
+{
+    return runtime_information_.is_desktop() && corlib_module_loaded.load(std::memory_order_acquire) &&
+           app_domain_id == corlib_app_domain_id.load(std::memory_order_relaxed);
+}
+
+bool CorProfiler::IsStartupHookCallsite(const ModuleMetadata* module_metadata, const FunctionInfo& caller) const
+{
+    // IIS: Ensure that the startup hook is inserted into System.Web.Compilation.BuildManager.InvokePreStartInitMethods.
+    // This will be the first call-site considered for the startup hook injection,
+    // which correctly loads Datadog.Trace.ClrProfiler.Managed.Loader into the application's
+    // own AppDomain because at this point in the code path, the ApplicationImpersonationContext
+    // has been started.
+    //
+    // Note: This check must only run on desktop because it is possible (and the default) to host
+    // ASP.NET Core in-process, so a new .NET Core runtime is instantiated and run in the same w3wp.exe process
+    if (is_desktop_iis)
+    {
+        return module_metadata->assemblyName == WStr("System.Web") &&
+               caller.type.name == WStr("System.Web.Compilation.BuildManager") &&
+               caller.name == WStr("InvokePreStartInitMethods");
+    }
+
+    return module_metadata->assemblyName != WStr("System") && module_metadata->assemblyName != WStr("System.Net.Http");
+}
+
+void CorProfiler::SetStartupHookEvents(bool enabled)
+{
+    if (startup_hook_events_ == 0 || startup_hook_events_enabled_ == enabled)
+    {
+        return;
+    }
+
+    // the other flags of the event mask are kept as they are, the immutable ones can't change
+    DWORD event_mask = 0;
+    DWORD event_mask_high = 0;
+    ICorProfilerInfo5* info5 = nullptr;
+    HRESULT hr = this->info_->QueryInterface(__uuidof(ICorProfilerInfo5), (void**) &info5);
+    if (SUCCEEDED(hr))
+    {
+        hr = info5->GetEventMask2(&event_mask, &event_mask_high);
+    }
+    else
+    {
+        info5 = nullptr;
+        hr = this->info_->GetEventMask(&event_mask);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        event_mask = enabled ? event_mask | startup_hook_events_ : event_mask & ~startup_hook_events_;
+        hr = info5 != nullptr ? info5->SetEventMask2(event_mask, event_mask_high)
+                              : this->info_->SetEventMask(event_mask);
+    }
+
+    if (info5 != nullptr)
+    {
+        info5->Release();
+    }
+
+    if (FAILED(hr))
+    {
+        // keep the events as they are, and stop trying
+        Warn("Unable to ", enabled ? "enable" : "disable", " the startup hook events: ", hr);
+        startup_hook_events_ = 0;
+        return;
+    }
+
+    Info("Startup hook events ", enabled ? "enabled." : "disabled, every AppDomain has the startup hook.");
+    startup_hook_events_enabled_ = enabled;
+}
+
 const std::string indent_values[] = {
     "",
     std::string(2 * 1, ' '),
@@ -2784,6 +3144,9 @@ extern uint8_t dll_end[] asm("_binary_Datadog_Trace_ClrProfiler_Managed_Loader_d
 
 extern uint8_t pdb_start[] asm("_binary_Datadog_Trace_ClrProfiler_Managed_Loader_pdb_start");
 extern uint8_t pdb_end[] asm("_binary_Datadog_Trace_ClrProfiler_Managed_Loader_pdb_end");
+
+extern uint8_t catalog_start[] asm("_binary_integrations_catalog_start");
+extern uint8_t catalog_end[] asm("_binary_integrations_catalog_end");
 #endif
 
 void CorProfiler::GetAssemblyAndSymbolsBytes(BYTE** pAssemblyArray, int* assemblySize, BYTE** pSymbolsArray,
@@ -2846,6 +3209,40 @@ void CorProfiler::GetAssemblyAndSymbolsBytes(BYTE** pAssemblyArray, int* assembl
 #endif
 }
 
+bool CorProfiler::GetIntegrationCatalogBytes(const BYTE** pCatalogArray, size_t* catalogSize) const
+{
+#ifdef _WIN32
+    // The Windows build doesn't embed the catalog, integrations are loaded from DD_INTEGRATIONS.
+    *pCatalogArray = nullptr;
+    *catalogSize = 0;
+#elif LINUX
+    *catalogSize = catalog_end - catalog_start;
+    *pCatalogArray = (const BYTE*) catalog_start;
+#else
+    *pCatalogArray = nullptr;
+    *catalogSize = 0;
+
+    const unsigned int imgCount = _dyld_image_count();
+
+    for (auto i = 0; i < imgCount; i++)
+    {
+        const std::string name = std::string(_dyld_get_image_name(i));
+
+        if (name.rfind("Datadog.Trace.ClrProfiler.Native.dylib") != std::string::npos)
+        {
+            const mach_header_64* header = (const struct mach_header_64*) _dyld_get_image_header(i);
+
+            unsigned long catalogDataSize;
+            const auto catalogData = getsectiondata(header, "binary", "integrations", &catalogDataSize);
+            *catalogSize = catalogDataSize;
+            *pCatalogArray = (const BYTE*) catalogData;
+            break;
+        }
+    }
+#endif
+    return *pCatalogArray != nullptr && *catalogSize > 0;
+}
+
 // ***
 // * ReJIT Methods
 // ***
@@ -2866,6 +3263,11 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ReJITCompilationStarted(FunctionID functi
 HRESULT STDMETHODCALLTYPE CorProfiler::GetReJITParameters(ModuleID moduleId, mdMethodDef methodId,
                                                           ICorProfilerFunctionControl* pFunctionControl)
 {
+    if (callback_trace_ != nullptr)
+    {
+        callback_trace_->RecordGetReJITParameters(moduleId, methodId);
+    }
+
     if (!is_attached_)
     {
         return S_OK;
@@ -2873,19 +3275,27 @@ HRESULT STDMETHODCALLTYPE CorProfiler::GetReJITParameters(ModuleID moduleId, mdM
 
     Debug("GetReJITParameters: [moduleId: ", moduleId, ", methodId: ", methodId, "]");
 
+    // a method that inlined an instrumented method is rejitted from its original IL, so it doesn't need the
+    // analysis of its module
+    RejitHandlerModule* module_handler;
+    if (!rejit_handler->TryGetModule(moduleId, &module_handler) || !module_handler->ContainsMethod(methodId))
+    {
+        Debug("GetReJITParameters: ReJIT of an inliner [moduleId: ", moduleId, ", methodId: ", methodId, "]");
+        return S_OK;
+    }
+
+    // the methods to rewrite are only known once the module has been analyzed
+    module_analysis_pool_->Wait(moduleId);
+
+    // keep the registry pinned while the method is rewritten,
+    // to prevent the module metadata from being freed while in use
+    ModuleRegistry::ReadGuard guard(module_registry_);
+
     // we get the module_metadata from the moduleId.
-    ModuleMetadata* module_metadata = nullptr;
+    ModuleMetadata* module_metadata = module_registry_.Get(moduleId);
+    if (module_metadata == nullptr)
     {
-        std::lock_guard<std::mutex> guard(module_id_to_info_map_lock_);
-        auto findRes = module_id_to_info_map_.find(moduleId);
-        if (findRes != module_id_to_info_map_.end())
-        {
-            module_metadata = findRes->second;
-        }
-        else
-        {
-            return S_FALSE;
-        }
+        return S_FALSE;
     }
 
     // we notify the reJIT handler of this event and pass the module_metadata.
@@ -2922,47 +3332,109 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ReJITError(ModuleID moduleId, mdMethodDef
 // * CallTarget Methods
 // ***
 
+void CorProfiler::DrainModuleAnalysis()
+{
+    if (module_analysis_pool_ != nullptr)
+    {
+        module_analysis_pool_->Drain();
+    }
+}
+
+/// <summary>
+/// Analyze a module on the analysis pool, unless it was unloaded or the profiler detached meanwhile
+/// </summary>
+/// <param name="module_id">Module id</param>
+void CorProfiler::CallTarget_AnalyzeModule(ModuleID module_id)
+{
+    if (!is_attached_)
+    {
+        return;
+    }
+
+    // keep the registry pinned while the module is analyzed,
+    // to prevent the module metadata from being freed while in use
+    ModuleRegistry::ReadGuard guard(module_registry_);
+
+    // double check if is_attached_ has changed to avoid possible race condition with shutdown function
+    if (!is_attached_)
+    {
+        return;
+    }
+
+    ModuleMetadata* module_metadata = module_registry_.Get(module_id);
+    if (module_metadata == nullptr)
+    {
+        return;
+    }
+
+    CallTarget_RequestRejitForModule(module_id, module_metadata, module_metadata->integrations);
+    module_metadata->analysis_pending.store(false, std::memory_order_release);
+}
+
 /// <summary>
 /// Search for methods to instrument in a module and request a ReJIT to them for a CallTarget instrumentation
 /// </summary>
 /// <param name="module_id">Module id</param>
 /// <param name="module_metadata">Module metadata for the module</param>
-/// <param name="filtered_integrations">Filtered vector of integrations to be applied</param>
+/// <param name="filtered_integrations">Integrations targeting the module's assembly name and version</param>
 /// <returns>Number of ReJIT requests made</returns>
 size_t CorProfiler::CallTarget_RequestRejitForModule(ModuleID module_id, ModuleMetadata* module_metadata,
-                                                     const std::vector<IntegrationMethod>& filtered_integrations)
+                                                     const std::vector<const IntegrationMethod*>& filtered_integrations)
 {
-    auto _ = trace::Stats::Instance()->CallTargetRequestRejitMeasure();
+    auto measure = trace::Stats::Instance()->CallTargetRequestRejitMeasure();
+    measure.SetName(module_metadata->assemblyName);
 
     auto metadata_import = module_metadata->metadata_import;
-    const auto assembly_metadata = GetAssemblyImportMetadata(module_metadata->assembly_import);
 
     std::vector<ModuleID> vtModules;
     std::vector<mdMethodDef> vtMethodDefs;
+    std::vector<RejitPlanEntry> plan;
+
+    const auto enqueue_method = [&](mdMethodDef methodDef, const FunctionInfo& functionInfo,
+                                    const IntegrationMethod& integration) {
+        // As we are in the right method, we gather all information we need and stored it in to the ReJIT handler.
+        auto moduleHandler = rejit_handler->GetOrAddModule(module_id);
+        moduleHandler->SetModuleMetadata(module_metadata);
+        auto methodHandler = moduleHandler->GetOrAddMethod(methodDef);
+        methodHandler->SetFunctionInfo(functionInfo);
+        methodHandler->SetMethodReplacement(&integration.replacement);
+
+        // Store module_id and methodDef to request the ReJIT after analyzing all integrations.
+        vtModules.push_back(module_id);
+        vtMethodDefs.push_back(methodDef);
+
+        bool caller_assembly_is_domain_neutral = IsDomainNeutralAppDomain(module_metadata->app_domain_id);
+
+        Info("Enqueue for ReJIT [ModuleId=", module_id, ", MethodDef=", TokenStr(&methodDef),
+             ", AppDomainId=", module_metadata->app_domain_id, ", IsDomainNeutral=", caller_assembly_is_domain_neutral,
+             ", Assembly=", module_metadata->assemblyName, ", Type=", functionInfo.type.name,
+             ", Method=", functionInfo.name, ", Signature=", functionInfo.signature.str(), "]");
+    };
 
-    for (const IntegrationMethod& integration : filtered_integrations)
+    // A warm start goes straight from the stored plan to the ReJIT request
+    if (rejit_plan_cache_ != nullptr && module_metadata->integration_set != nullptr &&
+        rejit_plan_cache_->TryLoad(module_metadata->module_version_id, plan))
     {
-
-        // If the integration is not for the current assembly we skip.
-        if (integration.replacement.target_method.assembly.name != module_metadata->assemblyName)
+        if (CallTarget_EnqueuePlan(module_metadata, plan, enqueue_method))
         {
-            continue;
+            Debug("ReJIT plan loaded for ", module_metadata->assemblyName, " with ", plan.size(), " methods.");
+            return CallTarget_RequestRejit(module_metadata, vtModules, vtMethodDefs);
         }
 
-        // If the integration mode is not CallTarget we skip.
-        if (integration.replacement.wrapper_method.action != calltarget_modification_action)
-        {
-            continue;
-        }
+        Debug("ReJIT plan for ", module_metadata->assemblyName, " doesn't match the module, analyzing it again.");
+        plan.clear();
+    }
 
-        // Check min version
-        if (integration.replacement.target_method.min_version > assembly_metadata.version)
-        {
-            continue;
-        }
+    // The signature types of the integrations are compiled against this module
+    SignatureMatcher signature_matcher(metadata_import, module_metadata->assembly_import);
+
+    // The integrations were already filtered by target assembly name and version using the integration index.
+    for (const IntegrationMethod* integration_method : filtered_integrations)
+    {
+        const IntegrationMethod& integration = *integration_method;
 
-        // Check max version
-        if (integration.replacement.target_method.max_version < assembly_metadata.version)
+        // If the integration mode is not CallTarget we skip.
+        if (integration.replacement.wrapper_method.action != calltarget_modification_action)
         {
             continue;
         }
@@ -2977,6 +3449,8 @@ size_t CorProfiler::CallTarget_RequestRejitForModule(ModuleID module_id, ModuleM
             continue;
         }
 
+        const auto signature_types = signature_matcher.Compile(integration.replacement.target_method.signature_types);
+
         // Now we enumerate all methods with the same target method name. (All overloads of the method)
         auto enumMethods = Enumerator<mdMethodDef>(
             [metadata_import, integration, typeDef](HCORENUM* ptr, mdMethodDef arr[], ULONG max,
@@ -2992,7 +3466,8 @@ size_t CorProfiler::CallTarget_RequestRejitForModule(ModuleID module_id, ModuleM
             auto methodDef = *enumIterator;
 
             // Extract the function info from the mdMethodDef
-            const auto caller = GetFunctionInfo(module_metadata->metadata_import, methodDef);
+            const auto caller_info = module_metadata->metadata_cache.GetFunctionInfo(methodDef);
+            const auto& caller = *caller_info;
             if (!caller.IsValid())
             {
                 Warn("The caller for the methoddef: ", TokenStr(&methodDef), " is not valid!");
@@ -3000,76 +3475,116 @@ size_t CorProfiler::CallTarget_RequestRejitForModule(ModuleID module_id, ModuleM
                 continue;
             }
 
-            // We create a new function info into the heap from the caller functionInfo in the stack, to be used later
-            // in the ReJIT process
-            auto functionInfo = FunctionInfo(caller);
-            auto hr = functionInfo.method_signature.TryParse();
+            // Compare the mdMethodDef arguments to the instrumentation target, straight from the signature blob
+            const auto hr = signature_matcher.Match(signature_types, caller.signature.data.data(),
+                                                    (ULONG) caller.signature.data.size());
             if (FAILED(hr))
             {
-                Warn("The method signature: ", functionInfo.method_signature.str(), " cannot be parsed.");
+                Warn("The method signature: ", caller.method_signature.str(), " cannot be parsed.");
                 enumIterator = ++enumIterator;
                 continue;
             }
-
-            // Compare if the current mdMethodDef contains the same number of arguments as the instrumentation target
-            const auto numOfArgs = functionInfo.method_signature.NumberOfArguments();
-            if (numOfArgs != integration.replacement.target_method.signature_types.size() - 1)
+            if (hr == S_FALSE)
             {
                 Debug("The caller for the methoddef: ", integration.replacement.target_method.method_name,
-                      " doesn't have the right number of arguments.");
+                      " doesn't have the right number or type of arguments.");
                 enumIterator = ++enumIterator;
                 continue;
             }
 
-            // Compare each mdMethodDef argument type to the instrumentation target
-            bool argumentsMismatch = false;
-            const auto methodArguments = functionInfo.method_signature.GetMethodArguments();
-            Debug("Comparing signature for method: ", integration.replacement.target_method.type_name, ".",
-                  integration.replacement.target_method.method_name);
-            for (unsigned int i = 0; i < numOfArgs; i++)
-            {
-                const auto argumentTypeName = methodArguments[i].GetTypeTokName(metadata_import);
-                const auto integrationArgumentTypeName = integration.replacement.target_method.signature_types[i + 1];
-                Debug("  -> ", argumentTypeName, " = ", integrationArgumentTypeName);
-                if (argumentTypeName != integrationArgumentTypeName && integrationArgumentTypeName != WStr("_"))
-                {
-                    argumentsMismatch = true;
-                    break;
-                }
-            }
-            if (argumentsMismatch)
+            // We create a new function info into the heap from the caller functionInfo in the stack, to be used later
+            // in the ReJIT process. The matcher walked the same blob, so it parses.
+            auto functionInfo = FunctionInfo(caller);
+            functionInfo.method_signature.TryParse();
+
+            enqueue_method(methodDef, functionInfo, integration);
+            if (module_metadata->integration_set != nullptr)
             {
-                Debug("The caller for the methoddef: ", integration.replacement.target_method.method_name,
-                      " doesn't have the right type of arguments.");
-                enumIterator = ++enumIterator;
-                continue;
+                plan.push_back({methodDef, (uint32_t)(integration_method - module_metadata->integration_set->data())});
             }
+            enumIterator = ++enumIterator;
+        }
+    }
 
-            // As we are in the right method, we gather all information we need and stored it in to the ReJIT handler.
-            auto moduleHandler = rejit_handler->GetOrAddModule(module_id);
-            moduleHandler->SetModuleMetadata(module_metadata);
-            auto methodHandler = moduleHandler->GetOrAddMethod(methodDef);
-            methodHandler->SetFunctionInfo(functionInfo);
-            methodHandler->SetMethodReplacement(integration.replacement);
+    // Modules without matches are stored too, so they are skipped on the next start as well
+    if (rejit_plan_cache_ != nullptr && module_metadata->integration_set != nullptr)
+    {
+        rejit_plan_cache_->Store(module_metadata->module_version_id, plan);
+    }
+
+    return CallTarget_RequestRejit(module_metadata, vtModules, vtMethodDefs);
+}
 
-            // Store module_id and methodDef to request the ReJIT after analyzing all integrations.
-            vtModules.push_back(module_id);
-            vtMethodDefs.push_back(methodDef);
+bool CorProfiler::CallTarget_EnqueuePlan(
+    ModuleMetadata* module_metadata, const std::vector<RejitPlanEntry>& plan,
+    const std::function<void(mdMethodDef, const FunctionInfo&, const IntegrationMethod&)>& enqueue_method)
+{
+    const auto& integration_methods = *module_metadata->integration_set;
 
-            bool caller_assembly_is_domain_neutral = runtime_information_.is_desktop() && corlib_module_loaded &&
-                                                     module_metadata->app_domain_id == corlib_app_domain_id;
+    // Validate the whole plan first, a plan that doesn't match the module must not enqueue anything
+    std::vector<std::pair<FunctionInfo, const IntegrationMethod*>> methods;
+    methods.reserve(plan.size());
+    std::unordered_map<WSTRING, mdTypeDef> type_defs;
+    for (const auto& entry : plan)
+    {
+        if (entry.integration_index >= integration_methods.size())
+        {
+            return false;
+        }
 
-            Info("Enqueue for ReJIT [ModuleId=", module_id, ", MethodDef=", TokenStr(&methodDef),
-                 ", AppDomainId=", module_metadata->app_domain_id,
-                 ", IsDomainNeutral=", caller_assembly_is_domain_neutral, ", Assembly=", module_metadata->assemblyName,
-                 ", Type=", caller.type.name, ", Method=", caller.name, ", Signature=", caller.signature.str(), "]");
-            enumIterator = ++enumIterator;
+        const IntegrationMethod& integration = integration_methods[entry.integration_index];
+        if (integration.replacement.wrapper_method.action != calltarget_modification_action)
+        {
+            return false;
+        }
+
+        const auto caller_info = module_metadata->metadata_cache.GetFunctionInfo(entry.method_def);
+        if (!caller_info->IsValid() || caller_info->name != integration.replacement.target_method.method_name)
+        {
+            return false;
+        }
+
+        // The method must also be declared by the target type, the same way the analysis finds it
+        const auto& type_name = integration.replacement.target_method.type_name;
+        auto type_def = type_defs.find(type_name);
+        if (type_def == type_defs.end())
+        {
+            mdTypeDef found = mdTypeDefNil;
+            if (!FindTypeDefByName(type_name, module_metadata->assemblyName, module_metadata->metadata_import, found))
+            {
+                found = mdTypeDefNil;
+            }
+            type_def = type_defs.emplace(type_name, found).first;
+        }
+        if (type_def->second == mdTypeDefNil || caller_info->type.id != type_def->second)
+        {
+            return false;
+        }
+
+        auto functionInfo = FunctionInfo(*caller_info);
+        if (FAILED(functionInfo.method_signature.TryParse()))
+        {
+            return false;
         }
+
+        methods.emplace_back(std::move(functionInfo), &integration);
+    }
+
+    for (size_t i = 0; i < methods.size(); i++)
+    {
+        enqueue_method(plan[i].method_def, methods[i].first, *methods[i].second);
     }
+    return true;
+}
 
+size_t CorProfiler::CallTarget_RequestRejit(ModuleMetadata* module_metadata, std::vector<ModuleID>& vtModules,
+                                            std::vector<mdMethodDef>& vtMethodDefs)
+{
     // Request the ReJIT for all integrations found in the module.
     if (!vtMethodDefs.empty())
     {
+        // Publish the methods before requesting the ReJIT, so the JIT stops inlining them right away
+        module_metadata->AddInstrumentedMethods(vtMethodDefs);
         this->rejit_handler->EnqueueForRejit(vtModules, vtMethodDefs);
     }
 
@@ -3133,15 +3648,18 @@ size_t CorProfiler::CallTarget_RequestRejitForModule(ModuleID module_id, ModuleM
 HRESULT CorProfiler::CallTarget_RewriterCallback(RejitHandlerModule* moduleHandler,
                                                  RejitHandlerModuleMethod* methodHandler)
 {
-    auto _ = trace::Stats::Instance()->CallTargetRewriterCallbackMeasure();
+    auto measure = trace::Stats::Instance()->CallTargetRewriterCallbackMeasure();
 
     ModuleID module_id = moduleHandler->GetModuleId();
     ModuleMetadata* module_metadata = moduleHandler->GetModuleMetadata();
+    std::lock_guard<std::mutex> rewrite_guard(module_metadata->rewrite_lock);
+
     FunctionInfo* caller = methodHandler->GetFunctionInfo();
+    measure.SetName(caller->type.name, caller->name);
     CallTargetTokens* callTargetTokens = module_metadata->GetCallTargetTokens();
     mdToken function_token = caller->id;
     FunctionMethodArgument retFuncArg = caller->method_signature.GetRet();
-    MethodReplacement* method_replacement = methodHandler->GetMethodReplacement();
+    const MethodReplacement* method_replacement = methodHandler->GetMethodReplacement();
     unsigned int retFuncElementType;
     int retTypeFlags = retFuncArg.GetTypeFlags(retFuncElementType);
     bool isVoid = (retTypeFlags & TypeFlagVoid) > 0;
@@ -3311,26 +3829,28 @@ HRESULT CorProfiler::CallTarget_RewriterCallback(RejitHandlerModule* moduleHandl
         Debug("Caller Type.Spec: ", HexStr(&caller->type.type_spec, sizeof(mdTypeSpec)));
         Debug("Caller Type.ValueType: ", caller->type.valueType);
         //
-        if (caller->type.extend_from != nullptr)
+        const auto extend_from = module_metadata->metadata_cache.GetExtendFrom(caller->type);
+        if (extend_from != nullptr)
         {
-            Debug("Caller Type Extend From.Id: ", HexStr(&caller->type.extend_from->id, sizeof(mdToken)));
-            Debug("Caller Type Extend From.IsGeneric: ", caller->type.extend_from->isGeneric);
-            Debug("Caller Type Extend From.IsValid: ", caller->type.extend_from->IsValid());
-            Debug("Caller Type Extend From.Name: ", caller->type.extend_from->name);
-            Debug("Caller Type Extend From.TokenType: ", caller->type.extend_from->token_type);
-            Debug("Caller Type Extend From.Spec: ", HexStr(&caller->type.extend_from->type_spec, sizeof(mdTypeSpec)));
-            Debug("Caller Type Extend From.ValueType: ", caller->type.extend_from->valueType);
+            Debug("Caller Type Extend From.Id: ", HexStr(&extend_from->id, sizeof(mdToken)));
+            Debug("Caller Type Extend From.IsGeneric: ", extend_from->isGeneric);
+            Debug("Caller Type Extend From.IsValid: ", extend_from->IsValid());
+            Debug("Caller Type Extend From.Name: ", extend_from->name);
+            Debug("Caller Type Extend From.TokenType: ", extend_from->token_type);
+            Debug("Caller Type Extend From.Spec: ", HexStr(&extend_from->type_spec, sizeof(mdTypeSpec)));
+            Debug("Caller Type Extend From.ValueType: ", extend_from->valueType);
         }
         //
-        if (caller->type.parent_type != nullptr)
+        const auto parent_type = module_metadata->metadata_cache.GetParentType(caller->type);
+        if (parent_type != nullptr)
         {
-            Debug("Caller ParentType.Id: ", HexStr(&caller->type.parent_type->id, sizeof(mdToken)));
-            Debug("Caller ParentType.IsGeneric: ", caller->type.parent_type->isGeneric);
-            Debug("Caller ParentType.IsValid: ", caller->type.parent_type->IsValid());
-            Debug("Caller ParentType.Name: ", caller->type.parent_type->name);
-            Debug("Caller ParentType.TokenType: ", caller->type.parent_type->token_type);
-            Debug("Caller ParentType.Spec: ", HexStr(&caller->type.parent_type->type_spec, sizeof(mdTypeSpec)));
-            Debug("Caller ParentType.ValueType: ", caller->type.parent_type->valueType);
+            Debug("Caller ParentType.Id: ", HexStr(&parent_type->id, sizeof(mdToken)));
+            Debug("Caller ParentType.IsGeneric: ", parent_type->isGeneric);
+            Debug("Caller ParentType.IsValid: ", parent_type->IsValid());
+            Debug("Caller ParentType.Name: ", parent_type->name);
+            Debug("Caller ParentType.TokenType: ", parent_type->token_type);
+            Debug("Caller ParentType.Spec: ", HexStr(&parent_type->type_spec, sizeof(mdTypeSpec)));
+            Debug("Caller ParentType.ValueType: ", parent_type->valueType);
         }
     }
 
@@ -3542,19 +4062,20 @@ HRESULT CorProfiler::CallTarget_RewriterCallback(RejitHandlerModule* moduleHandl
     // ***
     auto ehCount = rewriter.GetEHCount();
     auto ehPointer = rewriter.GetEHPointer();
-    auto newEHClauses = new EHClause[ehCount + 4];
-    for (unsigned i = 0; i < ehCount; i++)
-    {
-        newEHClauses[i] = ehPointer[i];
-    }
+    std::vector<EHClause> newEHClauses(ehPointer, ehPointer + ehCount);
 
     // *** Add the new EH clauses
-    ehCount += 4;
-    newEHClauses[ehCount - 4] = beginMethodExClause;
-    newEHClauses[ehCount - 3] = endMethodExClause;
-    newEHClauses[ehCount - 2] = exClause;
-    newEHClauses[ehCount - 1] = finallyClause;
-    rewriter.SetEHClause(newEHClauses, ehCount);
+    newEHClauses.push_back(beginMethodExClause);
+    newEHClauses.push_back(endMethodExClause);
+    newEHClauses.push_back(exClause);
+    newEHClauses.push_back(finallyClause);
+    hr = rewriter.SetEHClause(newEHClauses.data(), (unsigned) newEHClauses.size());
+    if (FAILED(hr))
+    {
+        Warn("*** CallTarget_RewriterCallback(): Call to ILRewriter.SetEHClause() failed for ", module_id, " ",
+             function_token);
+        return S_FALSE;
+    }
 
     if (dump_il_rewrite_enabled)
     {
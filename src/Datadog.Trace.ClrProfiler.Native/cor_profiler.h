@@ -4,18 +4,25 @@
 #include "cor.h"
 #include "corprof.h"
 #include <atomic>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "assembly_classifier.h"
+#include "callback_trace.h"
 #include "cor_profiler_base.h"
 #include "environment_variables.h"
 #include "il_rewriter.h"
 #include "integration.h"
+#include "integration_index.h"
+#include "module_analysis_pool.h"
 #include "module_metadata.h"
+#include "module_registry.h"
 #include "pal.h"
 #include "rejit_handler.h"
+#include "rejit_plan_cache.h"
 
 namespace trace
 {
@@ -25,17 +32,31 @@ class CorProfiler : public CorProfilerBase
 private:
     std::atomic_bool is_attached_ = {false};
     RuntimeInformation runtime_information_;
-    std::vector<IntegrationMethod> integration_methods_;
+    IntegrationMethodSet integration_methods_;
+    IntegrationIndex integration_index_;
+    // built once the integrations are loaded, read without locks by the module callbacks
+    AssemblyClassifier assembly_classifier_;
 
     // Startup helper variables
     bool first_jit_compilation_completed = false;
 
     bool instrument_domain_neutral_assemblies = false;
-    bool corlib_module_loaded = false;
-    AppDomainID corlib_app_domain_id = 0;
+    // written once under app_domains_lock_, read without it by the JIT callbacks and the module analysis workers:
+    // the AppDomain is stored before the flag is released
+    std::atomic_bool corlib_module_loaded = {false};
+    std::atomic<AppDomainID> corlib_app_domain_id = {0};
     bool managed_profiler_loaded_domain_neutral = false;
+    // guards the AppDomain sets below and the startup flags written after initialization
+    std::mutex app_domains_lock_;
     std::unordered_set<AppDomainID> managed_profiler_loaded_app_domains;
     std::unordered_set<AppDomainID> first_jit_compilation_app_domains;
+    // AppDomains that loaded a module to instrument before the startup hook was injected into them
+    std::unordered_set<AppDomainID> startup_hook_pending_app_domains_;
+    // In CallTarget mode some events are only needed to inject the startup hook: the JIT compilation events when
+    // nothing else needs them, and the cached function searches when the native images are kept. They are dropped
+    // from the event mask once no AppDomain is waiting for the hook.
+    DWORD startup_hook_events_ = 0;
+    bool startup_hook_events_enabled_ = true;
     bool in_azure_app_services = false;
     bool is_desktop_iis = false;
     bool is_net46_or_greater = false;
@@ -44,6 +65,11 @@ private:
     // CallTarget Members
     //
     RejitHandler* rejit_handler = nullptr;
+    // analyzes the integration targets off the module load thread
+    std::unique_ptr<ModuleAnalysisPool> module_analysis_pool_;
+    // only set when the plan cache is enabled
+    std::unique_ptr<RejitPlanCache> rejit_plan_cache_;
+    std::unique_ptr<CallbackTraceWriter> callback_trace_;
 
     // Cor assembly properties
     AssemblyProperty corAssemblyProperty{};
@@ -56,8 +82,7 @@ private:
     //
     // Module helper variables
     //
-    std::mutex module_id_to_info_map_lock_;
-    std::unordered_map<ModuleID, ModuleMetadata*> module_id_to_info_map_;
+    ModuleRegistry module_registry_;
 
     //
     // Helper methods
@@ -66,13 +91,22 @@ private:
     bool GetWrapperMethodRef(ModuleMetadata* module_metadata, ModuleID module_id,
                              const MethodReplacement& method_replacement, mdMemberRef& wrapper_method_ref,
                              mdTypeRef& wrapper_type_ref);
+    // Returns the replacements, in integration order, whose target matches the method called through the token.
+    // Each token is resolved once per module, the module rewrite_lock must be held.
+    const std::vector<const MethodReplacement*>& GetCallSiteReplacements(ModuleMetadata* module_metadata,
+                                                                         mdToken target_token);
     HRESULT ProcessReplacementCalls(ModuleMetadata* module_metadata, const FunctionID function_id,
                                     const ModuleID module_id, const mdToken function_token, const FunctionInfo& caller,
-                                    const std::vector<MethodReplacement> method_replacements);
+                                    const std::vector<const MethodReplacement*>& method_replacements);
     HRESULT ProcessInsertionCalls(ModuleMetadata* module_metadata, const FunctionID function_id,
                                   const ModuleID module_id, const mdToken function_token, const FunctionInfo& caller,
-                                  const std::vector<MethodReplacement> method_replacements);
+                                  const std::vector<const MethodReplacement*>& method_replacements);
     bool ProfilerAssemblyIsLoadedIntoAppDomain(AppDomainID app_domain_id);
+    // Whether the AppDomain is the shared domain that loaded corlib on .NET Framework
+    bool IsDomainNeutralAppDomain(AppDomainID app_domain_id) const;
+    bool IsStartupHookCallsite(const ModuleMetadata* module_metadata, const FunctionInfo& caller) const;
+    // Adds or removes the startup hook events from the event mask, app_domains_lock_ must be held
+    void SetStartupHookEvents(bool enabled);
     std::string GetILCodes(const std::string& title, ILRewriter* rewriter, const FunctionInfo& caller,
                            ModuleMetadata* module_metadata);
     //
@@ -85,8 +119,14 @@ private:
     //
     // CallTarget Methods
     //
+    void CallTarget_AnalyzeModule(ModuleID module_id);
     size_t CallTarget_RequestRejitForModule(ModuleID module_id, ModuleMetadata* module_metadata,
-                                            const std::vector<IntegrationMethod>& filtered_integrations);
+                                            const std::vector<const IntegrationMethod*>& filtered_integrations);
+    bool CallTarget_EnqueuePlan(
+        ModuleMetadata* module_metadata, const std::vector<RejitPlanEntry>& plan,
+        const std::function<void(mdMethodDef, const FunctionInfo&, const IntegrationMethod&)>& enqueue_method);
+    size_t CallTarget_RequestRejit(ModuleMetadata* module_metadata, std::vector<ModuleID>& vtModules,
+                                   std::vector<mdMethodDef>& vtMethodDefs);
     HRESULT CallTarget_RewriterCallback(RejitHandlerModule* moduleHandler, RejitHandlerModuleMethod* methodHandler);
 
 public:
@@ -97,11 +137,20 @@ public:
     void GetAssemblyAndSymbolsBytes(BYTE** pAssemblyArray, int* assemblySize, BYTE** pSymbolsArray,
                                     int* symbolsSize) const;
 
+    bool GetIntegrationCatalogBytes(const BYTE** pCatalogArray, size_t* catalogSize) const;
+
+    // Blocks until every loaded module has been analyzed and its ReJIT requested
+    void DrainModuleAnalysis();
+
     //
     // ICorProfilerCallback methods
     //
     HRESULT STDMETHODCALLTYPE Initialize(IUnknown* cor_profiler_info_unknown) override;
 
+    HRESULT STDMETHODCALLTYPE AppDomainCreationStarted(AppDomainID app_domain_id) override;
+
+    HRESULT STDMETHODCALLTYPE AppDomainShutdownStarted(AppDomainID app_domain_id) override;
+
     HRESULT STDMETHODCALLTYPE AssemblyLoadFinished(AssemblyID assembly_id, HRESULT hr_status) override;
 
     HRESULT STDMETHODCALLTYPE ModuleLoadFinished(ModuleID module_id, HRESULT hr_status) override;
@@ -115,6 +164,9 @@ public:
     HRESULT STDMETHODCALLTYPE ProfilerDetachSucceeded() override;
 
     HRESULT STDMETHODCALLTYPE JITInlining(FunctionID callerId, FunctionID calleeId, BOOL* pfShouldInline) override;
+
+    HRESULT STDMETHODCALLTYPE JITCachedFunctionSearchStarted(FunctionID function_id,
+                                                             BOOL* use_cached_function) override;
     //
     // ReJIT Methods
     //
@@ -67,6 +67,8 @@ const WSTRING managed_profiler_full_assembly_version =
 
 const WSTRING managed_profiler_name = WStr("Datadog.Trace.ClrProfiler.Managed");
 
+const WSTRING managed_loader_name = WStr("Datadog.Trace.ClrProfiler.Managed.Loader");
+
 const WSTRING nonwindows_nativemethods_type = WStr("Datadog.Trace.ClrProfiler.NativeMethods+NonWindows");
 
 const WSTRING calltarget_modification_action = WStr("CallTargetModification");
@@ -107,9 +107,48 @@ namespace environment
     // Sets whether to enable JIT inlining
     const WSTRING clr_enable_inlining = WStr("DD_CLR_ENABLE_INLINING");
 
+    // Sets whether to keep the ReadyToRun and NGEN images in CallTarget mode. The target methods are rewritten with
+    // ReJIT, which works on precompiled code, so the other methods don't need to be JIT compiled from IL.
+    // Default is false.
+    const WSTRING clr_enable_ngen = WStr("DD_CLR_ENABLE_NGEN");
+
     // Sets whether to enable the CallTarget instrumentation mode
     const WSTRING calltarget_enabled = WStr("DD_TRACE_CALLTARGET_ENABLED");
 
+    // Sets how long (in milliseconds) the ReJIT thread waits for more modules before
+    // requesting a ReJIT, so methods of modules loaded together share one runtime suspension.
+    // Default is 10. Use 0 to only merge the requests that are already queued.
+    const WSTRING rejit_batch_window = WStr("DD_CLR_REJIT_BATCH_WINDOW_MS");
+
+    // Sets the maximum number of methods requested in a single ReJIT batch.
+    // Default is 1000.
+    const WSTRING rejit_batch_max_methods = WStr("DD_CLR_REJIT_BATCH_MAX_METHODS");
+
+    // Sets the number of threads that analyze the loaded modules in CallTarget mode, so the thread loading a module
+    // doesn't wait for its analysis. Default is 2. Use 0 to analyze each module on the thread that loads it.
+    const WSTRING module_analysis_threads = WStr("DD_CLR_MODULE_ANALYSIS_THREADS");
+
+    // Sets a directory where the CallTarget methods found in each module are stored, keyed by the module MVID,
+    // so a process started from the same binaries skips the analysis of those modules.
+    // Disabled by default.
+    const WSTRING rejit_plan_cache_directory = WStr("DD_CLR_REJIT_PLAN_CACHE_DIRECTORY");
+
+    // Sets whether the profiler stats are also written to a memory mapped file next to the native log file
+    // (dotnet-tracer-native-stats-<pid>.dat), so other processes can read them while the application runs. The file is
+    // deleted when the profiler shuts down.
+    // Default is false.
+    const WSTRING stats_file_enabled = WStr("DD_CLR_STATS_FILE_ENABLED");
+
+    // Sets a file where the profiler records the module load, JIT, ReJIT and inlining callbacks it receives,
+    // so the startup of the application can be replayed against the native library without a runtime.
+    // Disabled by default.
+    const WSTRING callback_trace_path = WStr("DD_CLR_CALLBACK_TRACE_PATH");
+
+    // Sets more assemblies the profiler never instruments, on top of the known framework assemblies.
+    // Supports multiple values separated with semi-colons, a value ending with '*' is a prefix, for example:
+    // "MyCompany.Generated.*;Legacy.Reporting"
+    const WSTRING additional_skip_assemblies = WStr("DD_CLR_SKIP_ASSEMBLIES");
+
 } // namespace environment
 } // namespace trace
 
@@ -43,6 +43,25 @@
     }                                                                                                                  \
     return sValue == 1;
 
+#define ToUnsignedWithDefault(EXPR, DEFAULT)                                                                           \
+    static long long sValue = -1;                                                                                      \
+    if (sValue == -1)                                                                                                  \
+    {                                                                                                                  \
+        const auto envValue = EXPR;                                                                                    \
+        long long value = envValue.empty() || envValue.size() > 9 ? -1 : 0;                                            \
+        for (const auto c : envValue)                                                                                  \
+        {                                                                                                              \
+            if (c < '0' || c > '9')                                                                                    \
+            {                                                                                                          \
+                value = -1;                                                                                            \
+                break;                                                                                                 \
+            }                                                                                                          \
+            value = value * 10 + (c - '0');                                                                            \
+        }                                                                                                              \
+        sValue = value == -1 ? DEFAULT : value;                                                                        \
+    }                                                                                                                  \
+    return (unsigned int) sValue;
+
 namespace trace
 {
 
@@ -56,6 +75,11 @@ bool EnableInlining(bool defaultValue)
     ToBooleanWithDefault(GetEnvironmentValue(environment::clr_enable_inlining), defaultValue);
 }
 
+bool IsNGENEnabled()
+{
+    CheckIfTrue(GetEnvironmentValue(environment::clr_enable_ngen));
+}
+
 bool IsCallTargetEnabled(bool defaultValue) {
 #if defined(ARM64) || defined(ARM)
     //
@@ -97,6 +121,26 @@ bool IsDomainNeutralInstrumentation()
     CheckIfTrue(GetEnvironmentValue(environment::domain_neutral_instrumentation));
 }
 
+bool IsStatsFileEnabled()
+{
+    CheckIfTrue(GetEnvironmentValue(environment::stats_file_enabled));
+}
+
+unsigned int GetRejitBatchWindowMilliseconds()
+{
+    ToUnsignedWithDefault(GetEnvironmentValue(environment::rejit_batch_window), 10);
+}
+
+unsigned int GetRejitBatchMaxMethods()
+{
+    ToUnsignedWithDefault(GetEnvironmentValue(environment::rejit_batch_max_methods), 1000);
+}
+
+unsigned int GetModuleAnalysisThreads()
+{
+    ToUnsignedWithDefault(GetEnvironmentValue(environment::module_analysis_threads), 2);
+}
+
 } // namespace trace
 
 #endif // DD_CLR_PROFILER_ENVIRONMENT_VARIABLES_UTIL_H_
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <corhlpr.cpp>
 
 #include "il_rewriter.h"
+#include "logging.h"
 
 #undef IfFailRet
 #define IfFailRet(EXPR)                                                                                                \
@@ -106,6 +107,188 @@ static int k_rgnStackPushes[] = {
     0  // CEE_SWITCH_ARG
 };
 
+namespace
+{
+// Size of the block header, rounded so the data that follows it stays aligned
+const size_t k_BlockHeaderSize = 16;
+const size_t k_AllocationAlignment = 16;
+// Maximum number of free blocks kept per thread
+const unsigned k_MaxCachedBlocks = 4;
+
+// Free standard-size blocks of the current thread, reused by the next rewrites
+struct ArenaBlockCache
+{
+    void* m_pFirst = nullptr;
+    unsigned m_count = 0;
+
+    ~ArenaBlockCache()
+    {
+        while (m_pFirst != nullptr)
+        {
+            void* pNext = *(void**) m_pFirst;
+            free(m_pFirst);
+            m_pFirst = pNext;
+        }
+    }
+
+    void* Pop()
+    {
+        void* pBlock = m_pFirst;
+        if (pBlock != nullptr)
+        {
+            m_pFirst = *(void**) pBlock;
+            m_count--;
+        }
+        return pBlock;
+    }
+
+    bool Push(void* pBlock)
+    {
+        if (m_count >= k_MaxCachedBlocks)
+        {
+            return false;
+        }
+        *(void**) pBlock = m_pFirst;
+        m_pFirst = pBlock;
+        m_count++;
+        return true;
+    }
+};
+
+thread_local ArenaBlockCache t_arenaBlockCache;
+} // namespace
+
+ILRewriterArena::ILRewriterArena() : m_pBlocks(nullptr), m_pCurrent(nullptr), m_pEnd(nullptr)
+{
+}
+
+ILRewriterArena::~ILRewriterArena()
+{
+    Block* pBlock = m_pBlocks;
+    while (pBlock != nullptr)
+    {
+        Block* pNext = pBlock->m_pNext;
+        if (pBlock->m_size != k_BlockSize || !t_arenaBlockCache.Push(pBlock))
+        {
+            free(pBlock);
+        }
+        pBlock = pNext;
+    }
+}
+
+void* ILRewriterArena::Allocate(size_t size)
+{
+    size = (size + k_AllocationAlignment - 1) & ~(k_AllocationAlignment - 1);
+
+    if (size > (size_t)(m_pEnd - m_pCurrent))
+    {
+        // Oversized requests get a block of their own, which is freed instead of cached
+        const size_t blockSize = size > k_BlockSize ? size : k_BlockSize;
+
+        void* pMemory = blockSize == k_BlockSize ? t_arenaBlockCache.Pop() : nullptr;
+        if (pMemory == nullptr)
+        {
+            pMemory = malloc(k_BlockHeaderSize + blockSize);
+            if (pMemory == nullptr)
+            {
+                return nullptr;
+            }
+        }
+
+        Block* pBlock = (Block*) pMemory;
+        pBlock->m_pNext = m_pBlocks;
+        pBlock->m_size = blockSize;
+        m_pBlocks = pBlock;
+        m_pCurrent = (BYTE*) pMemory + k_BlockHeaderSize;
+        m_pEnd = m_pCurrent + blockSize;
+    }
+
+    void* pResult = m_pCurrent;
+    m_pCurrent += size;
+    ZeroMemory(pResult, size);
+    return pResult;
+}
+
+static int k_rgnStackPops[] = {
+
+#define OPDEF(c, s, pop, push, args, type, l, s1, s2, ctrl) pop,
+
+#define Pop0 0
+#define Pop1 1
+#define PopI 1
+#define PopI8 1
+#define PopR4 1
+#define PopR8 1
+#define PopRef 1
+#define VarPop 0 // Resolved from the method signature
+
+#include "opcode.def"
+
+#undef Pop0
+#undef Pop1
+#undef PopI
+#undef PopI8
+#undef PopR4
+#undef PopR8
+#undef PopRef
+#undef VarPop
+#undef OPDEF
+    0, // CEE_COUNT
+    0  // CEE_SWITCH_ARG
+};
+
+enum ILFlowControl
+{
+    FLOW_NEXT,
+    FLOW_BREAK,
+    FLOW_CALL,
+    FLOW_RETURN,
+    FLOW_BRANCH,
+    FLOW_COND_BRANCH,
+    FLOW_THROW,
+    FLOW_META
+};
+
+static const BYTE k_rgFlowControl[] = {
+#define OPDEF(c, s, pop, push, args, type, l, s1, s2, ctrl) FLOW_##ctrl,
+#include "opcode.def"
+#undef OPDEF
+    FLOW_NEXT,       // CEE_COUNT
+    FLOW_COND_BRANCH // CEE_SWITCH_ARG
+};
+
+// Reads the parts of a method signature that define the stack effect of a call
+static HRESULT ParseMethodSignature(PCCOR_SIGNATURE pSig, ULONG cbSig, bool* pHasThis, ULONG* pParamCount,
+                                    bool* pReturnsValue)
+{
+    PCCOR_SIGNATURE pEnd = pSig + cbSig;
+    if (cbSig < 3)
+    {
+        return COR_E_BADIMAGEFORMAT;
+    }
+
+    ULONG callingConvention = CorSigUncompressData(pSig);
+    *pHasThis = (callingConvention & IMAGE_CEE_CS_CALLCONV_HASTHIS) != 0;
+    if (callingConvention & IMAGE_CEE_CS_CALLCONV_GENERIC)
+    {
+        CorSigUncompressData(pSig); // generic parameter count
+    }
+    *pParamCount = CorSigUncompressData(pSig);
+
+    while (pSig < pEnd && (*pSig == ELEMENT_TYPE_CMOD_REQD || *pSig == ELEMENT_TYPE_CMOD_OPT))
+    {
+        pSig++;
+        CorSigUncompressToken(pSig);
+    }
+    if (pSig >= pEnd)
+    {
+        return COR_E_BADIMAGEFORMAT;
+    }
+
+    *pReturnsValue = *pSig != ELEMENT_TYPE_VOID;
+    return S_OK;
+}
+
 ILRewriter::ILRewriter(ICorProfilerInfo* pICorProfilerInfo, ICorProfilerFunctionControl* pICorProfilerFunctionControl,
                        ModuleID moduleID, mdToken tkMethod) :
     m_pICorProfilerInfo(pICorProfilerInfo),
@@ -115,7 +298,6 @@ ILRewriter::ILRewriter(ICorProfilerInfo* pICorProfilerInfo, ICorProfilerFunction
     m_fGenerateTinyHeader(false),
     m_pEH(nullptr),
     m_pOffsetToInstr(nullptr),
-    m_pOutputBuffer(nullptr),
     m_pIMethodMalloc(nullptr)
 {
     m_IL.m_pNext = &m_IL;
@@ -126,17 +308,7 @@ ILRewriter::ILRewriter(ICorProfilerInfo* pICorProfilerInfo, ICorProfilerFunction
 
 ILRewriter::~ILRewriter()
 {
-    ILInstr* p = m_IL.m_pNext;
-    while (p != &m_IL)
-    {
-        ILInstr* t = p->m_pNext;
-        delete p;
-        p = t;
-    }
-    delete[] m_pEH;
-    delete[] m_pOffsetToInstr;
-    delete[] m_pOutputBuffer;
-
+    // instructions, EH clauses and buffers are released with the arena
     if (m_pIMethodMalloc)
     {
         m_pIMethodMalloc->Release();
@@ -174,17 +346,19 @@ EHClause* ILRewriter::GetEHPointer()
     return m_pEH;
 }
 
-void ILRewriter::SetEHClause(EHClause* ehPointer, unsigned ehLength)
+HRESULT ILRewriter::SetEHClause(const EHClause* ehPointer, unsigned ehLength)
 {
-    if (m_pEH != nullptr)
+    // The previous array stays in the arena until the rewriter is destroyed
+    EHClause* pEH = nullptr;
+    if (ehLength > 0)
     {
-        // Delete previous array
-        m_nEH = 0;
-        delete[] m_pEH;
+        IfNullRet(pEH = m_arena.AllocateArray<EHClause>(ehLength));
+        CopyMemory(pEH, ehPointer, sizeof(EHClause) * ehLength);
     }
 
     m_nEH = ehLength;
-    m_pEH = ehPointer;
+    m_pEH = pEH;
+    return S_OK;
 }
 
 HRESULT ILRewriter::Import()
@@ -193,6 +367,11 @@ HRESULT ILRewriter::Import()
 
     IfFailRet(m_pICorProfilerInfo->GetILFunctionBody(m_moduleId, m_tkMethod, &pMethodBytes, nullptr));
 
+    return Import(pMethodBytes);
+}
+
+HRESULT ILRewriter::Import(LPCBYTE pMethodBytes)
+{
     COR_ILMETHOD_DECODER decoder((COR_ILMETHOD*) pMethodBytes);
 
     // Import the header flags
@@ -211,11 +390,9 @@ HRESULT ILRewriter::Import()
 
 HRESULT ILRewriter::ImportIL(LPCBYTE pIL)
 {
-    m_pOffsetToInstr = new ILInstr*[m_CodeSize + 1];
+    m_pOffsetToInstr = m_arena.AllocateArray<ILInstr*>(m_CodeSize + 1);
     IfNullRet(m_pOffsetToInstr);
 
-    ZeroMemory(m_pOffsetToInstr, m_CodeSize * sizeof(ILInstr*));
-
     // Set the sentinel instruction
     m_pOffsetToInstr[m_CodeSize] = &m_IL;
     m_IL.m_opcode = -1;
@@ -358,7 +535,7 @@ HRESULT ILRewriter::ImportEH(const COR_ILMETHOD_SECT_EH* pILEH, unsigned nEH)
 
     if (nEH == 0) return S_OK;
 
-    IfNullRet(m_pEH = new EHClause[m_nEH]);
+    IfNullRet(m_pEH = m_arena.AllocateArray<EHClause>(m_nEH));
     for (unsigned iEH = 0; iEH < m_nEH; iEH++)
     {
         // If the EH clause is in tiny form, the call to pILEH->EHClause() below
@@ -402,7 +579,7 @@ HRESULT ILRewriter::ImportEH(const COR_ILMETHOD_SECT_EH* pILEH, unsigned nEH)
 ILInstr* ILRewriter::NewILInstr()
 {
     m_nInstrs++;
-    return new ILInstr();
+    return m_arena.AllocateArray<ILInstr>(1);
 }
 
 HRESULT ILRewriter::GetInstrFromOffset(unsigned offset, ILInstr** ppInstr)
@@ -453,204 +630,490 @@ ILInstr* ILRewriter::GetILList()
     return &m_IL;
 }
 
-HRESULT ILRewriter::Export()
+HRESULT ILRewriter::GetMethodSignature(IMetaDataImport2* pImport, mdToken token, PCCOR_SIGNATURE* ppSig,
+                                       ULONG* pcbSig)
+{
+    switch (TypeFromToken(token))
+    {
+        case mdtMethodDef:
+            return pImport->GetMethodProps(token, nullptr, nullptr, 0, nullptr, nullptr, ppSig, pcbSig, nullptr,
+                                           nullptr);
+        case mdtMemberRef:
+            return pImport->GetMemberRefProps(token, nullptr, nullptr, 0, nullptr, ppSig, pcbSig);
+        case mdtMethodSpec:
+        {
+            // The instantiation doesn't change the shape of the generic method signature
+            mdToken parent = mdTokenNil;
+            IfFailRet(pImport->GetMethodSpecProps(token, &parent, nullptr, nullptr));
+            if (TypeFromToken(parent) == mdtMethodSpec)
+            {
+                return COR_E_BADIMAGEFORMAT;
+            }
+            return GetMethodSignature(pImport, parent, ppSig, pcbSig);
+        }
+        case mdtSignature:
+            return pImport->GetSigFromToken(token, ppSig, pcbSig);
+        default:
+            return COR_E_BADIMAGEFORMAT;
+    }
+}
+
+HRESULT ILRewriter::GetStackEffect(IMetaDataImport2* pImport, ILInstr* pInstr, int* pPops, int* pPushes)
 {
-    // One instruction produces 2 + sizeof(native int) bytes in the worst case
-    // which can be 10 bytes for 64-bit. For simplification we just use 10 here.
-    unsigned maxSize = m_nInstrs * 10;
+    unsigned opcode = pInstr->m_opcode;
+    *pPops = k_rgnStackPops[opcode];
+    *pPushes = k_rgnStackPushes[opcode];
 
-    m_pOutputBuffer = new BYTE[maxSize];
-    IfNullRet(m_pOutputBuffer);
+    if (opcode != CEE_CALL && opcode != CEE_CALLVIRT && opcode != CEE_NEWOBJ && opcode != CEE_CALLI &&
+        opcode != CEE_RET)
+    {
+        return S_OK;
+    }
 
-again:
-    BYTE* pIL = m_pOutputBuffer;
+    if (pImport == nullptr)
+    {
+        return S_FALSE;
+    }
 
-    bool fBranch = false;
-    unsigned offset = 0;
+    PCCOR_SIGNATURE pSig = nullptr;
+    ULONG cbSig = 0;
+    IfFailRet(GetMethodSignature(pImport, opcode == CEE_RET ? m_tkMethod : (mdToken) pInstr->m_Arg32, &pSig, &cbSig));
 
-    // Go over all instructions and produce code for them
+    bool hasThis = false;
+    ULONG paramCount = 0;
+    bool returnsValue = false;
+    IfFailRet(ParseMethodSignature(pSig, cbSig, &hasThis, &paramCount, &returnsValue));
+
+    switch (opcode)
+    {
+        case CEE_RET:
+            *pPops = returnsValue ? 1 : 0;
+            break;
+        case CEE_NEWOBJ:
+            // the new object is pushed instead of the constructor return value
+            *pPops = paramCount;
+            break;
+        case CEE_CALLI:
+            // the function pointer is on top of the arguments
+            *pPops = paramCount + (hasThis ? 1 : 0) + 1;
+            *pPushes = returnsValue ? 1 : 0;
+            break;
+        default:
+            *pPops = paramCount + (hasThis ? 1 : 0);
+            *pPushes = returnsValue ? 1 : 0;
+            break;
+    }
+
+    return S_OK;
+}
+
+HRESULT ILRewriter::ComputeMaxStack(unsigned* pMaxStack)
+{
+    // Number the instructions, the offsets are recomputed by the layout pass afterwards
+    unsigned nInstrs = 0;
     for (ILInstr* pInstr = m_IL.m_pNext; pInstr != &m_IL; pInstr = pInstr->m_pNext)
     {
+        pInstr->m_offset = nInstrs++;
+    }
+
+    if (nInstrs == 0)
+    {
+        *pMaxStack = 0;
+        return S_OK;
+    }
+
+    // Stack depth on entry of each instruction, -1 while the instruction hasn't been reached.
+    // Each instruction is pushed into the worklist once, when its depth becomes known.
+    int* pDepths = m_arena.AllocateArray<int>(nInstrs);
+    ILInstr** pWorklist = m_arena.AllocateArray<ILInstr*>(nInstrs);
+    IfNullRet(pDepths);
+    IfNullRet(pWorklist);
+    for (unsigned i = 0; i < nInstrs; i++)
+    {
+        pDepths[i] = -1;
+    }
+
+    unsigned nWorklist = 0;
+    ILInstr* pFailedInstr = nullptr;
+    int failedDepth = 0;
+    auto reach = [&](ILInstr* pInstr, int depth) -> bool {
+        if (pInstr == &m_IL || pInstr == nullptr)
+        {
+            // falling off the end of the method
+            pFailedInstr = &m_IL;
+            failedDepth = depth;
+            return false;
+        }
 
-        if (offset >= maxSize)
+        int& current = pDepths[pInstr->m_offset];
+        if (current == -1)
         {
-            return COR_E_INDEXOUTOFRANGE;
+            current = depth;
+            pWorklist[nWorklist++] = pInstr;
+            return true;
         }
+        if (current != depth)
+        {
+            pFailedInstr = pInstr;
+            failedDepth = depth;
+            return false;
+        }
+        return true;
+    };
 
-        pInstr->m_offset = offset;
+    bool fBalanced = reach(m_IL.m_pNext, 0);
 
-        unsigned opcode = pInstr->m_opcode;
-        if (opcode < CEE_COUNT)
+    // The evaluation stack is empty when entering a protected block, and holds the exception
+    // object when entering a catch handler or a filter
+    for (unsigned iEH = 0; fBalanced && iEH < m_nEH; iEH++)
+    {
+        const EHClause& clause = m_pEH[iEH];
+        fBalanced = reach(clause.m_pTryBegin, 0);
+
+        if (fBalanced && (clause.m_Flags & COR_ILEXCEPTION_CLAUSE_FILTER) != 0)
         {
-            // CEE_PREFIX1 refers not to instruction prefixes (like tail.), but to
-            // the lead byte of multi-byte opcodes. For now, the only lead byte
-            // supported is CEE_PREFIX1 = 0xFE.
-            if (opcode >= 0x100) m_pOutputBuffer[offset++] = CEE_PREFIX1;
+            fBalanced = reach(clause.m_pFilter, 1);
+        }
 
-            // This appears to depend on an implicit conversion from
-            // unsigned opcode down to BYTE, to deliberately lose data and have
-            // opcode >= 0x100 wrap around to 0.
-            m_pOutputBuffer[offset++] = (opcode & 0xFF);
+        if (fBalanced)
+        {
+            const bool hasException =
+                (clause.m_Flags & (COR_ILEXCEPTION_CLAUSE_FINALLY | COR_ILEXCEPTION_CLAUSE_FAULT)) == 0;
+            fBalanced = reach(clause.m_pHandlerBegin, hasException ? 1 : 0);
         }
+    }
 
-        if (pInstr->m_opcode >= (sizeof(s_OpCodeFlags) / sizeof(BYTE)))
+    IMetaDataImport2* pImport = nullptr;
+    if (m_pICorProfilerInfo == nullptr ||
+        FAILED(m_pICorProfilerInfo->GetModuleMetaData(m_moduleId, ofRead, IID_IMetaDataImport2,
+                                                      (IUnknown**) &pImport)))
+    {
+        pImport = nullptr;
+    }
+
+    HRESULT hr = S_OK;
+    int maxStack = 0;
+    while (fBalanced && nWorklist > 0)
+    {
+        ILInstr* pInstr = pWorklist[--nWorklist];
+        int depth = pDepths[pInstr->m_offset];
+        if (depth > maxStack)
         {
-            return COR_E_INVALIDPROGRAM;
+            // the exception object on entry of a handler counts even if it is popped right away
+            maxStack = depth;
         }
 
-        BYTE flags = s_OpCodeFlags[pInstr->m_opcode];
-        switch (flags)
+        int pops;
+        int pushes;
+        hr = GetStackEffect(pImport, pInstr, &pops, &pushes);
+        if (hr != S_OK)
         {
-            case 0:
-                break;
-            case 1:
-                *(UNALIGNED INT8*) &(pIL[offset]) = pInstr->m_Arg8;
-                break;
-            case 2:
-                *(UNALIGNED INT16*) &(pIL[offset]) = pInstr->m_Arg16;
-                break;
-            case 4:
-                *(UNALIGNED INT32*) &(pIL[offset]) = pInstr->m_Arg32;
+            // We can't know the stack effect of this call, so the exact value can't be computed
+            break;
+        }
+
+        if (depth < pops)
+        {
+            pFailedInstr = pInstr;
+            failedDepth = depth;
+            fBalanced = false;
+            break;
+        }
+
+        depth = depth - pops + pushes;
+        if (depth > maxStack)
+        {
+            maxStack = depth;
+        }
+
+        switch (k_rgFlowControl[pInstr->m_opcode])
+        {
+            case FLOW_BRANCH:
+                // leave empties the evaluation stack
+                if (pInstr->m_opcode == CEE_LEAVE || pInstr->m_opcode == CEE_LEAVE_S)
+                {
+                    depth = 0;
+                }
+                fBalanced = reach(pInstr->m_pTarget, depth);
                 break;
-            case 8:
-                *(UNALIGNED INT64*) &(pIL[offset]) = pInstr->m_Arg64;
+            case FLOW_COND_BRANCH:
+                if (pInstr->m_opcode != CEE_SWITCH)
+                {
+                    fBalanced = reach(pInstr->m_pTarget, depth);
+                }
+                fBalanced = fBalanced && reach(pInstr->m_pNext, depth);
                 break;
-            case 1 | OPCODEFLAGS_BranchTarget:
-                fBranch = true;
+            case FLOW_RETURN:
+                // ret must leave an empty stack, endfinally and endfilter end the handler
+                if (pInstr->m_opcode == CEE_RET && depth != 0)
+                {
+                    pFailedInstr = pInstr;
+                    failedDepth = depth;
+                    fBalanced = false;
+                }
                 break;
-            case 4 | OPCODEFLAGS_BranchTarget:
-                fBranch = true;
+            case FLOW_THROW:
                 break;
-            case 0 | OPCODEFLAGS_Switch:
-                *(UNALIGNED INT32*) &(pIL[offset]) = pInstr->m_Arg32;
-                offset += sizeof(INT32);
+            case FLOW_CALL:
+                if (pInstr->m_opcode == CEE_JMP)
+                {
+                    break;
+                }
+                fBalanced = reach(pInstr->m_pNext, depth);
                 break;
             default:
-                return COR_E_INVALIDPROGRAM;
+                fBalanced = reach(pInstr->m_pNext, depth);
+                break;
         }
-        offset += (flags & OPCODEFLAGS_SizeMask);
     }
-    m_IL.m_offset = offset;
 
-    if (fBranch)
+    if (pImport != nullptr)
     {
-        bool fTryAgain = false;
-        unsigned switchBase = 0;
+        pImport->Release();
+    }
+
+    if (!fBalanced)
+    {
+        if (pFailedInstr == &m_IL)
+        {
+            trace::Warn("ILRewriter: the IL of method ", m_tkMethod, " in module ", m_moduleId,
+                        " falls through the end of the method with stack depth ", failedDepth);
+        }
+        else
+        {
+            trace::Warn("ILRewriter: the IL of method ", m_tkMethod, " in module ", m_moduleId,
+                        " is unbalanced at instruction ", pFailedInstr->m_offset, " (opcode ", pFailedInstr->m_opcode,
+                        "), stack depth ", failedDepth);
+        }
+        return COR_E_INVALIDPROGRAM;
+    }
+
+    if (hr != S_OK)
+    {
+        return S_FALSE;
+    }
+
+    *pMaxStack = (unsigned) maxStack;
+    return S_OK;
+}
+
+HRESULT ILRewriter::Export()
+{
+    // Compute the exact max stack. If the stack effect of a call can't be resolved we keep the
+    // conservative value accumulated while inserting instructions.
+    unsigned maxStack = 0;
+    HRESULT hrMaxStack = ComputeMaxStack(&maxStack);
+    if (FAILED(hrMaxStack))
+    {
+        return hrMaxStack;
+    }
+    const bool fExactMaxStack = hrMaxStack == S_OK;
+    if (fExactMaxStack)
+    {
+        m_maxStack = maxStack;
+    }
+
+    // Lay out all instructions first, so we know the exact size of the body and can write it
+    // directly into its final allocation. Short branches whose target doesn't fit into an INT8
+    // are widened, which moves the following instructions, so we iterate until the layout is stable.
+    bool fBranch = false;
+    bool fTryAgain;
+    do
+    {
+        fTryAgain = false;
+        unsigned offset = 0;
 
-        // Go over all control flow instructions and resolve the targets
         for (ILInstr* pInstr = m_IL.m_pNext; pInstr != &m_IL; pInstr = pInstr->m_pNext)
         {
-            unsigned opcode = pInstr->m_opcode;
+            pInstr->m_offset = offset;
 
-            if (pInstr->m_opcode == CEE_SWITCH)
+            unsigned opcode = pInstr->m_opcode;
+            if (opcode >= (sizeof(s_OpCodeFlags) / sizeof(BYTE)))
             {
-                switchBase = pInstr->m_offset + 1 + sizeof(INT32) * (pInstr->m_Arg32 + 1);
-                continue;
+                return COR_E_INVALIDPROGRAM;
             }
-            if (opcode == CEE_SWITCH_ARG)
+
+            if (opcode < CEE_COUNT)
             {
-                // Switch args are special
-                *(UNALIGNED INT32*) &(pIL[pInstr->m_offset]) = pInstr->m_pTarget->m_offset - switchBase;
-                continue;
+                // CEE_PREFIX1 refers not to instruction prefixes (like tail.), but to
+                // the lead byte of multi-byte opcodes.
+                offset += opcode >= 0x100 ? 2 : 1;
             }
 
-            BYTE flags = s_OpCodeFlags[pInstr->m_opcode];
+            BYTE flags = s_OpCodeFlags[opcode];
+            switch (flags)
+            {
+                case 0:
+                case 1:
+                case 2:
+                case 4:
+                case 8:
+                    break;
+                case 1 | OPCODEFLAGS_BranchTarget:
+                case 4 | OPCODEFLAGS_BranchTarget:
+                    fBranch = true;
+                    break;
+                case 0 | OPCODEFLAGS_Switch:
+                    offset += sizeof(INT32);
+                    break;
+                default:
+                    return COR_E_INVALIDPROGRAM;
+            }
+            offset += (flags & OPCODEFLAGS_SizeMask);
+        }
+        m_IL.m_offset = offset;
 
-            if (flags & OPCODEFLAGS_BranchTarget)
+        if (fBranch)
+        {
+            for (ILInstr* pInstr = m_IL.m_pNext; pInstr != &m_IL; pInstr = pInstr->m_pNext)
             {
+                unsigned opcode = pInstr->m_opcode;
+                if (s_OpCodeFlags[opcode] != (1 | OPCODEFLAGS_BranchTarget))
+                {
+                    continue;
+                }
+
+                // Check if delta is too big to fit into an INT8.
                 int delta = pInstr->m_pTarget->m_offset - pInstr->m_pNext->m_offset;
+                if ((INT8) delta == delta)
+                {
+                    continue;
+                }
 
-                switch (flags)
+                if (opcode == CEE_LEAVE_S)
+                {
+                    pInstr->m_opcode = CEE_LEAVE;
+                }
+                else
                 {
-                    case 1 | OPCODEFLAGS_BranchTarget:
-                        // Check if delta is too big to fit into an INT8.
-                        //
-                        // (see #pragma at top of file)
-                        if ((INT8) delta != delta)
-                        {
-                            if (opcode == CEE_LEAVE_S)
-                            {
-                                pInstr->m_opcode = CEE_LEAVE;
-                            }
-                            else
-                            {
-                                if (!(opcode >= CEE_BR_S && opcode <= CEE_BLT_UN_S))
-                                {
-                                    return COR_E_INVALIDPROGRAM;
-                                }
-
-                                pInstr->m_opcode = opcode - CEE_BR_S + CEE_BR;
-
-                                if (!(pInstr->m_opcode >= CEE_BR && pInstr->m_opcode <= CEE_BLT_UN))
-                                {
-                                    return COR_E_INVALIDPROGRAM;
-                                }
-                            }
-                            fTryAgain = true;
-                            continue;
-                        }
-                        *(UNALIGNED INT8*) &(pIL[pInstr->m_pNext->m_offset - sizeof(INT8)]) = delta;
-                        break;
-                    case 4 | OPCODEFLAGS_BranchTarget:
-                        *(UNALIGNED INT32*) &(pIL[pInstr->m_pNext->m_offset - sizeof(INT32)]) = delta;
-                        break;
-                    default:
+                    if (!(opcode >= CEE_BR_S && opcode <= CEE_BLT_UN_S))
+                    {
                         return COR_E_INVALIDPROGRAM;
+                    }
+
+                    pInstr->m_opcode = opcode - CEE_BR_S + CEE_BR;
+
+                    if (!(pInstr->m_opcode >= CEE_BR && pInstr->m_opcode <= CEE_BLT_UN))
+                    {
+                        return COR_E_INVALIDPROGRAM;
+                    }
                 }
+                fTryAgain = true;
             }
         }
+    } while (fTryAgain);
+
+    unsigned codeSize = m_IL.m_offset;
 
-        // Do the whole thing again if we changed the size of some branch targets
-        if (fTryAgain) goto again;
+    // A tiny header implies a max stack of 8, no locals and no EH clauses
+    bool fTinyHeader = m_fGenerateTinyHeader;
+    if (!fTinyHeader && fExactMaxStack && m_maxStack <= 8 && m_tkLocalVarSig == mdTokenNil && m_nEH == 0 &&
+        codeSize < 64)
+    {
+        fTinyHeader = true;
     }
 
-    unsigned codeSize = offset;
+    unsigned headerSize;
     unsigned totalSize;
-    LPBYTE pBody = NULL;
-    if (m_fGenerateTinyHeader)
+    if (fTinyHeader)
     {
         // Make sure we can fit in a tiny header
-        if (codeSize >= 64) return E_FAIL;
-
-        totalSize = sizeof(IMAGE_COR_ILMETHOD_TINY) + codeSize;
-        pBody = AllocateILMemory(totalSize);
-        IfNullRet(pBody);
-
-        BYTE* pCurrent = pBody;
-
-        // Here's the tiny header
-        *pCurrent = (BYTE)(CorILMethod_TinyFormat | (codeSize << 2));
-        pCurrent += sizeof(IMAGE_COR_ILMETHOD_TINY);
+        if (codeSize >= 64 || (fExactMaxStack && m_maxStack > 8)) return E_FAIL;
 
-        // And the body
-        CopyMemory(pCurrent, m_pOutputBuffer, codeSize);
+        headerSize = sizeof(IMAGE_COR_ILMETHOD_TINY);
+        totalSize = headerSize + codeSize;
     }
     else
     {
-        // Use FAT header
-
-        unsigned alignedCodeSize = (offset + 3) & ~3;
+        unsigned alignedCodeSize = (codeSize + 3) & ~3;
 
+        headerSize = sizeof(IMAGE_COR_ILMETHOD_FAT);
         totalSize =
-            sizeof(IMAGE_COR_ILMETHOD_FAT) + alignedCodeSize +
+            headerSize + alignedCodeSize +
             (m_nEH ? (sizeof(IMAGE_COR_ILMETHOD_SECT_FAT) + sizeof(IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT) * m_nEH) : 0);
+    }
+
+    LPBYTE pBody = AllocateILMemory(totalSize);
+    IfNullRet(pBody);
 
-        pBody = AllocateILMemory(totalSize);
-        IfNullRet(pBody);
+    BYTE* pIL = pBody + headerSize;
+    unsigned switchBase = 0;
+
+    // Go over all instructions and produce code for them
+    for (ILInstr* pInstr = m_IL.m_pNext; pInstr != &m_IL; pInstr = pInstr->m_pNext)
+    {
+        BYTE* pCurrent = pIL + pInstr->m_offset;
+
+        unsigned opcode = pInstr->m_opcode;
+        if (opcode < CEE_COUNT)
+        {
+            if (opcode >= 0x100) *pCurrent++ = CEE_PREFIX1;
+
+            // This appears to depend on an implicit conversion from
+            // unsigned opcode down to BYTE, to deliberately lose data and have
+            // opcode >= 0x100 wrap around to 0.
+            *pCurrent++ = (opcode & 0xFF);
+        }
+
+        switch (s_OpCodeFlags[opcode])
+        {
+            case 0:
+                break;
+            case 1:
+                *(UNALIGNED INT8*) pCurrent = pInstr->m_Arg8;
+                break;
+            case 2:
+                *(UNALIGNED INT16*) pCurrent = pInstr->m_Arg16;
+                break;
+            case 4:
+                *(UNALIGNED INT32*) pCurrent = pInstr->m_Arg32;
+                break;
+            case 8:
+                *(UNALIGNED INT64*) pCurrent = pInstr->m_Arg64;
+                break;
+            case 1 | OPCODEFLAGS_BranchTarget:
+                *(UNALIGNED INT8*) pCurrent = (INT8)(pInstr->m_pTarget->m_offset - pInstr->m_pNext->m_offset);
+                break;
+            case 4 | OPCODEFLAGS_BranchTarget:
+                if (opcode == CEE_SWITCH_ARG)
+                {
+                    // Switch args are relative to the end of the switch table
+                    *(UNALIGNED INT32*) pCurrent = pInstr->m_pTarget->m_offset - switchBase;
+                }
+                else
+                {
+                    *(UNALIGNED INT32*) pCurrent = pInstr->m_pTarget->m_offset - pInstr->m_pNext->m_offset;
+                }
+                break;
+            case 0 | OPCODEFLAGS_Switch:
+                *(UNALIGNED INT32*) pCurrent = pInstr->m_Arg32;
+                switchBase = pInstr->m_offset + 1 + sizeof(INT32) * (pInstr->m_Arg32 + 1);
+                break;
+            default:
+                return COR_E_INVALIDPROGRAM;
+        }
+    }
 
-        BYTE* pCurrent = pBody;
+    if (fTinyHeader)
+    {
+        // Here's the tiny header
+        *pBody = (BYTE)(CorILMethod_TinyFormat | (codeSize << 2));
+    }
+    else
+    {
+        // Use FAT header
+        unsigned alignedCodeSize = (codeSize + 3) & ~3;
 
-        IMAGE_COR_ILMETHOD_FAT* pHeader = (IMAGE_COR_ILMETHOD_FAT*) pCurrent;
+        IMAGE_COR_ILMETHOD_FAT* pHeader = (IMAGE_COR_ILMETHOD_FAT*) pBody;
         pHeader->Flags = m_flags | (m_nEH ? CorILMethod_MoreSects : 0) | CorILMethod_FatFormat;
         pHeader->Size = sizeof(IMAGE_COR_ILMETHOD_FAT) / sizeof(DWORD);
         pHeader->MaxStack = m_maxStack;
-        pHeader->CodeSize = offset;
+        pHeader->CodeSize = codeSize;
         pHeader->LocalVarSigTok = m_tkLocalVarSig;
 
-        pCurrent = (BYTE*) (pHeader + 1);
-
-        CopyMemory(pCurrent, m_pOutputBuffer, codeSize);
-        pCurrent += alignedCodeSize;
+        BYTE* pCurrent = pIL + codeSize;
+        ZeroMemory(pCurrent, alignedCodeSize - codeSize);
+        pCurrent = pIL + alignedCodeSize;
 
         if (m_nEH != 0)
         {
@@ -682,7 +1145,6 @@ again:
     }
 
     IfFailRet(SetILFunctionBody(totalSize, pBody));
-    DeallocateILMemory(pBody);
 
     return S_OK;
 }
@@ -707,9 +1169,9 @@ LPBYTE ILRewriter::AllocateILMemory(unsigned size)
 {
     if (m_pICorProfilerFunctionControl != nullptr)
     {
-        // We're supplying IL for a rejit, so we can just allocate from
-        // the heap
-        return new BYTE[size];
+        // We're supplying IL for a rejit, the runtime copies the body
+        // so we can just allocate from the arena
+        return m_arena.AllocateArray<BYTE>(size);
     }
 
     // Else, this is "classic-style" instrumentation on first JIT, and
@@ -720,17 +1182,6 @@ LPBYTE ILRewriter::AllocateILMemory(unsigned size)
     return (LPBYTE) m_pIMethodMalloc->Alloc(size);
 }
 
-void ILRewriter::DeallocateILMemory(LPBYTE pBody)
-{
-    if (m_pICorProfilerFunctionControl == nullptr)
-    {
-        // Old-style instrumentation does not provide a way to free up bytes
-        return;
-    }
-
-    delete[] pBody;
-}
-
 unsigned ILRewriter::GetMaxStackValue()
 {
     return m_maxStack;
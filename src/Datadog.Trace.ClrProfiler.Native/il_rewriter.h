@@ -51,9 +51,47 @@ struct EHClause
     };
 };
 
+// Bump allocator that owns the memory of a single rewrite: instructions, EH clauses, the import
+// offset table and the exported method body. Everything is released at once when the rewriter is
+// destroyed, and the blocks are recycled through a per-thread cache so steady-state rewrites don't
+// go to the heap.
+class ILRewriterArena
+{
+private:
+    struct Block
+    {
+        Block* m_pNext;
+        size_t m_size;
+    };
+
+    Block* m_pBlocks;
+    BYTE* m_pCurrent;
+    BYTE* m_pEnd;
+
+public:
+    static const size_t k_BlockSize = 64 * 1024;
+
+    ILRewriterArena();
+    ~ILRewriterArena();
+
+    ILRewriterArena(const ILRewriterArena&) = delete;
+    ILRewriterArena& operator=(const ILRewriterArena&) = delete;
+
+    // Returns zeroed memory aligned for any of the rewriter types, or nullptr if out of memory
+    void* Allocate(size_t size);
+
+    template <typename T>
+    T* AllocateArray(size_t count)
+    {
+        return static_cast<T*>(Allocate(sizeof(T) * count));
+    }
+};
+
 class ILRewriter
 {
 private:
+    ILRewriterArena m_arena;
+
     ICorProfilerInfo* m_pICorProfilerInfo;
     ICorProfilerFunctionControl* m_pICorProfilerFunctionControl;
 
@@ -79,10 +117,14 @@ private:
 
     unsigned m_nInstrs;
 
-    BYTE* m_pOutputBuffer;
-
     IMethodMalloc* m_pIMethodMalloc;
 
+    HRESULT ComputeMaxStack(unsigned* pMaxStack);
+
+    HRESULT GetStackEffect(IMetaDataImport2* pImport, ILInstr* pInstr, int* pPops, int* pPushes);
+
+    HRESULT GetMethodSignature(IMetaDataImport2* pImport, mdToken token, PCCOR_SIGNATURE* ppSig, ULONG* pcbSig);
+
 public:
     ILRewriter(ICorProfilerInfo* pICorProfilerInfo, ICorProfilerFunctionControl* pICorProfilerFunctionControl,
                ModuleID moduleID, mdToken tkMethod);
@@ -99,7 +141,8 @@ public:
 
     EHClause* GetEHPointer();
 
-    void SetEHClause(EHClause* ehPointer, unsigned ehLength);
+    // Replaces the EH clauses of the method, the clauses are copied
+    HRESULT SetEHClause(const EHClause* ehPointer, unsigned ehLength);
 
     /////////////////////////////////////////////////////////////////////////////////////////////////
     //
@@ -109,6 +152,9 @@ public:
 
     HRESULT Import();
 
+    // Imports the given method body (header, IL and EH sections) instead of the current body of the method
+    HRESULT Import(LPCBYTE pMethodBytes);
+
     HRESULT ImportIL(LPCBYTE pIL);
 
     HRESULT ImportEH(const COR_ILMETHOD_SECT_EH* pILEH, unsigned nEH);
@@ -137,8 +183,6 @@ public:
 
     LPBYTE AllocateILMemory(unsigned size);
 
-    void DeallocateILMemory(LPBYTE pBody);
-
     unsigned GetMaxStackValue();
 };
 
@@ -13,6 +13,82 @@
 namespace trace
 {
 
+size_t GetRetainedBytes(const std::vector<IntegrationMethod>& integration_methods)
+{
+    const auto string_bytes = [](const WSTRING& str) { return str.capacity() * sizeof(WCHAR); };
+    const auto method_bytes = [&string_bytes](const MethodReference& method) {
+        size_t bytes = string_bytes(method.assembly.name) + string_bytes(method.assembly.locale) +
+                       string_bytes(method.type_name) + string_bytes(method.method_name) +
+                       string_bytes(method.action) + method.method_signature.data.capacity() +
+                       method.signature_types.capacity() * sizeof(WSTRING);
+        for (const auto& signature_type : method.signature_types)
+        {
+            bytes += string_bytes(signature_type);
+        }
+        return bytes;
+    };
+
+    size_t bytes = integration_methods.capacity() * sizeof(IntegrationMethod);
+    for (const auto& integration_method : integration_methods)
+    {
+        bytes += string_bytes(integration_method.integration_name) +
+                 method_bytes(integration_method.replacement.caller_method) +
+                 method_bytes(integration_method.replacement.target_method) +
+                 method_bytes(integration_method.replacement.wrapper_method);
+    }
+    return bytes;
+}
+
+uint64_t GetIntegrationMethodsHash(const std::vector<IntegrationMethod>& integration_methods)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const auto add_bytes = [&hash](const void* data, size_t size) {
+        const BYTE* bytes = static_cast<const BYTE*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    const auto add_size = [&add_bytes](uint64_t size) { add_bytes(&size, sizeof(size)); };
+    // strings are length-prefixed so adjacent fields can't be confused
+    const auto add_string = [&add_bytes, &add_size](const WSTRING& str) {
+        add_size(str.size());
+        add_bytes(str.data(), str.size() * sizeof(WCHAR));
+    };
+    const auto add_version = [&add_bytes](const Version& version) {
+        const unsigned short parts[] = {version.major, version.minor, version.build, version.revision};
+        add_bytes(parts, sizeof(parts));
+    };
+    const auto add_method = [&](const MethodReference& method) {
+        add_string(method.assembly.name);
+        add_version(method.assembly.version);
+        add_string(method.assembly.locale);
+        add_bytes(method.assembly.public_key.data, kPublicKeySize);
+        add_string(method.type_name);
+        add_string(method.method_name);
+        add_string(method.action);
+        add_size(method.method_signature.data.size());
+        add_bytes(method.method_signature.data.data(), method.method_signature.data.size());
+        add_version(method.min_version);
+        add_version(method.max_version);
+        add_size(method.signature_types.size());
+        for (const auto& signature_type : method.signature_types)
+        {
+            add_string(signature_type);
+        }
+    };
+
+    add_size(integration_methods.size());
+    for (const auto& integration_method : integration_methods)
+    {
+        add_string(integration_method.integration_name);
+        add_method(integration_method.replacement.caller_method);
+        add_method(integration_method.replacement.target_method);
+        add_method(integration_method.replacement.wrapper_method);
+    }
+    return hash;
+}
+
 AssemblyReference::AssemblyReference(const WSTRING& str) :
     name(GetNameFromAssemblyReferenceString(str)),
     version(GetVersionFromAssemblyReferenceString(str)),
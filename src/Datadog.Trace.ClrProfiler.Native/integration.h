@@ -2,7 +2,9 @@
 #define DD_CLR_PROFILER_INTEGRATION_H_
 
 #include <corhlpr.h>
+#include <cstdint>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 #include <vector>
 
@@ -132,6 +134,11 @@ struct AssemblyReference
     {
     }
     AssemblyReference(const WSTRING& str);
+    AssemblyReference(const WSTRING& name, const Version& version, const WSTRING& locale,
+                      const PublicKey& public_key) :
+        name(name), version(version), locale(locale), public_key(public_key)
+    {
+    }
 
     inline bool operator==(const AssemblyReference& other) const
     {
@@ -267,6 +274,20 @@ struct MethodReference
     {
     }
 
+    MethodReference(const AssemblyReference& assembly, WSTRING type_name, WSTRING method_name, WSTRING action,
+                    Version min_version, Version max_version, const std::vector<BYTE>& method_signature,
+                    const std::vector<WSTRING>& signature_types) :
+        assembly(assembly),
+        type_name(type_name),
+        method_name(method_name),
+        action(action),
+        method_signature(method_signature),
+        min_version(min_version),
+        max_version(max_version),
+        signature_types(signature_types)
+    {
+    }
+
     inline WSTRING get_type_cache_key() const
     {
         return WStr("[") + assembly.name + WStr("]") + type_name + WStr("_vMin_") + min_version.str() + WStr("_vMax_") +
@@ -349,6 +370,17 @@ struct IntegrationMethod
     }
 };
 
+// IntegrationMethodSet is the immutable set of enabled integration methods. It is
+// built once in Initialize and shared by every module, which only keep pointers
+// to the integration methods that apply to them.
+typedef std::shared_ptr<const std::vector<IntegrationMethod>> IntegrationMethodSet;
+
+// GetRetainedBytes returns an estimate of the heap memory used by the integration methods
+size_t GetRetainedBytes(const std::vector<IntegrationMethod>& integration_methods);
+
+// GetIntegrationMethodsHash returns a stable 64-bit hash (FNV-1a) of the integration methods and their order
+uint64_t GetIntegrationMethodsHash(const std::vector<IntegrationMethod>& integration_methods);
+
 namespace
 {
 
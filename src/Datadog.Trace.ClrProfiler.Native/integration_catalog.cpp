@@ -0,0 +1,356 @@
+#include "integration_catalog.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "logging.h"
+
+namespace trace
+{
+
+namespace
+{
+
+    class CatalogWriter
+    {
+    private:
+        std::vector<CatalogIntegration> integrations_;
+        std::vector<CatalogMethodReplacement> replacements_;
+        std::vector<CatalogString> string_refs_;
+        std::vector<BYTE> bytes_;
+        std::vector<WCHAR> chars_;
+        std::unordered_map<WSTRING, uint32_t> interned_;
+
+        CatalogString AddString(const WSTRING& str)
+        {
+            const auto found = interned_.find(str);
+            if (found != interned_.end())
+            {
+                return {found->second, (uint32_t) str.size()};
+            }
+
+            const auto offset = (uint32_t) chars_.size();
+            chars_.insert(chars_.end(), str.begin(), str.end());
+            interned_[str] = offset;
+            return {offset, (uint32_t) str.size()};
+        }
+
+        static CatalogVersion ToCatalogVersion(const Version& version)
+        {
+            return {version.major, version.minor, version.build, version.revision};
+        }
+
+        CatalogMethodReference AddMethodReference(const MethodReference& method)
+        {
+            CatalogMethodReference ref{};
+            ref.assembly_name = AddString(method.assembly.name);
+            ref.assembly_version = ToCatalogVersion(method.assembly.version);
+            ref.assembly_locale = AddString(method.assembly.locale);
+            std::memcpy(ref.assembly_public_key, method.assembly.public_key.data, kPublicKeySize);
+            ref.type_name = AddString(method.type_name);
+            ref.method_name = AddString(method.method_name);
+            ref.action = AddString(method.action);
+            ref.min_version = ToCatalogVersion(method.min_version);
+            ref.max_version = ToCatalogVersion(method.max_version);
+
+            ref.signature = {(uint32_t) bytes_.size(), (uint32_t) method.method_signature.data.size()};
+            bytes_.insert(bytes_.end(), method.method_signature.data.begin(), method.method_signature.data.end());
+
+            ref.signature_types = {(uint32_t) string_refs_.size(), (uint32_t) method.signature_types.size()};
+            for (const auto& signature_type : method.signature_types)
+            {
+                string_refs_.push_back(AddString(signature_type));
+            }
+
+            return ref;
+        }
+
+        template <typename T>
+        static void Append(std::vector<BYTE>& output, const T* data, size_t count)
+        {
+            const auto bytes = reinterpret_cast<const BYTE*>(data);
+            output.insert(output.end(), bytes, bytes + sizeof(T) * count);
+        }
+
+    public:
+        void AddIntegration(const Integration& integration)
+        {
+            CatalogIntegration item{};
+            item.name = AddString(integration.integration_name);
+            item.method_replacements = {(uint32_t) replacements_.size(),
+                                        (uint32_t) integration.method_replacements.size()};
+
+            for (const auto& replacement : integration.method_replacements)
+            {
+                CatalogMethodReplacement catalog_replacement{};
+                catalog_replacement.caller_method = AddMethodReference(replacement.caller_method);
+                catalog_replacement.target_method = AddMethodReference(replacement.target_method);
+                catalog_replacement.wrapper_method = AddMethodReference(replacement.wrapper_method);
+                replacements_.push_back(catalog_replacement);
+            }
+
+            integrations_.push_back(item);
+        }
+
+        std::vector<BYTE> Build() const
+        {
+            CatalogHeader header{};
+            header.magic = kIntegrationCatalogMagic;
+            header.version = kIntegrationCatalogVersion;
+            header.char_size = sizeof(WCHAR);
+
+            uint32_t offset = sizeof(CatalogHeader);
+            header.integration_count = (uint32_t) integrations_.size();
+            header.integrations_offset = offset;
+            offset += (uint32_t) (sizeof(CatalogIntegration) * integrations_.size());
+            header.replacement_count = (uint32_t) replacements_.size();
+            header.replacements_offset = offset;
+            offset += (uint32_t) (sizeof(CatalogMethodReplacement) * replacements_.size());
+            header.string_ref_count = (uint32_t) string_refs_.size();
+            header.string_refs_offset = offset;
+            offset += (uint32_t) (sizeof(CatalogString) * string_refs_.size());
+            header.bytes_size = (uint32_t) bytes_.size();
+            header.bytes_offset = offset;
+            offset += (uint32_t) bytes_.size();
+            header.chars_size = (uint32_t) chars_.size();
+            header.chars_offset = offset;
+            offset += (uint32_t) (sizeof(WCHAR) * chars_.size());
+            header.total_size = offset;
+
+            std::vector<BYTE> output;
+            output.reserve(offset);
+            Append(output, &header, 1);
+            Append(output, integrations_.data(), integrations_.size());
+            Append(output, replacements_.data(), replacements_.size());
+            Append(output, string_refs_.data(), string_refs_.size());
+            Append(output, bytes_.data(), bytes_.size());
+            Append(output, chars_.data(), chars_.size());
+            return output;
+        }
+    };
+
+    class CatalogReader
+    {
+    private:
+        const BYTE* data_;
+        const size_t size_;
+        CatalogHeader header_{};
+
+        template <typename T>
+        bool Read(uint32_t base, uint32_t count, uint32_t index, T* out) const
+        {
+            if (index >= count)
+            {
+                return false;
+            }
+            std::memcpy(out, data_ + base + sizeof(T) * index, sizeof(T));
+            return true;
+        }
+
+        bool InBounds(uint32_t offset, uint64_t length) const
+        {
+            return (uint64_t) offset + length <= size_;
+        }
+
+        bool ReadString(const CatalogString& str, WSTRING* out) const
+        {
+            if ((uint64_t) str.offset + str.length > header_.chars_size)
+            {
+                return false;
+            }
+            out->resize(str.length);
+            if (str.length > 0)
+            {
+                std::memcpy(&(*out)[0], data_ + header_.chars_offset + sizeof(WCHAR) * str.offset,
+                            sizeof(WCHAR) * str.length);
+            }
+            return true;
+        }
+
+        static Version ToVersion(const CatalogVersion& version)
+        {
+            return {version.major, version.minor, version.build, version.revision};
+        }
+
+        bool ReadMethodReference(const CatalogMethodReference& ref, std::vector<MethodReference>* out) const
+        {
+            WSTRING assembly_name;
+            WSTRING assembly_locale;
+            WSTRING type_name;
+            WSTRING method_name;
+            WSTRING action;
+            if (!ReadString(ref.assembly_name, &assembly_name) || !ReadString(ref.assembly_locale, &assembly_locale) ||
+                !ReadString(ref.type_name, &type_name) || !ReadString(ref.method_name, &method_name) ||
+                !ReadString(ref.action, &action))
+            {
+                return false;
+            }
+
+            if ((uint64_t) ref.signature.offset + ref.signature.count > header_.bytes_size)
+            {
+                return false;
+            }
+            const auto signature_start = data_ + header_.bytes_offset + ref.signature.offset;
+            const std::vector<BYTE> signature(signature_start, signature_start + ref.signature.count);
+
+            std::vector<WSTRING> signature_types(ref.signature_types.count);
+            for (uint32_t i = 0; i < ref.signature_types.count; i++)
+            {
+                CatalogString signature_type{};
+                if (!Read(header_.string_refs_offset, header_.string_ref_count, ref.signature_types.offset + i,
+                          &signature_type) ||
+                    !ReadString(signature_type, &signature_types[i]))
+                {
+                    return false;
+                }
+            }
+
+            const AssemblyReference assembly(assembly_name, ToVersion(ref.assembly_version), assembly_locale,
+                                             PublicKey(ref.assembly_public_key));
+            out->emplace_back(assembly, type_name, method_name, action, ToVersion(ref.min_version),
+                              ToVersion(ref.max_version), signature, signature_types);
+            return true;
+        }
+
+    public:
+        CatalogReader(const BYTE* data, size_t size) : data_(data), size_(size)
+        {
+        }
+
+        bool ReadHeader()
+        {
+            if (data_ == nullptr || size_ < sizeof(CatalogHeader))
+            {
+                return false;
+            }
+            std::memcpy(&header_, data_, sizeof(CatalogHeader));
+
+            return header_.magic == kIntegrationCatalogMagic && header_.version == kIntegrationCatalogVersion &&
+                   header_.char_size == sizeof(WCHAR) && header_.total_size <= size_ &&
+                   InBounds(header_.integrations_offset, sizeof(CatalogIntegration) * (uint64_t) header_.integration_count) &&
+                   InBounds(header_.replacements_offset,
+                            sizeof(CatalogMethodReplacement) * (uint64_t) header_.replacement_count) &&
+                   InBounds(header_.string_refs_offset, sizeof(CatalogString) * (uint64_t) header_.string_ref_count) &&
+                   InBounds(header_.bytes_offset, header_.bytes_size) &&
+                   InBounds(header_.chars_offset, sizeof(WCHAR) * (uint64_t) header_.chars_size);
+        }
+
+        bool ReadIntegrations(std::vector<Integration>* integrations) const
+        {
+            integrations->reserve(header_.integration_count);
+
+            for (uint32_t i = 0; i < header_.integration_count; i++)
+            {
+                CatalogIntegration item{};
+                WSTRING name;
+                if (!Read(header_.integrations_offset, header_.integration_count, i, &item) ||
+                    !ReadString(item.name, &name))
+                {
+                    return false;
+                }
+
+                std::vector<MethodReplacement> replacements;
+                replacements.reserve(item.method_replacements.count);
+                for (uint32_t j = 0; j < item.method_replacements.count; j++)
+                {
+                    CatalogMethodReplacement replacement{};
+                    if (!Read(header_.replacements_offset, header_.replacement_count,
+                              item.method_replacements.offset + j, &replacement))
+                    {
+                        return false;
+                    }
+
+                    std::vector<MethodReference> methods;
+                    methods.reserve(3);
+                    if (!ReadMethodReference(replacement.caller_method, &methods) ||
+                        !ReadMethodReference(replacement.target_method, &methods) ||
+                        !ReadMethodReference(replacement.wrapper_method, &methods))
+                    {
+                        return false;
+                    }
+                    replacements.emplace_back(methods[0], methods[1], methods[2]);
+                }
+
+                integrations->emplace_back(name, replacements);
+            }
+
+            return true;
+        }
+    };
+
+} // namespace
+
+std::vector<BYTE> SerializeIntegrationCatalog(const std::vector<Integration>& integrations)
+{
+    CatalogWriter writer;
+    for (const auto& integration : integrations)
+    {
+        writer.AddIntegration(integration);
+    }
+    return writer.Build();
+}
+
+std::vector<Integration> LoadIntegrationsFromCatalog(const BYTE* data, size_t size)
+{
+    std::vector<Integration> integrations;
+
+    CatalogReader reader(data, size);
+    if (!reader.ReadHeader())
+    {
+        Warn("Invalid integration catalog: unexpected header.");
+        return integrations;
+    }
+
+    if (!reader.ReadIntegrations(&integrations))
+    {
+        Warn("Invalid integration catalog: a record is out of bounds.");
+        integrations.clear();
+    }
+
+    return integrations;
+}
+
+std::vector<Integration> ApplyIntegrationOverrides(const std::vector<Integration>& base,
+                                                   const std::vector<Integration>& overrides)
+{
+    if (overrides.empty())
+    {
+        return base;
+    }
+
+    std::unordered_map<WSTRING, size_t> override_index;
+    for (size_t i = 0; i < overrides.size(); i++)
+    {
+        // the last definition of an integration wins
+        override_index[overrides[i].integration_name] = i;
+    }
+
+    std::vector<Integration> merged;
+    std::unordered_set<WSTRING> applied;
+    for (const auto& integration : base)
+    {
+        const auto found = override_index.find(integration.integration_name);
+        if (found == override_index.end())
+        {
+            merged.push_back(integration);
+        }
+        else if (applied.insert(integration.integration_name).second)
+        {
+            merged.push_back(overrides[found->second]);
+        }
+    }
+
+    for (size_t i = 0; i < overrides.size(); i++)
+    {
+        const auto& integration = overrides[i];
+        if (override_index[integration.integration_name] == i && applied.insert(integration.integration_name).second)
+        {
+            merged.push_back(integration);
+        }
+    }
+
+    return merged;
+}
+
+} // namespace trace
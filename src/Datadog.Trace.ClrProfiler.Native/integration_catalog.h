@@ -0,0 +1,115 @@
+#ifndef DD_CLR_PROFILER_INTEGRATION_CATALOG_H_
+#define DD_CLR_PROFILER_INTEGRATION_CATALOG_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "integration.h"
+
+namespace trace
+{
+
+// The integration catalog is a compact, read-only and pointer-free binary
+// representation of the integration definitions. It is generated at build time
+// from integrations.json and embedded into the native profiler, so the profiler
+// doesn't need to parse JSON on startup.
+//
+// Layout (all offsets are relative to the start of the blob, host endianness):
+//
+//   CatalogHeader
+//   CatalogIntegration[integration_count]
+//   CatalogMethodReplacement[replacement_count]
+//   CatalogString[string_ref_count]      (signature_types lists)
+//   BYTE[bytes_size]                     (method signatures)
+//   WCHAR[chars_size]                    (interned UTF-16 strings)
+//
+// Records are read with memcpy so the blob doesn't need any particular alignment.
+
+const uint32_t kIntegrationCatalogMagic = 0x43494444; // "DDIC"
+const uint16_t kIntegrationCatalogVersion = 1;
+
+#pragma pack(push, 1)
+
+struct CatalogString
+{
+    uint32_t offset; // in WCHARs, from the start of the chars pool
+    uint32_t length; // in WCHARs
+};
+
+struct CatalogSpan
+{
+    uint32_t offset; // in elements, from the start of the pool
+    uint32_t count;
+};
+
+struct CatalogVersion
+{
+    uint16_t major;
+    uint16_t minor;
+    uint16_t build;
+    uint16_t revision;
+};
+
+struct CatalogMethodReference
+{
+    CatalogString assembly_name;
+    CatalogVersion assembly_version;
+    CatalogString assembly_locale;
+    uint8_t assembly_public_key[kPublicKeySize];
+    CatalogString type_name;
+    CatalogString method_name;
+    CatalogString action;
+    CatalogVersion min_version;
+    CatalogVersion max_version;
+    CatalogSpan signature;       // into the bytes pool
+    CatalogSpan signature_types; // into the string refs pool
+};
+
+struct CatalogMethodReplacement
+{
+    CatalogMethodReference caller_method;
+    CatalogMethodReference target_method;
+    CatalogMethodReference wrapper_method;
+};
+
+struct CatalogIntegration
+{
+    CatalogString name;
+    CatalogSpan method_replacements; // into the replacements table
+};
+
+struct CatalogHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t char_size;
+    uint32_t total_size;
+    uint32_t integration_count;
+    uint32_t integrations_offset;
+    uint32_t replacement_count;
+    uint32_t replacements_offset;
+    uint32_t string_ref_count;
+    uint32_t string_refs_offset;
+    uint32_t bytes_size;
+    uint32_t bytes_offset;
+    uint32_t chars_size;
+    uint32_t chars_offset;
+};
+
+#pragma pack(pop)
+
+// SerializeIntegrationCatalog builds the binary catalog for the given integrations
+std::vector<BYTE> SerializeIntegrationCatalog(const std::vector<Integration>& integrations);
+
+// LoadIntegrationsFromCatalog loads the integrations from a binary catalog.
+// Returns an empty vector if the catalog is malformed.
+std::vector<Integration> LoadIntegrationsFromCatalog(const BYTE* data, size_t size);
+
+// ApplyIntegrationOverrides replaces the integrations in base with the ones in overrides that
+// have the same name, and appends the remaining overrides
+std::vector<Integration> ApplyIntegrationOverrides(const std::vector<Integration>& base,
+                                                   const std::vector<Integration>& overrides);
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_INTEGRATION_CATALOG_H_
@@ -0,0 +1,54 @@
+// Build-time tool that compiles integrations.json into the binary integration
+// catalog embedded in the native profiler.
+//
+// Usage: integration_catalog_compiler <integrations.json> <output file>
+
+#include <fstream>
+#include <iostream>
+
+#include "integration_catalog.h"
+#include "integration_loader.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <integrations.json> <output file>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(argv[1]);
+    if (!input)
+    {
+        std::cerr << "Unable to open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    const auto integrations = trace::LoadIntegrationsFromStream(input);
+    if (integrations.empty())
+    {
+        std::cerr << "No integrations were loaded from " << argv[1] << std::endl;
+        return 1;
+    }
+
+    const auto catalog = trace::SerializeIntegrationCatalog(integrations);
+
+    // make sure the catalog round-trips before embedding it
+    if (trace::LoadIntegrationsFromCatalog(catalog.data(), catalog.size()).size() != integrations.size())
+    {
+        std::cerr << "The generated integration catalog is invalid" << std::endl;
+        return 1;
+    }
+
+    std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char*>(catalog.data()), catalog.size());
+    if (!output)
+    {
+        std::cerr << "Unable to write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Compiled " << integrations.size() << " integrations into " << argv[2] << " (" << catalog.size()
+              << " bytes)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "integration_index.h"
+
+#include <algorithm>
+
+namespace trace
+{
+
+IntegrationIndex::IntegrationIndex(const IntegrationMethodSet& integrations) : integrations_(integrations)
+{
+    for (size_t i = 0; i < integrations_->size(); i++)
+    {
+        by_target_assembly_[GetTargetMethod(i).assembly.name].push_back(i);
+    }
+
+    for (auto& entry : by_target_assembly_)
+    {
+        // stable so integrations with the same minimum version keep their definition order
+        std::stable_sort(entry.second.begin(), entry.second.end(), [this](size_t a, size_t b) {
+            return GetTargetMethod(a).min_version < GetTargetMethod(b).min_version;
+        });
+    }
+}
+
+bool IntegrationIndex::ContainsTargetAssembly(const WSTRING& assembly_name) const
+{
+    return by_target_assembly_.find(assembly_name) != by_target_assembly_.end();
+}
+
+std::vector<const IntegrationMethod*> IntegrationIndex::GetIntegrationsForTarget(const WSTRING& assembly_name,
+                                                                                 const Version& assembly_version) const
+{
+    std::vector<const IntegrationMethod*> enabled;
+
+    const auto found = by_target_assembly_.find(assembly_name);
+    if (found == by_target_assembly_.end())
+    {
+        return enabled;
+    }
+
+    // skip every entry whose minimum version is greater than the assembly version
+    const auto& entries = found->second;
+    const auto last = std::upper_bound(entries.begin(), entries.end(), assembly_version,
+                                       [this](const Version& version, size_t index) {
+                                           return GetTargetMethod(index).min_version > version;
+                                       });
+
+    std::vector<size_t> indexes;
+    for (auto it = entries.begin(); it != last; ++it)
+    {
+        if (!(GetTargetMethod(*it).max_version < assembly_version))
+        {
+            indexes.push_back(*it);
+        }
+    }
+
+    // return the integrations in definition order
+    std::sort(indexes.begin(), indexes.end());
+    enabled.reserve(indexes.size());
+    for (const auto index : indexes)
+    {
+        enabled.push_back(&(*integrations_)[index]);
+    }
+
+    return enabled;
+}
+
+} // namespace trace
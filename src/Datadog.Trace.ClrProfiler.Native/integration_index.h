@@ -0,0 +1,43 @@
+#ifndef DD_CLR_PROFILER_INTEGRATION_INDEX_H_
+#define DD_CLR_PROFILER_INTEGRATION_INDEX_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "integration.h"
+
+namespace trace
+{
+
+// IntegrationIndex is an immutable lookup table from a target assembly name to
+// the integration methods of the shared integration set that instrument it. The entries of each assembly are
+// sorted by minimum version so the version range check only visits the
+// integrations that can apply to the loaded assembly version.
+class IntegrationIndex
+{
+private:
+    IntegrationMethodSet integrations_;
+    // indexes into integrations_, sorted by minimum target version
+    std::unordered_map<WSTRING, std::vector<size_t>> by_target_assembly_;
+
+    const MethodReference& GetTargetMethod(size_t index) const
+    {
+        return (*integrations_)[index].replacement.target_method;
+    }
+
+public:
+    IntegrationIndex() = default;
+    explicit IntegrationIndex(const IntegrationMethodSet& integrations);
+
+    // ContainsTargetAssembly returns true if any integration targets the given assembly name
+    bool ContainsTargetAssembly(const WSTRING& assembly_name) const;
+
+    // GetIntegrationsForTarget returns the integrations targeting the given assembly name and version.
+    // The result points into the shared integration set.
+    std::vector<const IntegrationMethod*> GetIntegrationsForTarget(const WSTRING& assembly_name,
+                                                                   const Version& assembly_version) const;
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_INTEGRATION_INDEX_H_
@@ -7,6 +7,7 @@
 //---------------------------------------------------------------------------------------
 
 #include "cor_profiler.h"
+#include "stats.h"
 
 EXTERN_C BOOL STDAPICALLTYPE IsProfilerAttached()
 {
@@ -18,3 +19,12 @@ EXTERN_C VOID STDAPICALLTYPE GetAssemblyAndSymbolsBytes(BYTE** pAssemblyArray, i
 {
     return trace::profiler->GetAssemblyAndSymbolsBytes(pAssemblyArray, assemblySize, pSymbolsArray, symbolsSize);
 }
+
+EXTERN_C VOID STDAPICALLTYPE GetProfilerStats(BYTE** pStatsBlock, int* statsBlockSize)
+{
+    // the block stays valid for the lifetime of the process, its counters are updated in place and its histograms
+    // are refreshed on every call, see stats_block.h for its layout
+    const trace::StatsBlock* stats_block = trace::Stats::Instance()->GetStatsBlock();
+    *pStatsBlock = (BYTE*) stats_block;
+    *statsBlockSize = (int) stats_block->size;
+}
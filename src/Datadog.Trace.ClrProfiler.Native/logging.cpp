@@ -1,7 +1,9 @@
 #include "logging.h"
 
 #include "pal.h"
+#include "stats.h"
 
+#include "spdlog/details/os.h"
 #include "spdlog/sinks/null_sink.h"
 #include "spdlog/sinks/rotating_file_sink.h"
 
@@ -60,6 +62,76 @@ std::string Logger::GetLogPath(const std::string& file_name_suffix)
     return path;
 }
 
+// LogBuffer is a single-producer single-consumer ring of messages. The owning thread is the only producer,
+// the consumers are serialized by Logger::m_drainLock.
+class Logger::LogBuffer
+{
+public:
+    static const size_t kCapacity = 1024;
+
+    struct Entry
+    {
+        spdlog::level::level_enum level;
+        spdlog::log_clock::time_point time;
+        std::string message;
+    };
+
+    const size_t thread_id;
+    // cleared when the owning thread exits
+    std::atomic_bool alive{true};
+
+    explicit LogBuffer(size_t thread_id) : thread_id(thread_id)
+    {
+    }
+
+    bool TryPush(spdlog::level::level_enum level, std::string&& message)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == kCapacity)
+        {
+            return false;
+        }
+
+        Entry& entry = m_entries[head % kCapacity];
+        entry.level = level;
+        entry.time = spdlog::log_clock::now();
+        entry.message = std::move(message);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    template <typename Callback>
+    bool Consume(Callback callback)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        if (tail == head)
+        {
+            return false;
+        }
+
+        for (; tail != head; tail++)
+        {
+            Entry& entry = m_entries[tail % kCapacity];
+            callback(entry);
+            // release the memory of the message now, the slot may stay unused for a long time
+            std::string().swap(entry.message);
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+private:
+    Entry m_entries[kCapacity];
+    std::atomic<size_t> m_head{0};
+    std::atomic<size_t> m_tail{0};
+};
+
 Logger::Logger()
 {
     spdlog::set_error_handler([](const std::string& msg) {
@@ -69,8 +141,6 @@ Logger::Logger()
         // std::cerr << "Logger Handler: " << msg << std::endl;
     });
 
-    spdlog::flush_every(std::chrono::seconds(3));
-
     static auto current_process_name = ToString(GetCurrentProcessName());
     static auto current_process_id = GetPID();
     static auto current_process_without_extension =
@@ -92,40 +162,235 @@ Logger::Logger()
 
     m_fileout->set_pattern("%D %I:%M:%S.%e %p [%P|%t] [%l] %v");
 
-    m_fileout->flush_on(spdlog::level::info);
+    // the file is written and flushed by the writer thread
+    m_writer = std::thread([this]() { WriterThreadLoop(); });
 };
 
 Logger::~Logger()
 {
-    m_fileout->flush();
+    Stop();
     spdlog::shutdown();
 };
 
-void Logger::Debug(const std::string& str)
+Logger::LogBuffer* Logger::GetThreadBuffer()
+{
+    // marks the buffer as dead when the thread exits, so the writer can drop it once drained
+    struct ThreadLogBuffer
+    {
+        std::shared_ptr<LogBuffer> buffer;
+
+        ~ThreadLogBuffer()
+        {
+            if (buffer != nullptr)
+            {
+                buffer->alive = false;
+            }
+        }
+    };
+
+    thread_local ThreadLogBuffer thread_buffer;
+    if (thread_buffer.buffer == nullptr)
+    {
+        auto buffer = std::make_shared<LogBuffer>(spdlog::details::os::thread_id());
+        {
+            std::lock_guard<std::mutex> guard(m_buffersLock);
+            m_buffers.push_back(buffer);
+        }
+        thread_buffer.buffer = std::move(buffer);
+    }
+    return thread_buffer.buffer.get();
+}
+
+void Logger::Log(spdlog::level::level_enum level, std::string&& str)
+{
+    if (m_stopped)
+    {
+        // the writer is gone, write the message ourselves
+        std::lock_guard<std::mutex> guard(m_drainLock);
+        Write(level, spdlog::log_clock::now(), spdlog::details::os::thread_id(), str);
+        m_fileout->flush();
+        return;
+    }
+
+    if (str.size() > kMaxMessageLength)
+    {
+        static const std::string truncated = "... (truncated)";
+        str.resize(kMaxMessageLength - truncated.size());
+        str += truncated;
+    }
+
+    LogBuffer* buffer = GetThreadBuffer();
+    if (!buffer->TryPush(level, std::move(str)))
+    {
+        m_dropped++;
+        Stats::Instance()->AddLogMessagesDropped(1);
+        return;
+    }
+
+    // if the logger stopped while we were pushing, the final drain may have missed the message,
+    // and if the writer went idle its last drain may have missed it too
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_stopped)
+    {
+        Flush();
+        return;
+    }
+
+    if (m_writerIdle.load() && m_writerIdle.exchange(false))
+    {
+        WakeWriter();
+    }
+}
+
+void Logger::Write(spdlog::level::level_enum level, spdlog::log_clock::time_point time, size_t thread_id,
+                   const std::string& str)
+{
+    spdlog::details::log_msg msg(m_fileout->name(), level, spdlog::string_view_t(str.data(), str.size()));
+    msg.time = time;
+    msg.thread_id = thread_id;
+
+    for (auto& sink : m_fileout->sinks())
+    {
+        if (sink->should_log(level))
+        {
+            sink->log(msg);
+        }
+    }
+}
+
+bool Logger::Drain()
+{
+    std::vector<std::shared_ptr<LogBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> guard(m_buffersLock);
+        buffers = m_buffers;
+    }
+
+    bool written = false;
+    for (const auto& buffer : buffers)
+    {
+        written |= buffer->Consume([this, &buffer](LogBuffer::Entry& entry) {
+            Write(entry.level, entry.time, buffer->thread_id, entry.message);
+        });
+    }
+
+    const uint64_t dropped = m_dropped.load();
+    if (dropped != m_reportedDropped)
+    {
+        Write(spdlog::level::warn, spdlog::log_clock::now(), spdlog::details::os::thread_id(),
+              "Logger: " + std::to_string(dropped - m_reportedDropped) +
+                  " messages were dropped because the log buffer was full.");
+        m_reportedDropped = dropped;
+        written = true;
+    }
+
+    // forget the buffers of exited threads, nothing can be added to them anymore
+    {
+        std::lock_guard<std::mutex> guard(m_buffersLock);
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                       [](const std::shared_ptr<LogBuffer>& buffer) {
+                                           return !buffer->alive && buffer->Size() == 0;
+                                       }),
+                        m_buffers.end());
+    }
+
+    if (written)
+    {
+        m_fileout->flush();
+    }
+    return written;
+}
+
+void Logger::WakeWriter()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_writerLock);
+        m_writerWoken = true;
+    }
+    m_writerCondition.notify_one();
+}
+
+void Logger::WriterThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_writerLock);
+    while (!m_writerStop)
+    {
+        m_writerWoken = false;
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> guard(m_drainLock);
+            while (Drain())
+            {
+            }
+
+            // the callers wake us up from now on, a message pushed before they could see the flag is
+            // caught by this last drain
+            m_writerIdle = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (Drain())
+            {
+                m_writerIdle = false;
+                lock.lock();
+                continue;
+            }
+        }
+        lock.lock();
+
+        m_writerCondition.wait(lock, [this]() { return m_writerStop || m_writerWoken; });
+        m_writerIdle = false;
+    }
+}
+
+void Logger::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_writerLock);
+        if (m_writerStop)
+        {
+            return;
+        }
+        m_writerStop = true;
+    }
+    m_writerCondition.notify_one();
+    if (m_writer.joinable())
+    {
+        m_writer.join();
+    }
+
+    // write whatever is still pending, later messages are written synchronously
+    std::lock_guard<std::mutex> guard(m_drainLock);
+    m_stopped = true;
+    Drain();
+    m_fileout->flush();
+}
+
+void Logger::Debug(std::string str)
 {
     if (debug_logging_enabled)
     {
-        m_fileout->debug(str);
+        Log(spdlog::level::debug, std::move(str));
     }
 }
-void Logger::Info(const std::string& str)
+void Logger::Info(std::string str)
 {
-    m_fileout->info(str);
+    Log(spdlog::level::info, std::move(str));
 }
-void Logger::Warn(const std::string& str)
+void Logger::Warn(std::string str)
 {
-    m_fileout->warn(str);
+    Log(spdlog::level::warn, std::move(str));
 }
-void Logger::Error(const std::string& str)
+void Logger::Error(std::string str)
 {
-    m_fileout->error(str);
+    Log(spdlog::level::err, std::move(str));
 }
-void Logger::Critical(const std::string& str)
+void Logger::Critical(std::string str)
 {
-    m_fileout->critical(str);
+    Log(spdlog::level::critical, std::move(str));
 }
 void Logger::Flush()
 {
+    std::lock_guard<std::mutex> guard(m_drainLock);
+    Drain();
     m_fileout->flush();
 }
 } // namespace trace
@@ -4,8 +4,13 @@
 
 #include <spdlog/spdlog.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace trace
 {
@@ -13,25 +18,65 @@ namespace trace
 extern bool debug_logging_enabled;
 extern bool dump_il_rewrite_enabled;
 
+// Logger writes the native log file asynchronously.
+//
+// Callers only append the message to a bounded ring buffer owned by their thread. A background thread drains the
+// buffers, formats the lines and writes (and flushes) the file, then sleeps until a caller finds it idle and wakes
+// it up. When a buffer is full the message is dropped and counted in the stats block, and the writer reports how
+// many were lost. Long messages are truncated, so the buffers are bounded in bytes too.
 class Logger : public Singleton<Logger>
 {
     friend class Singleton<Logger>;
 
 private:
+    class LogBuffer;
+
     std::shared_ptr<spdlog::logger> m_fileout;
+
+    // every thread buffer ever registered, the ones of exited threads are removed once drained
+    std::mutex m_buffersLock;
+    std::vector<std::shared_ptr<LogBuffer>> m_buffers;
+
+    // serializes the consumers of the buffers (the writer thread and Flush)
+    std::mutex m_drainLock;
+    std::atomic<uint64_t> m_dropped{0};
+    uint64_t m_reportedDropped = 0;
+
+    std::thread m_writer;
+    std::mutex m_writerLock;
+    std::condition_variable m_writerCondition;
+    bool m_writerStop = false;
+    bool m_writerWoken = false;
+    // set while the writer waits with every buffer drained
+    std::atomic_bool m_writerIdle{false};
+    std::atomic_bool m_stopped{false};
+
     static std::string GetLogPath(const std::string& file_name_suffix);
     Logger();
     ~Logger();
 
+    LogBuffer* GetThreadBuffer();
+    void Log(spdlog::level::level_enum level, std::string&& str);
+    void Write(spdlog::level::level_enum level, spdlog::log_clock::time_point time, size_t thread_id,
+               const std::string& str);
+    bool Drain();
+    void WakeWriter();
+    void WriterThreadLoop();
+    void Stop();
+
 public:
-    void Debug(const std::string& str);
-    void Info(const std::string& str);
-    void Warn(const std::string& str);
-    void Error(const std::string& str);
-    void Critical(const std::string& str);
+    static const size_t kMaxMessageLength = 16 * 1024;
+
+    void Debug(std::string str);
+    void Info(std::string str);
+    void Warn(std::string str);
+    void Error(std::string str);
+    void Critical(std::string str);
+    // Flush writes every pending message to the file before returning
     void Flush();
     static void Shutdown()
     {
+        Instance()->Stop();
         spdlog::shutdown();
     }
 };
@@ -45,9 +90,9 @@ std::string LogToString(Arg const& arg)
 template <typename... Args>
 std::string LogToString(Args const&... args)
 {
-    std::ostringstream oss;
-    int a[] = {0, ((void) (oss << LogToString(args)), 0)...};
-    return oss.str();
+    std::string str;
+    int a[] = {0, ((void) (str += LogToString(args)), 0)...};
+    return str;
 }
 
 template <typename... Args>
@@ -0,0 +1,76 @@
+#include "metadata_cache.h"
+
+namespace trace
+{
+
+std::shared_ptr<const TypeInfo> MetadataCache::GetTypeInfo(mdToken token)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        const auto findRes = types_.find(token);
+        if (findRes != types_.end())
+        {
+            return findRes->second;
+        }
+    }
+
+    // resolved outside of the lock, the metadata calls are the expensive part
+    auto type_info = std::make_shared<const TypeInfo>(trace::GetTypeInfo(metadata_import_, token));
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (cleared_)
+    {
+        return type_info;
+    }
+    // another thread may have resolved the same token in the meantime, keep the first one
+    return types_.emplace(token, std::move(type_info)).first->second;
+}
+
+std::shared_ptr<const FunctionInfo> MetadataCache::GetFunctionInfo(mdToken token)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        const auto findRes = functions_.find(token);
+        if (findRes != functions_.end())
+        {
+            return findRes->second;
+        }
+    }
+
+    auto function_info = std::make_shared<const FunctionInfo>(trace::GetFunctionInfo(metadata_import_, token));
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (cleared_)
+    {
+        return function_info;
+    }
+    return functions_.emplace(token, std::move(function_info)).first->second;
+}
+
+std::shared_ptr<const TypeInfo> MetadataCache::GetExtendFrom(const TypeInfo& type)
+{
+    if (type.extend_from_token == mdTokenNil)
+    {
+        return nullptr;
+    }
+    return GetTypeInfo(type.extend_from_token);
+}
+
+std::shared_ptr<const TypeInfo> MetadataCache::GetParentType(const TypeInfo& type)
+{
+    if (type.parent_type_token == mdTokenNil)
+    {
+        return nullptr;
+    }
+    return GetTypeInfo(type.parent_type_token);
+}
+
+void MetadataCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    cleared_ = true;
+    types_.clear();
+    functions_.clear();
+}
+
+} // namespace trace
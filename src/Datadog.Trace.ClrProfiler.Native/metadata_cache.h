@@ -0,0 +1,55 @@
+#ifndef DD_CLR_PROFILER_METADATA_CACHE_H_
+#define DD_CLR_PROFILER_METADATA_CACHE_H_
+
+#include <corhlpr.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "clr_helpers.h"
+#include "com_ptr.h"
+#include "util.h"
+
+namespace trace
+{
+
+// MetadataCache memoizes the TypeInfo and FunctionInfo of the tokens of a module.
+//
+// Entries are immutable and shared, so a caller can keep one after the cache is cleared. The base type
+// and the enclosing type of a TypeInfo are only resolved when asked for, through GetExtendFrom and GetParentType.
+class MetadataCache : public UnCopyable
+{
+private:
+    ComPtr<IMetaDataImport2> metadata_import_;
+
+    std::mutex lock_;
+    std::unordered_map<mdToken, std::shared_ptr<const TypeInfo>> types_;
+    std::unordered_map<mdToken, std::shared_ptr<const FunctionInfo>> functions_;
+    bool cleared_ = false;
+
+public:
+    explicit MetadataCache(const ComPtr<IMetaDataImport2>& metadata_import) : metadata_import_(metadata_import)
+    {
+    }
+
+    // Returns the TypeInfo of a TypeDef, TypeRef, TypeSpec, ModuleRef, MemberRef or MethodDef token.
+    // The result is never null, an unresolved token returns an invalid TypeInfo.
+    std::shared_ptr<const TypeInfo> GetTypeInfo(mdToken token);
+
+    // Returns the FunctionInfo of a MethodDef, MemberRef or MethodSpec token.
+    // The result is never null, an unresolved token returns an invalid FunctionInfo.
+    std::shared_ptr<const FunctionInfo> GetFunctionInfo(mdToken token);
+
+    // Returns the type the given type extends, or nullptr if it doesn't extend a type
+    std::shared_ptr<const TypeInfo> GetExtendFrom(const TypeInfo& type);
+
+    // Returns the type the given type is nested in, or nullptr if it isn't a nested type
+    std::shared_ptr<const TypeInfo> GetParentType(const TypeInfo& type);
+
+    // Drops every entry. Called when the module unloads, later lookups are no longer cached.
+    void Clear();
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_METADATA_CACHE_H_
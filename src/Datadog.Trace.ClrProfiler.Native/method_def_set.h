@@ -0,0 +1,68 @@
+#ifndef DD_CLR_PROFILER_METHOD_DEF_SET_H_
+#define DD_CLR_PROFILER_METHOD_DEF_SET_H_
+
+#include <corhlpr.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace trace
+{
+
+/// <summary>
+/// Immutable bitmap of the methodDef RIDs of a module, so membership is a bounds check and a single load.
+/// </summary>
+class MethodDefSet
+{
+private:
+    std::vector<uint64_t> words_;
+
+public:
+    MethodDefSet() = default;
+
+    // Creates a set with the methods of base (if any) plus the given methods
+    MethodDefSet(const MethodDefSet* base, const std::vector<mdMethodDef>& method_defs)
+    {
+        if (base != nullptr)
+        {
+            words_ = base->words_;
+        }
+
+        for (const auto method_def : method_defs)
+        {
+            if (TypeFromToken(method_def) != mdtMethodDef)
+            {
+                continue;
+            }
+
+            const ULONG rid = RidFromToken(method_def);
+            const size_t word = rid >> 6;
+            if (word >= words_.size())
+            {
+                words_.resize(word + 1, 0);
+            }
+            words_[word] |= (uint64_t) 1 << (rid & 63);
+        }
+    }
+
+    bool Contains(mdToken method_def) const
+    {
+        if (TypeFromToken(method_def) != mdtMethodDef)
+        {
+            return false;
+        }
+
+        const ULONG rid = RidFromToken(method_def);
+        const size_t word = rid >> 6;
+        return word < words_.size() && (words_[word] & ((uint64_t) 1 << (rid & 63))) != 0;
+    }
+
+    bool IsEmpty() const
+    {
+        return words_.empty();
+    }
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_METHOD_DEF_SET_H_
@@ -0,0 +1,182 @@
+#include "module_analysis_pool.h"
+
+#include <algorithm>
+
+#include "stats.h"
+
+namespace trace
+{
+
+ModuleAnalysisPool::ModuleAnalysisPool(unsigned int threads, std::function<void(ModuleID)> analyze) :
+    analyze_(std::move(analyze))
+{
+    workers_.reserve(threads);
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        workers_.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+ModuleAnalysisPool::~ModuleAnalysisPool()
+{
+    Shutdown();
+}
+
+void ModuleAnalysisPool::WorkerLoop()
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            work_condition_.wait(guard, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+            {
+                return;
+            }
+
+            task = queue_.front();
+            queue_.pop_front();
+            running_.insert(task.module_id);
+        }
+
+        Stats::Instance()->AddModuleAnalysisQueueDepth(-1);
+        Run(task);
+    }
+}
+
+void ModuleAnalysisPool::Run(const Task& task)
+{
+    analyze_(task.module_id);
+    Stats::Instance()->RecordModuleAnalysisLatency(std::chrono::steady_clock::now() - task.queued);
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        running_.erase(task.module_id);
+        pending_.fetch_sub(1);
+    }
+    done_condition_.notify_all();
+}
+
+bool ModuleAnalysisPool::TryTake(ModuleID module_id, Task* task)
+{
+    const auto found = std::find_if(queue_.begin(), queue_.end(),
+                                    [module_id](const Task& queued) { return queued.module_id == module_id; });
+    if (found == queue_.end())
+    {
+        return false;
+    }
+
+    *task = *found;
+    queue_.erase(found);
+    Stats::Instance()->AddModuleAnalysisQueueDepth(-1);
+    return true;
+}
+
+void ModuleAnalysisPool::Enqueue(ModuleID module_id)
+{
+    const Task task = {module_id, std::chrono::steady_clock::now()};
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (stopping_)
+        {
+            return;
+        }
+
+        pending_.fetch_add(1);
+        if (!workers_.empty())
+        {
+            queue_.push_back(task);
+            Stats::Instance()->AddModuleAnalysisQueueDepth(1);
+        }
+        else
+        {
+            running_.insert(module_id);
+        }
+    }
+
+    if (workers_.empty())
+    {
+        Run(task);
+        return;
+    }
+    work_condition_.notify_one();
+}
+
+void ModuleAnalysisPool::Wait(ModuleID module_id)
+{
+    if (pending_.load() == 0)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(lock_);
+    Task task;
+    if (TryTake(module_id, &task))
+    {
+        // no worker took it yet, the caller needs it now
+        running_.insert(module_id);
+        guard.unlock();
+        Run(task);
+        return;
+    }
+
+    done_condition_.wait(guard, [this, module_id]() { return running_.find(module_id) == running_.end(); });
+}
+
+void ModuleAnalysisPool::Cancel(ModuleID module_id)
+{
+    if (pending_.load() == 0)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(lock_);
+    Task task;
+    if (TryTake(module_id, &task))
+    {
+        pending_.fetch_sub(1);
+        guard.unlock();
+        done_condition_.notify_all();
+        return;
+    }
+
+    done_condition_.wait(guard, [this, module_id]() { return running_.find(module_id) == running_.end(); });
+}
+
+void ModuleAnalysisPool::Drain()
+{
+    std::unique_lock<std::mutex> guard(lock_);
+    done_condition_.wait(guard, [this]() { return queue_.empty() && running_.empty(); });
+}
+
+size_t ModuleAnalysisPool::GetQueueDepth()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return queue_.size();
+}
+
+void ModuleAnalysisPool::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (stopping_)
+        {
+            return;
+        }
+
+        stopping_ = true;
+        Stats::Instance()->AddModuleAnalysisQueueDepth(-(long long) queue_.size());
+        pending_.fetch_sub(queue_.size());
+        queue_.clear();
+    }
+    work_condition_.notify_all();
+    done_condition_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+} // namespace trace
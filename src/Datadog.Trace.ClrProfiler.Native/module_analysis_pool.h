@@ -0,0 +1,82 @@
+#ifndef DD_CLR_PROFILER_MODULE_ANALYSIS_POOL_H_
+#define DD_CLR_PROFILER_MODULE_ANALYSIS_POOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "cor.h"
+#include "corprof.h"
+#include "util.h"
+
+namespace trace
+{
+
+// ModuleAnalysisPool analyzes the loaded modules on a fixed number of worker threads, so the thread that loads
+// a module doesn't wait for the CallTarget analysis. The analyses start in load order.
+//
+// A callback that needs the result of an analysis calls Wait, which runs the analysis on the calling thread if no
+// worker took it yet. With no worker threads every module is analyzed on the thread that enqueues it.
+class ModuleAnalysisPool : public UnCopyable
+{
+private:
+    struct Task
+    {
+        ModuleID module_id;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    std::function<void(ModuleID)> analyze_;
+
+    std::mutex lock_;
+    // signaled when a task is queued or the pool stops
+    std::condition_variable work_condition_;
+    // signaled when an analysis finishes
+    std::condition_variable done_condition_;
+    std::deque<Task> queue_;
+    std::unordered_set<ModuleID> running_;
+    bool stopping_ = false;
+    // queued and running analyses, read without the lock by the callbacks that usually have nothing to wait for
+    std::atomic<size_t> pending_{0};
+
+    std::vector<std::thread> workers_;
+
+    void WorkerLoop();
+    // Runs a task taken from the queue, the lock must not be held
+    void Run(const Task& task);
+    // Removes the queued task of the module, the lock must be held
+    bool TryTake(ModuleID module_id, Task* task);
+
+public:
+    ModuleAnalysisPool(unsigned int threads, std::function<void(ModuleID)> analyze);
+    ~ModuleAnalysisPool();
+
+    // Queues the analysis of a module
+    void Enqueue(ModuleID module_id);
+
+    // Returns once the module is neither queued nor being analyzed
+    void Wait(ModuleID module_id);
+
+    // Drops the queued analysis of the module, or waits for the one running. Once it returns the module won't be
+    // analyzed anymore.
+    void Cancel(ModuleID module_id);
+
+    // Returns once no module is queued or being analyzed
+    void Drain();
+
+    // Number of modules waiting for a worker
+    size_t GetQueueDepth();
+
+    // Drops the queued analyses and joins the workers
+    void Shutdown();
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_MODULE_ANALYSIS_POOL_H_
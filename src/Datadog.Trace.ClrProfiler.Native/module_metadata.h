@@ -1,7 +1,9 @@
 ﻿#ifndef DD_CLR_PROFILER_MODULE_METADATA_H_
 #define DD_CLR_PROFILER_MODULE_METADATA_H_
 
+#include <atomic>
 #include <corhlpr.h>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -9,6 +11,8 @@
 #include "clr_helpers.h"
 #include "com_ptr.h"
 #include "integration.h"
+#include "metadata_cache.h"
+#include "method_def_set.h"
 #include "string.h"
 
 namespace trace
@@ -20,8 +24,16 @@ private:
     std::unordered_map<WSTRING, mdMemberRef> wrapper_refs{};
     std::unordered_map<WSTRING, mdTypeRef> wrapper_parent_type{};
     std::unordered_set<WSTRING> failed_wrapper_keys{};
+    // the replacements whose target each call token of this module matches, empty when none does
+    std::unordered_map<mdToken, std::vector<const MethodReplacement*>> call_site_replacements{};
     std::unique_ptr<CallTargetTokens> calltargetTokens = nullptr;
 
+    // methods requested for ReJIT, read without locks by the inlining callback
+    std::atomic<const MethodDefSet*> instrumented_methods{nullptr};
+    // every published set is kept until the module is freed, readers may still hold an older one
+    std::vector<std::unique_ptr<const MethodDefSet>> published_instrumented_methods{};
+    std::mutex instrumented_methods_lock;
+
 public:
     const ComPtr<IMetaDataImport2> metadata_import{};
     const ComPtr<IMetaDataEmit2> metadata_emit{};
@@ -30,13 +42,23 @@ public:
     WSTRING assemblyName = WStr("");
     AppDomainID app_domain_id;
     GUID module_version_id;
-    std::vector<IntegrationMethod> integrations = {};
+    // keeps the shared integration set alive while the module points into it
+    const IntegrationMethodSet integration_set{};
+    const std::vector<const IntegrationMethod*> integrations = {};
     AssemblyProperty* corAssemblyProperty{};
+    // serializes the IL rewrites of this module, which share the wrapper and calltarget caches
+    std::mutex rewrite_lock;
+    // TypeInfo and FunctionInfo of the tokens of this module, cleared when the module unloads
+    MetadataCache metadata_cache;
+    // set while the module waits for its CallTarget analysis or is being analyzed, read without locks by the
+    // inlining callback
+    std::atomic_bool analysis_pending{false};
 
     ModuleMetadata(ComPtr<IMetaDataImport2> metadata_import, ComPtr<IMetaDataEmit2> metadata_emit,
                    ComPtr<IMetaDataAssemblyImport> assembly_import, ComPtr<IMetaDataAssemblyEmit> assembly_emit,
                    WSTRING assembly_name, AppDomainID app_domain_id, GUID module_version_id,
-                   std::vector<IntegrationMethod> integrations, AssemblyProperty* corAssemblyProperty) :
+                   IntegrationMethodSet integration_set, std::vector<const IntegrationMethod*> integrations,
+                   AssemblyProperty* corAssemblyProperty) :
         metadata_import(metadata_import),
         metadata_emit(metadata_emit),
         assembly_import(assembly_import),
@@ -44,8 +66,10 @@ public:
         assemblyName(assembly_name),
         app_domain_id(app_domain_id),
         module_version_id(module_version_id),
-        integrations(integrations),
-        corAssemblyProperty(corAssemblyProperty)
+        integration_set(std::move(integration_set)),
+        integrations(std::move(integrations)),
+        corAssemblyProperty(corAssemblyProperty),
+        metadata_cache(metadata_import)
     {
     }
 
@@ -102,22 +126,62 @@ public:
         failed_wrapper_keys.insert(key);
     }
 
-    std::vector<MethodReplacement> GetMethodReplacementsForCaller(const trace::FunctionInfo& caller)
+    bool TryGetCallSiteReplacements(mdToken token, const std::vector<const MethodReplacement*>** valueOut) const
     {
-        std::vector<MethodReplacement> enabled;
-        for (auto& i : integrations)
+        const auto search = call_site_replacements.find(token);
+
+        if (search != call_site_replacements.end())
         {
-            if ((i.replacement.caller_method.type_name.empty() ||
-                 i.replacement.caller_method.type_name == caller.type.name) &&
-                (i.replacement.caller_method.method_name.empty() ||
-                 i.replacement.caller_method.method_name == caller.name))
+            *valueOut = &search->second;
+            return true;
+        }
+
+        return false;
+    }
+
+    const std::vector<const MethodReplacement*>& AddCallSiteReplacements(
+        mdToken token, std::vector<const MethodReplacement*>&& replacements)
+    {
+        return call_site_replacements.emplace(token, std::move(replacements)).first->second;
+    }
+
+    std::vector<const MethodReplacement*> GetMethodReplacementsForCaller(const trace::FunctionInfo& caller) const
+    {
+        std::vector<const MethodReplacement*> enabled;
+        for (auto i : integrations)
+        {
+            if ((i->replacement.caller_method.type_name.empty() ||
+                 i->replacement.caller_method.type_name == caller.type.name) &&
+                (i->replacement.caller_method.method_name.empty() ||
+                 i->replacement.caller_method.method_name == caller.name))
             {
-                enabled.push_back(i.replacement);
+                enabled.push_back(&i->replacement);
             }
         }
         return enabled;
     }
 
+    size_t GetRetainedBytes() const
+    {
+        return integrations.capacity() * sizeof(const IntegrationMethod*);
+    }
+
+    // AddInstrumentedMethods publishes a new set with the given methods added to the current ones
+    void AddInstrumentedMethods(const std::vector<mdMethodDef>& method_defs)
+    {
+        std::lock_guard<std::mutex> guard(instrumented_methods_lock);
+
+        auto methods = std::make_unique<const MethodDefSet>(instrumented_methods.load(), method_defs);
+        instrumented_methods.store(methods.get());
+        published_instrumented_methods.push_back(std::move(methods));
+    }
+
+    bool IsInstrumentedMethod(mdToken method_def) const
+    {
+        const MethodDefSet* methods = instrumented_methods.load(std::memory_order_acquire);
+        return methods != nullptr && methods->Contains(method_def);
+    }
+
     CallTargetTokens* GetCallTargetTokens()
     {
         if (calltargetTokens == nullptr)
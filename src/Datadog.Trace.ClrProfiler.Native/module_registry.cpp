@@ -0,0 +1,235 @@
+#include "module_registry.h"
+
+#include <limits>
+#include <thread>
+
+namespace trace
+{
+
+ModuleRegistry::ModuleRegistry() : current_(new Snapshot())
+{
+}
+
+ModuleRegistry::~ModuleRegistry()
+{
+    std::lock_guard<std::mutex> guard(write_lock_);
+
+    const Snapshot* snapshot = current_.exchange(nullptr);
+    for (const auto& entry : *snapshot)
+    {
+        delete entry.second;
+    }
+    delete snapshot;
+
+    for (const auto& item : retired_)
+    {
+        delete item.snapshot;
+        delete item.metadata;
+    }
+    retired_.clear();
+}
+
+size_t ModuleRegistry::AcquireReaderSlot(uint64_t* epoch)
+{
+    // each thread starts probing at its own slot so readers don't contend on the same cache line
+    static std::atomic<size_t> next_first_slot{0};
+    thread_local const size_t first_slot = next_first_slot.fetch_add(1) % kReaderSlots;
+
+    for (size_t i = 0; i < kReaderSlots; i++)
+    {
+        const size_t slot = (first_slot + i) % kReaderSlots;
+        auto& slot_epoch = reader_slots_[slot].epoch;
+
+        uint64_t expected = 0;
+        if (slot_epoch.load(std::memory_order_relaxed) == 0 &&
+            slot_epoch.compare_exchange_strong(expected, epoch_.load()))
+        {
+            return slot;
+        }
+    }
+
+    // more live guards than slots (nested guards take one each), pin the epoch under the overflow lock rather
+    // than waiting for a slot that this thread may be holding itself
+    std::lock_guard<std::mutex> guard(overflow_lock_);
+    *epoch = epoch_.load();
+    overflow_epochs_.insert(*epoch);
+    return kReaderSlots;
+}
+
+void ModuleRegistry::ReleaseReaderSlot(size_t slot, uint64_t epoch)
+{
+    if (slot == kReaderSlots)
+    {
+        std::lock_guard<std::mutex> guard(overflow_lock_);
+        overflow_epochs_.erase(overflow_epochs_.find(epoch));
+    }
+    else
+    {
+        reader_slots_[slot].epoch.store(0);
+    }
+
+    // the last reader of a retired item deletes it, unless a writer is busy and will do it
+    if (retired_count_.load() > 0 && write_lock_.try_lock())
+    {
+        Reclaim();
+        write_lock_.unlock();
+    }
+}
+
+ModuleMetadata* ModuleRegistry::Get(ModuleID module_id) const
+{
+    const Snapshot* snapshot = current_.load();
+    const auto findRes = snapshot->find(module_id);
+    if (findRes != snapshot->end())
+    {
+        return findRes->second;
+    }
+    return nullptr;
+}
+
+void ModuleRegistry::Add(ModuleID module_id, ModuleMetadata* metadata)
+{
+    std::lock_guard<std::mutex> guard(write_lock_);
+
+    auto snapshot = new Snapshot(*current_.load());
+    ModuleMetadata* replaced_metadata = nullptr;
+
+    auto findRes = snapshot->find(module_id);
+    if (findRes != snapshot->end())
+    {
+        replaced_metadata = findRes->second;
+        findRes->second = metadata;
+    }
+    else
+    {
+        snapshot->emplace(module_id, metadata);
+    }
+
+    Publish(snapshot, replaced_metadata);
+}
+
+ModuleMetadata* ModuleRegistry::Remove(ModuleID module_id)
+{
+    std::lock_guard<std::mutex> guard(write_lock_);
+
+    const Snapshot* current = current_.load();
+    const auto findRes = current->find(module_id);
+    if (findRes == current->end())
+    {
+        return nullptr;
+    }
+
+    ModuleMetadata* metadata = findRes->second;
+
+    auto snapshot = new Snapshot(*current);
+    snapshot->erase(module_id);
+    Publish(snapshot, metadata);
+
+    return metadata;
+}
+
+size_t ModuleRegistry::Size() const
+{
+    // snapshots are only reclaimed by writers, so the current one can't go away while we hold the lock
+    std::lock_guard<std::mutex> guard(write_lock_);
+    return current_.load()->size();
+}
+
+size_t ModuleRegistry::RetiredSize() const
+{
+    std::lock_guard<std::mutex> guard(write_lock_);
+    return retired_.size();
+}
+
+void ModuleRegistry::Synchronize()
+{
+    const uint64_t epoch = epoch_.fetch_add(1);
+
+    for (auto& slot : reader_slots_)
+    {
+        while (true)
+        {
+            const uint64_t slot_epoch = slot.epoch.load();
+            if (slot_epoch == 0 || slot_epoch > epoch)
+            {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> guard(overflow_lock_);
+            if (overflow_epochs_.empty() || *overflow_epochs_.begin() > epoch)
+            {
+                break;
+            }
+        }
+        std::this_thread::yield();
+    }
+
+    std::lock_guard<std::mutex> guard(write_lock_);
+    Reclaim();
+}
+
+void ModuleRegistry::Publish(const Snapshot* snapshot, ModuleMetadata* removed_metadata)
+{
+    const Snapshot* previous = current_.exchange(snapshot);
+
+    // readers that pinned this epoch or an older one may still see the previous snapshot
+    const uint64_t retired_epoch = epoch_.fetch_add(1);
+    retired_.push_back({retired_epoch, previous, removed_metadata});
+    retired_count_.store(retired_.size());
+
+    Reclaim();
+}
+
+uint64_t ModuleRegistry::GetOldestPinnedEpoch() const
+{
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const auto& slot : reader_slots_)
+    {
+        const uint64_t slot_epoch = slot.epoch.load();
+        if (slot_epoch != 0 && slot_epoch < oldest)
+        {
+            oldest = slot_epoch;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(overflow_lock_);
+    if (!overflow_epochs_.empty() && *overflow_epochs_.begin() < oldest)
+    {
+        oldest = *overflow_epochs_.begin();
+    }
+    return oldest;
+}
+
+void ModuleRegistry::Reclaim()
+{
+    if (retired_.empty())
+    {
+        return;
+    }
+
+    const uint64_t oldest_pinned_epoch = GetOldestPinnedEpoch();
+
+    auto it = retired_.begin();
+    while (it != retired_.end())
+    {
+        if (it->epoch < oldest_pinned_epoch)
+        {
+            delete it->snapshot;
+            delete it->metadata;
+            it = retired_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    retired_count_.store(retired_.size());
+}
+
+} // namespace trace
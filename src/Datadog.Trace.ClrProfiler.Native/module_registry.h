@@ -0,0 +1,111 @@
+#ifndef DD_CLR_PROFILER_MODULE_REGISTRY_H_
+#define DD_CLR_PROFILER_MODULE_REGISTRY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "module_metadata.h"
+#include "util.h"
+
+namespace trace
+{
+
+// ModuleRegistry maps a ModuleID to the ModuleMetadata stored for it.
+//
+// Lookups are lock-free: the map is an immutable snapshot that writers replace (copy-on-write) under a mutex.
+// Memory is reclaimed with epochs: a reader pins the current epoch with a ReadGuard, and a retired snapshot or
+// an unloaded ModuleMetadata is only deleted once no guard that could have observed it is still alive.
+// A ModuleMetadata pointer obtained from the registry stays valid for the lifetime of the guard.
+// When more guards are alive than there are reader slots, the extra ones pin their epoch under a lock instead.
+class ModuleRegistry : public UnCopyable
+{
+private:
+    static const size_t kReaderSlots = 128;
+
+    struct alignas(64) ReaderSlot
+    {
+        // 0 when free, otherwise the epoch pinned by the reader that owns the slot
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    typedef std::unordered_map<ModuleID, ModuleMetadata*> Snapshot;
+
+    struct RetiredItem
+    {
+        uint64_t epoch;
+        const Snapshot* snapshot;
+        ModuleMetadata* metadata;
+    };
+
+    std::atomic<const Snapshot*> current_;
+    std::atomic<uint64_t> epoch_{1};
+    ReaderSlot reader_slots_[kReaderSlots];
+
+    // epochs pinned by the readers that found no free slot
+    mutable std::mutex overflow_lock_;
+    std::multiset<uint64_t> overflow_epochs_;
+
+    // serializes writers and protects retired_
+    mutable std::mutex write_lock_;
+    std::vector<RetiredItem> retired_;
+    // read without the lock by the readers leaving, so the last reader of a retired item reclaims it
+    std::atomic<size_t> retired_count_{0};
+
+    // Returns the slot pinning the current epoch, or kReaderSlots if the epoch is pinned in overflow_epochs_
+    size_t AcquireReaderSlot(uint64_t* epoch);
+    void ReleaseReaderSlot(size_t slot, uint64_t epoch);
+    void Publish(const Snapshot* snapshot, ModuleMetadata* removed_metadata);
+    void Reclaim();
+    uint64_t GetOldestPinnedEpoch() const;
+
+public:
+    // ReadGuard pins the registry for the current scope. Guards are cheap and may be nested.
+    class ReadGuard : public UnCopyable
+    {
+    private:
+        ModuleRegistry* registry_;
+        uint64_t epoch_ = 0;
+        size_t slot_;
+
+    public:
+        explicit ReadGuard(ModuleRegistry& registry) :
+            registry_(&registry), slot_(registry.AcquireReaderSlot(&epoch_))
+        {
+        }
+
+        ~ReadGuard()
+        {
+            registry_->ReleaseReaderSlot(slot_, epoch_);
+        }
+    };
+
+    ModuleRegistry();
+    ~ModuleRegistry();
+
+    // Get returns the metadata stored for the module, or nullptr. Requires a live ReadGuard.
+    ModuleMetadata* Get(ModuleID module_id) const;
+
+    // Add stores the metadata for the module and takes ownership of it.
+    void Add(ModuleID module_id, ModuleMetadata* metadata);
+
+    // Remove unregisters the module and returns its metadata, or nullptr if it was not registered.
+    // The metadata is deleted once every reader that could still use it is gone, so the caller
+    // can keep using it while it holds a ReadGuard.
+    ModuleMetadata* Remove(ModuleID module_id);
+
+    size_t Size() const;
+
+    // Number of snapshots and metadata removed but not deleted yet, because a reader may still use them
+    size_t RetiredSize() const;
+
+    // Synchronize blocks until every ReadGuard acquired before the call has been released.
+    void Synchronize();
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_MODULE_REGISTRY_H_
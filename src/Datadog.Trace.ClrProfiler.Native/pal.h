@@ -99,6 +99,15 @@ inline int GetPID()
 #endif
 }
 
+inline WSTRING DatadogStatsFilePath()
+{
+    // the stats file of each process goes next to the native log file
+    const WSTRING log_path = DatadogLogFilePath("");
+    const auto separator = log_path.find_last_of(WStr("/\\"));
+    const WSTRING directory = separator == WSTRING::npos ? WSTRING() : log_path.substr(0, separator + 1);
+    return directory + ToWSTRING("dotnet-tracer-native-stats-" + std::to_string(GetPID()) + ".dat");
+}
+
 } // namespace trace
 
 #endif // DD_CLR_PROFILER_PAL_H_
@@ -1,6 +1,7 @@
 #include "rejit_handler.h"
 
 #include "logging.h"
+#include "stats.h"
 
 namespace trace
 {
@@ -9,7 +10,7 @@ namespace trace
 // RejitItem
 //
 
-RejitItem::RejitItem(int length, std::unique_ptr<ModuleID>&& modulesId, std::unique_ptr<mdMethodDef>&& methodDefs)
+RejitItem::RejitItem(int length, std::unique_ptr<ModuleID[]>&& modulesId, std::unique_ptr<mdMethodDef[]>&& methodDefs)
 {
     m_length = length;
     m_modulesId = std::move(modulesId);
@@ -18,7 +19,7 @@ RejitItem::RejitItem(int length, std::unique_ptr<ModuleID>&& modulesId, std::uni
 
 std::unique_ptr<RejitItem> RejitItem::CreateEndRejitThread()
 {
-    return std::make_unique<RejitItem>(RejitItem(-1, std::unique_ptr<ModuleID>(), std::unique_ptr<mdMethodDef>()));
+    return std::make_unique<RejitItem>(RejitItem(-1, std::unique_ptr<ModuleID[]>(), std::unique_ptr<mdMethodDef[]>()));
 }
 
 
@@ -65,14 +66,15 @@ void RejitHandlerModuleMethod::SetFunctionInfo(const FunctionInfo& functionInfo)
     m_functionInfo = std::make_unique<FunctionInfo>(functionInfo);
 }
 
-MethodReplacement* RejitHandlerModuleMethod::GetMethodReplacement()
+const MethodReplacement* RejitHandlerModuleMethod::GetMethodReplacement()
 {
-    return m_methodReplacement.get();
+    return m_methodReplacement;
 }
 
-void RejitHandlerModuleMethod::SetMethodReplacement(const MethodReplacement& methodReplacement)
+void RejitHandlerModuleMethod::SetMethodReplacement(const MethodReplacement* methodReplacement)
 {
-    m_methodReplacement = std::make_unique<MethodReplacement>(methodReplacement);
+    // the method replacement is owned by the shared integration set, which outlives the module
+    m_methodReplacement = methodReplacement;
 }
 
 
@@ -159,38 +161,125 @@ void RejitHandler::EnqueueThreadLoop(RejitHandler* handler)
         Warn("Call to InitializeCurrentThread fail.");
     }
 
-    while (true)
+    std::vector<ModuleID> modulesIds;
+    std::vector<mdMethodDef> methodDefs;
+    // the request that didn't fit in the previous batch, and how many of its methods were sent already
+    std::unique_ptr<RejitItem> item;
+    int itemOffset = 0;
+    bool exitThread = false;
+
+    while (!exitThread)
     {
-        const auto item = queue->pop();
+        unsigned int popped = 0;
+        if (item == nullptr)
+        {
+            item = queue->pop();
+            if (item->m_length == -1)
+            {
+                break;
+            }
+            popped++;
+        }
 
-        if (item->m_length == -1)
+        // Each RequestReJIT call suspends the runtime, modules matching integrations tend to load in bursts
+        // so we merge all requests that arrive within the batch window into a single call.
+        unsigned int items = 0;
+        bool waitForMore = false;
+        const auto deadline = std::chrono::steady_clock::now() + handler->m_batchWindow;
+        while (true)
         {
-            break;
+            items++;
+            const size_t count = std::min<size_t>(handler->m_batchMaxMethods - methodDefs.size(),
+                                                  (size_t) (item->m_length - itemOffset));
+            modulesIds.insert(modulesIds.end(), item->m_modulesId.get() + itemOffset,
+                              item->m_modulesId.get() + itemOffset + count);
+            methodDefs.insert(methodDefs.end(), item->m_methodDefs.get() + itemOffset,
+                              item->m_methodDefs.get() + itemOffset + count);
+            itemOffset += (int) count;
+            if (itemOffset < item->m_length)
+            {
+                // the batch is full, the rest of the request goes in the next one
+                break;
+            }
+
+            item = nullptr;
+            itemOffset = 0;
+            if (methodDefs.size() >= handler->m_batchMaxMethods)
+            {
+                break;
+            }
+
+            // a lone request is sent right away, we only wait for the window while requests keep coming
+            item = waitForMore ? queue->pop(deadline) : queue->try_pop();
+            if (item == nullptr)
+            {
+                break;
+            }
+            waitForMore = true;
+
+            if (item->m_length == -1)
+            {
+                // we still send the batch we have before exiting
+                item = nullptr;
+                exitThread = true;
+                break;
+            }
+            popped++;
+        }
+
+        Stats::Instance()->AddRejitQueueDepth(-(long long) popped);
+
+        {
+            auto _ = Stats::Instance()->RequestReJITMeasure(items, (unsigned int) methodDefs.size());
+            if (handler->m_profilerInfo10 != nullptr)
+            {
+                hr = handler->m_profilerInfo10->RequestReJITWithInliners(
+                    COR_PRF_REJIT_BLOCK_INLINING | COR_PRF_REJIT_INLINING_CALLBACKS, (ULONG) methodDefs.size(),
+                    modulesIds.data(), methodDefs.data());
+            }
+            else
+            {
+                hr = profilerInfo->RequestReJIT((ULONG) methodDefs.size(), modulesIds.data(), methodDefs.data());
+            }
         }
 
-        hr = profilerInfo->RequestReJIT((ULONG) item->m_length, item->m_modulesId.get(), item->m_methodDefs.get());
         if (SUCCEEDED(hr))
         {
-            Info("Request ReJIT done for ", item->m_length, " methods");
+            Info("Request ReJIT done for ", methodDefs.size(), " methods from ", items, " requests");
         }
         else
         {
-            Warn("Error requesting ReJIT for ", item->m_length, " methods");
+            Warn("Error requesting ReJIT for ", methodDefs.size(), " methods from ", items, " requests");
         }
+
+        modulesIds.clear();
+        methodDefs.clear();
     }
     Info("Exiting ReJIT request thread.");
 }
 
 RejitHandler::RejitHandler(ICorProfilerInfo4* pInfo,
-             std::function<HRESULT(RejitHandlerModule*, RejitHandlerModuleMethod*)> rewriteCallback)
+                           std::function<HRESULT(RejitHandlerModule*, RejitHandlerModuleMethod*)> rewriteCallback,
+                           unsigned int batchWindowMilliseconds, unsigned int batchMaxMethods)
 {
     m_profilerInfo = pInfo;
+    if (FAILED(pInfo->QueryInterface(__uuidof(ICorProfilerInfo10), (void**) &m_profilerInfo10)))
+    {
+        m_profilerInfo10 = nullptr;
+    }
     m_rewriteCallback = rewriteCallback;
+    m_batchWindow = std::chrono::milliseconds(batchWindowMilliseconds);
+    m_batchMaxMethods = batchMaxMethods > 0 ? batchMaxMethods : 1;
     m_rejit_queue = std::make_unique<UniqueBlockingQueue<RejitItem>>();
     m_rejit_queue_thread = std::make_unique<std::thread>(EnqueueThreadLoop, this);
 }
 
 
+bool RejitHandler::TracksInliners() const
+{
+    return m_profilerInfo10 != nullptr;
+}
+
 RejitHandlerModule* RejitHandler::GetOrAddModule(ModuleID moduleId)
 {
     std::lock_guard<std::mutex> guard(m_modules_lock);
@@ -236,8 +325,9 @@ void RejitHandler::EnqueueForRejit(std::vector<ModuleID>& modulesVector, std::ve
     auto mDefs = new mdMethodDef[length];
     std::copy(modulesMethodDef.begin(), modulesMethodDef.end(), mDefs);
 
-    m_rejit_queue->push(std::make_unique<RejitItem>((int) length, std::unique_ptr<ModuleID>(moduleIds),
-                                                    std::unique_ptr<mdMethodDef>(mDefs)));
+    Stats::Instance()->AddRejitQueueDepth(1);
+    m_rejit_queue->push(std::make_unique<RejitItem>((int) length, std::unique_ptr<ModuleID[]>(moduleIds),
+                                                    std::unique_ptr<mdMethodDef[]>(mDefs)));
 }
 
 void RejitHandler::Shutdown()
@@ -250,6 +340,11 @@ void RejitHandler::Shutdown()
 
     m_modules.clear();
     m_profilerInfo = nullptr;
+    if (m_profilerInfo10 != nullptr)
+    {
+        m_profilerInfo10->Release();
+        m_profilerInfo10 = nullptr;
+    }
     m_rewriteCallback = nullptr;
 }
 
@@ -257,9 +352,16 @@ void RejitHandler::Shutdown()
 HRESULT RejitHandler::NotifyReJITParameters(ModuleID moduleId, mdMethodDef methodId,
                                             ICorProfilerFunctionControl* pFunctionControl, ModuleMetadata* metadata)
 {
-    auto moduleHandler = GetOrAddModule(moduleId);
+    RejitHandlerModule* moduleHandler;
+    RejitHandlerModuleMethod* methodHandler;
+    if (!TryGetModule(moduleId, &moduleHandler) || !moduleHandler->TryGetMethod(methodId, &methodHandler))
+    {
+        // a method that inlined an instrumented method, ReJIT from its original IL so it calls the new version
+        Debug("NotifyReJITParameters: ReJIT of an inliner [ModuleId=", moduleId, ", MethodDef=", methodId, "]");
+        return S_OK;
+    }
+
     moduleHandler->SetModuleMetadata(metadata);
-    auto methodHandler = moduleHandler->GetOrAddMethod(methodId);
     methodHandler->SetFunctionControl(pFunctionControl);
 
     if (methodHandler->GetMethodDef() == mdMethodDefNil)
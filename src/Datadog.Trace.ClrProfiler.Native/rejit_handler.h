@@ -2,6 +2,7 @@
 #define DD_CLR_PROFILER_REJIT_HANDLER_H_
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -17,10 +18,10 @@ namespace trace
 struct RejitItem
 {
     int m_length = 0;
-    std::unique_ptr<ModuleID> m_modulesId = nullptr;
-    std::unique_ptr<mdMethodDef> m_methodDefs = nullptr;
+    std::unique_ptr<ModuleID[]> m_modulesId = nullptr;
+    std::unique_ptr<mdMethodDef[]> m_methodDefs = nullptr;
 
-    RejitItem(int length, std::unique_ptr<ModuleID>&& modulesId, std::unique_ptr<mdMethodDef>&& methodDefs);
+    RejitItem(int length, std::unique_ptr<ModuleID[]>&& modulesId, std::unique_ptr<mdMethodDef[]>&& methodDefs);
     static std::unique_ptr<RejitItem> CreateEndRejitThread();
 };
 
@@ -37,7 +38,7 @@ private:
     mdMethodDef m_methodDef;
     ICorProfilerFunctionControl* m_pFunctionControl;
     std::unique_ptr<FunctionInfo> m_functionInfo;
-    std::unique_ptr<MethodReplacement> m_methodReplacement;
+    const MethodReplacement* m_methodReplacement;
     RejitHandlerModule* m_module;
 
 public:
@@ -51,8 +52,8 @@ public:
     FunctionInfo* GetFunctionInfo();
     void SetFunctionInfo(const FunctionInfo& functionInfo);
 
-    MethodReplacement* GetMethodReplacement();
-    void SetMethodReplacement(const MethodReplacement& methodReplacement);
+    const MethodReplacement* GetMethodReplacement();
+    void SetMethodReplacement(const MethodReplacement* methodReplacement);
 };
 
 /// <summary>
@@ -91,22 +92,33 @@ private:
     std::unordered_map<ModuleID, std::unique_ptr<RejitHandlerModule>> m_modules;
 
     ICorProfilerInfo4* m_profilerInfo;
+    // only set when the runtime supports RequestReJITWithInliners (.NET Core 3.0+)
+    ICorProfilerInfo10* m_profilerInfo10 = nullptr;
     std::function<HRESULT(RejitHandlerModule*, RejitHandlerModuleMethod*)> m_rewriteCallback;
 
     std::unique_ptr<UniqueBlockingQueue<RejitItem>> m_rejit_queue;
     std::unique_ptr<std::thread> m_rejit_queue_thread;
 
+    // ReJIT requests arriving within this window are merged into a single RequestReJIT call
+    std::chrono::milliseconds m_batchWindow;
+    size_t m_batchMaxMethods;
+
     static void EnqueueThreadLoop(RejitHandler* handler);
 
 public:
     RejitHandler(ICorProfilerInfo4* pInfo,
-                 std::function<HRESULT(RejitHandlerModule*, RejitHandlerModuleMethod*)> rewriteCallback);
+                 std::function<HRESULT(RejitHandlerModule*, RejitHandlerModuleMethod*)> rewriteCallback,
+                 unsigned int batchWindowMilliseconds, unsigned int batchMaxMethods);
 
     RejitHandlerModule* GetOrAddModule(ModuleID moduleId);
 
     bool TryGetModule(ModuleID moduleId, RejitHandlerModule** moduleHandler);
     void RemoveModule(ModuleID moduleId);
 
+    // When true the runtime keeps the instrumented methods from being inlined and ReJITs the methods that already
+    // inlined them, so the profiler doesn't need the JITInlining callback
+    bool TracksInliners() const;
+
     void EnqueueForRejit(std::vector<ModuleID>& modulesVector, std::vector<mdMethodDef>& modulesMethodDef);
     void Shutdown();
 
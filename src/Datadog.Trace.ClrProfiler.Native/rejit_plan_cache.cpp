@@ -0,0 +1,175 @@
+#include "rejit_plan_cache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "logging.h"
+#include "pal.h"
+#include "version.h"
+
+namespace trace
+{
+
+namespace
+{
+    const uint32_t kRejitPlanMagic = 0x50524444; // "DDRP"
+    const uint16_t kRejitPlanVersion = 1;
+
+#pragma pack(push, 1)
+    struct RejitPlanHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint64_t key;
+        GUID module_version_id;
+        uint32_t entry_count;
+    };
+
+    struct RejitPlanRecord
+    {
+        uint32_t method_def;
+        uint32_t integration_index;
+    };
+#pragma pack(pop)
+
+    // modules with more CallTarget targets than this are not expected, larger files are treated as corrupted
+    const uint32_t kMaxRejitPlanEntries = 1 << 16;
+} // namespace
+
+RejitPlanCache::RejitPlanCache(const WSTRING& directory, uint64_t integration_methods_hash) :
+    directory_(ToString(directory)), key_(integration_methods_hash)
+{
+    // the matching logic may change between releases, so plans are also tied to the profiler version
+    for (const char* c = PROFILER_VERSION; *c != '\0'; c++)
+    {
+        key_ = (key_ ^ (BYTE) *c) * 1099511628211ULL;
+    }
+}
+
+std::string RejitPlanCache::GetPlanPath(const GUID& module_version_id) const
+{
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+
+    std::string path = directory_;
+    if (!path.empty() && path.back() != separator && path.back() != '/')
+    {
+        path += separator;
+    }
+    return path + ToString(HexStr(&module_version_id, sizeof(GUID))) + ".rejitplan";
+}
+
+bool RejitPlanCache::TryLoad(const GUID& module_version_id, std::vector<RejitPlanEntry>& entries) const
+{
+    std::ifstream stream(GetPlanPath(module_version_id), std::ios::binary);
+    if (!stream.is_open())
+    {
+        return false;
+    }
+
+    RejitPlanHeader header{};
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+
+    if (header.magic != kRejitPlanMagic || header.version != kRejitPlanVersion || header.key != key_ ||
+        memcmp(&header.module_version_id, &module_version_id, sizeof(GUID)) != 0 ||
+        header.entry_count > kMaxRejitPlanEntries)
+    {
+        Debug("RejitPlanCache: ignoring stale plan for module ", HexStr(&module_version_id, sizeof(GUID)));
+        return false;
+    }
+
+    std::vector<RejitPlanRecord> records(header.entry_count);
+    if (header.entry_count > 0 &&
+        !stream.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(RejitPlanRecord)))
+    {
+        return false;
+    }
+
+    // the file must end right after the records, otherwise it was not written by us
+    if (stream.peek() != std::ifstream::traits_type::eof())
+    {
+        return false;
+    }
+
+    entries.clear();
+    entries.reserve(records.size());
+    for (const auto& record : records)
+    {
+        if (TypeFromToken(record.method_def) != mdtMethodDef)
+        {
+            entries.clear();
+            return false;
+        }
+        entries.push_back({record.method_def, record.integration_index});
+    }
+    return true;
+}
+
+void RejitPlanCache::Store(const GUID& module_version_id, const std::vector<RejitPlanEntry>& entries) const
+{
+    if (entries.size() > kMaxRejitPlanEntries)
+    {
+        return;
+    }
+
+    const auto path = GetPlanPath(module_version_id);
+
+    // write to a file of our own and rename it, so concurrent processes never read a partial plan
+    static std::atomic<unsigned> next_temp_id{0};
+    const auto temp_path = path + "." + std::to_string(GetPID()) + "." + std::to_string(next_temp_id++) + ".tmp";
+
+    RejitPlanHeader header{};
+    header.magic = kRejitPlanMagic;
+    header.version = kRejitPlanVersion;
+    header.key = key_;
+    header.module_version_id = module_version_id;
+    header.entry_count = (uint32_t) entries.size();
+
+    std::vector<RejitPlanRecord> records;
+    records.reserve(entries.size());
+    for (const auto& entry : entries)
+    {
+        records.push_back({entry.method_def, entry.integration_index});
+    }
+
+    {
+        std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open())
+        {
+            Debug("RejitPlanCache: unable to create ", temp_path);
+            return;
+        }
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(RejitPlanRecord));
+        if (!stream.good())
+        {
+            stream.close();
+            std::remove(temp_path.c_str());
+            Debug("RejitPlanCache: unable to write ", temp_path);
+            return;
+        }
+    }
+
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        // rename doesn't replace an existing file on Windows
+        std::remove(path.c_str());
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp_path.c_str());
+            Debug("RejitPlanCache: unable to store the plan in ", path);
+        }
+    }
+}
+
+} // namespace trace
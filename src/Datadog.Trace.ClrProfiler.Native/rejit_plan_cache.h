@@ -0,0 +1,46 @@
+#ifndef DD_CLR_PROFILER_REJIT_PLAN_CACHE_H_
+#define DD_CLR_PROFILER_REJIT_PLAN_CACHE_H_
+
+#include <corhlpr.h>
+#include <cstdint>
+#include <vector>
+
+#include "string.h"
+#include "util.h"
+
+namespace trace
+{
+
+// A method of a module that CallTarget instruments, and the integration method that matched it
+struct RejitPlanEntry
+{
+    mdMethodDef method_def;
+    uint32_t integration_index; // into the shared IntegrationMethodSet
+};
+
+// RejitPlanCache persists the result of matching the CallTarget integrations against a module, so a
+// process started again from the same image can request the ReJIT without analyzing the module again.
+//
+// There is one file per module, named after its MVID. A plan is only valid for the integration methods
+// (and the profiler version) it was built for, which is checked through a hash stored in the file.
+class RejitPlanCache : public UnCopyable
+{
+private:
+    std::string directory_;
+    uint64_t key_;
+
+    std::string GetPlanPath(const GUID& module_version_id) const;
+
+public:
+    RejitPlanCache(const WSTRING& directory, uint64_t integration_methods_hash);
+
+    // TryLoad reads the plan of the module. Returns false if there is no valid plan for it.
+    bool TryLoad(const GUID& module_version_id, std::vector<RejitPlanEntry>& entries) const;
+
+    // Store writes the plan of the module, replacing any previous one. Failures are only logged.
+    void Store(const GUID& module_version_id, const std::vector<RejitPlanEntry>& entries) const;
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_REJIT_PLAN_CACHE_H_
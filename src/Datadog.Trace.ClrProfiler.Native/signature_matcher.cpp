@@ -0,0 +1,281 @@
+#include "signature_matcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "clr_helpers.h"
+#include "macros.h"
+
+namespace trace
+{
+
+namespace
+{
+    struct PrimitiveType
+    {
+        const WSTRING& name;
+        CorElementType element_type;
+    };
+
+    // the types GetSigTypeTokName names after their element type
+    const PrimitiveType kPrimitiveTypes[] = {
+        {SystemBoolean, ELEMENT_TYPE_BOOLEAN}, {SystemChar, ELEMENT_TYPE_CHAR},     {SystemSByte, ELEMENT_TYPE_I1},
+        {SystemByte, ELEMENT_TYPE_U1},         {SystemUInt16, ELEMENT_TYPE_U2},     {SystemInt16, ELEMENT_TYPE_I2},
+        {SystemInt32, ELEMENT_TYPE_I4},        {SystemUInt32, ELEMENT_TYPE_U4},     {SystemInt64, ELEMENT_TYPE_I8},
+        {SystemUInt64, ELEMENT_TYPE_U8},       {SystemSingle, ELEMENT_TYPE_R4},     {SystemDouble, ELEMENT_TYPE_R8},
+        {SystemIntPtr, ELEMENT_TYPE_I},        {SystemUIntPtr, ELEMENT_TYPE_U},     {SystemString, ELEMENT_TYPE_STRING},
+        {SystemObject, ELEMENT_TYPE_OBJECT},
+    };
+
+    bool EndsWith(const WSTRING& value, const WSTRING& suffix)
+    {
+        return value.size() >= suffix.size() &&
+               value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Parses the number of a generic parameter name ("!0" or "!!0") after its prefix
+    bool TryParseGenericParameterNumber(const WSTRING& value, size_t start, ULONG& number)
+    {
+        if (start >= value.size() || value.size() - start > 9)
+        {
+            return false;
+        }
+
+        number = 0;
+        for (size_t i = start; i < value.size(); i++)
+        {
+            if (value[i] < WStr('0') || value[i] > WStr('9'))
+            {
+                return false;
+            }
+            number = number * 10 + (ULONG)(value[i] - WStr('0'));
+        }
+        return true;
+    }
+
+    void AppendGenericParameter(std::vector<BYTE>& element, CorElementType element_type, ULONG number)
+    {
+        BYTE compressed[4];
+        const auto length = CorSigCompressData(number, compressed);
+        element.push_back((BYTE) element_type);
+        element.insert(element.end(), compressed, compressed + length);
+    }
+} // namespace
+
+SignatureMatcher::SignatureMatcher(const ComPtr<IMetaDataImport2>& metadata_import,
+                                   const ComPtr<IMetaDataAssemblyImport>& assembly_import) :
+    metadata_import_(metadata_import), assembly_import_(assembly_import)
+{
+}
+
+CompiledSignatureTypes SignatureMatcher::Compile(const std::vector<WSTRING>& signature_types)
+{
+    CompiledSignatureTypes compiled;
+    compiled.has_return_type = !signature_types.empty();
+    for (size_t i = 1; i < signature_types.size(); i++)
+    {
+        compiled.arguments.push_back(CompileType(signature_types[i]));
+    }
+    return compiled;
+}
+
+SignatureTypePattern SignatureMatcher::CompileType(const WSTRING& type_name)
+{
+    SignatureTypePattern pattern;
+    if (type_name == WStr("_"))
+    {
+        pattern.any = true;
+        return pattern;
+    }
+
+    // GetSigTypeTokName names a BYREF with a trailing "&" and a SZARRAY with a trailing "[]"
+    auto element_name = type_name;
+    if (EndsWith(element_name, WStr("&")))
+    {
+        pattern.prefix.push_back(ELEMENT_TYPE_BYREF);
+        element_name.resize(element_name.size() - 1);
+    }
+    while (EndsWith(element_name, WStr("[]")))
+    {
+        pattern.prefix.push_back(ELEMENT_TYPE_SZARRAY);
+        element_name.resize(element_name.size() - 2);
+    }
+
+    // generic instances, and any name that doesn't come from a single element type, are compared by name
+    if (element_name.empty() || element_name.find_first_of(WStr("[]&")) != WSTRING::npos)
+    {
+        SignatureTypePattern by_name;
+        by_name.by_name = true;
+        by_name.name = type_name;
+        return by_name;
+    }
+
+    pattern.name = element_name;
+
+    ULONG number;
+    if (element_name.compare(0, 2, WStr("!!")) == 0 && TryParseGenericParameterNumber(element_name, 2, number))
+    {
+        AppendGenericParameter(pattern.element, ELEMENT_TYPE_MVAR, number);
+    }
+    else if (element_name[0] == WStr('!') && TryParseGenericParameterNumber(element_name, 1, number))
+    {
+        AppendGenericParameter(pattern.element, ELEMENT_TYPE_VAR, number);
+    }
+    else
+    {
+        for (const auto& primitive : kPrimitiveTypes)
+        {
+            if (primitive.name == element_name)
+            {
+                pattern.element.push_back((BYTE) primitive.element_type);
+                break;
+            }
+        }
+    }
+
+    // class and valuetype tokens are still compared by name with the primitive types, see MatchToken
+    if (pattern.element.empty())
+    {
+        pattern.tokens = ResolveTypeName(element_name);
+    }
+    return pattern;
+}
+
+std::vector<mdToken> SignatureMatcher::ResolveTypeName(const WSTRING& type_name)
+{
+    if (!resolution_scopes_loaded_)
+    {
+        // type references are scoped by the assembly reference or by the module itself
+        resolution_scopes_loaded_ = true;
+        mdModule module = mdModuleNil;
+        if (SUCCEEDED(metadata_import_->GetModuleFromScope(&module)))
+        {
+            resolution_scopes_.push_back(module);
+        }
+        if (assembly_import_)
+        {
+            for (mdAssemblyRef assembly_ref : EnumAssemblyRefs(assembly_import_))
+            {
+                resolution_scopes_.push_back(assembly_ref);
+            }
+        }
+    }
+
+    std::vector<mdToken> tokens;
+
+    mdTypeDef type_def = mdTypeDefNil;
+    if (SUCCEEDED(metadata_import_->FindTypeDefByName(type_name.c_str(), mdTokenNil, &type_def)))
+    {
+        tokens.push_back(type_def);
+    }
+
+    for (const auto scope : resolution_scopes_)
+    {
+        mdTypeRef type_ref = mdTypeRefNil;
+        if (SUCCEEDED(metadata_import_->FindTypeRef(scope, type_name.c_str(), &type_ref)))
+        {
+            tokens.push_back(type_ref);
+        }
+    }
+
+    std::sort(tokens.begin(), tokens.end());
+    return tokens;
+}
+
+bool SignatureMatcher::MatchToken(const SignatureTypePattern& pattern, mdToken token)
+{
+    if (std::binary_search(pattern.tokens.begin(), pattern.tokens.end(), token))
+    {
+        return true;
+    }
+
+    auto name = token_names_.find(token);
+    if (name == token_names_.end())
+    {
+        name = token_names_.emplace(token, GetTypeInfo(metadata_import_, token).name).first;
+    }
+    return name->second == pattern.name;
+}
+
+bool SignatureMatcher::MatchArgument(const SignatureTypePattern& pattern, PCCOR_SIGNATURE pbCur,
+                                     PCCOR_SIGNATURE pbEnd)
+{
+    if (pattern.any)
+    {
+        return true;
+    }
+
+    if (pattern.by_name)
+    {
+        return GetSigTypeTokName(pbCur, metadata_import_) == pattern.name;
+    }
+
+    const auto prefix_length = pattern.prefix.size();
+    if ((size_t)(pbEnd - pbCur) <= prefix_length ||
+        (prefix_length > 0 && memcmp(pbCur, pattern.prefix.data(), prefix_length) != 0))
+    {
+        return false;
+    }
+    pbCur += prefix_length;
+
+    if (*pbCur == ELEMENT_TYPE_CLASS || *pbCur == ELEMENT_TYPE_VALUETYPE)
+    {
+        pbCur++;
+        mdToken token;
+        pbCur += CorSigUncompressToken(pbCur, &token);
+        return pbCur == pbEnd && MatchToken(pattern, token);
+    }
+
+    const auto element_length = pattern.element.size();
+    return element_length > 0 && (size_t)(pbEnd - pbCur) == element_length &&
+           memcmp(pbCur, pattern.element.data(), element_length) == 0;
+}
+
+HRESULT SignatureMatcher::Match(const CompiledSignatureTypes& signature_types, PCCOR_SIGNATURE signature,
+                                ULONG signature_length)
+{
+    // the blob is walked like FunctionMethodSignature::TryParse, so the same signatures fail
+    PCCOR_SIGNATURE pbCur = signature;
+    PCCOR_SIGNATURE pbEnd = signature + signature_length;
+
+    unsigned char calling_convention;
+    IfFalseRetFAIL(ParseByte(pbCur, pbEnd, &calling_convention));
+
+    if (calling_convention & IMAGE_CEE_CS_CALLCONV_GENERIC)
+    {
+        unsigned generic_param_count;
+        IfFalseRetFAIL(ParseNumber(pbCur, pbEnd, &generic_param_count));
+    }
+
+    unsigned param_count;
+    IfFalseRetFAIL(ParseNumber(pbCur, pbEnd, &param_count));
+    IfFalseRetFAIL(ParseRetType(pbCur, pbEnd));
+
+    const auto& patterns = signature_types.arguments;
+    bool matches = signature_types.has_return_type && param_count == patterns.size();
+    bool encountered_sentinel = false;
+    for (unsigned i = 0; i < param_count; i++)
+    {
+        if (pbCur >= pbEnd) return E_FAIL;
+
+        if (*pbCur == ELEMENT_TYPE_SENTINEL)
+        {
+            if (encountered_sentinel) return E_FAIL;
+
+            encountered_sentinel = true;
+            pbCur++;
+        }
+
+        const PCCOR_SIGNATURE pbParam = pbCur;
+        IfFalseRetFAIL(ParseParam(pbCur, pbEnd));
+
+        if (matches && !MatchArgument(patterns[i], pbParam, pbCur))
+        {
+            matches = false;
+        }
+    }
+
+    return matches ? S_OK : S_FALSE;
+}
+
+} // namespace trace
@@ -0,0 +1,76 @@
+#ifndef DD_CLR_PROFILER_SIGNATURE_MATCHER_H_
+#define DD_CLR_PROFILER_SIGNATURE_MATCHER_H_
+
+#include <corhlpr.h>
+#include <unordered_map>
+#include <vector>
+
+#include "com_ptr.h"
+#include "string.h"
+#include "util.h"
+
+namespace trace
+{
+
+// The pattern of an argument of the integration signature types, compiled against a module
+struct SignatureTypePattern
+{
+    // "_" matches any argument
+    bool any = false;
+    // the argument type name is built and compared, for the shapes without a byte pattern (generic instances)
+    bool by_name = false;
+    // BYREF and SZARRAY bytes in front of the element type
+    std::vector<BYTE> prefix{};
+    // the element type (with its number for VAR and MVAR), empty for a class or valuetype
+    std::vector<BYTE> element{};
+    // name of the element type, compared with the class and valuetype tokens
+    WSTRING name{};
+    // TypeDef and TypeRef tokens of the module named after the element type, sorted
+    std::vector<mdToken> tokens{};
+};
+
+// The signature types of an integration target compiled against a module, see SignatureMatcher::Compile
+struct CompiledSignatureTypes
+{
+    // signature types without the return type never match
+    bool has_return_type = false;
+    std::vector<SignatureTypePattern> arguments{};
+};
+
+// SignatureMatcher compares the argument types of method signature blobs of a module with the signature types
+// of an integration target, as CallTarget_RequestRejitForModule did by building the type name of each argument.
+//
+// The signature types of an integration are compiled once per module: primitive types become their element
+// type bytes and the class names are resolved to the TypeDef and TypeRef tokens of the module. Matching an
+// overload is then a byte comparison of its signature. A class token that isn't one of the resolved tokens
+// (a nested type or a type of a module reference) is compared by name, once per token.
+class SignatureMatcher : public UnCopyable
+{
+private:
+    ComPtr<IMetaDataImport2> metadata_import_;
+    ComPtr<IMetaDataAssemblyImport> assembly_import_;
+
+    std::vector<mdToken> resolution_scopes_;
+    bool resolution_scopes_loaded_ = false;
+    std::unordered_map<mdToken, WSTRING> token_names_;
+
+    SignatureTypePattern CompileType(const WSTRING& type_name);
+    std::vector<mdToken> ResolveTypeName(const WSTRING& type_name);
+    bool MatchToken(const SignatureTypePattern& pattern, mdToken token);
+    bool MatchArgument(const SignatureTypePattern& pattern, PCCOR_SIGNATURE pbCur, PCCOR_SIGNATURE pbEnd);
+
+public:
+    SignatureMatcher(const ComPtr<IMetaDataImport2>& metadata_import,
+                     const ComPtr<IMetaDataAssemblyImport>& assembly_import);
+
+    // Compiles the signature types of an integration target, whose first entry is the return type
+    CompiledSignatureTypes Compile(const std::vector<WSTRING>& signature_types);
+
+    // Compares the arguments of a method signature with compiled signature types, the return type isn't compared.
+    // Returns S_OK when the arguments match, S_FALSE when they don't, and E_FAIL when the signature can't be parsed.
+    HRESULT Match(const CompiledSignatureTypes& signature_types, PCCOR_SIGNATURE signature, ULONG signature_length);
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_SIGNATURE_MATCHER_H_
@@ -1,28 +1,353 @@
 #ifndef DD_CLR_PROFILER_STATS_H_
 #define DD_CLR_PROFILER_STATS_H_
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 
+#include "stats_block.h"
 #include "util.h"
 
 namespace trace
 {
 
+// LatencyHistogram records durations in nanoseconds into log buckets: every power of two is split
+// into 4 linear sub buckets, so the bucket of a value is at most 25% wider than the value itself.
+// Recording is a few relaxed increments on a shard picked per thread, the shards are merged on read.
+// A snapshot of the histogram can be exported to a stats block, the owner of the block refreshes it.
+class LatencyHistogram : public UnCopyable
+{
+public:
+    static constexpr int kSubBucketBits = 2;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+    static_assert(kBuckets == kStatsBlockHistogramBuckets, "the stats block layout must match the histogram");
+
+    struct Snapshot
+    {
+        std::array<uint64_t, kBuckets> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // Returns an upper bound of the given percentile (0 to 1), never more than the max recorded value
+        uint64_t Percentile(double percentile) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+
+            uint64_t rank = (uint64_t) std::ceil(percentile * count);
+            if (rank < 1)
+            {
+                rank = 1;
+            }
+
+            uint64_t seen = 0;
+            for (int i = 0; i < kBuckets; i++)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                {
+                    return std::min(GetBucketUpperBound(i), max);
+                }
+            }
+            return max;
+        }
+    };
+
+private:
+    static const int kShards = 8;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> buckets[kBuckets];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    Shard shards_[kShards];
+
+    static int GetHighestBit(uint64_t value)
+    {
+        int bit = 0;
+        for (int shift = 32; shift > 0; shift >>= 1)
+        {
+            if (value >> shift)
+            {
+                value >>= shift;
+                bit += shift;
+            }
+        }
+        return bit;
+    }
+
+    static Shard& GetShard(Shard* shards)
+    {
+        // threads are spread round robin over the shards, so concurrent callbacks rarely share a cache line
+        static std::atomic<unsigned int> next_shard{0};
+        thread_local const unsigned int shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return shards[shard];
+    }
+
+public:
+    LatencyHistogram()
+    {
+        for (auto& shard : shards_)
+        {
+            for (auto& bucket : shard.buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            shard.count.store(0, std::memory_order_relaxed);
+            shard.sum.store(0, std::memory_order_relaxed);
+            shard.max.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static int GetBucketIndex(uint64_t value)
+    {
+        if (value < kSubBuckets)
+        {
+            return (int) value;
+        }
+
+        const int bit = GetHighestBit(value);
+        const int sub_bucket = (int) (value >> (bit - kSubBucketBits)) & (kSubBuckets - 1);
+        return (bit - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+    }
+
+    // Smallest value that falls into the given bucket
+    static uint64_t GetBucketLowerBound(int index)
+    {
+        if (index < kSubBuckets)
+        {
+            return (uint64_t) index;
+        }
+
+        const int bit = index / kSubBuckets + kSubBucketBits - 1;
+        const uint64_t sub_bucket = (uint64_t)(index % kSubBuckets);
+        return (kSubBuckets + sub_bucket) << (bit - kSubBucketBits);
+    }
+
+    // Largest value that falls into the given bucket
+    static uint64_t GetBucketUpperBound(int index)
+    {
+        if (index + 1 >= kBuckets)
+        {
+            return UINT64_MAX;
+        }
+        return GetBucketLowerBound(index + 1) - 1;
+    }
+
+    void Record(uint64_t value)
+    {
+        Shard& shard = GetShard(shards_);
+        shard.buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Copies what was recorded so far into the given stats block histogram
+    void Export(StatsBlockHistogram* target) const
+    {
+        const auto snapshot = GetSnapshot();
+        for (int i = 0; i < kBuckets; i++)
+        {
+            target->buckets[i].store(snapshot.buckets[i], std::memory_order_relaxed);
+        }
+        target->count.store(snapshot.count, std::memory_order_relaxed);
+        target->total_ns.store(snapshot.sum, std::memory_order_relaxed);
+        target->max_ns.store(snapshot.max, std::memory_order_relaxed);
+    }
+
+    Snapshot GetSnapshot() const
+    {
+        Snapshot snapshot;
+        for (const auto& shard : shards_)
+        {
+            for (int i = 0; i < kBuckets; i++)
+            {
+                snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+            }
+            snapshot.count += shard.count.load(std::memory_order_relaxed);
+            snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+            snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+        }
+        return snapshot;
+    }
+};
+
+// SlowestCalls keeps the N slowest named calls. Calls faster than the current N-th are rejected
+// with a single relaxed load, so only the rare slow calls take the lock.
+class SlowestCalls : public UnCopyable
+{
+public:
+    struct Entry
+    {
+        uint64_t duration;
+        const char* callback;
+        WSTRING name;
+    };
+
+private:
+    static const size_t kMaxEntries = 10;
+
+    std::atomic<uint64_t> threshold_{0};
+    mutable std::mutex lock_;
+    std::vector<Entry> entries_;
+
+public:
+    bool IsCandidate(uint64_t duration) const
+    {
+        return duration > threshold_.load(std::memory_order_relaxed);
+    }
+
+    void Add(uint64_t duration, const char* callback, WSTRING&& name)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        const auto position = std::find_if(entries_.begin(), entries_.end(),
+                                           [duration](const Entry& entry) { return entry.duration < duration; });
+        if (position == entries_.end() && entries_.size() >= kMaxEntries)
+        {
+            return;
+        }
+
+        entries_.insert(position, {duration, callback, std::move(name)});
+        if (entries_.size() > kMaxEntries)
+        {
+            entries_.pop_back();
+        }
+
+        if (entries_.size() == kMaxEntries)
+        {
+            threshold_.store(entries_.back().duration, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns the entries, slowest first
+    std::vector<Entry> GetEntries() const
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        return entries_;
+    }
+};
+
 class SWStat
 {
-    std::atomic_ullong* _value;
+    LatencyHistogram* _histogram;
+    SlowestCalls* _slowest;
+    const char* _callback;
+    // the name is only built from its parts if the call is among the slowest ones
+    const WSTRING* _typeName = nullptr;
+    const WSTRING* _methodName = nullptr;
+    WSTRING _name;
     std::chrono::steady_clock::time_point _startTime;
 
+    uint64_t GetElapsed() const
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                               _startTime)
+            .count();
+    }
+
+    void BuildName()
+    {
+        if (_typeName != nullptr)
+        {
+            _name.reserve(_typeName->size() + 1 + _methodName->size());
+            _name = *_typeName;
+            _name += WStr(".");
+        }
+        _name += *_methodName;
+
+        _typeName = nullptr;
+        _methodName = nullptr;
+    }
+
 public:
-    SWStat(std::atomic_ullong* value)
+    // Keeps the name of the measured call while its parts are alive: when the scope ends, the name is copied
+    // if the call is already among the slowest ones
+    class NameScope : public UnCopyable
+    {
+        SWStat* _stat;
+
+    public:
+        explicit NameScope(SWStat* stat) : _stat(stat)
+        {
+        }
+        ~NameScope()
+        {
+            if (_stat->_methodName != nullptr && _stat->_slowest->IsCandidate(_stat->GetElapsed()))
+            {
+                _stat->BuildName();
+            }
+            _stat->_typeName = nullptr;
+            _stat->_methodName = nullptr;
+        }
+    };
+
+    SWStat(LatencyHistogram* histogram, SlowestCalls* slowest = nullptr, const char* callback = nullptr)
     {
-        _value = value;
+        _histogram = histogram;
+        _slowest = slowest;
+        _callback = callback;
         _startTime = std::chrono::steady_clock::now();
     }
     ~SWStat()
     {
-        auto increment = (std::chrono::steady_clock::now() - _startTime).count();
-        _value->fetch_add(increment);
+        const uint64_t elapsed = GetElapsed();
+        _histogram->Record(elapsed);
+
+        if (_slowest != nullptr && _slowest->IsCandidate(elapsed))
+        {
+            if (_methodName != nullptr)
+            {
+                BuildName();
+            }
+            if (!_name.empty())
+            {
+                _slowest->Add(elapsed, _callback, std::move(_name));
+            }
+        }
+    }
+    // Names the measured call (module or method) for the slowest calls report.
+    // The strings are read when the measure ends, so they must outlive it.
+    void SetName(const WSTRING& name)
+    {
+        if (_slowest != nullptr)
+        {
+            _methodName = &name;
+        }
+    }
+    void SetName(const WSTRING& type_name, const WSTRING& method_name)
+    {
+        if (_slowest != nullptr)
+        {
+            _typeName = &type_name;
+            _methodName = &method_name;
+        }
+    }
+    // Names the measured call with strings that may not outlive the measure, the scope must not outlive them
+    NameScope SetScopedName(const WSTRING& name)
+    {
+        SetName(name);
+        return NameScope(this);
+    }
+    NameScope SetScopedName(const WSTRING& type_name, const WSTRING& method_name)
+    {
+        SetName(type_name, method_name);
+        return NameScope(this);
     }
 };
 
@@ -31,107 +356,283 @@ class Stats : public Singleton<Stats>
     friend class Singleton<Stats>;
 
 private:
-    std::atomic_ullong callTargetRequestRejit = {0};
-    std::atomic_ullong callTargetRewriter = {0};
-    std::atomic_ullong jitInlining = {0};
-    std::atomic_ullong jitCompilationStarted = {0};
-    std::atomic_ullong moduleUnloadStarted = {0};
-    std::atomic_ullong moduleLoadFinished = {0};
-    std::atomic_ullong assemblyLoadFinished = {0};
-    std::atomic_ullong initialize = {0};
+    LatencyHistogram callTargetRequestRejit;
+    LatencyHistogram callTargetRewriter;
+    LatencyHistogram jitInlining;
+    LatencyHistogram jitCompilationStarted;
+    LatencyHistogram moduleUnloadStarted;
+    LatencyHistogram moduleLoadFinished;
+    LatencyHistogram assemblyLoadFinished;
+    LatencyHistogram initialize;
+    LatencyHistogram rejitRequest;
+    LatencyHistogram moduleAnalysis;
+
+    //
+    SlowestCalls slowestModules;
+    SlowestCalls slowestMethods;
 
     //
-    std::atomic_uint callTargetRequestRejitCount = {0};
-    std::atomic_uint callTargetRewriterCount = {0};
-    std::atomic_uint jitInliningCount = {0};
-    std::atomic_uint jitCompilationStartedCount = {0};
-    std::atomic_uint moduleUnloadStartedCount = {0};
-    std::atomic_uint moduleLoadFinishedCount = {0};
-    std::atomic_uint assemblyLoadFinishedCount = {0};
+    StatsBlock localBlock;
+    std::atomic<StatsBlock*> block = {nullptr};
+    WSTRING filePath;
+
+    // the histograms are only copied into the block when it is read, and periodically while it is mapped to a file
+    std::mutex refreshLock;
+    std::thread refresher;
+    std::mutex refresherLock;
+    std::condition_variable refresherCondition;
+    bool refresherStop = false;
+
+    void RefreshHistograms(StatsBlock* target)
+    {
+        std::lock_guard<std::mutex> guard(refreshLock);
+        initialize.Export(&target->callbacks[(uint32_t) StatsCallback::Initialize]);
+        moduleLoadFinished.Export(&target->callbacks[(uint32_t) StatsCallback::ModuleLoadFinished]);
+        moduleUnloadStarted.Export(&target->callbacks[(uint32_t) StatsCallback::ModuleUnloadStarted]);
+        assemblyLoadFinished.Export(&target->callbacks[(uint32_t) StatsCallback::AssemblyLoadFinished]);
+        jitCompilationStarted.Export(&target->callbacks[(uint32_t) StatsCallback::JitCompilationStarted]);
+        jitInlining.Export(&target->callbacks[(uint32_t) StatsCallback::JitInlining]);
+        callTargetRequestRejit.Export(&target->callbacks[(uint32_t) StatsCallback::CallTargetRequestRejit]);
+        callTargetRewriter.Export(&target->callbacks[(uint32_t) StatsCallback::CallTargetRewriter]);
+        rejitRequest.Export(&target->callbacks[(uint32_t) StatsCallback::RequestReJIT]);
+        moduleAnalysis.Export(&target->callbacks[(uint32_t) StatsCallback::ModuleAnalysis]);
+    }
+
+    void RefresherThreadLoop()
+    {
+        std::unique_lock<std::mutex> lock(refresherLock);
+        while (!refresherCondition.wait_for(lock, std::chrono::seconds(1), [this]() { return refresherStop; }))
+        {
+            RefreshHistograms(block.load());
+        }
+    }
+
+    void ExportTo(StatsBlock* target)
+    {
+        const StatsBlock* current = block.load();
+        if (current != nullptr)
+        {
+            target->modules_tracked.store(current->modules_tracked.load());
+            target->rejit_queue_depth.store(current->rejit_queue_depth.load());
+            target->integration_bytes_retained.store(current->integration_bytes_retained.load());
+            target->rejit_request_items.store(current->rejit_request_items.load());
+            target->rejit_request_methods.store(current->rejit_request_methods.load());
+            target->rejit_request_max_batch.store(current->rejit_request_max_batch.load());
+            target->module_analysis_queue_depth.store(current->module_analysis_queue_depth.load());
+            target->log_messages_dropped.store(current->log_messages_dropped.load());
+        }
+
+        RefreshHistograms(target);
+
+        block.store(target);
+    }
+
+    static void WriteHistogram(std::stringstream& ss, const char* name, const LatencyHistogram& histogram,
+                               bool withCount = true)
+    {
+        const auto snapshot = histogram.GetSnapshot();
+        ss << name << "=" << snapshot.sum / 1000000 << "ms";
+        if (withCount)
+        {
+            ss << "/" << snapshot.count;
+        }
+        if (snapshot.count > 0)
+        {
+            ss << " (p50=" << snapshot.Percentile(0.5) / 1000 << "us, p99=" << snapshot.Percentile(0.99) / 1000
+               << "us, max=" << snapshot.max / 1000 << "us)";
+        }
+    }
+
+    static void WriteSlowest(std::stringstream& ss, const char* name, const SlowestCalls& slowest)
+    {
+        ss << name << "=[";
+        bool first = true;
+        for (const auto& entry : slowest.GetEntries())
+        {
+            if (!first)
+            {
+                ss << ", ";
+            }
+            first = false;
+            ss << ::trace::ToString(entry.name) << " (" << entry.callback << ", " << entry.duration / 1000 << "us)";
+        }
+        ss << "]";
+    }
 
 public:
     Stats()
     {
-        callTargetRequestRejit = 0;
-        jitInlining = 0;
-        jitCompilationStarted = 0;
-        moduleUnloadStarted = 0;
-        moduleLoadFinished = 0;
-        assemblyLoadFinished = 0;
-        initialize = 0;
-
-        callTargetRequestRejitCount = 0;
-        jitInliningCount = 0;
-        jitCompilationStartedCount = 0;
-        moduleUnloadStartedCount = 0;
-        moduleLoadFinishedCount = 0;
-        assemblyLoadFinishedCount = 0;
+        InitializeStatsBlock(&localBlock);
+        ExportTo(&localBlock);
+    }
+    ~Stats()
+    {
+        Stop();
+    }
+    // Moves the stats block into a file other processes can map, must be called before the callbacks start.
+    // The histograms of the file are refreshed every second until Stop.
+    bool ExportToFile(const WSTRING& path)
+    {
+        StatsBlock* fileBlock = MapStatsBlockFile(path);
+        if (fileBlock == nullptr)
+        {
+            return false;
+        }
+
+        filePath = path;
+        ExportTo(fileBlock);
+        if (!refresher.joinable())
+        {
+            refresher = std::thread([this]() { RefresherThreadLoop(); });
+        }
+        return true;
+    }
+    // Refreshes the histograms of the stats block one last time and stops refreshing the stats file
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(refresherLock);
+            refresherStop = true;
+        }
+        refresherCondition.notify_all();
+        if (refresher.joinable())
+        {
+            refresher.join();
+        }
+        RefreshHistograms(block.load());
+    }
+    // Moves the stats block back into the process, then unmaps and deletes the stats file.
+    // Must be called after Stop, once the callbacks are done.
+    void CloseFile()
+    {
+        StatsBlock* fileBlock = block.load();
+        if (fileBlock == &localBlock)
+        {
+            return;
+        }
+
+        ExportTo(&localBlock);
+        UnmapStatsBlockFile(fileBlock, filePath);
+    }
+    // The live stats block. Readers see the counters change as the profiler updates them, the histograms are
+    // copied when the block is returned.
+    const StatsBlock* GetStatsBlock()
+    {
+        StatsBlock* current = block.load();
+        RefreshHistograms(current);
+        return current;
     }
     SWStat CallTargetRequestRejitMeasure()
     {
-        callTargetRequestRejitCount++;
-        return SWStat(&callTargetRequestRejit);
+        return SWStat(&callTargetRequestRejit, &slowestModules, "CallTargetRequestRejit");
     }
     SWStat CallTargetRewriterCallbackMeasure()
     {
-        callTargetRewriterCount++;
-        return SWStat(&callTargetRewriter);
+        return SWStat(&callTargetRewriter, &slowestMethods, "CallTargetRewriter");
     }
     SWStat JITInliningMeasure()
     {
-        jitInliningCount++;
         return SWStat(&jitInlining);
     }
     SWStat JITCompilationStartedMeasure()
     {
-        jitCompilationStartedCount++;
-        return SWStat(&jitCompilationStarted);
+        return SWStat(&jitCompilationStarted, &slowestMethods, "JitCompilationStarted");
     }
     SWStat ModuleUnloadStartedMeasure()
     {
-        moduleUnloadStartedCount++;
         return SWStat(&moduleUnloadStarted);
     }
     SWStat ModuleLoadFinishedMeasure()
     {
-        moduleLoadFinishedCount++;
-        return SWStat(&moduleLoadFinished);
+        return SWStat(&moduleLoadFinished, &slowestModules, "ModuleLoadFinished");
     }
     SWStat AssemblyLoadFinishedMeasure()
     {
-        assemblyLoadFinishedCount++;
         return SWStat(&assemblyLoadFinished);
     }
     SWStat InitializeMeasure()
     {
         return SWStat(&initialize);
     }
+    // Measures a RequestReJIT call (one runtime suspension) for a batch of methods merged from several requests
+    SWStat RequestReJITMeasure(unsigned int items, unsigned int methods)
+    {
+        StatsBlock* current = block.load(std::memory_order_acquire);
+        current->rejit_request_items.fetch_add(items, std::memory_order_relaxed);
+        current->rejit_request_methods.fetch_add(methods, std::memory_order_relaxed);
+
+        uint64_t maxBatch = current->rejit_request_max_batch.load(std::memory_order_relaxed);
+        while (methods > maxBatch &&
+               !current->rejit_request_max_batch.compare_exchange_weak(maxBatch, methods, std::memory_order_relaxed))
+        {
+        }
+        return SWStat(&rejitRequest);
+    }
+    void AddIntegrationBytesRetained(long long bytes)
+    {
+        block.load(std::memory_order_acquire)->integration_bytes_retained.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void AddModulesTracked(long long modules)
+    {
+        block.load(std::memory_order_acquire)->modules_tracked.fetch_add(modules, std::memory_order_relaxed);
+    }
+    // Number of ReJIT requests waiting for the ReJIT thread
+    void AddRejitQueueDepth(long long requests)
+    {
+        block.load(std::memory_order_acquire)->rejit_queue_depth.fetch_add(requests, std::memory_order_relaxed);
+    }
+    // Number of modules waiting for a module analysis worker
+    void AddModuleAnalysisQueueDepth(long long modules)
+    {
+        block.load(std::memory_order_acquire)
+            ->module_analysis_queue_depth.fetch_add(modules, std::memory_order_relaxed);
+    }
+    void AddLogMessagesDropped(long long messages)
+    {
+        block.load(std::memory_order_acquire)->log_messages_dropped.fetch_add(messages, std::memory_order_relaxed);
+    }
+    // Time from the load of a module to the end of its analysis
+    void RecordModuleAnalysisLatency(std::chrono::steady_clock::duration latency)
+    {
+        moduleAnalysis.Record((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    }
     std::string ToString()
     {
         std::stringstream ss;
-        ss << "[Initialize=";
-        ss << initialize.load() / 1000000 << "ms";
-        ss << ", ModuleLoadFinished=";
-        ss << moduleLoadFinished.load() / 1000000 << "ms"
-           << "/" << moduleLoadFinishedCount.load();
-        ss << ", CallTargetRequestRejit=";
-        ss << callTargetRequestRejit.load() / 1000000 << "ms"
-           << "/" << callTargetRequestRejitCount.load();
-        ss << ", CallTargetRewriter=";
-        ss << callTargetRewriter.load() / 1000000 << "ms"
-           << "/" << callTargetRewriterCount.load();
-        ss << ", AssemblyLoadFinished=";
-        ss << assemblyLoadFinished.load() / 1000000 << "ms"
-           << "/" << assemblyLoadFinishedCount.load();
-        ss << ", ModuleUnloadStarted=";
-        ss << moduleUnloadStarted.load() / 1000000 << "ms"
-           << "/" << moduleUnloadStartedCount.load();
-        ss << ", JitCompilationStarted=";
-        ss << jitCompilationStarted.load() / 1000000 << "ms"
-           << "/" << jitCompilationStartedCount.load();
-        ss << ", JitInlining=";
-        ss << jitInlining.load() / 1000000 << "ms"
-           << "/" << jitInliningCount.load();
+        ss << "[";
+        WriteHistogram(ss, "Initialize", initialize, false);
+        ss << ", ";
+        WriteHistogram(ss, "ModuleLoadFinished", moduleLoadFinished);
+        ss << ", ";
+        WriteHistogram(ss, "CallTargetRequestRejit", callTargetRequestRejit);
+        ss << ", ";
+        WriteHistogram(ss, "ModuleAnalysis", moduleAnalysis);
+        ss << ", ";
+        WriteHistogram(ss, "CallTargetRewriter", callTargetRewriter);
+        ss << ", ";
+        WriteHistogram(ss, "AssemblyLoadFinished", assemblyLoadFinished);
+        ss << ", ";
+        WriteHistogram(ss, "ModuleUnloadStarted", moduleUnloadStarted);
+        ss << ", ";
+        WriteHistogram(ss, "JitCompilationStarted", jitCompilationStarted);
+        ss << ", ";
+        WriteHistogram(ss, "JitInlining", jitInlining);
+        ss << ", ";
+        WriteHistogram(ss, "RequestReJIT", rejitRequest);
+
+        const StatsBlock* current = block.load();
+        ss << " (Requests=" << current->rejit_request_items.load()
+           << ", Methods=" << current->rejit_request_methods.load()
+           << ", MaxBatch=" << current->rejit_request_max_batch.load() << ")";
+        ss << ", ModulesTracked=" << current->modules_tracked.load();
+        ss << ", ModuleAnalysisQueue=" << current->module_analysis_queue_depth.load();
+        ss << ", IntegrationsRetained=";
+        ss << current->integration_bytes_retained.load() / 1024 << "KB";
+        ss << ", LogMessagesDropped=" << current->log_messages_dropped.load();
+        ss << ", ";
+        WriteSlowest(ss, "SlowestModules", slowestModules);
+        ss << ", ";
+        WriteSlowest(ss, "SlowestMethods", slowestMethods);
         ss << "]";
         return ss.str();
     }
@@ -139,4 +640,4 @@ public:
 
 } // namespace trace
 
-#endif // DD_CLR_PROFILER_STATS_H_
\ No newline at end of file
+#endif // DD_CLR_PROFILER_STATS_H_
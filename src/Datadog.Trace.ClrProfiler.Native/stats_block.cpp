@@ -0,0 +1,91 @@
+#include "stats_block.h"
+
+#include <cstring>
+
+#include "pal.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace trace
+{
+
+void InitializeStatsBlock(StatsBlock* block)
+{
+    std::memset((void*) block, 0, sizeof(StatsBlock));
+    block->version = kStatsBlockVersion;
+    block->size = sizeof(StatsBlock);
+    block->histogram_buckets = kStatsBlockHistogramBuckets;
+    block->callbacks_count = kStatsBlockCallbacks;
+    block->process_id = (uint32_t) GetPID();
+
+    // readers use the magic to know the header is complete
+    std::atomic_thread_fence(std::memory_order_release);
+    block->magic = kStatsBlockMagic;
+}
+
+StatsBlock* MapStatsBlockFile(const WSTRING& path)
+{
+#ifdef _WIN32
+    const HANDLE file = CreateFileW((LPCWSTR) path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                    nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, sizeof(StatsBlock), nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        return nullptr;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(StatsBlock));
+    CloseHandle(mapping);
+    if (view == nullptr)
+    {
+        return nullptr;
+    }
+#else
+    const int fd = open(ToString(path).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        return nullptr;
+    }
+
+    if (ftruncate(fd, sizeof(StatsBlock)) != 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    void* view = mmap(nullptr, sizeof(StatsBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return nullptr;
+    }
+#endif
+
+    auto block = static_cast<StatsBlock*>(view);
+    InitializeStatsBlock(block);
+    return block;
+}
+
+void UnmapStatsBlockFile(StatsBlock* block, const WSTRING& path)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(block);
+    DeleteFileW((LPCWSTR) path.c_str());
+#else
+    munmap(block, sizeof(StatsBlock));
+    unlink(ToString(path).c_str());
+#endif
+}
+
+} // namespace trace
@@ -0,0 +1,97 @@
+#ifndef DD_CLR_PROFILER_STATS_BLOCK_H_
+#define DD_CLR_PROFILER_STATS_BLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "string.h"
+
+namespace trace
+{
+
+// The stats block is read by code outside of the profiler (the managed tracer through GetProfilerStats,
+// or another process through the stats file) while the profiler keeps updating it, so its layout is an ABI:
+// fields are only ever appended, and readers check the magic, version and size before using it.
+// Every counter is a 64-bit integer updated with relaxed atomics, readers may see them slightly out of sync.
+// The histograms of the callbacks have a fixed capacity, so measuring a new callback doesn't move the fields
+// after them.
+
+const uint32_t kStatsBlockMagic = 0x54534444; // "DDST"
+// version 2 added the ModuleAnalysis histogram and module_analysis_queue_depth
+// version 3 added log_messages_dropped
+// version 4 moved the counters before the histograms, and gave the histograms a fixed capacity
+const uint32_t kStatsBlockVersion = 4;
+
+// Buckets of LatencyHistogram: every power of two is split into 4 linear sub buckets
+const uint32_t kStatsBlockHistogramBuckets = 252;
+
+// Measured callbacks, the index of their histogram in the stats block
+enum class StatsCallback : uint32_t
+{
+    Initialize = 0,
+    ModuleLoadFinished,
+    ModuleUnloadStarted,
+    AssemblyLoadFinished,
+    JitCompilationStarted,
+    JitInlining,
+    CallTargetRequestRejit,
+    CallTargetRewriter,
+    RequestReJIT,
+    // from the module load to the end of its analysis, including the time waiting for a worker
+    ModuleAnalysis,
+    Count
+};
+
+const uint32_t kStatsBlockCallbacks = (uint32_t) StatsCallback::Count;
+const uint32_t kStatsBlockCallbacksCapacity = 16;
+static_assert(kStatsBlockCallbacks <= kStatsBlockCallbacksCapacity, "the stats block has no room for the callbacks");
+
+struct StatsBlockHistogram
+{
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[kStatsBlockHistogramBuckets];
+};
+
+struct StatsBlock
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t histogram_buckets;
+    uint32_t callbacks_count; // histograms in use, out of kStatsBlockCallbacksCapacity
+    uint32_t process_id;
+
+    std::atomic<uint64_t> modules_tracked;
+    std::atomic<uint64_t> rejit_queue_depth;
+    std::atomic<int64_t> integration_bytes_retained;
+    std::atomic<uint64_t> rejit_request_items;
+    std::atomic<uint64_t> rejit_request_methods;
+    std::atomic<uint64_t> rejit_request_max_batch;
+    std::atomic<uint64_t> module_analysis_queue_depth;
+
+    // log messages dropped because the log buffer of their thread was full
+    std::atomic<uint64_t> log_messages_dropped;
+
+    StatsBlockHistogram callbacks[kStatsBlockCallbacksCapacity];
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+              "the stats block counters must be plain lock-free 64-bit integers");
+static_assert(std::is_standard_layout<StatsBlock>::value, "the stats block must have a fixed layout");
+
+// Fills the header and zeroes the counters of a block
+void InitializeStatsBlock(StatsBlock* block);
+
+// Maps a stats block into the given file, so other processes can read it while this one is running.
+// Returns nullptr if the file can't be created or mapped.
+StatsBlock* MapStatsBlockFile(const WSTRING& path);
+
+// Unmaps a block returned by MapStatsBlockFile and deletes its file
+void UnmapStatsBlockFile(StatsBlock* block, const WSTRING& path);
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_STATS_BLOCK_H_
@@ -3,12 +3,182 @@
 #include <Windows.h>
 #define tmp_buffer_size 512
 #else
-#include "miniutf.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #endif
 
 namespace trace
 {
 
+#ifndef _WIN32
+namespace
+{
+    // Narrows the leading ASCII code units of src into dst, returns how many were narrowed
+    size_t NarrowAscii(const char16_t* src, size_t length, char* dst)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i non_ascii = _mm_set1_epi16((short) 0xFF80);
+        for (; i + 16 <= length; i += 16)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+            const __m128i bits = _mm_and_si128(_mm_or_si128(low, high), non_ascii);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128())) != 0xFFFF)
+            {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        for (; i + 16 <= length; i += 16)
+        {
+            const uint16x8_t low = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i));
+            const uint16x8_t high = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i + 8));
+            if (vmaxvq_u16(vorrq_u16(low, high)) >= 0x80)
+            {
+                break;
+            }
+            vst1q_u8(reinterpret_cast<uint8_t*>(dst + i), vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+        }
+#endif
+        for (; i < length && src[i] < 0x80; i++)
+        {
+            dst[i] = (char) src[i];
+        }
+        return i;
+    }
+
+    // Widens the leading ASCII bytes of src into dst, returns how many were widened
+    size_t WidenAscii(const char* src, size_t length, char16_t* dst)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 16 <= length; i += 16)
+        {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            if (_mm_movemask_epi8(bytes) != 0)
+            {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(bytes, _mm_setzero_si128()));
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        for (; i + 16 <= length; i += 16)
+        {
+            const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+            if (vmaxvq_u8(bytes) >= 0x80)
+            {
+                break;
+            }
+            vst1q_u16(reinterpret_cast<uint16_t*>(dst + i), vmovl_u8(vget_low_u8(bytes)));
+            vst1q_u16(reinterpret_cast<uint16_t*>(dst + i + 8), vmovl_u8(vget_high_u8(bytes)));
+        }
+#endif
+        for (; i < length && (unsigned char) src[i] < 0x80; i++)
+        {
+            dst[i] = (char16_t) src[i];
+        }
+        return i;
+    }
+
+    bool IsContinuation(const char* src, const char* end)
+    {
+        return src < end && ((unsigned char) *src & 0xC0) == 0x80;
+    }
+
+    // Decodes the UTF-8 sequence at src into UTF-16 like miniutf::to_utf16: an invalid sequence is replaced
+    // by U+FFFD and skips a single byte. Returns the number of bytes read.
+    size_t DecodeUtf8(const char* src, const char* end, char16_t*& dst)
+    {
+        const uint32_t b0 = (unsigned char) src[0];
+        uint32_t pt = 0;
+        size_t size = 0;
+        if (b0 >= 0xC0 && b0 < 0xE0 && IsContinuation(src + 1, end))
+        {
+            pt = (b0 & 0x1F) << 6 | (src[1] & 0x3F);
+            size = pt < 0x80 ? 0 : 2;
+        }
+        else if (b0 >= 0xE0 && b0 < 0xF0 && IsContinuation(src + 1, end) && IsContinuation(src + 2, end))
+        {
+            pt = (b0 & 0x0F) << 12 | (src[1] & 0x3F) << 6 | (src[2] & 0x3F);
+            size = pt < 0x800 ? 0 : 3;
+        }
+        else if (b0 >= 0xF0 && b0 < 0xF8 && IsContinuation(src + 1, end) && IsContinuation(src + 2, end) &&
+                 IsContinuation(src + 3, end))
+        {
+            pt = (b0 & 0x07) << 18 | (src[1] & 0x3F) << 12 | (src[2] & 0x3F) << 6 | (src[3] & 0x3F);
+            size = pt < 0x10000 || pt >= 0x110000 ? 0 : 4;
+        }
+
+        if (size == 0)
+        {
+            *dst++ = 0xFFFD;
+            return 1;
+        }
+
+        if (pt >= 0x10000)
+        {
+            *dst++ = (char16_t)(((pt - 0x10000) >> 10) + 0xD800);
+            *dst++ = (char16_t)((pt & 0x3FF) + 0xDC00);
+        }
+        else
+        {
+            *dst++ = (char16_t) pt;
+        }
+        return size;
+    }
+
+    // Encodes the UTF-16 code point at src into UTF-8 like miniutf::to_utf8: an unpaired surrogate is
+    // replaced by U+FFFD. Returns the number of code units read.
+    size_t EncodeUtf8(const char16_t* src, const char16_t* end, char*& dst)
+    {
+        uint32_t pt = src[0];
+        size_t size = 1;
+        if (pt >= 0xD800 && pt < 0xE000)
+        {
+            if (pt < 0xDC00 && src + 1 < end && src[1] >= 0xDC00 && src[1] < 0xE000)
+            {
+                pt = ((pt - 0xD800) << 10 | (src[1] - 0xDC00)) + 0x10000;
+                size = 2;
+            }
+            else
+            {
+                pt = 0xFFFD;
+            }
+        }
+
+        if (pt < 0x80)
+        {
+            *dst++ = (char) pt;
+        }
+        else if (pt < 0x800)
+        {
+            *dst++ = (char) (pt >> 6 | 0xC0);
+            *dst++ = (char) ((pt & 0x3F) | 0x80);
+        }
+        else if (pt < 0x10000)
+        {
+            *dst++ = (char) (pt >> 12 | 0xE0);
+            *dst++ = (char) ((pt >> 6 & 0x3F) | 0x80);
+            *dst++ = (char) ((pt & 0x3F) | 0x80);
+        }
+        else
+        {
+            *dst++ = (char) (pt >> 18 | 0xF0);
+            *dst++ = (char) ((pt >> 12 & 0x3F) | 0x80);
+            *dst++ = (char) ((pt >> 6 & 0x3F) | 0x80);
+            *dst++ = (char) ((pt & 0x3F) | 0x80);
+        }
+        return size;
+    }
+} // namespace
+#endif
+
 std::string ToString(const std::string& str)
 {
     return str;
@@ -38,8 +208,28 @@ std::string ToString(const WSTRING& wstr)
     WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int) wstr.size(), &strTo[0], size_needed, NULL, NULL);
     return strTo;
 #else
-    std::u16string ustr(reinterpret_cast<const char16_t*>(wstr.c_str()));
-    return miniutf::to_utf8(ustr);
+    // names are almost always ASCII: narrow them in place and only grow the string for the rest, a UTF-16
+    // code unit is at most 3 bytes of UTF-8
+    const auto* src = wstr.data();
+    const auto length = wstr.size();
+    std::string str(length, 0);
+    size_t read = NarrowAscii(src, length, &str[0]);
+    if (read == length)
+    {
+        return str;
+    }
+
+    str.resize(read + (length - read) * 3);
+    char* dst = &str[read];
+    while (read < length)
+    {
+        read += EncodeUtf8(src + read, src + length, dst);
+        const auto ascii = NarrowAscii(src + read, length - read, dst);
+        read += ascii;
+        dst += ascii;
+    }
+    str.resize(dst - str.data());
+    return str;
 #endif
 }
 
@@ -59,14 +249,38 @@ WSTRING ToWSTRING(const std::string& str)
     MultiByteToWideChar(CP_UTF8, 0, &str[0], (int) str.size(), &wstrTo[0], size_needed);
     return wstrTo;
 #else
-    auto ustr = miniutf::to_utf16(str);
-    return WSTRING(reinterpret_cast<const WCHAR*>(ustr.c_str()));
+    // a UTF-8 byte is at most one UTF-16 code unit
+    const auto* src = str.data();
+    const auto length = str.size();
+    WSTRING wstr(length, 0);
+    WCHAR* dst = &wstr[0];
+    size_t read = WidenAscii(src, length, dst);
+    if (read == length)
+    {
+        return wstr;
+    }
+
+    dst += read;
+    while (read < length)
+    {
+        read += DecodeUtf8(src + read, src + length, dst);
+        const auto ascii = WidenAscii(src + read, length - read, dst);
+        read += ascii;
+        dst += ascii;
+    }
+    wstr.resize(dst - wstr.data());
+    return wstr;
 #endif
 }
 
 WSTRING ToWSTRING(const uint64_t i)
 {
-    return WSTRING(reinterpret_cast<const WCHAR*>(std::to_wstring(i).c_str()));
+#ifdef _WIN32
+    return std::to_wstring(i);
+#else
+    // wchar_t is 4 bytes wide here, it can't be reinterpreted as a WSTRING
+    return ToWSTRING(std::to_string(i));
+#endif
 }
 
 } // namespace trace
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define DD_CLR_PROFILER_UTIL_H_
 
 #include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -122,6 +123,33 @@ public:
         queue_.pop();
         return value;
     }
+    // pops an item waiting until the deadline at most, returns nullptr if the queue is still empty
+    std::unique_ptr<T> pop(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> mlock(mutex_);
+        while (queue_.empty())
+        {
+            if (condition_.wait_until(mlock, deadline) == std::cv_status::timeout && queue_.empty())
+            {
+                return nullptr;
+            }
+        }
+        std::unique_ptr<T> value = std::move(queue_.front());
+        queue_.pop();
+        return value;
+    }
+    // pops an item without waiting, returns nullptr if the queue is empty
+    std::unique_ptr<T> try_pop()
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (queue_.empty())
+        {
+            return nullptr;
+        }
+        std::unique_ptr<T> value = std::move(queue_.front());
+        queue_.pop();
+        return value;
+    }
     void push(std::unique_ptr<T>&& item)
     {
         {
@@ -0,0 +1,75 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/assembly_classifier.h"
+
+using namespace trace;
+
+TEST(AssemblyClassifierTest, ClassifiesTheDefaultAssemblies) {
+  auto classifier = CreateDefaultAssemblyClassifier();
+  classifier.Add(WStr("System.Net.Http"), AssemblyKind::IntegrationTarget);
+  classifier.Add(WStr("System.Runtime.Caching"),
+                 AssemblyKind::IntegrationTarget);
+
+  EXPECT_EQ(AssemblyKind::Skipped, classifier.Classify(WStr("mscorlib")));
+  EXPECT_EQ(AssemblyKind::Skipped, classifier.Classify(WStr("System.Xml")));
+  EXPECT_EQ(AssemblyKind::Skipped,
+            classifier.Classify(WStr("System.Xml.Linq")));
+  EXPECT_EQ(AssemblyKind::Skipped,
+            classifier.Classify(WStr("Microsoft.Extensions.Logging")));
+  EXPECT_EQ(AssemblyKind::Profiler,
+            classifier.Classify(WStr("Datadog.Trace.ClrProfiler.Managed")));
+  EXPECT_EQ(AssemblyKind::Profiler,
+            classifier.Classify(
+                WStr("Datadog.Trace.ClrProfiler.Managed.Loader")));
+  EXPECT_EQ(AssemblyKind::IntegrationTarget,
+            classifier.Classify(WStr("System.Net.Http")));
+
+  // a skipped prefix wins over the target of an integration
+  EXPECT_EQ(AssemblyKind::Skipped,
+            classifier.Classify(WStr("System.Runtime.Caching")));
+
+  EXPECT_EQ(AssemblyKind::Other, classifier.Classify(WStr("")));
+  EXPECT_EQ(AssemblyKind::Other, classifier.Classify(WStr("System")));
+  EXPECT_EQ(AssemblyKind::Other, classifier.Classify(WStr("System.Net")));
+  EXPECT_EQ(AssemblyKind::Other,
+            classifier.Classify(WStr("System.Net.Http.Json")));
+  EXPECT_EQ(AssemblyKind::Other, classifier.Classify(WStr("Samples.App")));
+}
+
+TEST(AssemblyClassifierTest, AddsUserPatterns) {
+  auto classifier = CreateDefaultAssemblyClassifier();
+  classifier.Add(WStr("Legacy.Reporting"), AssemblyKind::IntegrationTarget);
+  classifier.AddSkippedPatterns(
+      {WStr("MyCompany.Generated.*"), WStr("Legacy.Reporting"), WStr(""),
+       WStr("*")});
+
+  EXPECT_EQ(AssemblyKind::Skipped,
+            classifier.Classify(WStr("MyCompany.Generated.Models")));
+  EXPECT_EQ(AssemblyKind::Skipped,
+            classifier.Classify(WStr("Legacy.Reporting")));
+  EXPECT_EQ(AssemblyKind::Other,
+            classifier.Classify(WStr("Legacy.Reporting.Pdf")));
+  EXPECT_EQ(AssemblyKind::Other,
+            classifier.Classify(WStr("MyCompany.Generated")));
+
+  // a skipped name stays skipped
+  classifier.Add(WStr("Legacy.Reporting"), AssemblyKind::IntegrationTarget);
+  EXPECT_EQ(AssemblyKind::Skipped,
+            classifier.Classify(WStr("Legacy.Reporting")));
+}
+
+TEST(AssemblyClassifierTest, GetsTheAssemblyNameOfAPath) {
+  const auto name = [](const WCHAR* path) {
+    size_t length;
+    const WCHAR* start = GetAssemblyNameFromPath(path, &length);
+    return WSTRING(start, length);
+  };
+
+  EXPECT_EQ(WStr("System.Net.Http"),
+            name(WStr("/usr/share/dotnet/System.Net.Http.dll")));
+  EXPECT_EQ(WStr("System.Web"),
+            name(WStr("C:\\Windows\\assembly\\NativeImages\\System.Web.ni.dll")));
+  EXPECT_EQ(WStr("Samples.App"), name(WStr("Samples.App")));
+  EXPECT_EQ(WStr("Samples.App.exe"), name(WStr("bin/Samples.App.exe")));
+  EXPECT_EQ(WStr(""), name(WStr("bin/")));
+}
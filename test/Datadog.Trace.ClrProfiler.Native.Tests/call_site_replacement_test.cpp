@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/cor_profiler.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/environment_variables.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/version.h"
+#include "fake_profiler_info.h"
+
+using namespace trace;
+
+namespace {
+
+const WSTRING kTargetType = WStr("Samples.FakeClient.Client");
+
+// Body of a static method calling the first method of the module the given
+// number of times in a row
+std::vector<BYTE> CreateConsecutiveCallsBody(int calls) {
+  std::vector<BYTE> body = {0};
+  for (int i = 0; i < calls; i++) {
+    body.insert(body.end(), {CEE_CALL, 0x01, 0x00, 0x00, 0x06});
+  }
+  body.push_back(CEE_RET);
+  body[0] = (BYTE)(((body.size() - 1) << 2) | CorILMethod_TinyFormat);
+  return body;
+}
+
+// Loads a module whose Main calls the target the given number of times in a
+// row, JIT compiles Main with the call site instrumentation, then prints how
+// many calls go to the wrapper and how many still go to the target.
+//
+// Runs in a new process: CallTarget is read once per process, and the other
+// profiler tests enable it.
+void RewriteConsecutiveCalls(int calls) {
+  const auto integrations_file =
+      std::filesystem::temp_directory_path() / "call-site-replacement-test.json";
+  std::ofstream f(integrations_file);
+  // the second replacement targets another overload of the same method
+  f << R"TEXT(
+      [{
+          "name": "fake-client",
+          "method_replacements": [{
+              "caller": { },
+              "target": { "assembly": "Samples.FakeClient", "type": "Samples.FakeClient.Client", "method": "Send", "signature_types": ["System.Void"], "minimum_major": 1, "maximum_major": 1 },
+              "wrapper": { "assembly": "Datadog.Trace.ClrProfiler.Managed, Version=1.28.1.0, Culture=neutral, PublicKeyToken=def86d061d0d2eeb", "type": "Datadog.Trace.ClrProfiler.Integrations.FakeClientIntegration", "method": "Send", "signature": "00 03 01 08 08 0A", "action": "ReplaceTargetMethod" }
+          },{
+              "caller": { },
+              "target": { "assembly": "Samples.FakeClient", "type": "Samples.FakeClient.Client", "method": "Send", "signature_types": ["System.Int32"], "minimum_major": 1, "maximum_major": 1 },
+              "wrapper": { "assembly": "Datadog.Trace.ClrProfiler.Managed, Version=1.28.1.0, Culture=neutral, PublicKeyToken=def86d061d0d2eeb", "type": "Datadog.Trace.ClrProfiler.Integrations.FakeClientIntegration", "method": "SendOther", "signature": "00 03 01 08 08 0A", "action": "ReplaceTargetMethod" }
+          }]
+      }]
+  )TEXT";
+  f.close();
+
+  SetEnvironmentVariableW(environment::integrations_path.data(),
+                          integrations_file.wstring().data());
+  SetEnvironmentVariableW(environment::calltarget_enabled.data(), L"false");
+
+  FakeProfilerInfo info;
+  CorProfiler* profiler = new CorProfiler();
+  profiler->AddRef();
+  if (profiler->Initialize(&info) != S_OK) {
+    std::exit(1);
+  }
+
+  FakeModuleDefinition corlib;
+  corlib.assembly = {WStr("System.Private.CoreLib"), 5, 0, 0, 0};
+  profiler->ModuleLoadFinished(info.AddModule(corlib), S_OK);
+
+  // with the loader already in the AppDomain, Main doesn't get the startup
+  // hook
+  FakeModuleDefinition loader;
+  loader.assembly.name = WStr("Datadog.Trace.ClrProfiler.Managed.Loader");
+  profiler->ModuleLoadFinished(info.AddModule(loader, 2), S_OK);
+
+  FakeModuleDefinition managed_profiler;
+  managed_profiler.assembly.name = WStr("Datadog.Trace.ClrProfiler.Managed");
+  sscanf(PROFILER_VERSION, "%hu.%hu.%hu", &managed_profiler.assembly.major,
+         &managed_profiler.assembly.minor, &managed_profiler.assembly.build);
+  // the fake uses the ModuleID as the AssemblyID
+  const ModuleID managed_profiler_id = info.AddModule(managed_profiler, 2);
+  profiler->AssemblyLoadFinished(managed_profiler_id, S_OK);
+  profiler->ModuleLoadFinished(managed_profiler_id, S_OK);
+
+  FakeModuleDefinition module;
+  module.assembly = {WStr("Samples.FakeClient"), 1, 0, 0, 0};
+  module.references = {{WStr("System.Runtime"), 5, 0, 0, 0}};
+  FakeTypeDefinition type;
+  type.name = kTargetType;
+  // Send is the first method, token 0x06000001
+  type.methods = {
+      {WStr("Send"), {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}, {}},
+      {WStr("Main"),
+       {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID},
+       CreateConsecutiveCallsBody(calls)},
+  };
+  module.types.push_back(type);
+  const ModuleID module_id = info.AddModule(module, 2);
+  profiler->ModuleLoadFinished(module_id, S_OK);
+
+  const mdMethodDef main =
+      info.GetMetadata(module_id)->GetMethodDef(kTargetType, WStr("Main"));
+  profiler->JITCompilationStarted(
+      FakeProfilerInfo::GetFunctionId(module_id, main), true);
+
+  // the wrappers are MemberRefs, the target a MethodDef
+  const auto rewritten = info.GetRewrittenBody(module_id, main);
+  int wrapper_calls = 0;
+  int target_calls = 0;
+  for (size_t i = 0; i + 4 < rewritten.size(); i++) {
+    if (rewritten[i] == CEE_CALL && rewritten[i + 4] == 0x0A) {
+      wrapper_calls++;
+    } else if (rewritten[i] == CEE_CALL && rewritten[i + 1] == 0x01 &&
+               rewritten[i + 4] == 0x06) {
+      target_calls++;
+    }
+  }
+
+  profiler->Shutdown();
+  profiler->Release();
+  std::filesystem::remove(integrations_file);
+
+  fprintf(stderr, "%d wrapper calls, %d target calls\n", wrapper_calls,
+          target_calls);
+  std::exit(0);
+}
+
+}  // namespace
+
+TEST(CallSiteReplacementTest, ReplacesConsecutiveCalls) {
+  // re-executes the test binary rather than forking it, so the environment
+  // variables of the profiler are read again
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(RewriteConsecutiveCalls(10), ::testing::ExitedWithCode(0),
+              "10 wrapper calls, 0 target calls");
+}
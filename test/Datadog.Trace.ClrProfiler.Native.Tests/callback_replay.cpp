@@ -0,0 +1,143 @@
+#include "callback_replay.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace trace {
+
+namespace {
+
+void AddMethodRid(std::unordered_map<ModuleID, ULONG>& method_rids,
+                  ModuleID module_id, mdToken token) {
+  if (module_id == 0 || TypeFromToken(token) != mdtMethodDef) {
+    return;
+  }
+  auto& rid = method_rids[module_id];
+  rid = std::max(rid, RidFromToken(token));
+}
+
+FakeModuleDefinition CreateModule(const CallbackTraceEvent& module_load,
+                                  ULONG method_rids) {
+  FakeModuleDefinition module;
+  module.assembly = {module_load.assembly_name,
+                     module_load.assembly_version[0],
+                     module_load.assembly_version[1],
+                     module_load.assembly_version[2],
+                     module_load.assembly_version[3]};
+  module.mvid = module_load.module_version_id;
+
+  // the methods get the rid they had in the recorded process
+  FakeTypeDefinition type;
+  type.name = module_load.assembly_name + WStr(".Replay");
+  for (ULONG rid = 1; rid <= method_rids; rid++) {
+    type.methods.push_back({WStr("Method") + ToWSTRING((uint64_t)rid),
+                            {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0,
+                             ELEMENT_TYPE_VOID},
+                            {}});
+  }
+  module.types.push_back(std::move(type));
+  return module;
+}
+
+}  // namespace
+
+CallbackReplay::CallbackReplay(std::vector<CallbackTraceEvent> events,
+                               FakeProfilerInfo& info,
+                               IMetaDataDispenser* dispenser)
+    : events_(std::move(events)) {
+  std::unordered_map<ModuleID, ULONG> method_rids;
+  for (const auto& event : events_) {
+    AddMethodRid(method_rids, event.module_id, event.token);
+    AddMethodRid(method_rids, event.callee_module_id, event.callee_token);
+  }
+
+  for (const auto& event : events_) {
+    if (event.type != CallbackTraceEventType::ModuleLoadFinished ||
+        FAILED(event.hr_status) || event.assembly_name.empty()) {
+      continue;
+    }
+
+    ModuleID module_id = 0;
+    if (dispenser != nullptr && !event.module_path.empty()) {
+      ComPtr<IUnknown> metadata;
+      if (SUCCEEDED(dispenser->OpenScope(event.module_path.c_str(),
+                                         ofRead | ofWrite,
+                                         IID_IMetaDataImport2,
+                                         metadata.GetAddressOf()))) {
+        module_id = info.AddModule(event.assembly_name, metadata,
+                                   event.app_domain_id);
+      }
+    }
+
+    if (module_id == 0) {
+      module_id = info.AddModule(
+          CreateModule(event, method_rids[event.module_id]),
+          event.app_domain_id);
+    }
+
+    if (module_id != 0) {
+      modules_[event.module_id] = module_id;
+    }
+  }
+}
+
+ModuleID CallbackReplay::GetModuleId(ModuleID recorded_module_id) const {
+  const auto it = modules_.find(recorded_module_id);
+  return it != modules_.end() ? it->second : 0;
+}
+
+void CallbackReplay::Run(ICorProfilerCallback4* profiler) const {
+  for (const auto& event : events_) {
+    const ModuleID module_id = GetModuleId(event.module_id);
+
+    switch (event.type) {
+      case CallbackTraceEventType::ModuleLoadFinished:
+        if (FAILED(event.hr_status)) {
+          profiler->ModuleLoadFinished(0, event.hr_status);
+        } else if (module_id != 0) {
+          profiler->ModuleLoadFinished(module_id, S_OK);
+        }
+        break;
+
+      case CallbackTraceEventType::AssemblyLoadFinished:
+        // the fake uses the ModuleID of the manifest module as the AssemblyID
+        if (FAILED(event.hr_status)) {
+          profiler->AssemblyLoadFinished(0, event.hr_status);
+        } else if (module_id != 0) {
+          profiler->AssemblyLoadFinished(module_id, S_OK);
+        }
+        break;
+
+      case CallbackTraceEventType::JITCompilationStarted:
+        if (module_id != 0) {
+          profiler->JITCompilationStarted(
+              FakeProfilerInfo::GetFunctionId(module_id, event.token),
+              event.is_safe_to_block);
+        }
+        break;
+
+      case CallbackTraceEventType::GetReJITParameters:
+        if (module_id != 0) {
+          FakeFunctionControl function_control;
+          profiler->GetReJITParameters(module_id, event.token,
+                                       &function_control);
+        }
+        break;
+
+      case CallbackTraceEventType::JITInlining: {
+        const ModuleID callee_module_id = GetModuleId(event.callee_module_id);
+        if (module_id != 0 && callee_module_id != 0) {
+          BOOL should_inline = TRUE;
+          profiler->JITInlining(
+              FakeProfilerInfo::GetFunctionId(module_id, event.token),
+              FakeProfilerInfo::GetFunctionId(callee_module_id,
+                                              event.callee_token),
+              &should_inline);
+        }
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace trace
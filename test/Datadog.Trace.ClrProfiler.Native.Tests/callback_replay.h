@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cor.h>
+#include <corprof.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/callback_trace.h"
+#include "fake_profiler_info.h"
+
+namespace trace {
+
+// CallbackReplay runs the callbacks recorded by CallbackTraceWriter (see
+// DD_CLR_CALLBACK_TRACE_PATH) against a profiler, on the current thread and in
+// the recorded order.
+//
+// Every module of the trace is registered in the FakeProfilerInfo. When a
+// metadata dispenser is given, a module whose file still exists is opened from
+// disk, so the profiler sees its real types and methods. Otherwise the module
+// gets synthetic metadata with the recorded assembly name, version and MVID,
+// and one type whose methods are named after their token, one for each token
+// used in the trace.
+class CallbackReplay {
+ public:
+  CallbackReplay(std::vector<CallbackTraceEvent> events, FakeProfilerInfo& info,
+                 IMetaDataDispenser* dispenser = nullptr);
+
+  // Delivers the recorded callbacks to the profiler. Events of modules that
+  // couldn't be registered are skipped.
+  void Run(ICorProfilerCallback4* profiler) const;
+
+  size_t GetEventCount() const { return events_.size(); }
+
+  // Returns the ModuleID a recorded module is registered with, or 0
+  ModuleID GetModuleId(ModuleID recorded_module_id) const;
+
+ private:
+  std::vector<CallbackTraceEvent> events_;
+  std::unordered_map<ModuleID, ModuleID> modules_;
+};
+
+}  // namespace trace
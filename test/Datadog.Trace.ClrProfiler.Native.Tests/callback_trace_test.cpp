@@ -0,0 +1,203 @@
+#include "pch.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/callback_trace.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/cor_profiler.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/environment_variables.h"
+#include "callback_replay.h"
+#include "fake_profiler_info.h"
+
+using namespace trace;
+
+namespace {
+
+FakeModuleDefinition CreateModule(const WSTRING& assembly_name) {
+  FakeModuleDefinition module;
+  module.assembly = {assembly_name, 1, 2, 3, 4};
+  module.mvid.Data1 = 42;
+
+  FakeTypeDefinition type;
+  type.name = assembly_name + WStr(".Program");
+  type.methods = {
+      {WStr("Main"), {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}, {}},
+      {WStr("Run"), {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}, {}},
+  };
+  module.types.push_back(type);
+  return module;
+}
+
+std::filesystem::path GetTracePath() {
+  return std::filesystem::temp_directory_path() / "callback-trace-test.bin";
+}
+
+WSTRING GetTraceFile() { return ToWSTRING(GetTracePath().string()); }
+
+}  // namespace
+
+TEST(CallbackTraceTest, RoundTripsEvents) {
+  FakeProfilerInfo info;
+  const ModuleID module_id =
+      info.AddModule(CreateModule(WStr("Samples.Console")), 7);
+  const mdMethodDef main = info.GetMetadata(module_id)->GetMethodDef(
+      WStr("Samples.Console.Program"), WStr("Main"));
+  const mdMethodDef run = info.GetMetadata(module_id)->GetMethodDef(
+      WStr("Samples.Console.Program"), WStr("Run"));
+
+  {
+    CallbackTraceWriter writer(GetTraceFile());
+    ASSERT_TRUE(writer.IsOpen());
+    writer.RecordModuleLoadFinished(&info, module_id, S_OK);
+    writer.RecordModuleLoadFinished(&info, 99, E_FAIL);
+    writer.RecordAssemblyLoadFinished(&info, module_id, S_OK);
+    writer.RecordJITCompilationStarted(
+        &info, FakeProfilerInfo::GetFunctionId(module_id, main), TRUE);
+    writer.RecordGetReJITParameters(module_id, run);
+    writer.RecordJITInlining(&info,
+                             FakeProfilerInfo::GetFunctionId(module_id, main),
+                             FakeProfilerInfo::GetFunctionId(module_id, run));
+  }
+
+  std::vector<CallbackTraceEvent> events;
+  ASSERT_TRUE(ReadCallbackTrace(GetTraceFile(), events));
+  ASSERT_EQ(6, events.size());
+
+  EXPECT_EQ(CallbackTraceEventType::ModuleLoadFinished, events[0].type);
+  EXPECT_EQ(module_id, events[0].module_id);
+  EXPECT_EQ(7, events[0].app_domain_id);
+  EXPECT_EQ(WStr("Samples.Console"), events[0].assembly_name);
+  EXPECT_EQ(WStr("Samples.Console.dll"), events[0].module_path);
+  EXPECT_EQ(42, events[0].module_version_id.Data1);
+  EXPECT_EQ(1, events[0].assembly_version[0]);
+  EXPECT_EQ(4, events[0].assembly_version[3]);
+
+  EXPECT_EQ(CallbackTraceEventType::ModuleLoadFinished, events[1].type);
+  EXPECT_EQ(E_FAIL, events[1].hr_status);
+  EXPECT_TRUE(events[1].assembly_name.empty());
+
+  EXPECT_EQ(CallbackTraceEventType::AssemblyLoadFinished, events[2].type);
+  EXPECT_EQ(module_id, events[2].module_id);
+
+  EXPECT_EQ(CallbackTraceEventType::JITCompilationStarted, events[3].type);
+  EXPECT_EQ(module_id, events[3].module_id);
+  EXPECT_EQ(main, events[3].token);
+  EXPECT_EQ(TRUE, events[3].is_safe_to_block);
+
+  EXPECT_EQ(CallbackTraceEventType::GetReJITParameters, events[4].type);
+  EXPECT_EQ(run, events[4].token);
+
+  EXPECT_EQ(CallbackTraceEventType::JITInlining, events[5].type);
+  EXPECT_EQ(main, events[5].token);
+  EXPECT_EQ(module_id, events[5].callee_module_id);
+  EXPECT_EQ(run, events[5].callee_token);
+
+  for (size_t i = 1; i < events.size(); i++) {
+    EXPECT_LE(events[i - 1].timestamp, events[i].timestamp);
+    EXPECT_EQ(events[0].thread, events[i].thread);
+  }
+
+  std::filesystem::remove(GetTracePath());
+}
+
+TEST(CallbackTraceTest, KeepsTheEventsOfATruncatedTrace) {
+  FakeProfilerInfo info;
+  const ModuleID module_id =
+      info.AddModule(CreateModule(WStr("Samples.Console")));
+  {
+    CallbackTraceWriter writer(GetTraceFile());
+    writer.RecordModuleLoadFinished(&info, module_id, S_OK);
+    writer.RecordGetReJITParameters(module_id, 0x06000001);
+  }
+  std::filesystem::resize_file(GetTracePath(),
+                               std::filesystem::file_size(GetTracePath()) - 1);
+
+  std::vector<CallbackTraceEvent> events;
+  EXPECT_TRUE(ReadCallbackTrace(GetTraceFile(), events));
+  EXPECT_EQ(1, events.size());
+
+  std::filesystem::remove(GetTracePath());
+}
+
+TEST(CallbackTraceTest, RejectsOtherFiles) {
+  std::ofstream f(GetTracePath());
+  f << "not a trace";
+  f.close();
+
+  std::vector<CallbackTraceEvent> events;
+  EXPECT_FALSE(ReadCallbackTrace(GetTraceFile(), events));
+  EXPECT_FALSE(ReadCallbackTrace(L"missing-file", events));
+
+  std::filesystem::remove(GetTracePath());
+}
+
+TEST(CallbackTraceTest, ReplaysARecordedStartup) {
+  const auto integrations_path =
+      std::filesystem::temp_directory_path() / "callback-trace-test.json";
+  std::ofstream f(integrations_path);
+  f << R"TEXT(
+        [{
+            "name": "fake-client",
+            "method_replacements": [{
+                "caller": { },
+                "target": { "assembly": "Samples.FakeClient", "type": "Samples.FakeClient.Client", "method": "Send", "signature_types": ["System.Void"], "minimum_major": 1, "maximum_major": 1 },
+                "wrapper": { "assembly": "Datadog.Trace.ClrProfiler.Managed, Version=1.28.1.0, Culture=neutral, PublicKeyToken=def86d061d0d2eeb", "type": "Datadog.Trace.ClrProfiler.Integrations.FakeClientIntegration", "action": "CallTargetModification" }
+            }]
+        }]
+    )TEXT";
+  f.close();
+  SetEnvironmentVariableW(environment::integrations_path.data(),
+                          integrations_path.wstring().data());
+  SetEnvironmentVariableW(environment::calltarget_enabled.data(), L"true");
+
+  FakeModuleDefinition corlib;
+  corlib.assembly = {WStr("System.Private.CoreLib"), 5, 0, 0, 0};
+
+  // record the startup of an application
+  SetEnvironmentVariableW(environment::callback_trace_path.data(),
+                          GetTracePath().wstring().data());
+  {
+    FakeProfilerInfo info;
+    const ModuleID module_id =
+        info.AddModule(CreateModule(WStr("Samples.Console")), 2);
+    const mdMethodDef main = info.GetMetadata(module_id)->GetMethodDef(
+        WStr("Samples.Console.Program"), WStr("Main"));
+
+    auto profiler = new CorProfiler();
+    profiler->AddRef();
+    ASSERT_EQ(S_OK, profiler->Initialize(&info));
+    profiler->ModuleLoadFinished(info.AddModule(corlib), S_OK);
+    profiler->ModuleLoadFinished(module_id, S_OK);
+    profiler->JITCompilationStarted(
+        FakeProfilerInfo::GetFunctionId(module_id, main), TRUE);
+    profiler->Shutdown();
+    profiler->Release();
+  }
+  SetEnvironmentVariableW(environment::callback_trace_path.data(), nullptr);
+
+  std::vector<CallbackTraceEvent> events;
+  ASSERT_TRUE(ReadCallbackTrace(GetTraceFile(), events));
+  ASSERT_EQ(3, events.size());
+
+  // replay it against a new profiler, the startup hook is inserted in the
+  // same method
+  FakeProfilerInfo info;
+  CallbackReplay replay(events, info);
+  auto profiler = new CorProfiler();
+  profiler->AddRef();
+  ASSERT_EQ(S_OK, profiler->Initialize(&info));
+  replay.Run(profiler);
+
+  const ModuleID module_id = replay.GetModuleId(events[1].module_id);
+  ASSERT_NE(0, module_id);
+  EXPECT_FALSE(info.GetRewrittenBody(module_id, events[2].token).empty());
+
+  profiler->Shutdown();
+  profiler->Release();
+
+  SetEnvironmentVariableW(environment::integrations_path.data(), nullptr);
+  SetEnvironmentVariableW(environment::calltarget_enabled.data(), nullptr);
+  std::filesystem::remove(integrations_path);
+  std::filesystem::remove(GetTracePath());
+}
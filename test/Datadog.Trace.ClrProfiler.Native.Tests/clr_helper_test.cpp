@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "../../src/Datadog.Trace.ClrProfiler.Native/clr_helpers.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/metadata_cache.h"
 #include "test_helpers.h"
 
 using namespace trace;
@@ -107,7 +108,7 @@ TEST_F(CLRHelperTest, FiltersIntegrationsByCaller) {
   AppDomainID app_domain_id{};
   trace::AssemblyInfo assembly_info = { 1, L"Assembly.One", manifest_module_id,  app_domain_id, L"AppDomain1"};
   auto actual = FilterIntegrationsByCaller(all, assembly_info);
-  EXPECT_EQ(actual, expected);
+  EXPECT_EQ(Dereference(actual), expected);
 }
 
 TEST_F(CLRHelperTest, FiltersIntegrationsByTarget) {
@@ -132,8 +133,8 @@ TEST_F(CLRHelperTest, FiltersIntegrationsByTarget) {
       {{{}, {L"System.Runtime", L"", L"", L"ReplaceTargetMethod", min_ver_, max_ver_, {}, empty_sig_type_}, {}}}};
   auto all = FlattenIntegrations({i1, i2, i3}, false);
   auto expected = FlattenIntegrations({i1, i3}, false);
-  auto actual = FilterIntegrationsByTarget(all, assembly_import_);
-  EXPECT_EQ(actual, expected);
+  auto actual = FilterIntegrationsByTarget(References(all), assembly_import_);
+  EXPECT_EQ(Dereference(actual), expected);
 }
 
 TEST_F(CLRHelperTest, FiltersFlattenedIntegrationMethodsByTargetAssembly) {
@@ -189,10 +190,10 @@ TEST_F(CLRHelperTest, FiltersFlattenedIntegrationMethodsByTarget) {
 
   Integration i1 = {L"integration-1", {{{}, included, {}}, {{}, excluded, {}}}};
   auto all = FlattenIntegrations({i1}, false);
-  auto filtered = FilterIntegrationsByTarget(all, assembly_import_);
+  auto filtered = FilterIntegrationsByTarget(References(all), assembly_import_);
   bool foundExclusion = false;
-  for (auto& item : filtered) {
-    if (item.replacement.target_method == excluded) {
+  for (auto item : filtered) {
+    if (item->replacement.target_method == excluded) {
       foundExclusion = true;
     }
   }
@@ -323,6 +324,50 @@ TEST_F(CLRHelperTest, GetsTypeInfoFromMethods) {
   EXPECT_EQ(actual, expected);
 }
 
+TEST_F(CLRHelperTest, MetadataCacheReturnsTheSameTypeInfo) {
+  MetadataCache cache(metadata_import_);
+  for (auto& type_def : EnumTypeDefs(metadata_import_)) {
+    auto type_info = cache.GetTypeInfo(type_def);
+    EXPECT_EQ(type_info, cache.GetTypeInfo(type_def));
+    EXPECT_EQ(GetTypeInfo(metadata_import_, type_def).name, type_info->name);
+  }
+
+  auto type_defs = EnumTypeDefs(metadata_import_);
+  auto type_def = *type_defs.begin();
+  auto type_info = cache.GetTypeInfo(type_def);
+  cache.Clear();
+  auto new_type_info = cache.GetTypeInfo(type_def);
+  EXPECT_NE(type_info, new_type_info);
+  EXPECT_EQ(type_info->name, new_type_info->name);
+}
+
+TEST_F(CLRHelperTest, MetadataCacheResolvesRelatedTypesOnDemand) {
+  MetadataCache cache(metadata_import_);
+  bool found_value_type = false;
+  for (auto& type_def : EnumTypeDefs(metadata_import_)) {
+    auto type_info = cache.GetTypeInfo(type_def);
+
+    mdToken parent_token = mdTokenNil;
+    metadata_import_->GetNestedClassProps(type_def, &parent_token);
+    auto parent_type = cache.GetParentType(*type_info);
+    if (parent_token == mdTokenNil) {
+      EXPECT_EQ(nullptr, parent_type);
+    } else {
+      ASSERT_NE(nullptr, parent_type);
+      EXPECT_EQ(parent_token, parent_type->id);
+    }
+
+    if (type_info->name == L"Samples.ExampleLibrary.GenericTests.PointStruct") {
+      auto extend_from = cache.GetExtendFrom(*type_info);
+      ASSERT_NE(nullptr, extend_from);
+      EXPECT_EQ(L"System.ValueType", extend_from->name);
+      EXPECT_TRUE(type_info->valueType);
+      found_value_type = true;
+    }
+  }
+  EXPECT_TRUE(found_value_type);
+}
+
 TEST_F(CLRHelperTest,
        ReturnTypeIsValueTypeOrGenericReturnsCorrectlyForMethodDefs) {
   std::set<std::pair<std::wstring, std::wstring>> expected = {
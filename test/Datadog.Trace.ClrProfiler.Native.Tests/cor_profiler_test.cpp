@@ -0,0 +1,450 @@
+#include "pch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/cor_profiler.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/environment_variables.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/version.h"
+#include "fake_profiler_info.h"
+
+using namespace trace;
+
+namespace {
+
+const WSTRING kTargetAssembly = WStr("Samples.FakeClient");
+const WSTRING kTargetType = WStr("Samples.FakeClient.Client");
+const WSTRING kTargetMethod = WStr("Send");
+
+using ReJITRequest = std::pair<ModuleID, mdMethodDef>;
+
+FakeModuleDefinition CreateModule(const WSTRING& assembly_name,
+                                  unsigned long index) {
+  FakeModuleDefinition module;
+  module.assembly = {assembly_name, 1, 0, 0, 0};
+  module.mvid.Data1 = index;
+  module.references = {{WStr("System.Runtime"), 5, 0, 0, 0}};
+
+  FakeTypeDefinition type;
+  type.name = assembly_name == kTargetAssembly
+                  ? kTargetType
+                  : assembly_name + WStr(".Program");
+  type.methods = {
+      {kTargetMethod,
+       {IMAGE_CEE_CS_CALLCONV_HASTHIS, 0, ELEMENT_TYPE_VOID},
+       {}},
+      {WStr("Main"), {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}, {}},
+  };
+  module.types.push_back(type);
+  return module;
+}
+
+// Writes a CallTarget integration of Samples.FakeClient.Client.Send
+void WriteIntegrationsFile(const std::filesystem::path& path) {
+  std::ofstream f(path);
+  f << R"TEXT(
+      [{
+          "name": "fake-client",
+          "method_replacements": [{
+              "caller": { },
+              "target": { "assembly": "Samples.FakeClient", "type": "Samples.FakeClient.Client", "method": "Send", "signature_types": ["System.Void"], "minimum_major": 1, "minimum_minor": 0, "minimum_patch": 0, "maximum_major": 1, "maximum_minor": 65535, "maximum_patch": 65535 },
+              "wrapper": { "assembly": "Datadog.Trace.ClrProfiler.Managed, Version=1.28.1.0, Culture=neutral, PublicKeyToken=def86d061d0d2eeb", "type": "Datadog.Trace.ClrProfiler.Integrations.FakeClientIntegration", "action": "CallTargetModification" }
+          }]
+      }]
+  )TEXT";
+}
+
+class CorProfilerTest : public ::testing::Test {
+ protected:
+  std::filesystem::path integrations_file_ =
+      std::filesystem::temp_directory_path() / "cor-profiler-test.json";
+  FakeProfilerInfo info_;
+  CorProfiler* profiler_ = nullptr;
+
+  void SetUp() override {
+    WriteIntegrationsFile(integrations_file_);
+    SetEnvironmentVariableW(environment::integrations_path.data(),
+                            integrations_file_.wstring().data());
+    SetEnvironmentVariableW(environment::calltarget_enabled.data(), L"true");
+
+    profiler_ = new CorProfiler();
+    profiler_->AddRef();
+    ASSERT_EQ(S_OK, profiler_->Initialize(&info_));
+
+    FakeModuleDefinition corlib;
+    corlib.assembly = {WStr("System.Private.CoreLib"), 5, 0, 0, 0};
+    ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(info_.AddModule(corlib), S_OK));
+  }
+
+  void TearDown() override {
+    if (profiler_ != nullptr) {
+      profiler_->Shutdown();
+      profiler_->Release();
+    }
+
+    SetEnvironmentVariableW(environment::integrations_path.data(), nullptr);
+    SetEnvironmentVariableW(environment::calltarget_enabled.data(), nullptr);
+    std::filesystem::remove(integrations_file_);
+  }
+
+  // Loads the managed profiler into an AppDomain, CallTarget only rewrites
+  // methods once it is there
+  void LoadManagedProfiler(AppDomainID app_domain_id) {
+    FakeModuleDefinition managed_profiler;
+    managed_profiler.assembly.name = WStr("Datadog.Trace.ClrProfiler.Managed");
+    sscanf(PROFILER_VERSION, "%hu.%hu.%hu", &managed_profiler.assembly.major,
+           &managed_profiler.assembly.minor, &managed_profiler.assembly.build);
+
+    // the fake uses the ModuleID as the AssemblyID
+    const ModuleID module_id = info_.AddModule(managed_profiler, app_domain_id);
+    ASSERT_EQ(S_OK, profiler_->AssemblyLoadFinished(module_id, S_OK));
+    ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+  }
+
+  // Waits for the ReJIT of the given number of methods to be requested
+  std::vector<ReJITRequest> WaitForReJITRequests(size_t count) {
+    std::vector<ReJITRequest> requests;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (requests.size() < count &&
+           std::chrono::steady_clock::now() < deadline) {
+      for (auto&& request : info_.TakeReJITRequests()) {
+        requests.push_back(request);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return requests;
+  }
+
+  bool JITCompilationEventsEnabled() {
+    DWORD event_mask = 0;
+    info_.GetEventMask(&event_mask);
+    return (event_mask & COR_PRF_MONITOR_JIT_COMPILATION) != 0;
+  }
+
+  // Calls JITCompilationStarted for a method of the module
+  void JITCompile(ModuleID module_id, const WSTRING& type_name,
+                  const WSTRING& method_name) {
+    const mdMethodDef method_def =
+        info_.GetMetadata(module_id)->GetMethodDef(type_name, method_name);
+    EXPECT_EQ(S_OK,
+              profiler_->JITCompilationStarted(
+                  FakeProfilerInfo::GetFunctionId(module_id, method_def), true));
+  }
+};
+
+// Runs the profiler with the ReJIT plan cache in an empty directory
+class CorProfilerPlanCacheTest : public CorProfilerTest {
+ protected:
+  std::filesystem::path plan_directory_ =
+      std::filesystem::temp_directory_path() / "cor-profiler-plan-cache-test";
+
+  void SetUp() override {
+    std::filesystem::remove_all(plan_directory_);
+    std::filesystem::create_directories(plan_directory_);
+    SetEnvironmentVariableW(environment::rejit_plan_cache_directory.data(),
+                            plan_directory_.wstring().data());
+    CorProfilerTest::SetUp();
+  }
+
+  void TearDown() override {
+    CorProfilerTest::TearDown();
+    SetEnvironmentVariableW(environment::rejit_plan_cache_directory.data(),
+                            nullptr);
+    std::filesystem::remove_all(plan_directory_);
+  }
+
+  size_t CountPlans() {
+    return std::distance(std::filesystem::directory_iterator(plan_directory_),
+                         std::filesystem::directory_iterator());
+  }
+
+  // Loads the target module, whose plan gets stored, and returns the
+  // requested ReJIT
+  std::vector<ReJITRequest> LoadTargetModule() {
+    const ModuleID module_id =
+        info_.AddModule(CreateModule(kTargetAssembly, 1), 2);
+    EXPECT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+    return WaitForReJITRequests(1);
+  }
+};
+
+// Starts the profiler in CallTarget mode with or without DD_CLR_ENABLE_NGEN,
+// then prints whether the runtime keeps the native images and, when it
+// searches them, which methods of a module may be taken from them.
+//
+// Runs in a new process: DD_CLR_ENABLE_NGEN is read once per process.
+void SearchPrecompiledMethods(bool enable_ngen) {
+  const auto integrations_file =
+      std::filesystem::temp_directory_path() / "cor-profiler-ngen-test.json";
+  WriteIntegrationsFile(integrations_file);
+  SetEnvironmentVariableW(environment::integrations_path.data(),
+                          integrations_file.wstring().data());
+  SetEnvironmentVariableW(environment::calltarget_enabled.data(), L"true");
+  SetEnvironmentVariableW(environment::clr_enable_ngen.data(),
+                          enable_ngen ? L"true" : nullptr);
+
+  FakeProfilerInfo info;
+  CorProfiler* profiler = new CorProfiler();
+  profiler->AddRef();
+  if (profiler->Initialize(&info) != S_OK) {
+    std::exit(1);
+  }
+
+  DWORD event_mask = 0;
+  info.GetEventMask(&event_mask);
+  const bool searches = (event_mask & COR_PRF_MONITOR_CACHE_SEARCHES) != 0;
+  fprintf(stderr, "native images %s, cache searches %s",
+          (event_mask & COR_PRF_DISABLE_ALL_NGEN_IMAGES) != 0 ? "disabled"
+                                                              : "kept",
+          searches ? "monitored" : "not monitored");
+
+  if (searches) {
+    FakeModuleDefinition corlib;
+    corlib.assembly = {WStr("System.Private.CoreLib"), 5, 0, 0, 0};
+    profiler->ModuleLoadFinished(info.AddModule(corlib), S_OK);
+
+    const WSTRING program = WStr("Samples.Console.Program");
+    const ModuleID module_id =
+        info.AddModule(CreateModule(WStr("Samples.Console"), 1), 3);
+    profiler->ModuleLoadFinished(module_id, S_OK);
+    const auto function_id = [&](const WSTRING& method_name) {
+      return FakeProfilerInfo::GetFunctionId(
+          module_id,
+          info.GetMetadata(module_id)->GetMethodDef(program, method_name));
+    };
+    const auto search = [&](const WSTRING& method_name) {
+      BOOL use_cached_function = TRUE;
+      profiler->JITCachedFunctionSearchStarted(function_id(method_name),
+                                               &use_cached_function);
+      return use_cached_function ? "precompiled" : "JIT compiled";
+    };
+
+    // the first method is JIT compiled to insert the startup hook
+    const auto main = search(WStr("Main"));
+    profiler->JITCompilationStarted(function_id(WStr("Main")), true);
+    fprintf(stderr, ", Main %s, Send %s", main, search(kTargetMethod));
+  }
+  fprintf(stderr, "\n");
+
+  profiler->Shutdown();
+  profiler->Release();
+  std::filesystem::remove(integrations_file);
+  std::exit(0);
+}
+
+}  // namespace
+
+TEST_F(CorProfilerTest, RequestsReJITOfTargetsLoadedConcurrently) {
+  const int kThreads = 16;
+  const int kModulesPerThread = 8;
+
+  std::vector<ModuleID> modules;
+  std::set<ReJITRequest> expected;
+  for (int i = 0; i < kThreads * kModulesPerThread; i++) {
+    // every target is loaded in its own AppDomain, like a plugin
+    const bool is_target = i % 4 == 0;
+    const auto definition = CreateModule(
+        is_target ? kTargetAssembly
+                  : WStr("Samples.Module.") + ToWSTRING(std::to_string(i)),
+        i);
+    const ModuleID module_id =
+        info_.AddModule(definition, is_target ? 100 + i : 1);
+    modules.push_back(module_id);
+
+    if (is_target) {
+      expected.emplace(module_id, info_.GetMetadata(module_id)->GetMethodDef(
+                                      kTargetType, kTargetMethod));
+    }
+  }
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = t; i < (int)modules.size(); i += kThreads) {
+        EXPECT_EQ(S_OK, profiler_->ModuleLoadFinished(modules[i], S_OK));
+      }
+    });
+  }
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+
+  const auto requests = WaitForReJITRequests(expected.size());
+  EXPECT_EQ(expected, std::set<ReJITRequest>(requests.begin(), requests.end()));
+}
+
+TEST_F(CorProfilerTest, RewritesTheTargetOnReJIT) {
+  const ModuleID module_id =
+      info_.AddModule(CreateModule(kTargetAssembly, 1), 2);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+
+  const auto requests = WaitForReJITRequests(1);
+  ASSERT_EQ(1, requests.size());
+
+  LoadManagedProfiler(2);
+
+  FakeFunctionControl function_control;
+  EXPECT_EQ(S_OK,
+            profiler_->GetReJITParameters(requests[0].first,
+                                          requests[0].second,
+                                          &function_control));
+  EXPECT_FALSE(function_control.body.empty());
+}
+
+TEST_F(CorProfilerTest, ReJITsInlinersFromTheirOriginalIL) {
+  const ModuleID module_id =
+      info_.AddModule(CreateModule(kTargetAssembly, 1), 2);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+  ASSERT_EQ(1, WaitForReJITRequests(1).size());
+
+  LoadManagedProfiler(2);
+
+  // the runtime also ReJITs the methods that inlined the target
+  const mdMethodDef inliner =
+      info_.GetMetadata(module_id)->GetMethodDef(kTargetType, WStr("Main"));
+  FakeFunctionControl function_control;
+  EXPECT_EQ(S_OK, profiler_->GetReJITParameters(module_id, inliner,
+                                                &function_control));
+  EXPECT_TRUE(function_control.body.empty());
+}
+
+TEST_F(CorProfilerTest, KeepsTheTargetsFromBeingInlined) {
+  const ModuleID module_id =
+      info_.AddModule(CreateModule(kTargetAssembly, 1), 2);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+  profiler_->DrainModuleAnalysis();
+
+  const auto function_id = [&](const WSTRING& method_name) {
+    return FakeProfilerInfo::GetFunctionId(
+        module_id,
+        info_.GetMetadata(module_id)->GetMethodDef(kTargetType, method_name));
+  };
+  const FunctionID main = function_id(WStr("Main"));
+
+  BOOL should_inline = TRUE;
+  EXPECT_EQ(S_OK, profiler_->JITInlining(main, function_id(kTargetMethod),
+                                         &should_inline));
+  EXPECT_FALSE(should_inline);
+
+  // once the module is analyzed its other methods can be inlined
+  EXPECT_EQ(S_OK, profiler_->JITInlining(main, main, &should_inline));
+  EXPECT_TRUE(should_inline);
+}
+
+TEST_F(CorProfilerTest, InsertsTheStartupHookOnFirstJITCompilation) {
+  const ModuleID module_id =
+      info_.AddModule(CreateModule(WStr("Samples.Console"), 1), 3);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+
+  const mdMethodDef main = info_.GetMetadata(module_id)->GetMethodDef(
+      WStr("Samples.Console.Program"), WStr("Main"));
+  EXPECT_EQ(S_OK, profiler_->JITCompilationStarted(
+                      FakeProfilerInfo::GetFunctionId(module_id, main), true));
+  EXPECT_FALSE(info_.GetRewrittenBody(module_id, main).empty());
+}
+
+TEST_F(CorProfilerTest,
+       DropsJITCompilationEventsOnceEveryAppDomainHasTheStartupHook) {
+  // JITInlining needs the events, and the inlining setting is read once per
+  // process: without DD_CLR_ENABLE_INLINING=false they are always kept
+  DWORD event_mask = 0;
+  info_.GetEventMask(&event_mask);
+  const bool keeps_events = (event_mask & COR_PRF_DISABLE_INLINING) == 0;
+
+  const WSTRING program = WStr("Samples.Console.Program");
+  const ModuleID module_id =
+      info_.AddModule(CreateModule(WStr("Samples.Console"), 1), 3);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+  EXPECT_TRUE(JITCompilationEventsEnabled());
+
+  // the startup hook is inserted in the first method, the events are dropped
+  // on the next one
+  JITCompile(module_id, program, WStr("Main"));
+  EXPECT_TRUE(JITCompilationEventsEnabled());
+  JITCompile(module_id, program, kTargetMethod);
+  EXPECT_EQ(keeps_events, JITCompilationEventsEnabled());
+
+  // a new AppDomain needs the startup hook
+  ASSERT_EQ(S_OK, profiler_->AppDomainCreationStarted(4));
+  EXPECT_TRUE(JITCompilationEventsEnabled());
+  const ModuleID plugin_id =
+      info_.AddModule(CreateModule(WStr("Samples.Plugin"), 2), 4);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(plugin_id, S_OK));
+
+  // they are kept while the new AppDomain waits for the hook
+  JITCompile(module_id, program, kTargetMethod);
+  EXPECT_TRUE(JITCompilationEventsEnabled());
+
+  JITCompile(plugin_id, WStr("Samples.Plugin.Program"), WStr("Main"));
+  JITCompile(module_id, program, kTargetMethod);
+  EXPECT_EQ(keeps_events, JITCompilationEventsEnabled());
+
+  // a module loaded in an AppDomain without the hook brings them back
+  const ModuleID late_id =
+      info_.AddModule(CreateModule(WStr("Samples.Late"), 3), 5);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(late_id, S_OK));
+  EXPECT_TRUE(JITCompilationEventsEnabled());
+}
+
+TEST(CorProfilerNGENTest, JITCompilesThePrecompiledMethodThatGetsTheStartupHook) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(SearchPrecompiledMethods(true), ::testing::ExitedWithCode(0),
+              "native images kept, cache searches monitored, "
+              "Main JIT compiled, Send precompiled");
+}
+
+TEST(CorProfilerNGENTest, DisablesTheNativeImagesByDefault) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(SearchPrecompiledMethods(false), ::testing::ExitedWithCode(0),
+              "native images disabled, cache searches not monitored");
+}
+
+TEST_F(CorProfilerPlanCacheTest, StoresThePlanOfAnAnalyzedModule) {
+  EXPECT_EQ(0, CountPlans());
+  EXPECT_EQ(1, LoadTargetModule().size());
+  EXPECT_EQ(1, CountPlans());
+}
+
+TEST_F(CorProfilerPlanCacheTest, RequestsReJITFromTheStoredPlan) {
+  ASSERT_EQ(1, LoadTargetModule().size());
+
+  // the same image in another AppDomain, with an overload the integration
+  // doesn't match: only the stored plan requests its ReJIT
+  auto definition = CreateModule(kTargetAssembly, 1);
+  definition.types[0].methods[0].signature = {IMAGE_CEE_CS_CALLCONV_HASTHIS, 1,
+                                              ELEMENT_TYPE_VOID,
+                                              ELEMENT_TYPE_I4};
+  const ModuleID module_id = info_.AddModule(definition, 3);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(module_id, S_OK));
+
+  const auto requests = WaitForReJITRequests(1);
+  ASSERT_EQ(1, requests.size());
+  EXPECT_EQ(module_id, requests[0].first);
+}
+
+TEST_F(CorProfilerPlanCacheTest, AnalyzesAModuleThatDoesNotMatchItsPlan) {
+  ASSERT_EQ(1, LoadTargetModule().size());
+
+  // same MVID, but the method of the plan is now declared by another type
+  auto definition = CreateModule(kTargetAssembly, 1);
+  definition.types[0].name = WStr("Samples.FakeClient.Other");
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(
+                      info_.AddModule(definition, 3), S_OK));
+  profiler_->DrainModuleAnalysis();
+
+  // the requests are sent in order, the stale entry would come first
+  const ModuleID other_id =
+      info_.AddModule(CreateModule(kTargetAssembly, 2), 4);
+  ASSERT_EQ(S_OK, profiler_->ModuleLoadFinished(other_id, S_OK));
+  const auto requests = WaitForReJITRequests(1);
+  ASSERT_EQ(1, requests.size());
+  EXPECT_EQ(other_id, requests[0].first);
+}
@@ -0,0 +1,933 @@
+#include "fake_metadata.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace trace {
+
+namespace {
+
+// The state behind an HCORENUM
+struct FakeEnum {
+  std::vector<mdToken> tokens;
+  ULONG next = 0;
+};
+
+HRESULT CopyName(const WSTRING& name, LPWSTR buffer, ULONG buffer_size,
+                 ULONG* name_size) {
+  const ULONG size = (ULONG)name.size() + 1;
+  if (name_size != nullptr) {
+    *name_size = size;
+  }
+  if (buffer == nullptr || buffer_size == 0) {
+    return S_OK;
+  }
+
+  const ULONG copied = std::min(size, buffer_size);
+  memcpy(buffer, name.c_str(), (copied - 1) * sizeof(WCHAR));
+  buffer[copied - 1] = 0;
+  return copied < size ? CLDB_S_TRUNCATION : S_OK;
+}
+
+std::vector<BYTE> ToBytes(PCCOR_SIGNATURE signature, ULONG size) {
+  return std::vector<BYTE>(signature, signature + size);
+}
+
+bool SameName(const WSTRING& name, LPCWSTR other) {
+  return other != nullptr && name == other;
+}
+
+// Returns the row of a token, or nullptr if the token is not of the rows type
+// or out of range
+template <typename Rows>
+auto GetRow(Rows& rows, mdToken token, CorTokenType token_type)
+    -> decltype(&rows[0]) {
+  const ULONG rid = RidFromToken(token);
+  if ((CorTokenType)TypeFromToken(token) != token_type || rid == 0 ||
+      rid > rows.size()) {
+    return nullptr;
+  }
+  return &rows[rid - 1];
+}
+
+// Returns the token of the first matching row, or mdTokenNil
+template <typename Rows, typename Matches>
+mdToken Find(const Rows& rows, CorTokenType token_type, Matches matches) {
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (matches(rows[i])) {
+      return TokenFromRid((ULONG)i + 1, token_type);
+    }
+  }
+  return mdTokenNil;
+}
+
+// Returns the token of the first matching row, adding the row if none matches
+template <typename Rows, typename Matches>
+mdToken FindOrAdd(Rows& rows, CorTokenType token_type, Matches matches,
+                  typename Rows::value_type&& row) {
+  const mdToken token = Find(rows, token_type, matches);
+  if (token != mdTokenNil) {
+    return token;
+  }
+  rows.push_back(std::move(row));
+  return TokenFromRid((ULONG)rows.size(), token_type);
+}
+
+void SetVersion(const FakeAssemblyDefinition& assembly,
+                ASSEMBLYMETADATA* metadata) {
+  if (metadata == nullptr) {
+    return;
+  }
+  metadata->usMajorVersion = assembly.major;
+  metadata->usMinorVersion = assembly.minor;
+  metadata->usBuildNumber = assembly.build;
+  metadata->usRevisionNumber = assembly.revision;
+  metadata->cbLocale = 0;
+  metadata->ulProcessor = 0;
+  metadata->ulOS = 0;
+}
+
+}  // namespace
+
+FakeMetadata::FakeMetadata(const FakeModuleDefinition& definition)
+    : assembly_(definition.assembly),
+      mvid_(definition.mvid),
+      assembly_refs_(definition.references.begin(),
+                     definition.references.end()) {
+  for (const auto& type : definition.types) {
+    const mdTypeDef type_def =
+        TokenFromRid((ULONG)type_defs_.size() + 1, mdtTypeDef);
+    TypeDefRow type_row{type.name, tdPublic, mdTokenNil, {}};
+
+    for (const auto& method : type.methods) {
+      const bool is_static =
+          method.signature.empty() ||
+          (method.signature[0] & IMAGE_CEE_CS_CALLCONV_HASTHIS) == 0;
+
+      // tiny header with a single ret
+      std::vector<BYTE> body = method.body;
+      if (body.empty()) {
+        body = {(BYTE)(CorILMethod_TinyFormat | (1 << 2)), 0x2A};
+      }
+
+      method_defs_.push_back({type_def, method.name,
+                              (DWORD)(mdPublic | mdHideBySig |
+                                      (is_static ? mdStatic : 0)),
+                              miIL | miManaged, method.signature,
+                              std::move(body), 0, {}, mdModuleRefNil});
+      type_row.methods.push_back(
+          TokenFromRid((ULONG)method_defs_.size(), mdtMethodDef));
+    }
+
+    type_defs_.push_back(std::move(type_row));
+  }
+}
+
+mdMethodDef FakeMetadata::GetMethodDef(const WSTRING& type_name,
+                                       const WSTRING& method_name) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& type_row : type_defs_) {
+    if (type_row.name != type_name) {
+      continue;
+    }
+    for (const auto method_def : type_row.methods) {
+      if (method_defs_[RidFromToken(method_def) - 1].name == method_name) {
+        return method_def;
+      }
+    }
+  }
+  return mdMethodDefNil;
+}
+
+HRESULT FakeMetadata::GetMethodBody(mdMethodDef method_def, LPCBYTE* body,
+                                    ULONG* body_size) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_defs_, method_def, mdtMethodDef);
+  if (row == nullptr || row->body.empty()) {
+    return CORPROF_E_FUNCTION_NOT_IL;
+  }
+  *body = row->body.data();
+  if (body_size != nullptr) {
+    *body_size = (ULONG)row->body.size();
+  }
+  return S_OK;
+}
+
+template <typename GetTokens>
+HRESULT FakeMetadata::Enumerate(HCORENUM* phEnum, GetTokens get_tokens,
+                                mdToken tokens[], ULONG cMax,
+                                ULONG* pcTokens) {
+  auto fake_enum = static_cast<FakeEnum*>(*phEnum);
+  if (fake_enum == nullptr) {
+    std::lock_guard<std::mutex> guard(lock_);
+    fake_enum = new FakeEnum{get_tokens()};
+    *phEnum = fake_enum;
+  }
+
+  ULONG count = 0;
+  while (count < cMax && fake_enum->next < fake_enum->tokens.size()) {
+    tokens[count++] = fake_enum->tokens[fake_enum->next++];
+  }
+  if (pcTokens != nullptr) {
+    *pcTokens = count;
+  }
+  return count > 0 ? S_OK : S_FALSE;
+}
+
+//
+// IUnknown
+//
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::QueryInterface(REFIID riid,
+                                                       void** ppvObject) {
+  if (ppvObject == nullptr) {
+    return E_POINTER;
+  }
+
+  if (riid == IID_IUnknown || riid == IID_IMetaDataImport ||
+      riid == IID_IMetaDataImport2) {
+    *ppvObject = static_cast<IMetaDataImport2*>(this);
+  } else if (riid == IID_IMetaDataEmit || riid == IID_IMetaDataEmit2) {
+    *ppvObject = static_cast<IMetaDataEmit2*>(this);
+  } else if (riid == IID_IMetaDataAssemblyImport) {
+    *ppvObject = static_cast<IMetaDataAssemblyImport*>(this);
+  } else if (riid == IID_IMetaDataAssemblyEmit) {
+    *ppvObject = static_cast<IMetaDataAssemblyEmit*>(this);
+  } else {
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  AddRef();
+  return S_OK;
+}
+
+ULONG STDMETHODCALLTYPE FakeMetadata::AddRef() { return ++ref_count_; }
+
+ULONG STDMETHODCALLTYPE FakeMetadata::Release() {
+  const ULONG count = --ref_count_;
+  if (count == 0) {
+    delete this;
+  }
+  return count;
+}
+
+//
+// IMetaDataImport
+//
+
+void STDMETHODCALLTYPE FakeMetadata::CloseEnum(HCORENUM hEnum) {
+  delete static_cast<FakeEnum*>(hEnum);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::CountEnum(HCORENUM hEnum,
+                                                  ULONG* pulCount) {
+  const auto fake_enum = static_cast<FakeEnum*>(hEnum);
+  *pulCount = fake_enum == nullptr ? 0 : (ULONG)fake_enum->tokens.size();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::ResetEnum(HCORENUM hEnum, ULONG ulPos) {
+  const auto fake_enum = static_cast<FakeEnum*>(hEnum);
+  if (fake_enum != nullptr) {
+    fake_enum->next = ulPos;
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::EnumTypeDefs(HCORENUM* phEnum,
+                                                     mdTypeDef rTypeDefs[],
+                                                     ULONG cMax,
+                                                     ULONG* pcTypeDefs) {
+  return Enumerate(
+      phEnum,
+      [this]() {
+        std::vector<mdToken> tokens;
+        for (ULONG rid = 1; rid <= type_defs_.size(); rid++) {
+          tokens.push_back(TokenFromRid(rid, mdtTypeDef));
+        }
+        return tokens;
+      },
+      rTypeDefs, cMax, pcTypeDefs);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::EnumTypeRefs(HCORENUM* phEnum,
+                                                     mdTypeRef rTypeRefs[],
+                                                     ULONG cMax,
+                                                     ULONG* pcTypeRefs) {
+  return Enumerate(
+      phEnum,
+      [this]() {
+        std::vector<mdToken> tokens;
+        for (ULONG rid = 1; rid <= type_refs_.size(); rid++) {
+          tokens.push_back(TokenFromRid(rid, mdtTypeRef));
+        }
+        return tokens;
+      },
+      rTypeRefs, cMax, pcTypeRefs);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::FindTypeDefByName(
+    LPCWSTR szTypeDef, mdToken tkEnclosingClass, mdTypeDef* ptd) {
+  // nested types are not supported
+  if (!IsNilToken(tkEnclosingClass)) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *ptd = Find(type_defs_, mdtTypeDef, [szTypeDef](const TypeDefRow& row) {
+    return SameName(row.name, szTypeDef);
+  });
+  return *ptd != mdTokenNil ? S_OK : CLDB_E_RECORD_NOTFOUND;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetScopeProps(LPWSTR szName,
+                                                      ULONG cchName,
+                                                      ULONG* pchName,
+                                                      GUID* pmvid) {
+  if (pmvid != nullptr) {
+    *pmvid = mvid_;
+  }
+  return CopyName(assembly_.name + WStr(".dll"), szName, cchName, pchName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetModuleFromScope(mdModule* pmd) {
+  *pmd = TokenFromRid(1, mdtModule);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetTypeDefProps(mdTypeDef td,
+                                                        LPWSTR szTypeDef,
+                                                        ULONG cchTypeDef,
+                                                        ULONG* pchTypeDef,
+                                                        DWORD* pdwTypeDefFlags,
+                                                        mdToken* ptkExtends) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(type_defs_, td, mdtTypeDef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (pdwTypeDefFlags != nullptr) {
+    *pdwTypeDefFlags = row->flags;
+  }
+  if (ptkExtends != nullptr) {
+    *ptkExtends = row->extends;
+  }
+  return CopyName(row->name, szTypeDef, cchTypeDef, pchTypeDef);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetTypeRefProps(
+    mdTypeRef tr, mdToken* ptkResolutionScope, LPWSTR szName, ULONG cchName,
+    ULONG* pchName) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(type_refs_, tr, mdtTypeRef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (ptkResolutionScope != nullptr) {
+    *ptkResolutionScope = row->scope;
+  }
+  return CopyName(row->name, szName, cchName, pchName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::EnumMethods(HCORENUM* phEnum,
+                                                    mdTypeDef cl,
+                                                    mdMethodDef rMethods[],
+                                                    ULONG cMax,
+                                                    ULONG* pcTokens) {
+  return EnumMethodsWithName(phEnum, cl, nullptr, rMethods, cMax, pcTokens);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::EnumMethodsWithName(
+    HCORENUM* phEnum, mdTypeDef cl, LPCWSTR szName, mdMethodDef rMethods[],
+    ULONG cMax, ULONG* pcTokens) {
+  return Enumerate(
+      phEnum,
+      [this, cl, szName]() {
+        std::vector<mdToken> tokens;
+        const auto type_row = GetRow(type_defs_, cl, mdtTypeDef);
+        if (type_row != nullptr) {
+          for (const auto method_def : type_row->methods) {
+            if (szName == nullptr ||
+                SameName(method_defs_[RidFromToken(method_def) - 1].name,
+                         szName)) {
+              tokens.push_back(method_def);
+            }
+          }
+        }
+        return tokens;
+      },
+      rMethods, cMax, pcTokens);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::EnumMemberRefs(
+    HCORENUM* phEnum, mdToken tkParent, mdMemberRef rMemberRefs[], ULONG cMax,
+    ULONG* pcTokens) {
+  return Enumerate(
+      phEnum,
+      [this, tkParent]() {
+        std::vector<mdToken> tokens;
+        for (ULONG rid = 1; rid <= member_refs_.size(); rid++) {
+          if (member_refs_[rid - 1].parent == tkParent) {
+            tokens.push_back(TokenFromRid(rid, mdtMemberRef));
+          }
+        }
+        return tokens;
+      },
+      rMemberRefs, cMax, pcTokens);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::FindMemberRef(mdTypeRef td,
+                                                      LPCWSTR szName,
+                                                      PCCOR_SIGNATURE pvSigBlob,
+                                                      ULONG cbSigBlob,
+                                                      mdMemberRef* pmr) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *pmr = Find(member_refs_, mdtMemberRef,
+              [td, szName, pvSigBlob, cbSigBlob](const MemberRefRow& row) {
+                return row.parent == td && SameName(row.name, szName) &&
+                       (pvSigBlob == nullptr ||
+                        row.signature == ToBytes(pvSigBlob, cbSigBlob));
+              });
+  return *pmr != mdTokenNil ? S_OK : CLDB_E_RECORD_NOTFOUND;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetMethodProps(
+    mdMethodDef mb, mdTypeDef* pClass, LPWSTR szMethod, ULONG cchMethod,
+    ULONG* pchMethod, DWORD* pdwAttr, PCCOR_SIGNATURE* ppvSigBlob,
+    ULONG* pcbSigBlob, ULONG* pulCodeRVA, DWORD* pdwImplFlags) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_defs_, mb, mdtMethodDef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (pClass != nullptr) {
+    *pClass = row->parent;
+  }
+  if (pdwAttr != nullptr) {
+    *pdwAttr = row->flags;
+  }
+  if (ppvSigBlob != nullptr) {
+    *ppvSigBlob = row->signature.data();
+  }
+  if (pcbSigBlob != nullptr) {
+    *pcbSigBlob = (ULONG)row->signature.size();
+  }
+  if (pulCodeRVA != nullptr) {
+    *pulCodeRVA = 0;
+  }
+  if (pdwImplFlags != nullptr) {
+    *pdwImplFlags = row->impl_flags;
+  }
+  return CopyName(row->name, szMethod, cchMethod, pchMethod);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetMemberRefProps(
+    mdMemberRef mr, mdToken* ptk, LPWSTR szMember, ULONG cchMember,
+    ULONG* pchMember, PCCOR_SIGNATURE* ppvSigBlob, ULONG* pbSig) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(member_refs_, mr, mdtMemberRef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (ptk != nullptr) {
+    *ptk = row->parent;
+  }
+  if (ppvSigBlob != nullptr) {
+    *ppvSigBlob = row->signature.data();
+  }
+  if (pbSig != nullptr) {
+    *pbSig = (ULONG)row->signature.size();
+  }
+  return CopyName(row->name, szMember, cchMember, pchMember);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetModuleRefProps(mdModuleRef mur,
+                                                          LPWSTR szName,
+                                                          ULONG cchName,
+                                                          ULONG* pchName) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(module_refs_, mur, mdtModuleRef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  return CopyName(*row, szName, cchName, pchName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetTypeSpecFromToken(
+    mdTypeSpec typespec, PCCOR_SIGNATURE* ppvSig, ULONG* pcbSig) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(type_specs_, typespec, mdtTypeSpec);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  *ppvSig = row->data();
+  *pcbSig = (ULONG)row->size();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetSigFromToken(mdSignature mdSig,
+                                                        PCCOR_SIGNATURE* ppvSig,
+                                                        ULONG* pcbSig) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(signatures_, mdSig, mdtSignature);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  *ppvSig = row->data();
+  *pcbSig = (ULONG)row->size();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetUserString(mdString stk,
+                                                      LPWSTR szString,
+                                                      ULONG cchString,
+                                                      ULONG* pchString) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(user_strings_, stk, mdtString);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+
+  // user strings are not null terminated
+  const ULONG length = (ULONG)row->size();
+  if (pchString != nullptr) {
+    *pchString = length;
+  }
+  if (szString != nullptr) {
+    memcpy(szString, row->data(), std::min(length, cchString) * sizeof(WCHAR));
+  }
+  return cchString < length && szString != nullptr ? CLDB_S_TRUNCATION : S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetPinvokeMap(
+    mdToken tk, DWORD* pdwMappingFlags, LPWSTR szImportName,
+    ULONG cchImportName, ULONG* pchImportName, mdModuleRef* pmrImportDLL) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_defs_, tk, mdtMethodDef);
+  if (row == nullptr || IsNilToken(row->pinvoke_module)) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (pdwMappingFlags != nullptr) {
+    *pdwMappingFlags = row->pinvoke_flags;
+  }
+  if (pmrImportDLL != nullptr) {
+    *pmrImportDLL = row->pinvoke_module;
+  }
+  return CopyName(row->pinvoke_name, szImportName, cchImportName,
+                  pchImportName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::FindTypeRef(mdToken tkResolutionScope,
+                                                    LPCWSTR szName,
+                                                    mdTypeRef* ptr) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *ptr = Find(type_refs_, mdtTypeRef,
+              [tkResolutionScope, szName](const TypeRefRow& row) {
+                return row.scope == tkResolutionScope &&
+                       SameName(row.name, szName);
+              });
+  return *ptr != mdTokenNil ? S_OK : CLDB_E_RECORD_NOTFOUND;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetMemberProps(
+    mdToken mb, mdTypeDef* pClass, LPWSTR szMember, ULONG cchMember,
+    ULONG* pchMember, DWORD* pdwAttr, PCCOR_SIGNATURE* ppvSigBlob,
+    ULONG* pcbSigBlob, ULONG* pulCodeRVA, DWORD* pdwImplFlags,
+    DWORD* pdwCPlusTypeFlag, UVCP_CONSTANT* ppValue, ULONG* pcchValue) {
+  if (pdwCPlusTypeFlag != nullptr) {
+    *pdwCPlusTypeFlag = ELEMENT_TYPE_VOID;
+  }
+  if (ppValue != nullptr) {
+    *ppValue = nullptr;
+  }
+  if (pcchValue != nullptr) {
+    *pcchValue = 0;
+  }
+
+  if (TypeFromToken(mb) == mdtMethodDef) {
+    return GetMethodProps(mb, pClass, szMember, cchMember, pchMember, pdwAttr,
+                          ppvSigBlob, pcbSigBlob, pulCodeRVA, pdwImplFlags);
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(fields_, mb, mdtFieldDef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (pClass != nullptr) {
+    *pClass = row->parent;
+  }
+  if (pdwAttr != nullptr) {
+    *pdwAttr = row->flags;
+  }
+  if (ppvSigBlob != nullptr) {
+    *ppvSigBlob = row->signature.data();
+  }
+  if (pcbSigBlob != nullptr) {
+    *pcbSigBlob = (ULONG)row->signature.size();
+  }
+  if (pulCodeRVA != nullptr) {
+    *pulCodeRVA = 0;
+  }
+  if (pdwImplFlags != nullptr) {
+    *pdwImplFlags = 0;
+  }
+  return CopyName(row->name, szMember, cchMember, pchMember);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetNestedClassProps(
+    mdTypeDef tdNestedClass, mdTypeDef* ptdEnclosingClass) {
+  // nested types are not supported
+  *ptdEnclosingClass = mdTypeDefNil;
+  return CLDB_E_RECORD_NOTFOUND;
+}
+
+BOOL STDMETHODCALLTYPE FakeMetadata::IsValidToken(mdToken tk) {
+  std::lock_guard<std::mutex> guard(lock_);
+  switch (TypeFromToken(tk)) {
+    case mdtModule:
+      return RidFromToken(tk) == 1;
+    case mdtTypeDef:
+      return GetRow(type_defs_, tk, mdtTypeDef) != nullptr;
+    case mdtMethodDef:
+      return GetRow(method_defs_, tk, mdtMethodDef) != nullptr;
+    case mdtFieldDef:
+      return GetRow(fields_, tk, mdtFieldDef) != nullptr;
+    case mdtTypeRef:
+      return GetRow(type_refs_, tk, mdtTypeRef) != nullptr;
+    case mdtMemberRef:
+      return GetRow(member_refs_, tk, mdtMemberRef) != nullptr;
+    case mdtModuleRef:
+      return GetRow(module_refs_, tk, mdtModuleRef) != nullptr;
+    case mdtTypeSpec:
+      return GetRow(type_specs_, tk, mdtTypeSpec) != nullptr;
+    case mdtSignature:
+      return GetRow(signatures_, tk, mdtSignature) != nullptr;
+    case mdtMethodSpec:
+      return GetRow(method_specs_, tk, mdtMethodSpec) != nullptr;
+    case mdtString:
+      return GetRow(user_strings_, tk, mdtString) != nullptr;
+    case mdtAssembly:
+      return RidFromToken(tk) == 1;
+    case mdtAssemblyRef:
+      return GetRow(assembly_refs_, tk, mdtAssemblyRef) != nullptr;
+    default:
+      return FALSE;
+  }
+}
+
+//
+// IMetaDataImport2
+//
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetMethodSpecProps(
+    mdMethodSpec mi, mdToken* tkParent, PCCOR_SIGNATURE* ppvSigBlob,
+    ULONG* pcbSigBlob) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_specs_, mi, mdtMethodSpec);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (tkParent != nullptr) {
+    *tkParent = row->parent;
+  }
+  if (ppvSigBlob != nullptr) {
+    *ppvSigBlob = row->signature.data();
+  }
+  if (pcbSigBlob != nullptr) {
+    *pcbSigBlob = (ULONG)row->signature.size();
+  }
+  return S_OK;
+}
+
+//
+// IMetaDataEmit
+//
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineTypeDef(LPCWSTR szTypeDef,
+                                                      DWORD dwTypeDefFlags,
+                                                      mdToken tkExtends,
+                                                      mdToken rtkImplements[],
+                                                      mdTypeDef* ptd) {
+  std::lock_guard<std::mutex> guard(lock_);
+  type_defs_.push_back({szTypeDef, dwTypeDefFlags, tkExtends, {}});
+  *ptd = TokenFromRid((ULONG)type_defs_.size(), mdtTypeDef);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineMethod(mdTypeDef td,
+                                                     LPCWSTR szName,
+                                                     DWORD dwMethodFlags,
+                                                     PCCOR_SIGNATURE pvSigBlob,
+                                                     ULONG cbSigBlob,
+                                                     ULONG ulCodeRVA,
+                                                     DWORD dwImplFlags,
+                                                     mdMethodDef* pmd) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto type_row = GetRow(type_defs_, td, mdtTypeDef);
+  if (type_row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+
+  // the body is set later with ICorProfilerInfo::SetILFunctionBody
+  method_defs_.push_back({td, szName, dwMethodFlags, dwImplFlags,
+                          ToBytes(pvSigBlob, cbSigBlob), {}, 0, {},
+                          mdModuleRefNil});
+  *pmd = TokenFromRid((ULONG)method_defs_.size(), mdtMethodDef);
+  type_row->methods.push_back(*pmd);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineTypeRefByName(
+    mdToken tkResolutionScope, LPCWSTR szName, mdTypeRef* ptr) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *ptr = FindOrAdd(
+      type_refs_, mdtTypeRef,
+      [tkResolutionScope, szName](const TypeRefRow& row) {
+        return row.scope == tkResolutionScope && SameName(row.name, szName);
+      },
+      {tkResolutionScope, szName});
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineMemberRef(
+    mdToken tkImport, LPCWSTR szName, PCCOR_SIGNATURE pvSigBlob,
+    ULONG cbSigBlob, mdMemberRef* pmr) {
+  auto signature = ToBytes(pvSigBlob, cbSigBlob);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *pmr = FindOrAdd(
+      member_refs_, mdtMemberRef,
+      [tkImport, szName, &signature](const MemberRefRow& row) {
+        return row.parent == tkImport && SameName(row.name, szName) &&
+               row.signature == signature;
+      },
+      {tkImport, szName, signature});
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefinePinvokeMap(
+    mdToken tk, DWORD dwMappingFlags, LPCWSTR szImportName,
+    mdModuleRef mrImportDLL) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_defs_, tk, mdtMethodDef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  row->pinvoke_flags = dwMappingFlags;
+  row->pinvoke_name = szImportName != nullptr ? szImportName : row->name;
+  row->pinvoke_module = mrImportDLL;
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DeletePinvokeMap(mdToken tk) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_defs_, tk, mdtMethodDef);
+  if (row == nullptr || IsNilToken(row->pinvoke_module)) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  row->pinvoke_module = mdModuleRefNil;
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineField(mdTypeDef td,
+                                                    LPCWSTR szName,
+                                                    DWORD dwFieldFlags,
+                                                    PCCOR_SIGNATURE pvSigBlob,
+                                                    ULONG cbSigBlob,
+                                                    DWORD dwCPlusTypeFlag,
+                                                    void const* pValue,
+                                                    ULONG cchValue,
+                                                    mdFieldDef* pmd) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (GetRow(type_defs_, td, mdtTypeDef) == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  fields_.push_back({td, szName, dwFieldFlags, ToBytes(pvSigBlob, cbSigBlob)});
+  *pmd = TokenFromRid((ULONG)fields_.size(), mdtFieldDef);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineModuleRef(LPCWSTR szName,
+                                                        mdModuleRef* pmur) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *pmur = FindOrAdd(
+      module_refs_, mdtModuleRef,
+      [szName](const WSTRING& row) { return SameName(row, szName); }, szName);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetTokenFromSig(PCCOR_SIGNATURE pvSig,
+                                                        ULONG cbSig,
+                                                        mdSignature* pmsig) {
+  auto signature = ToBytes(pvSig, cbSig);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *pmsig = FindOrAdd(
+      signatures_, mdtSignature,
+      [&signature](const std::vector<BYTE>& row) { return row == signature; },
+      std::move(signature));
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetTokenFromTypeSpec(
+    PCCOR_SIGNATURE pvSig, ULONG cbSig, mdTypeSpec* ptypespec) {
+  auto signature = ToBytes(pvSig, cbSig);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *ptypespec = FindOrAdd(
+      type_specs_, mdtTypeSpec,
+      [&signature](const std::vector<BYTE>& row) { return row == signature; },
+      std::move(signature));
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineUserString(LPCWSTR szString,
+                                                         ULONG cchString,
+                                                         mdString* pstk) {
+  WSTRING value(szString, cchString);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *pstk = FindOrAdd(
+      user_strings_, mdtString,
+      [&value](const WSTRING& row) { return row == value; }, std::move(value));
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::SetMethodImplFlags(mdMethodDef md,
+                                                           DWORD dwImplFlags) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(method_defs_, md, mdtMethodDef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  row->impl_flags = dwImplFlags;
+  return S_OK;
+}
+
+//
+// IMetaDataEmit2
+//
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineMethodSpec(
+    mdToken tkParent, PCCOR_SIGNATURE pvSigBlob, ULONG cbSigBlob,
+    mdMethodSpec* pmi) {
+  auto signature = ToBytes(pvSigBlob, cbSigBlob);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *pmi = FindOrAdd(
+      method_specs_, mdtMethodSpec,
+      [tkParent, &signature](const MethodSpecRow& row) {
+        return row.parent == tkParent && row.signature == signature;
+      },
+      {tkParent, signature});
+  return S_OK;
+}
+
+//
+// IMetaDataAssemblyImport
+//
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetAssemblyProps(
+    mdAssembly mda, const void** ppbPublicKey, ULONG* pcbPublicKey,
+    ULONG* pulHashAlgId, LPWSTR szName, ULONG cchName, ULONG* pchName,
+    ASSEMBLYMETADATA* pMetaData, DWORD* pdwAssemblyFlags) {
+  if (mda != TokenFromRid(1, mdtAssembly)) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (ppbPublicKey != nullptr) {
+    *ppbPublicKey = nullptr;
+  }
+  if (pcbPublicKey != nullptr) {
+    *pcbPublicKey = 0;
+  }
+  if (pulHashAlgId != nullptr) {
+    *pulHashAlgId = CALG_SHA1;
+  }
+  if (pdwAssemblyFlags != nullptr) {
+    *pdwAssemblyFlags = 0;
+  }
+  SetVersion(assembly_, pMetaData);
+  return CopyName(assembly_.name, szName, cchName, pchName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetAssemblyRefProps(
+    mdAssemblyRef mdar, const void** ppbPublicKeyOrToken,
+    ULONG* pcbPublicKeyOrToken, LPWSTR szName, ULONG cchName, ULONG* pchName,
+    ASSEMBLYMETADATA* pMetaData, const void** ppbHashValue, ULONG* pcbHashValue,
+    DWORD* pdwAssemblyRefFlags) {
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto row = GetRow(assembly_refs_, mdar, mdtAssemblyRef);
+  if (row == nullptr) {
+    return CLDB_E_RECORD_NOTFOUND;
+  }
+  if (ppbPublicKeyOrToken != nullptr) {
+    *ppbPublicKeyOrToken = nullptr;
+  }
+  if (pcbPublicKeyOrToken != nullptr) {
+    *pcbPublicKeyOrToken = 0;
+  }
+  if (ppbHashValue != nullptr) {
+    *ppbHashValue = nullptr;
+  }
+  if (pcbHashValue != nullptr) {
+    *pcbHashValue = 0;
+  }
+  if (pdwAssemblyRefFlags != nullptr) {
+    *pdwAssemblyRefFlags = 0;
+  }
+  SetVersion(*row, pMetaData);
+  return CopyName(row->name, szName, cchName, pchName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::EnumAssemblyRefs(
+    HCORENUM* phEnum, mdAssemblyRef rAssemblyRefs[], ULONG cMax,
+    ULONG* pcTokens) {
+  return Enumerate(
+      phEnum,
+      [this]() {
+        std::vector<mdToken> tokens;
+        for (ULONG rid = 1; rid <= assembly_refs_.size(); rid++) {
+          tokens.push_back(TokenFromRid(rid, mdtAssemblyRef));
+        }
+        return tokens;
+      },
+      rAssemblyRefs, cMax, pcTokens);
+}
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::GetAssemblyFromScope(
+    mdAssembly* ptkAssembly) {
+  *ptkAssembly = TokenFromRid(1, mdtAssembly);
+  return S_OK;
+}
+
+//
+// IMetaDataAssemblyEmit
+//
+
+HRESULT STDMETHODCALLTYPE FakeMetadata::DefineAssemblyRef(
+    const void* pbPublicKeyOrToken, ULONG cbPublicKeyOrToken, LPCWSTR szName,
+    const ASSEMBLYMETADATA* pMetaData, const void* pbHashValue,
+    ULONG cbHashValue, DWORD dwAssemblyRefFlags, mdAssemblyRef* pmdar) {
+  FakeAssemblyDefinition assembly{szName};
+  if (pMetaData != nullptr) {
+    assembly.major = pMetaData->usMajorVersion;
+    assembly.minor = pMetaData->usMinorVersion;
+    assembly.build = pMetaData->usBuildNumber;
+    assembly.revision = pMetaData->usRevisionNumber;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  *pmdar = FindOrAdd(
+      assembly_refs_, mdtAssemblyRef,
+      [&assembly](const FakeAssemblyDefinition& row) {
+        return row.name == assembly.name && row.major == assembly.major &&
+               row.minor == assembly.minor && row.build == assembly.build &&
+               row.revision == assembly.revision;
+      },
+      std::move(assembly));
+  return S_OK;
+}
+
+}  // namespace trace
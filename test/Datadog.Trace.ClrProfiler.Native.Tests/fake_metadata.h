@@ -0,0 +1,910 @@
+#pragma once
+
+#include <corhlpr.h>
+#include <corprof.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/string.h"
+
+namespace trace {
+
+// A method of a synthetic module. A method without a body gets a tiny body
+// that only returns.
+struct FakeMethodDefinition {
+  WSTRING name;
+  std::vector<BYTE> signature;
+  std::vector<BYTE> body;
+};
+
+struct FakeTypeDefinition {
+  WSTRING name;
+  std::vector<FakeMethodDefinition> methods;
+};
+
+struct FakeAssemblyDefinition {
+  WSTRING name;
+  USHORT major = 0;
+  USHORT minor = 0;
+  USHORT build = 0;
+  USHORT revision = 0;
+};
+
+// Describes a synthetic module: its assembly, the assemblies it references
+// and the types it defines.
+struct FakeModuleDefinition {
+  FakeAssemblyDefinition assembly;
+  GUID mvid{};
+  std::vector<FakeAssemblyDefinition> references;
+  std::vector<FakeTypeDefinition> types;
+};
+
+// FakeMetadata serves the metadata of a synthetic module through the
+// IMetaDataImport2, IMetaDataEmit2, IMetaDataAssemblyImport and
+// IMetaDataAssemblyEmit interfaces, so the profiler can read and emit
+// metadata without a runtime.
+//
+// Only the members used by the profiler are implemented, the others return
+// E_NOTIMPL. Emitted rows go to the same tables the import side reads and,
+// like the runtime, defining a row that already exists returns its token.
+// Every member can be called from any thread. The metadata starts with one
+// reference, owned by its creator.
+class FakeMetadata : public IMetaDataImport2,
+                     public IMetaDataEmit2,
+                     public IMetaDataAssemblyImport,
+                     public IMetaDataAssemblyEmit {
+ public:
+  explicit FakeMetadata(const FakeModuleDefinition& definition);
+
+  // Returns the token of a method defined in the module, or mdMethodDefNil
+  mdMethodDef GetMethodDef(const WSTRING& type_name,
+                           const WSTRING& method_name) const;
+
+  // Gets the IL body of a method, fails for a method without a body
+  HRESULT GetMethodBody(mdMethodDef method_def, LPCBYTE* body,
+                        ULONG* body_size) const;
+
+  // IUnknown
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void** ppvObject) override;
+  ULONG STDMETHODCALLTYPE AddRef() override;
+  ULONG STDMETHODCALLTYPE Release() override;
+
+  // IMetaDataImport
+  void STDMETHODCALLTYPE CloseEnum(HCORENUM hEnum) override;
+  HRESULT STDMETHODCALLTYPE CountEnum(HCORENUM hEnum, ULONG* pulCount) override;
+  HRESULT STDMETHODCALLTYPE ResetEnum(HCORENUM hEnum, ULONG ulPos) override;
+  HRESULT STDMETHODCALLTYPE EnumTypeDefs(HCORENUM* phEnum,
+                                         mdTypeDef rTypeDefs[], ULONG cMax,
+                                         ULONG* pcTypeDefs) override;
+  HRESULT STDMETHODCALLTYPE EnumTypeRefs(HCORENUM* phEnum,
+                                         mdTypeRef rTypeRefs[], ULONG cMax,
+                                         ULONG* pcTypeRefs) override;
+  HRESULT STDMETHODCALLTYPE FindTypeDefByName(LPCWSTR szTypeDef,
+                                              mdToken tkEnclosingClass,
+                                              mdTypeDef* ptd) override;
+  HRESULT STDMETHODCALLTYPE GetScopeProps(LPWSTR szName, ULONG cchName,
+                                          ULONG* pchName, GUID* pmvid) override;
+  HRESULT STDMETHODCALLTYPE GetModuleFromScope(mdModule* pmd) override;
+  HRESULT STDMETHODCALLTYPE GetTypeDefProps(mdTypeDef td, LPWSTR szTypeDef,
+                                            ULONG cchTypeDef, ULONG* pchTypeDef,
+                                            DWORD* pdwTypeDefFlags,
+                                            mdToken* ptkExtends) override;
+  HRESULT STDMETHODCALLTYPE GetTypeRefProps(mdTypeRef tr,
+                                            mdToken* ptkResolutionScope,
+                                            LPWSTR szName, ULONG cchName,
+                                            ULONG* pchName) override;
+  HRESULT STDMETHODCALLTYPE EnumMethods(HCORENUM* phEnum, mdTypeDef cl,
+                                        mdMethodDef rMethods[], ULONG cMax,
+                                        ULONG* pcTokens) override;
+  HRESULT STDMETHODCALLTYPE EnumMethodsWithName(HCORENUM* phEnum, mdTypeDef cl,
+                                                LPCWSTR szName,
+                                                mdMethodDef rMethods[],
+                                                ULONG cMax,
+                                                ULONG* pcTokens) override;
+  HRESULT STDMETHODCALLTYPE EnumMemberRefs(HCORENUM* phEnum, mdToken tkParent,
+                                           mdMemberRef rMemberRefs[],
+                                           ULONG cMax,
+                                           ULONG* pcTokens) override;
+  HRESULT STDMETHODCALLTYPE FindMemberRef(mdTypeRef td, LPCWSTR szName,
+                                          PCCOR_SIGNATURE pvSigBlob,
+                                          ULONG cbSigBlob,
+                                          mdMemberRef* pmr) override;
+  HRESULT STDMETHODCALLTYPE GetMethodProps(mdMethodDef mb, mdTypeDef* pClass,
+                                           LPWSTR szMethod, ULONG cchMethod,
+                                           ULONG* pchMethod, DWORD* pdwAttr,
+                                           PCCOR_SIGNATURE* ppvSigBlob,
+                                           ULONG* pcbSigBlob, ULONG* pulCodeRVA,
+                                           DWORD* pdwImplFlags) override;
+  HRESULT STDMETHODCALLTYPE GetMemberRefProps(mdMemberRef mr, mdToken* ptk,
+                                              LPWSTR szMember, ULONG cchMember,
+                                              ULONG* pchMember,
+                                              PCCOR_SIGNATURE* ppvSigBlob,
+                                              ULONG* pbSig) override;
+  HRESULT STDMETHODCALLTYPE GetSigFromToken(mdSignature mdSig,
+                                            PCCOR_SIGNATURE* ppvSig,
+                                            ULONG* pcbSig) override;
+  HRESULT STDMETHODCALLTYPE GetModuleRefProps(mdModuleRef mur, LPWSTR szName,
+                                              ULONG cchName,
+                                              ULONG* pchName) override;
+  HRESULT STDMETHODCALLTYPE GetTypeSpecFromToken(mdTypeSpec typespec,
+                                                 PCCOR_SIGNATURE* ppvSig,
+                                                 ULONG* pcbSig) override;
+  HRESULT STDMETHODCALLTYPE GetUserString(mdString stk, LPWSTR szString,
+                                          ULONG cchString,
+                                          ULONG* pchString) override;
+  HRESULT STDMETHODCALLTYPE GetPinvokeMap(mdToken tk, DWORD* pdwMappingFlags,
+                                          LPWSTR szImportName,
+                                          ULONG cchImportName,
+                                          ULONG* pchImportName,
+                                          mdModuleRef* pmrImportDLL) override;
+  HRESULT STDMETHODCALLTYPE FindTypeRef(mdToken tkResolutionScope,
+                                        LPCWSTR szName,
+                                        mdTypeRef* ptr) override;
+  HRESULT STDMETHODCALLTYPE GetMemberProps(mdToken mb, mdTypeDef* pClass,
+                                           LPWSTR szMember, ULONG cchMember,
+                                           ULONG* pchMember, DWORD* pdwAttr,
+                                           PCCOR_SIGNATURE* ppvSigBlob,
+                                           ULONG* pcbSigBlob, ULONG* pulCodeRVA,
+                                           DWORD* pdwImplFlags,
+                                           DWORD* pdwCPlusTypeFlag,
+                                           UVCP_CONSTANT* ppValue,
+                                           ULONG* pcchValue) override;
+  BOOL STDMETHODCALLTYPE IsValidToken(mdToken tk) override;
+  HRESULT STDMETHODCALLTYPE GetNestedClassProps(
+      mdTypeDef tdNestedClass, mdTypeDef* ptdEnclosingClass) override;
+
+  // IMetaDataImport2
+  HRESULT STDMETHODCALLTYPE GetMethodSpecProps(mdMethodSpec mi,
+                                               mdToken* tkParent,
+                                               PCCOR_SIGNATURE* ppvSigBlob,
+                                               ULONG* pcbSigBlob) override;
+
+  // IMetaDataEmit
+  HRESULT STDMETHODCALLTYPE DefineTypeDef(LPCWSTR szTypeDef,
+                                          DWORD dwTypeDefFlags,
+                                          mdToken tkExtends,
+                                          mdToken rtkImplements[],
+                                          mdTypeDef* ptd) override;
+  HRESULT STDMETHODCALLTYPE DefineMethod(mdTypeDef td, LPCWSTR szName,
+                                         DWORD dwMethodFlags,
+                                         PCCOR_SIGNATURE pvSigBlob,
+                                         ULONG cbSigBlob, ULONG ulCodeRVA,
+                                         DWORD dwImplFlags,
+                                         mdMethodDef* pmd) override;
+  HRESULT STDMETHODCALLTYPE DefineTypeRefByName(mdToken tkResolutionScope,
+                                                LPCWSTR szName,
+                                                mdTypeRef* ptr) override;
+  HRESULT STDMETHODCALLTYPE DefineMemberRef(mdToken tkImport, LPCWSTR szName,
+                                            PCCOR_SIGNATURE pvSigBlob,
+                                            ULONG cbSigBlob,
+                                            mdMemberRef* pmr) override;
+  HRESULT STDMETHODCALLTYPE GetTokenFromSig(PCCOR_SIGNATURE pvSig, ULONG cbSig,
+                                            mdSignature* pmsig) override;
+  HRESULT STDMETHODCALLTYPE DefineModuleRef(LPCWSTR szName,
+                                            mdModuleRef* pmur) override;
+  HRESULT STDMETHODCALLTYPE GetTokenFromTypeSpec(
+      PCCOR_SIGNATURE pvSig, ULONG cbSig, mdTypeSpec* ptypespec) override;
+  HRESULT STDMETHODCALLTYPE DefineUserString(LPCWSTR szString, ULONG cchString,
+                                             mdString* pstk) override;
+  HRESULT STDMETHODCALLTYPE DefinePinvokeMap(mdToken tk, DWORD dwMappingFlags,
+                                             LPCWSTR szImportName,
+                                             mdModuleRef mrImportDLL) override;
+  HRESULT STDMETHODCALLTYPE DeletePinvokeMap(mdToken tk) override;
+  HRESULT STDMETHODCALLTYPE DefineField(mdTypeDef td, LPCWSTR szName,
+                                        DWORD dwFieldFlags,
+                                        PCCOR_SIGNATURE pvSigBlob,
+                                        ULONG cbSigBlob, DWORD dwCPlusTypeFlag,
+                                        void const* pValue, ULONG cchValue,
+                                        mdFieldDef* pmd) override;
+  HRESULT STDMETHODCALLTYPE SetMethodImplFlags(mdMethodDef md,
+                                               DWORD dwImplFlags) override;
+
+  // IMetaDataEmit2
+  HRESULT STDMETHODCALLTYPE DefineMethodSpec(mdToken tkParent,
+                                             PCCOR_SIGNATURE pvSigBlob,
+                                             ULONG cbSigBlob,
+                                             mdMethodSpec* pmi) override;
+
+  // IMetaDataAssemblyImport
+  HRESULT STDMETHODCALLTYPE GetAssemblyProps(mdAssembly mda,
+                                             const void** ppbPublicKey,
+                                             ULONG* pcbPublicKey,
+                                             ULONG* pulHashAlgId, LPWSTR szName,
+                                             ULONG cchName, ULONG* pchName,
+                                             ASSEMBLYMETADATA* pMetaData,
+                                             DWORD* pdwAssemblyFlags) override;
+  HRESULT STDMETHODCALLTYPE GetAssemblyRefProps(
+      mdAssemblyRef mdar, const void** ppbPublicKeyOrToken,
+      ULONG* pcbPublicKeyOrToken, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      ASSEMBLYMETADATA* pMetaData, const void** ppbHashValue,
+      ULONG* pcbHashValue, DWORD* pdwAssemblyRefFlags) override;
+  HRESULT STDMETHODCALLTYPE EnumAssemblyRefs(HCORENUM* phEnum,
+                                             mdAssemblyRef rAssemblyRefs[],
+                                             ULONG cMax,
+                                             ULONG* pcTokens) override;
+  HRESULT STDMETHODCALLTYPE GetAssemblyFromScope(
+      mdAssembly* ptkAssembly) override;
+
+  // IMetaDataAssemblyEmit
+  HRESULT STDMETHODCALLTYPE DefineAssemblyRef(const void* pbPublicKeyOrToken,
+                                              ULONG cbPublicKeyOrToken,
+                                              LPCWSTR szName,
+                                              const ASSEMBLYMETADATA* pMetaData,
+                                              const void* pbHashValue,
+                                              ULONG cbHashValue,
+                                              DWORD dwAssemblyRefFlags,
+                                              mdAssemblyRef* pmdar) override;
+
+
+  // Not used by the profiler
+
+  // IMetaDataImport
+  HRESULT STDMETHODCALLTYPE EnumInterfaceImpls(HCORENUM* phEnum, mdTypeDef td,
+                                               mdInterfaceImpl rImpls[],
+                                               ULONG cMax,
+                                               ULONG* pcImpls) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetInterfaceImplProps(mdInterfaceImpl iiImpl,
+                                                  mdTypeDef* pClass,
+                                                  mdToken* ptkIface) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE ResolveTypeRef(mdTypeRef tr, REFIID riid,
+                                           IUnknown** ppIScope,
+                                           mdTypeDef* ptd) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumMembers(HCORENUM* phEnum, mdTypeDef cl,
+                                        mdToken rMembers[], ULONG cMax,
+                                        ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumMembersWithName(HCORENUM* phEnum, mdTypeDef cl,
+                                                LPCWSTR szName,
+                                                mdToken rMembers[], ULONG cMax,
+                                                ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumFields(HCORENUM* phEnum, mdTypeDef cl,
+                                       mdFieldDef rFields[], ULONG cMax,
+                                       ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumFieldsWithName(HCORENUM* phEnum, mdTypeDef cl,
+                                               LPCWSTR szName,
+                                               mdFieldDef rFields[], ULONG cMax,
+                                               ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumParams(HCORENUM* phEnum, mdMethodDef mb,
+                                       mdParamDef rParams[], ULONG cMax,
+                                       ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumMethodImpls(HCORENUM* phEnum, mdTypeDef td,
+                                            mdToken rMethodBody[],
+                                            mdToken rMethodDecl[], ULONG cMax,
+                                            ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumPermissionSets(HCORENUM* phEnum, mdToken tk,
+                                               DWORD dwActions,
+                                               mdPermission rPermission[],
+                                               ULONG cMax,
+                                               ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindMember(mdTypeDef td, LPCWSTR szName,
+                                       PCCOR_SIGNATURE pvSigBlob,
+                                       ULONG cbSigBlob, mdToken* pmb) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindMethod(mdTypeDef td, LPCWSTR szName,
+                                       PCCOR_SIGNATURE pvSigBlob,
+                                       ULONG cbSigBlob,
+                                       mdMethodDef* pmb) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindField(mdTypeDef td, LPCWSTR szName,
+                                      PCCOR_SIGNATURE pvSigBlob,
+                                      ULONG cbSigBlob,
+                                      mdFieldDef* pmb) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumProperties(HCORENUM* phEnum, mdTypeDef td,
+                                           mdProperty rProperties[], ULONG cMax,
+                                           ULONG* pcProperties) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumEvents(HCORENUM* phEnum, mdTypeDef td,
+                                       mdEvent rEvents[], ULONG cMax,
+                                       ULONG* pcEvents) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetEventProps(mdEvent ev, mdTypeDef* pClass,
+                                          LPCWSTR szEvent, ULONG cchEvent,
+                                          ULONG* pchEvent, DWORD* pdwEventFlags,
+                                          mdToken* ptkEventType,
+                                          mdMethodDef* pmdAddOn,
+                                          mdMethodDef* pmdRemoveOn,
+                                          mdMethodDef* pmdFire,
+                                          mdMethodDef rmdOtherMethod[],
+                                          ULONG cMax,
+                                          ULONG* pcOtherMethod) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumMethodSemantics(HCORENUM* phEnum,
+                                                mdMethodDef mb,
+                                                mdToken rEventProp[],
+                                                ULONG cMax,
+                                                ULONG* pcEventProp) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetMethodSemantics(
+      mdMethodDef mb, mdToken tkEventProp, DWORD* pdwSemanticsFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetClassLayout(mdTypeDef td, DWORD* pdwPackSize,
+                                           COR_FIELD_OFFSET rFieldOffset[],
+                                           ULONG cMax, ULONG* pcFieldOffset,
+                                           ULONG* pulClassSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFieldMarshal(mdToken tk,
+                                            PCCOR_SIGNATURE* ppvNativeType,
+                                            ULONG* pcbNativeType) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetRVA(mdToken tk, ULONG* pulCodeRVA,
+                                   DWORD* pdwImplFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetPermissionSetProps(
+      mdPermission pm, DWORD* pdwAction, void const** ppvPermission,
+      ULONG* pcbPermission) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumModuleRefs(HCORENUM* phEnum,
+                                           mdModuleRef rModuleRefs[],
+                                           ULONG cmax,
+                                           ULONG* pcModuleRefs) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetNameFromToken(
+      mdToken tk, MDUTF8CSTR* pszUtf8NamePtr) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumUnresolvedMethods(HCORENUM* phEnum,
+                                                  mdToken rMethods[],
+                                                  ULONG cMax,
+                                                  ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumSignatures(HCORENUM* phEnum,
+                                           mdSignature rSignatures[],
+                                           ULONG cmax,
+                                           ULONG* pcSignatures) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumTypeSpecs(HCORENUM* phEnum,
+                                          mdTypeSpec rTypeSpecs[], ULONG cmax,
+                                          ULONG* pcTypeSpecs) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumUserStrings(HCORENUM* phEnum,
+                                            mdString rStrings[], ULONG cmax,
+                                            ULONG* pcStrings) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetParamForMethodIndex(mdMethodDef md,
+                                                   ULONG ulParamSeq,
+                                                   mdParamDef* ppd) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumCustomAttributes(
+      HCORENUM* phEnum, mdToken tk, mdToken tkType,
+      mdCustomAttribute rCustomAttributes[], ULONG cMax,
+      ULONG* pcCustomAttributes) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetCustomAttributeProps(mdCustomAttribute cv,
+                                                    mdToken* ptkObj,
+                                                    mdToken* ptkType,
+                                                    void const** ppBlob,
+                                                    ULONG* pcbSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFieldProps(mdFieldDef mb, mdTypeDef* pClass,
+                                          LPWSTR szField, ULONG cchField,
+                                          ULONG* pchField, DWORD* pdwAttr,
+                                          PCCOR_SIGNATURE* ppvSigBlob,
+                                          ULONG* pcbSigBlob,
+                                          DWORD* pdwCPlusTypeFlag,
+                                          UVCP_CONSTANT* ppValue,
+                                          ULONG* pcchValue) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetPropertyProps(mdProperty prop, mdTypeDef* pClass,
+                                             LPCWSTR szProperty,
+                                             ULONG cchProperty,
+                                             ULONG* pchProperty,
+                                             DWORD* pdwPropFlags,
+                                             PCCOR_SIGNATURE* ppvSig,
+                                             ULONG* pbSig,
+                                             DWORD* pdwCPlusTypeFlag,
+                                             UVCP_CONSTANT* ppDefaultValue,
+                                             ULONG* pcchDefaultValue,
+                                             mdMethodDef* pmdSetter,
+                                             mdMethodDef* pmdGetter,
+                                             mdMethodDef rmdOtherMethod[],
+                                             ULONG cMax,
+                                             ULONG* pcOtherMethod) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetParamProps(mdParamDef tk, mdMethodDef* pmd,
+                                          ULONG* pulSequence, LPWSTR szName,
+                                          ULONG cchName, ULONG* pchName,
+                                          DWORD* pdwAttr,
+                                          DWORD* pdwCPlusTypeFlag,
+                                          UVCP_CONSTANT* ppValue,
+                                          ULONG* pcchValue) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetCustomAttributeByName(mdToken tkObj,
+                                                     LPCWSTR szName,
+                                                     const void** ppData,
+                                                     ULONG* pcbData) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetNativeCallConvFromSig(
+      void const* pvSig, ULONG cbSig, ULONG* pCallConv) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE IsGlobal(mdToken pd, int* pbGlobal) override {
+    return E_NOTIMPL;
+  }
+
+  // IMetaDataImport2
+  HRESULT STDMETHODCALLTYPE EnumGenericParams(HCORENUM* phEnum, mdToken tk,
+                                              mdGenericParam rGenericParams[],
+                                              ULONG cMax,
+                                              ULONG* pcGenericParams) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetGenericParamProps(mdGenericParam gp,
+                                                 ULONG* pulParamSeq,
+                                                 DWORD* pdwParamFlags,
+                                                 mdToken* ptOwner,
+                                                 DWORD* reserved, LPWSTR wzname,
+                                                 ULONG cchName,
+                                                 ULONG* pchName) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumGenericParamConstraints(
+      HCORENUM* phEnum, mdGenericParam tk,
+      mdGenericParamConstraint rGenericParamConstraints[], ULONG cMax,
+      ULONG* pcGenericParamConstraints) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetGenericParamConstraintProps(
+      mdGenericParamConstraint gpc, mdGenericParam* ptGenericParam,
+      mdToken* ptkConstraintType) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetPEKind(DWORD* pdwPEKind,
+                                      DWORD* pdwMAchine) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetVersionString(LPWSTR pwzBuf, DWORD ccBufSize,
+                                             DWORD* pccBufSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumMethodSpecs(HCORENUM* phEnum, mdToken tk,
+                                            mdMethodSpec rMethodSpecs[],
+                                            ULONG cMax,
+                                            ULONG* pcMethodSpecs) override {
+    return E_NOTIMPL;
+  }
+
+  // IMetaDataEmit
+  HRESULT STDMETHODCALLTYPE SetModuleProps(LPCWSTR szName) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Save(LPCWSTR szFile, DWORD dwSaveFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SaveToStream(IStream* pIStream,
+                                         DWORD dwSaveFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetSaveSize(CorSaveSize fSave,
+                                        DWORD* pdwSaveSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineNestedType(LPCWSTR szTypeDef,
+                                             DWORD dwTypeDefFlags,
+                                             mdToken tkExtends,
+                                             mdToken rtkImplements[],
+                                             mdTypeDef tdEncloser,
+                                             mdTypeDef* ptd) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetHandler(IUnknown* pUnk) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineMethodImpl(mdTypeDef td, mdToken tkBody,
+                                             mdToken tkDecl) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineImportType(
+      IMetaDataAssemblyImport* pAssemImport, const void* pbHashValue,
+      ULONG cbHashValue, IMetaDataImport* pImport, mdTypeDef tdImport,
+      IMetaDataAssemblyEmit* pAssemEmit, mdTypeRef* ptr) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineImportMember(
+      IMetaDataAssemblyImport* pAssemImport, const void* pbHashValue,
+      ULONG cbHashValue, IMetaDataImport* pImport, mdToken mbMember,
+      IMetaDataAssemblyEmit* pAssemEmit, mdToken tkParent,
+      mdMemberRef* pmr) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineEvent(mdTypeDef td, LPCWSTR szEvent,
+                                        DWORD dwEventFlags, mdToken tkEventType,
+                                        mdMethodDef mdAddOn,
+                                        mdMethodDef mdRemoveOn,
+                                        mdMethodDef mdFire,
+                                        mdMethodDef rmdOtherMethods[],
+                                        mdEvent* pmdEvent) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetClassLayout(mdTypeDef td, DWORD dwPackSize,
+                                           COR_FIELD_OFFSET rFieldOffsets[],
+                                           ULONG ulClassSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DeleteClassLayout(mdTypeDef td) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFieldMarshal(mdToken tk,
+                                            PCCOR_SIGNATURE pvNativeType,
+                                            ULONG cbNativeType) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DeleteFieldMarshal(mdToken tk) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefinePermissionSet(mdToken tk, DWORD dwAction,
+                                                void const* pvPermission,
+                                                ULONG cbPermission,
+                                                mdPermission* ppm) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetRVA(mdMethodDef md, ULONG ulRVA) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetParent(mdMemberRef mr, mdToken tk) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SaveToMemory(void* pbData, ULONG cbData) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DeleteToken(mdToken tkObj) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetMethodProps(mdMethodDef md, DWORD dwMethodFlags,
+                                           ULONG ulCodeRVA,
+                                           DWORD dwImplFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetTypeDefProps(mdTypeDef td, DWORD dwTypeDefFlags,
+                                            mdToken tkExtends,
+                                            mdToken rtkImplements[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetEventProps(
+      mdEvent ev, DWORD dwEventFlags, mdToken tkEventType, mdMethodDef mdAddOn,
+      mdMethodDef mdRemoveOn, mdMethodDef mdFire,
+      mdMethodDef rmdOtherMethods[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetPermissionSetProps(mdToken tk, DWORD dwAction,
+                                                  void const* pvPermission,
+                                                  ULONG cbPermission,
+                                                  mdPermission* ppm) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetPinvokeMap(mdToken tk, DWORD dwMappingFlags,
+                                          LPCWSTR szImportName,
+                                          mdModuleRef mrImportDLL) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineCustomAttribute(
+      mdToken tkOwner, mdToken tkCtor, void const* pCustomAttribute,
+      ULONG cbCustomAttribute, mdCustomAttribute* pcv) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetCustomAttributeValue(
+      mdCustomAttribute pcv, void const* pCustomAttribute,
+      ULONG cbCustomAttribute) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineProperty(mdTypeDef td, LPCWSTR szProperty,
+                                           DWORD dwPropFlags,
+                                           PCCOR_SIGNATURE pvSig, ULONG cbSig,
+                                           DWORD dwCPlusTypeFlag,
+                                           void const* pValue, ULONG cchValue,
+                                           mdMethodDef mdSetter,
+                                           mdMethodDef mdGetter,
+                                           mdMethodDef rmdOtherMethods[],
+                                           mdProperty* pmdProp) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineParam(mdMethodDef md, ULONG ulParamSeq,
+                                        LPCWSTR szName, DWORD dwParamFlags,
+                                        DWORD dwCPlusTypeFlag,
+                                        void const* pValue, ULONG cchValue,
+                                        mdParamDef* ppd) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFieldProps(mdFieldDef fd, DWORD dwFieldFlags,
+                                          DWORD dwCPlusTypeFlag,
+                                          void const* pValue,
+                                          ULONG cchValue) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetPropertyProps(
+      mdProperty pr, DWORD dwPropFlags, DWORD dwCPlusTypeFlag,
+      void const* pValue, ULONG cchValue, mdMethodDef mdSetter,
+      mdMethodDef mdGetter, mdMethodDef rmdOtherMethods[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetParamProps(mdParamDef pd, LPCWSTR szName,
+                                          DWORD dwParamFlags,
+                                          DWORD dwCPlusTypeFlag,
+                                          void const* pValue,
+                                          ULONG cchValue) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineSecurityAttributeSet(
+      mdToken tkObj, COR_SECATTR rSecAttrs[], ULONG cSecAttrs,
+      ULONG* pulErrorAttr) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE ApplyEditAndContinue(IUnknown* pImport) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE TranslateSigWithScope(
+      IMetaDataAssemblyImport* pAssemImport, const void* pbHashValue,
+      ULONG cbHashValue, IMetaDataImport* import, PCCOR_SIGNATURE pbSigBlob,
+      ULONG cbSigBlob, IMetaDataAssemblyEmit* pAssemEmit, IMetaDataEmit* emit,
+      PCOR_SIGNATURE pvTranslatedSig, ULONG cbTranslatedSigMax,
+      ULONG* pcbTranslatedSig) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFieldRVA(mdFieldDef fd, ULONG ulRVA) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Merge(IMetaDataImport* pImport,
+                                  IMapToken* pHostMapToken,
+                                  IUnknown* pHandler) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE MergeEnd() override { return E_NOTIMPL; }
+
+  // IMetaDataEmit2
+  HRESULT STDMETHODCALLTYPE GetDeltaSaveSize(CorSaveSize fSave,
+                                             DWORD* pdwSaveSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SaveDelta(LPCWSTR szFile,
+                                      DWORD dwSaveFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SaveDeltaToStream(IStream* pIStream,
+                                              DWORD dwSaveFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SaveDeltaToMemory(void* pbData,
+                                              ULONG cbData) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineGenericParam(mdToken tk, ULONG ulParamSeq,
+                                               DWORD dwParamFlags,
+                                               LPCWSTR szname, DWORD reserved,
+                                               mdToken rtkConstraints[],
+                                               mdGenericParam* pgp) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetGenericParamProps(
+      mdGenericParam gp, DWORD dwParamFlags, LPCWSTR szName, DWORD reserved,
+      mdToken rtkConstraints[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE ResetENCLog() override { return E_NOTIMPL; }
+
+  // IMetaDataAssemblyImport
+  HRESULT STDMETHODCALLTYPE GetFileProps(mdFile mdf, LPWSTR szName,
+                                         ULONG cchName, ULONG* pchName,
+                                         const void** ppbHashValue,
+                                         ULONG* pcbHashValue,
+                                         DWORD* pdwFileFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetExportedTypeProps(
+      mdExportedType mdct, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      mdToken* ptkImplementation, mdTypeDef* ptkTypeDef,
+      DWORD* pdwExportedTypeFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetManifestResourceProps(
+      mdManifestResource mdmr, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      mdToken* ptkImplementation, DWORD* pdwOffset,
+      DWORD* pdwResourceFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumFiles(HCORENUM* phEnum, mdFile rFiles[],
+                                      ULONG cMax, ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumExportedTypes(HCORENUM* phEnum,
+                                              mdExportedType rExportedTypes[],
+                                              ULONG cMax,
+                                              ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumManifestResources(
+      HCORENUM* phEnum, mdManifestResource rManifestResources[], ULONG cMax,
+      ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindExportedTypeByName(
+      LPCWSTR szName, mdToken mdtExportedType,
+      mdExportedType* ptkExportedType) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindManifestResourceByName(
+      LPCWSTR szName, mdManifestResource* ptkManifestResource) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindAssembliesByName(LPCWSTR szAppBase,
+                                                 LPCWSTR szPrivateBin,
+                                                 LPCWSTR szAssemblyName,
+                                                 IUnknown* ppIUnk[], ULONG cMax,
+                                                 ULONG* pcAssemblies) override {
+    return E_NOTIMPL;
+  }
+
+  // IMetaDataAssemblyEmit
+  HRESULT STDMETHODCALLTYPE DefineAssembly(const void* pbPublicKey,
+                                           ULONG cbPublicKey, ULONG ulHashAlgId,
+                                           LPCWSTR szName,
+                                           const ASSEMBLYMETADATA* pMetaData,
+                                           DWORD dwAssemblyFlags,
+                                           mdAssembly* pma) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineFile(LPCWSTR szName, const void* pbHashValue,
+                                       ULONG cbHashValue, DWORD dwFileFlags,
+                                       mdFile* pmdf) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineExportedType(LPCWSTR szName,
+                                               mdToken tkImplementation,
+                                               mdTypeDef tkTypeDef,
+                                               DWORD dwExportedTypeFlags,
+                                               mdExportedType* pmdct) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE DefineManifestResource(
+      LPCWSTR szName, mdToken tkImplementation, DWORD dwOffset,
+      DWORD dwResourceFlags, mdManifestResource* pmdmr) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetAssemblyProps(mdAssembly pma,
+                                             const void* pbPublicKey,
+                                             ULONG cbPublicKey,
+                                             ULONG ulHashAlgId, LPCWSTR szName,
+                                             const ASSEMBLYMETADATA* pMetaData,
+                                             DWORD dwAssemblyFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetAssemblyRefProps(
+      mdAssemblyRef ar, const void* pbPublicKeyOrToken,
+      ULONG cbPublicKeyOrToken, LPCWSTR szName,
+      const ASSEMBLYMETADATA* pMetaData, const void* pbHashValue,
+      ULONG cbHashValue, DWORD dwAssemblyRefFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFileProps(mdFile file, const void* pbHashValue,
+                                         ULONG cbHashValue,
+                                         DWORD dwFileFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetExportedTypeProps(
+      mdExportedType ct, mdToken tkImplementation, mdTypeDef tkTypeDef,
+      DWORD dwExportedTypeFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetManifestResourceProps(
+      mdManifestResource mr, mdToken tkImplementation, DWORD dwOffset,
+      DWORD dwResourceFlags) override {
+    return E_NOTIMPL;
+  }
+
+
+ private:
+  struct TypeDefRow {
+    WSTRING name;
+    DWORD flags;
+    mdToken extends;
+    std::vector<mdMethodDef> methods;
+  };
+
+  struct MethodDefRow {
+    mdTypeDef parent;
+    WSTRING name;
+    DWORD flags;
+    DWORD impl_flags;
+    std::vector<BYTE> signature;
+    std::vector<BYTE> body;
+    DWORD pinvoke_flags;
+    WSTRING pinvoke_name;
+    mdModuleRef pinvoke_module;
+  };
+
+  struct FieldRow {
+    mdTypeDef parent;
+    WSTRING name;
+    DWORD flags;
+    std::vector<BYTE> signature;
+  };
+
+  struct TypeRefRow {
+    mdToken scope;
+    WSTRING name;
+  };
+
+  struct MemberRefRow {
+    mdToken parent;
+    WSTRING name;
+    std::vector<BYTE> signature;
+  };
+
+  struct MethodSpecRow {
+    mdToken parent;
+    std::vector<BYTE> signature;
+  };
+
+  std::atomic<ULONG> ref_count_{1};
+  const FakeAssemblyDefinition assembly_;
+  const GUID mvid_;
+
+  // rows are never moved once added, so the signatures and names handed out
+  // stay valid while the metadata is alive
+  mutable std::mutex lock_;
+  std::deque<FakeAssemblyDefinition> assembly_refs_;
+  std::deque<TypeDefRow> type_defs_;
+  std::deque<MethodDefRow> method_defs_;
+  std::deque<FieldRow> fields_;
+  std::deque<TypeRefRow> type_refs_;
+  std::deque<MemberRefRow> member_refs_;
+  std::deque<WSTRING> module_refs_;
+  std::deque<std::vector<BYTE>> type_specs_;
+  std::deque<std::vector<BYTE>> signatures_;
+  std::deque<MethodSpecRow> method_specs_;
+  std::deque<WSTRING> user_strings_;
+
+  // Starts an enumeration with the tokens returned by get_tokens (under the
+  // lock) on the first call, then returns the next tokens
+  template <typename GetTokens>
+  HRESULT Enumerate(HCORENUM* phEnum, GetTokens get_tokens, mdToken tokens[],
+                    ULONG cMax, ULONG* pcTokens);
+};
+
+}  // namespace trace
@@ -0,0 +1,397 @@
+#include "fake_profiler_info.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace trace {
+
+namespace {
+
+// a FunctionID is the ModuleID followed by the RID of the method, so it can
+// be decoded without a lookup and still fits in 32 bits
+const int kFunctionRidBits = 20;
+const FunctionID kFunctionRidMask = ((FunctionID)1 << kFunctionRidBits) - 1;
+
+HRESULT CopyName(const WSTRING& name, WCHAR buffer[], ULONG buffer_size,
+                 ULONG* name_size) {
+  const ULONG size = (ULONG)name.size() + 1;
+  if (name_size != nullptr) {
+    *name_size = size;
+  }
+  if (buffer == nullptr || buffer_size == 0) {
+    return S_OK;
+  }
+
+  const ULONG copied = std::min(size, buffer_size);
+  memcpy(buffer, name.c_str(), (copied - 1) * sizeof(WCHAR));
+  buffer[copied - 1] = 0;
+  return S_OK;
+}
+
+}  // namespace
+
+class FakeProfilerInfo::MethodMalloc : public IMethodMalloc {
+ public:
+  explicit MethodMalloc(FakeProfilerInfo* info) : info_(info) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void** ppvObject) override {
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+  ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+  PVOID STDMETHODCALLTYPE Alloc(ULONG cb) override {
+    return info_->Allocate(cb);
+  }
+
+ private:
+  FakeProfilerInfo* info_;
+};
+
+FakeProfilerInfo::FakeProfilerInfo()
+    : modules_(new Module[kMaxModules]),
+      method_malloc_(new MethodMalloc(this)) {}
+
+FakeProfilerInfo::~FakeProfilerInfo() = default;
+
+ModuleID FakeProfilerInfo::AddModule(const FakeModuleDefinition& definition,
+                                     AppDomainID app_domain_id) {
+  const auto fake_metadata = new FakeMetadata(definition);
+
+  ComPtr<IUnknown> metadata;
+  metadata.Attach(static_cast<IMetaDataImport2*>(fake_metadata));
+
+  return Register(
+      {definition.assembly.name, app_domain_id, metadata, fake_metadata});
+}
+
+ModuleID FakeProfilerInfo::AddModule(const WSTRING& assembly_name,
+                                     const ComPtr<IUnknown>& metadata,
+                                     AppDomainID app_domain_id) {
+  return Register({assembly_name, app_domain_id, metadata, nullptr});
+}
+
+ModuleID FakeProfilerInfo::Register(Module&& module) {
+  std::lock_guard<std::mutex> guard(add_module_lock_);
+
+  const size_t count = module_count_.load();
+  if (count == kMaxModules) {
+    return 0;
+  }
+
+  modules_[count] = std::move(module);
+  module_count_.store(count + 1);
+  return count + 1;
+}
+
+const FakeProfilerInfo::Module* FakeProfilerInfo::GetModule(
+    ModuleID module_id) const {
+  if (module_id == 0 || module_id > module_count_.load()) {
+    return nullptr;
+  }
+  return &modules_[module_id - 1];
+}
+
+FakeMetadata* FakeProfilerInfo::GetMetadata(ModuleID module_id) const {
+  const auto module = GetModule(module_id);
+  return module != nullptr ? module->fake_metadata : nullptr;
+}
+
+FunctionID FakeProfilerInfo::GetFunctionId(ModuleID module_id,
+                                           mdMethodDef method_def) {
+  return ((FunctionID)module_id << kFunctionRidBits) |
+         RidFromToken(method_def);
+}
+
+std::vector<std::pair<ModuleID, mdMethodDef>>
+FakeProfilerInfo::TakeReJITRequests() {
+  std::lock_guard<std::mutex> guard(rejit_lock_);
+  std::vector<std::pair<ModuleID, mdMethodDef>> requests;
+  requests.swap(rejit_requests_);
+  return requests;
+}
+
+std::vector<size_t> FakeProfilerInfo::TakeReJITBatchSizes() {
+  std::lock_guard<std::mutex> guard(rejit_lock_);
+  std::vector<size_t> sizes;
+  sizes.swap(rejit_batch_sizes_);
+  return sizes;
+}
+
+void FakeProfilerInfo::HoldReJITRequests(bool hold) {
+  {
+    std::lock_guard<std::mutex> guard(rejit_lock_);
+    rejit_held_ = hold;
+  }
+  rejit_condition_.notify_all();
+}
+
+void FakeProfilerInfo::WaitForReJITRequests(size_t calls) {
+  std::unique_lock<std::mutex> lock(rejit_lock_);
+  rejit_condition_.wait(lock, [&] { return rejit_calls_ >= calls; });
+}
+
+std::vector<BYTE> FakeProfilerInfo::GetRewrittenBody(
+    ModuleID module_id, mdMethodDef method_def) const {
+  std::lock_guard<std::mutex> guard(bodies_lock_);
+  const auto findRes = rewritten_bodies_.find({module_id, method_def});
+  if (findRes == rewritten_bodies_.end()) {
+    return {};
+  }
+  const auto& body = findRes->second;
+  return std::vector<BYTE>(body.first, body.first + body.second);
+}
+
+LPBYTE FakeProfilerInfo::Allocate(ULONG size) {
+  std::lock_guard<std::mutex> guard(bodies_lock_);
+  allocations_.emplace_back(new BYTE[size]());
+  const LPBYTE allocation = allocations_.back().get();
+  allocation_sizes_[allocation] = size;
+  return allocation;
+}
+
+//
+// IUnknown
+//
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::QueryInterface(REFIID riid,
+                                                           void** ppvObject) {
+  if (ppvObject == nullptr) {
+    return E_POINTER;
+  }
+
+  if (riid == IID_IUnknown || riid == IID_ICorProfilerInfo ||
+      riid == IID_ICorProfilerInfo2 || riid == IID_ICorProfilerInfo3 ||
+      riid == IID_ICorProfilerInfo4) {
+    *ppvObject = static_cast<ICorProfilerInfo4*>(this);
+    return S_OK;
+  }
+
+  *ppvObject = nullptr;
+  return E_NOINTERFACE;
+}
+
+//
+// ICorProfilerInfo
+//
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetEventMask(DWORD* pdwEvents) {
+  *pdwEvents = event_mask_.load();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetFunctionFromToken(
+    ModuleID moduleId, mdToken token, FunctionID* pFunctionId) {
+  if (GetModule(moduleId) == nullptr || TypeFromToken(token) != mdtMethodDef) {
+    return E_INVALIDARG;
+  }
+  *pFunctionId = GetFunctionId(moduleId, token);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetFunctionInfo(
+    FunctionID functionId, ClassID* pClassId, ModuleID* pModuleId,
+    mdToken* pToken) {
+  const ModuleID module_id = functionId >> kFunctionRidBits;
+  if (GetModule(module_id) == nullptr) {
+    return E_INVALIDARG;
+  }
+  if (pClassId != nullptr) {
+    *pClassId = 0;
+  }
+  if (pModuleId != nullptr) {
+    *pModuleId = module_id;
+  }
+  if (pToken != nullptr) {
+    *pToken =
+        TokenFromRid((ULONG)(functionId & kFunctionRidMask), mdtMethodDef);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::SetEventMask(DWORD dwEvents) {
+  event_mask_.store(dwEvents);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetTokenAndMetaDataFromFunction(
+    FunctionID functionId, REFIID riid, IUnknown** ppImport, mdToken* pToken) {
+  ModuleID module_id;
+  const HRESULT hr = GetFunctionInfo(functionId, nullptr, &module_id, pToken);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  return GetModuleMetaData(module_id, ofRead, riid, ppImport);
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetModuleInfo(
+    ModuleID moduleId, LPCBYTE* ppBaseLoadAddress, ULONG cchName,
+    ULONG* pcchName, WCHAR szName[], AssemblyID* pAssemblyId) {
+  return GetModuleInfo2(moduleId, ppBaseLoadAddress, cchName, pcchName, szName,
+                        pAssemblyId, nullptr);
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetModuleMetaData(
+    ModuleID moduleId, DWORD dwOpenFlags, REFIID riid, IUnknown** ppOut) {
+  const auto module = GetModule(moduleId);
+  if (module == nullptr) {
+    return E_INVALIDARG;
+  }
+  return module->metadata->QueryInterface(riid, (void**)ppOut);
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetILFunctionBody(
+    ModuleID moduleId, mdMethodDef methodId, LPCBYTE* ppMethodHeader,
+    ULONG* pcbMethodSize) {
+  const auto module = GetModule(moduleId);
+  if (module == nullptr) {
+    return E_INVALIDARG;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(bodies_lock_);
+    const auto findRes = rewritten_bodies_.find({moduleId, methodId});
+    if (findRes != rewritten_bodies_.end()) {
+      *ppMethodHeader = findRes->second.first;
+      if (pcbMethodSize != nullptr) {
+        *pcbMethodSize = findRes->second.second;
+      }
+      return S_OK;
+    }
+  }
+
+  if (module->fake_metadata == nullptr) {
+    return CORPROF_E_FUNCTION_NOT_IL;
+  }
+  return module->fake_metadata->GetMethodBody(methodId, ppMethodHeader,
+                                              pcbMethodSize);
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetILFunctionBodyAllocator(
+    ModuleID moduleId, IMethodMalloc** ppMalloc) {
+  if (GetModule(moduleId) == nullptr) {
+    return E_INVALIDARG;
+  }
+  *ppMalloc = method_malloc_.get();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::SetILFunctionBody(
+    ModuleID moduleId, mdMethodDef methodid, LPCBYTE pbNewILMethodHeader) {
+  if (GetModule(moduleId) == nullptr) {
+    return E_INVALIDARG;
+  }
+
+  // like the runtime, only bodies from the allocator are accepted
+  std::lock_guard<std::mutex> guard(bodies_lock_);
+  const auto findRes = allocation_sizes_.find(pbNewILMethodHeader);
+  if (findRes == allocation_sizes_.end()) {
+    return E_INVALIDARG;
+  }
+  rewritten_bodies_[{moduleId, methodid}] = {pbNewILMethodHeader,
+                                             findRes->second};
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetAppDomainInfo(
+    AppDomainID appDomainId, ULONG cchName, ULONG* pcchName, WCHAR szName[],
+    ProcessID* pProcessId) {
+  if (pProcessId != nullptr) {
+    *pProcessId = 0;
+  }
+  return CopyName(WStr("AppDomain ") + ToWSTRING((uint64_t)appDomainId),
+                  szName, cchName, pcchName);
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetAssemblyInfo(
+    AssemblyID assemblyId, ULONG cchName, ULONG* pcchName, WCHAR szName[],
+    AppDomainID* pAppDomainId, ModuleID* pModuleId) {
+  // every assembly has a single module, with the same id
+  const auto module = GetModule(assemblyId);
+  if (module == nullptr) {
+    return E_INVALIDARG;
+  }
+  if (pAppDomainId != nullptr) {
+    *pAppDomainId = module->app_domain_id;
+  }
+  if (pModuleId != nullptr) {
+    *pModuleId = assemblyId;
+  }
+  return CopyName(module->assembly_name, szName, cchName, pcchName);
+}
+
+//
+// ICorProfilerInfo3
+//
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetRuntimeInformation(
+    USHORT* pClrInstanceId, COR_PRF_RUNTIME_TYPE* pRuntimeType,
+    USHORT* pMajorVersion, USHORT* pMinorVersion, USHORT* pBuildNumber,
+    USHORT* pQFEVersion, ULONG cchVersionString, ULONG* pcchVersionString,
+    WCHAR szVersionString[]) {
+  if (pClrInstanceId != nullptr) {
+    *pClrInstanceId = 0;
+  }
+  if (pRuntimeType != nullptr) {
+    *pRuntimeType = COR_PRF_CORE_CLR;
+  }
+  if (pMajorVersion != nullptr) {
+    *pMajorVersion = 5;
+  }
+  if (pMinorVersion != nullptr) {
+    *pMinorVersion = 0;
+  }
+  if (pBuildNumber != nullptr) {
+    *pBuildNumber = 0;
+  }
+  if (pQFEVersion != nullptr) {
+    *pQFEVersion = 0;
+  }
+  return CopyName(WStr("5.0.0"), szVersionString, cchVersionString,
+                  pcchVersionString);
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::GetModuleInfo2(
+    ModuleID moduleId, LPCBYTE* ppBaseLoadAddress, ULONG cchName,
+    ULONG* pcchName, WCHAR szName[], AssemblyID* pAssemblyId,
+    DWORD* pdwModuleFlags) {
+  const auto module = GetModule(moduleId);
+  if (module == nullptr) {
+    return E_INVALIDARG;
+  }
+  if (ppBaseLoadAddress != nullptr) {
+    *ppBaseLoadAddress = nullptr;
+  }
+  if (pAssemblyId != nullptr) {
+    *pAssemblyId = moduleId;
+  }
+  if (pdwModuleFlags != nullptr) {
+    *pdwModuleFlags = COR_PRF_MODULE_DISK;
+  }
+  return CopyName(module->assembly_name + WStr(".dll"), szName, cchName,
+                  pcchName);
+}
+
+//
+// ICorProfilerInfo4
+//
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::InitializeCurrentThread() {
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE FakeProfilerInfo::RequestReJIT(
+    ULONG cFunctions, ModuleID moduleIds[], mdMethodDef methodIds[]) {
+  std::unique_lock<std::mutex> lock(rejit_lock_);
+  for (ULONG i = 0; i < cFunctions; i++) {
+    rejit_requests_.emplace_back(moduleIds[i], methodIds[i]);
+  }
+  rejit_batch_sizes_.push_back(cFunctions);
+  rejit_calls_++;
+  rejit_condition_.notify_all();
+  rejit_condition_.wait(lock, [&] { return !rejit_held_; });
+  return S_OK;
+}
+
+}  // namespace trace
@@ -0,0 +1,506 @@
+#pragma once
+
+#include <corhlpr.h>
+#include <corprof.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/com_ptr.h"
+#include "fake_metadata.h"
+
+namespace trace {
+
+// Stands in for the runtime when the profiler sets the IL of a ReJIT method,
+// it keeps a copy of the body.
+class FakeFunctionControl : public ICorProfilerFunctionControl {
+ public:
+  std::vector<BYTE> body;
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void** ppvObject) override {
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+  ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+  HRESULT STDMETHODCALLTYPE SetCodegenFlags(DWORD flags) override {
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE SetILFunctionBody(
+      ULONG cbNewILMethodHeader, LPCBYTE pbNewILMethodHeader) override {
+    body.assign(pbNewILMethodHeader,
+                pbNewILMethodHeader + cbNewILMethodHeader);
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE SetILInstrumentedCodeMap(
+      ULONG cILMapEntries, COR_IL_MAP rgILMapEntries[]) override {
+    return S_OK;
+  }
+};
+
+// FakeProfilerInfo stands in for the runtime behind ICorProfilerInfo4, so the
+// CorProfiler callbacks can be driven without a CLR: a test registers modules,
+// then calls ModuleLoadFinished, JITCompilationStarted, GetReJITParameters...
+// from as many threads as it wants.
+//
+// A module is backed by a FakeMetadata, or by any metadata scope such as an
+// assembly opened from disk with the metadata dispenser (its methods have no
+// IL body then). Only the members used by the profiler are implemented, the
+// others return E_NOTIMPL. ReJIT requests are only recorded, the test decides
+// when to deliver them. The object is not reference counted, it must outlive
+// the profiler.
+class FakeProfilerInfo : public ICorProfilerInfo4 {
+ public:
+  static const size_t kMaxModules = 4095;
+
+  FakeProfilerInfo();
+  ~FakeProfilerInfo();
+
+  // Registers a module with synthetic metadata and returns its ModuleID
+  ModuleID AddModule(const FakeModuleDefinition& definition,
+                     AppDomainID app_domain_id = 1);
+
+  // Registers a module backed by the given metadata scope and returns its
+  // ModuleID
+  ModuleID AddModule(const WSTRING& assembly_name,
+                     const ComPtr<IUnknown>& metadata,
+                     AppDomainID app_domain_id = 1);
+
+  // Returns the synthetic metadata of a module, or nullptr
+  FakeMetadata* GetMetadata(ModuleID module_id) const;
+
+  // Returns the FunctionID the runtime would pass to JITCompilationStarted
+  static FunctionID GetFunctionId(ModuleID module_id, mdMethodDef method_def);
+
+  // Returns and forgets the methods requested with RequestReJIT
+  std::vector<std::pair<ModuleID, mdMethodDef>> TakeReJITRequests();
+
+  // Returns and forgets the number of methods of each RequestReJIT call
+  std::vector<size_t> TakeReJITBatchSizes();
+
+  // While held, RequestReJIT blocks until released, so a test can queue
+  // requests behind the one in flight
+  void HoldReJITRequests(bool hold);
+
+  // Waits until RequestReJIT has been called the given number of times
+  void WaitForReJITRequests(size_t calls);
+
+  // Returns the body set with SetILFunctionBody, empty if there is none
+  std::vector<BYTE> GetRewrittenBody(ModuleID module_id,
+                                     mdMethodDef method_def) const;
+
+  // IUnknown
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void** ppvObject) override;
+  ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+  ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+  // ICorProfilerInfo
+  HRESULT STDMETHODCALLTYPE GetEventMask(DWORD* pdwEvents) override;
+  HRESULT STDMETHODCALLTYPE GetFunctionFromToken(
+      ModuleID moduleId, mdToken token, FunctionID* pFunctionId) override;
+  HRESULT STDMETHODCALLTYPE GetFunctionInfo(FunctionID functionId,
+                                            ClassID* pClassId,
+                                            ModuleID* pModuleId,
+                                            mdToken* pToken) override;
+  HRESULT STDMETHODCALLTYPE SetEventMask(DWORD dwEvents) override;
+  HRESULT STDMETHODCALLTYPE GetTokenAndMetaDataFromFunction(
+      FunctionID functionId, REFIID riid, IUnknown** ppImport,
+      mdToken* pToken) override;
+  HRESULT STDMETHODCALLTYPE GetModuleInfo(ModuleID moduleId,
+                                          LPCBYTE* ppBaseLoadAddress,
+                                          ULONG cchName, ULONG* pcchName,
+                                          WCHAR szName[],
+                                          AssemblyID* pAssemblyId) override;
+  HRESULT STDMETHODCALLTYPE GetModuleMetaData(ModuleID moduleId,
+                                              DWORD dwOpenFlags, REFIID riid,
+                                              IUnknown** ppOut) override;
+  HRESULT STDMETHODCALLTYPE GetILFunctionBody(ModuleID moduleId,
+                                              mdMethodDef methodId,
+                                              LPCBYTE* ppMethodHeader,
+                                              ULONG* pcbMethodSize) override;
+  HRESULT STDMETHODCALLTYPE GetILFunctionBodyAllocator(
+      ModuleID moduleId, IMethodMalloc** ppMalloc) override;
+  HRESULT STDMETHODCALLTYPE SetILFunctionBody(
+      ModuleID moduleId, mdMethodDef methodid,
+      LPCBYTE pbNewILMethodHeader) override;
+  HRESULT STDMETHODCALLTYPE GetAppDomainInfo(AppDomainID appDomainId,
+                                             ULONG cchName, ULONG* pcchName,
+                                             WCHAR szName[],
+                                             ProcessID* pProcessId) override;
+  HRESULT STDMETHODCALLTYPE GetAssemblyInfo(AssemblyID assemblyId,
+                                            ULONG cchName, ULONG* pcchName,
+                                            WCHAR szName[],
+                                            AppDomainID* pAppDomainId,
+                                            ModuleID* pModuleId) override;
+
+  // ICorProfilerInfo3
+  HRESULT STDMETHODCALLTYPE GetRuntimeInformation(
+      USHORT* pClrInstanceId, COR_PRF_RUNTIME_TYPE* pRuntimeType,
+      USHORT* pMajorVersion, USHORT* pMinorVersion, USHORT* pBuildNumber,
+      USHORT* pQFEVersion, ULONG cchVersionString, ULONG* pcchVersionString,
+      WCHAR szVersionString[]) override;
+  HRESULT STDMETHODCALLTYPE GetModuleInfo2(ModuleID moduleId,
+                                           LPCBYTE* ppBaseLoadAddress,
+                                           ULONG cchName, ULONG* pcchName,
+                                           WCHAR szName[],
+                                           AssemblyID* pAssemblyId,
+                                           DWORD* pdwModuleFlags) override;
+
+  // ICorProfilerInfo4
+  HRESULT STDMETHODCALLTYPE InitializeCurrentThread() override;
+  HRESULT STDMETHODCALLTYPE RequestReJIT(ULONG cFunctions, ModuleID moduleIds[],
+                                         mdMethodDef methodIds[]) override;
+
+  // Not used by the profiler
+
+  // ICorProfilerInfo
+  HRESULT STDMETHODCALLTYPE GetClassFromObject(ObjectID objectId,
+                                               ClassID* pClassId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetClassFromToken(ModuleID moduleId,
+                                              mdTypeDef typeDef,
+                                              ClassID* pClassId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo(FunctionID functionId, LPCBYTE* pStart,
+                                        ULONG* pcSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromIP(
+      LPCBYTE ip, FunctionID* pFunctionId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetHandleFromThread(ThreadID threadId,
+                                                HANDLE* phThread) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetObjectSize(ObjectID objectId,
+                                          ULONG* pcSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE IsArrayClass(ClassID classId,
+                                         CorElementType* pBaseElemType,
+                                         ClassID* pBaseClassId,
+                                         ULONG* pcRank) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetThreadInfo(ThreadID threadId,
+                                          DWORD* pdwWin32ThreadId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetCurrentThreadID(ThreadID* pThreadId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetClassIDInfo(ClassID classId, ModuleID* pModuleId,
+                                           mdTypeDef* pTypeDefToken) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks(
+      FunctionEnter* pFuncEnter, FunctionLeave* pFuncLeave,
+      FunctionTailcall* pFuncTailcall) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFunctionIDMapper(
+      FunctionIDMapper* pFunc) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFunctionReJIT(FunctionID functionId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE ForceGC() override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetILInstrumentedCodeMap(
+      FunctionID functionId, BOOL fStartJit, ULONG cILMapEntries,
+      COR_IL_MAP rgILMapEntries[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetInprocInspectionInterface(
+      IUnknown** ppicd) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetInprocInspectionIThisThread(
+      IUnknown** ppicd) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetThreadContext(ThreadID threadId,
+                                             ContextID* pContextId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE BeginInprocDebugging(
+      BOOL fThisThreadOnly, DWORD* pdwProfilerContext) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EndInprocDebugging(
+      DWORD dwProfilerContext) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetILToNativeMapping(
+      FunctionID functionId, ULONG32 cMap, ULONG32* pcMap,
+      COR_DEBUG_IL_TO_NATIVE_MAP map[]) override {
+    return E_NOTIMPL;
+  }
+
+  // ICorProfilerInfo2
+  HRESULT STDMETHODCALLTYPE DoStackSnapshot(ThreadID thread,
+                                            StackSnapshotCallback* callback,
+                                            ULONG32 infoFlags, void* clientData,
+                                            BYTE context[],
+                                            ULONG32 contextSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks2(
+      FunctionEnter2* pFuncEnter, FunctionLeave2* pFuncLeave,
+      FunctionTailcall2* pFuncTailcall) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionInfo2(FunctionID funcId,
+                                             COR_PRF_FRAME_INFO frameInfo,
+                                             ClassID* pClassId,
+                                             ModuleID* pModuleId,
+                                             mdToken* pToken, ULONG32 cTypeArgs,
+                                             ULONG32* pcTypeArgs,
+                                             ClassID typeArgs[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetStringLayout(ULONG* pBufferLengthOffset,
+                                            ULONG* pStringLengthOffset,
+                                            ULONG* pBufferOffset) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetClassLayout(ClassID classID,
+                                           COR_FIELD_OFFSET rFieldOffset[],
+                                           ULONG cFieldOffset,
+                                           ULONG* pcFieldOffset,
+                                           ULONG* pulClassSize) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetClassIDInfo2(ClassID classId,
+                                            ModuleID* pModuleId,
+                                            mdTypeDef* pTypeDefToken,
+                                            ClassID* pParentClassId,
+                                            ULONG32 cNumTypeArgs,
+                                            ULONG32* pcNumTypeArgs,
+                                            ClassID typeArgs[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo2(
+      FunctionID functionID, ULONG32 cCodeInfos, ULONG32* pcCodeInfos,
+      COR_PRF_CODE_INFO codeInfos[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetClassFromTokenAndTypeArgs(
+      ModuleID moduleID, mdTypeDef typeDef, ULONG32 cTypeArgs,
+      ClassID typeArgs[], ClassID* pClassID) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromTokenAndTypeArgs(
+      ModuleID moduleID, mdMethodDef funcDef, ClassID classId,
+      ULONG32 cTypeArgs, ClassID typeArgs[], FunctionID* pFunctionID) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumModuleFrozenObjects(
+      ModuleID moduleID, ICorProfilerObjectEnum** ppEnum) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetArrayObjectInfo(ObjectID objectId,
+                                               ULONG32 cDimensions,
+                                               ULONG32 pDimensionSizes[],
+                                               int pDimensionLowerBounds[],
+                                               BYTE** ppData) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetBoxClassLayout(ClassID classId,
+                                              ULONG32* pBufferOffset) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetThreadAppDomain(
+      ThreadID threadId, AppDomainID* pAppDomainId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetRVAStaticAddress(ClassID classId,
+                                                mdFieldDef fieldToken,
+                                                void** ppAddress) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetAppDomainStaticAddress(
+      ClassID classId, mdFieldDef fieldToken, AppDomainID appDomainId,
+      void** ppAddress) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetThreadStaticAddress(ClassID classId,
+                                                   mdFieldDef fieldToken,
+                                                   ThreadID threadId,
+                                                   void** ppAddress) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetContextStaticAddress(ClassID classId,
+                                                    mdFieldDef fieldToken,
+                                                    ContextID contextId,
+                                                    void** ppAddress) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetStaticFieldInfo(
+      ClassID classId, mdFieldDef fieldToken,
+      COR_PRF_STATIC_TYPE* pFieldInfo) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetGenerationBounds(
+      ULONG cObjectRanges, ULONG* pcObjectRanges,
+      COR_PRF_GC_GENERATION_RANGE ranges[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetObjectGeneration(
+      ObjectID objectId, COR_PRF_GC_GENERATION_RANGE* range) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetNotifiedExceptionClauseInfo(
+      COR_PRF_EX_CLAUSE_INFO* pinfo) override {
+    return E_NOTIMPL;
+  }
+
+  // ICorProfilerInfo3
+  HRESULT STDMETHODCALLTYPE EnumJITedFunctions(
+      ICorProfilerFunctionEnum** ppEnum) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE RequestProfilerDetach(
+      DWORD dwExpectedCompletionMilliseconds) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetFunctionIDMapper2(FunctionIDMapper2* pFunc,
+                                                 void* clientData) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetStringLayout2(ULONG* pStringLengthOffset,
+                                             ULONG* pBufferOffset) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks3(
+      FunctionEnter3* pFuncEnter3, FunctionLeave3* pFuncLeave3,
+      FunctionTailcall3* pFuncTailcall3) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks3WithInfo(
+      FunctionEnter3WithInfo* pFuncEnter3WithInfo,
+      FunctionLeave3WithInfo* pFuncLeave3WithInfo,
+      FunctionTailcall3WithInfo* pFuncTailcall3WithInfo) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionEnter3Info(
+      FunctionID functionId, COR_PRF_ELT_INFO eltInfo,
+      COR_PRF_FRAME_INFO* pFrameInfo, ULONG* pcbArgumentInfo,
+      COR_PRF_FUNCTION_ARGUMENT_INFO* pArgumentInfo) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionLeave3Info(
+      FunctionID functionId, COR_PRF_ELT_INFO eltInfo,
+      COR_PRF_FRAME_INFO* pFrameInfo,
+      COR_PRF_FUNCTION_ARGUMENT_RANGE* pRetvalRange) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionTailcall3Info(
+      FunctionID functionId, COR_PRF_ELT_INFO eltInfo,
+      COR_PRF_FRAME_INFO* pFrameInfo) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumModules(
+      ICorProfilerModuleEnum** ppEnum) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetThreadStaticAddress2(ClassID classId,
+                                                    mdFieldDef fieldToken,
+                                                    AppDomainID appDomainId,
+                                                    ThreadID threadId,
+                                                    void** ppAddress) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetAppDomainsContainingModule(
+      ModuleID moduleId, ULONG32 cAppDomainIds, ULONG32* pcAppDomainIds,
+      AppDomainID appDomainIds[]) override {
+    return E_NOTIMPL;
+  }
+
+  // ICorProfilerInfo4
+  HRESULT STDMETHODCALLTYPE EnumThreads(
+      ICorProfilerThreadEnum** ppEnum) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE RequestRevert(ULONG cFunctions,
+                                          ModuleID moduleIds[],
+                                          mdMethodDef methodIds[],
+                                          HRESULT status[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo3(
+      FunctionID functionID, ReJITID reJitId, ULONG32 cCodeInfos,
+      ULONG32* pcCodeInfos, COR_PRF_CODE_INFO codeInfos[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromIP2(LPCBYTE ip,
+                                               FunctionID* pFunctionId,
+                                               ReJITID* pReJitId) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetReJITIDs(FunctionID functionId, ULONG cReJitIds,
+                                        ULONG* pcReJitIds,
+                                        ReJITID reJitIds[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetILToNativeMapping2(
+      FunctionID functionId, ReJITID reJitId, ULONG32 cMap, ULONG32* pcMap,
+      COR_DEBUG_IL_TO_NATIVE_MAP map[]) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumJITedFunctions2(
+      ICorProfilerFunctionEnum** ppEnum) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetObjectSize2(ObjectID objectId,
+                                           SIZE_T* pcSize) override {
+    return E_NOTIMPL;
+  }
+
+ private:
+  class MethodMalloc;
+
+  struct Module {
+    WSTRING assembly_name;
+    AppDomainID app_domain_id = 0;
+    ComPtr<IUnknown> metadata;
+    FakeMetadata* fake_metadata = nullptr;
+  };
+
+  // modules are only added, so they are read without a lock
+  std::unique_ptr<Module[]> modules_;
+  std::atomic<size_t> module_count_{0};
+  std::mutex add_module_lock_;
+
+  std::atomic<DWORD> event_mask_{0};
+  std::unique_ptr<MethodMalloc> method_malloc_;
+
+  mutable std::mutex bodies_lock_;
+  std::map<LPCBYTE, ULONG> allocation_sizes_;
+  std::vector<std::unique_ptr<BYTE[]>> allocations_;
+  std::map<std::pair<ModuleID, mdMethodDef>, std::pair<LPCBYTE, ULONG>>
+      rewritten_bodies_;
+
+  std::mutex rejit_lock_;
+  std::vector<std::pair<ModuleID, mdMethodDef>> rejit_requests_;
+  std::vector<size_t> rejit_batch_sizes_;
+  std::condition_variable rejit_condition_;
+  size_t rejit_calls_ = 0;
+  bool rejit_held_ = false;
+
+  ModuleID Register(Module&& module);
+  const Module* GetModule(ModuleID module_id) const;
+  LPBYTE Allocate(ULONG size);
+};
+
+}  // namespace trace
@@ -0,0 +1,394 @@
+#include "pch.h"
+
+#include <functional>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/il_rewriter.h"
+#include "fake_profiler_info.h"
+
+using namespace trace;
+
+namespace {
+
+const WSTRING kType = WStr("Samples.Rewritten");
+const std::vector<BYTE> kVoidSignature = {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0,
+                                          ELEMENT_TYPE_VOID};
+const mdSignature kLocalVarSig = 0x11000001;
+const mdTypeRef kExceptionType = 0x01000001;
+
+std::vector<BYTE> TinyBody(const std::vector<BYTE>& code) {
+  std::vector<BYTE> body = {
+      (BYTE)(CorILMethod_TinyFormat | (code.size() << 2))};
+  body.insert(body.end(), code.begin(), code.end());
+  return body;
+}
+
+// Lays out a fat body the way ILRewriter::Export does: the code is padded to
+// 4 bytes and followed by a fat EH section if there are clauses
+std::vector<BYTE> FatBody(
+    const std::vector<BYTE>& code, unsigned max_stack,
+    mdSignature local_var_sig = mdTokenNil,
+    const std::vector<IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT>& clauses = {}) {
+  IMAGE_COR_ILMETHOD_FAT header{};
+  header.Flags = CorILMethod_FatFormat |
+                 (local_var_sig != mdTokenNil ? CorILMethod_InitLocals : 0) |
+                 (clauses.empty() ? 0 : CorILMethod_MoreSects);
+  header.Size = sizeof(IMAGE_COR_ILMETHOD_FAT) / sizeof(DWORD);
+  header.MaxStack = max_stack;
+  header.CodeSize = (DWORD)code.size();
+  header.LocalVarSigTok = local_var_sig;
+
+  std::vector<BYTE> body((BYTE*)&header, (BYTE*)(&header + 1));
+  body.insert(body.end(), code.begin(), code.end());
+  body.resize((body.size() + 3) & ~3);
+
+  if (!clauses.empty()) {
+    IMAGE_COR_ILMETHOD_SECT_FAT section{};
+    section.Kind = CorILMethod_Sect_EHTable | CorILMethod_Sect_FatFormat;
+    section.DataSize =
+        (unsigned)(sizeof(IMAGE_COR_ILMETHOD_SECT_FAT) +
+                   sizeof(IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT) *
+                       clauses.size());
+    body.insert(body.end(), (BYTE*)&section, (BYTE*)(&section + 1));
+    for (const auto& clause : clauses) {
+      body.insert(body.end(), (BYTE*)&clause, (BYTE*)(&clause + 1));
+    }
+  }
+  return body;
+}
+
+IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT Clause(CorExceptionFlag flags,
+                                             DWORD try_offset,
+                                             DWORD try_length,
+                                             DWORD handler_offset,
+                                             DWORD handler_length,
+                                             DWORD token_or_filter = 0) {
+  IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT clause{};
+  clause.Flags = flags;
+  clause.TryOffset = try_offset;
+  clause.TryLength = try_length;
+  clause.HandlerOffset = handler_offset;
+  clause.HandlerLength = handler_length;
+  clause.ClassToken = token_or_filter;
+  return clause;
+}
+
+bool IsTiny(const std::vector<BYTE>& body) {
+  return !body.empty() && (body[0] & 0x3) == CorILMethod_TinyFormat;
+}
+
+std::vector<BYTE> GetCode(const std::vector<BYTE>& body) {
+  COR_ILMETHOD_DECODER decoder((COR_ILMETHOD*)body.data());
+  return std::vector<BYTE>(decoder.Code, decoder.Code + decoder.GetCodeSize());
+}
+
+// Loads a module whose first method, 0x06000001, has the given signature and
+// body and is followed by the other methods, then imports the body, applies
+// the edit and exports it again
+HRESULT Rewrite(const std::vector<BYTE>& body, std::vector<BYTE>* exported,
+                const std::vector<BYTE>& signature = kVoidSignature,
+                const std::vector<FakeMethodDefinition>& other_methods = {},
+                const std::function<void(ILRewriter&)>& edit = nullptr) {
+  FakeProfilerInfo info;
+  FakeModuleDefinition module;
+  module.assembly = {WStr("Samples.Rewritten"), 1, 0, 0, 0};
+  FakeTypeDefinition type;
+  type.name = kType;
+  type.methods = {{WStr("Method"), signature, body}};
+  type.methods.insert(type.methods.end(), other_methods.begin(),
+                      other_methods.end());
+  module.types.push_back(type);
+  const ModuleID module_id = info.AddModule(module);
+  const mdMethodDef method_def =
+      info.GetMetadata(module_id)->GetMethodDef(kType, WStr("Method"));
+
+  ILRewriter rewriter(&info, nullptr, module_id, method_def);
+  HRESULT hr = rewriter.Import();
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (edit != nullptr) {
+    edit(rewriter);
+  }
+  hr = rewriter.Export();
+  if (hr == S_OK) {
+    *exported = info.GetRewrittenBody(module_id, method_def);
+  }
+  return hr;
+}
+
+// Exports a body with locals, so it keeps its fat header, and returns the
+// max stack of the exported header
+HRESULT ComputeMaxStack(
+    const std::vector<BYTE>& code, unsigned* max_stack,
+    const std::vector<IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT>& clauses = {},
+    const std::vector<BYTE>& signature = kVoidSignature,
+    const std::vector<FakeMethodDefinition>& other_methods = {}) {
+  std::vector<BYTE> exported;
+  const HRESULT hr = Rewrite(FatBody(code, 100, kLocalVarSig, clauses),
+                             &exported, signature, other_methods);
+  if (hr == S_OK) {
+    COR_ILMETHOD_DECODER decoder((COR_ILMETHOD*)exported.data());
+    *max_stack = decoder.GetMaxStack();
+  }
+  return hr;
+}
+
+std::vector<BYTE> Nops(size_t count) {
+  return std::vector<BYTE>(count, CEE_NOP);
+}
+
+}  // namespace
+
+TEST(ILRewriterTest, KeepsAFatBodyWithLocalsAndClauses) {
+  // try { nop; leave.s END } catch { pop; leave.s END } END: ret
+  const std::vector<BYTE> code = {CEE_NOP, CEE_LEAVE_S, 0x03, CEE_POP,
+                                  CEE_LEAVE_S, 0x00, CEE_RET};
+  const auto body =
+      FatBody(code, 1, kLocalVarSig,
+              {Clause(COR_ILEXCEPTION_CLAUSE_NONE, 0, 3, 3, 3, kExceptionType)});
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(body, &exported), S_OK);
+  EXPECT_EQ(exported, body);
+}
+
+TEST(ILRewriterTest, KeepsATinyBody) {
+  const auto body = TinyBody({CEE_LDC_I4_1, CEE_POP, CEE_RET});
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(body, &exported), S_OK);
+  EXPECT_EQ(exported, body);
+}
+
+TEST(ILRewriterTest, PromotesAFatBodyThatFitsATinyHeader) {
+  // 63 bytes of code and a max stack of 8
+  std::vector<BYTE> code;
+  for (int i = 0; i < 8; i++) {
+    code.push_back(CEE_LDC_I4_0);
+  }
+  for (int i = 0; i < 8; i++) {
+    code.push_back(CEE_POP);
+  }
+  const auto nops = Nops(46);
+  code.insert(code.end(), nops.begin(), nops.end());
+  code.push_back(CEE_RET);
+  ASSERT_EQ(code.size(), 63);
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(FatBody(code, 8), &exported), S_OK);
+  EXPECT_EQ(exported, TinyBody(code));
+}
+
+TEST(ILRewriterTest, KeepsAFatBodyOverTheTinyCodeSize) {
+  auto code = Nops(63);
+  code.push_back(CEE_RET);
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(FatBody(code, 0), &exported), S_OK);
+  EXPECT_EQ(exported, FatBody(code, 0));
+}
+
+TEST(ILRewriterTest, KeepsAFatBodyOverTheTinyMaxStack) {
+  std::vector<BYTE> code;
+  for (int i = 0; i < 9; i++) {
+    code.push_back(CEE_LDC_I4_0);
+  }
+  for (int i = 0; i < 9; i++) {
+    code.push_back(CEE_POP);
+  }
+  code.push_back(CEE_RET);
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(FatBody(code, 9), &exported), S_OK);
+  EXPECT_EQ(exported, FatBody(code, 9));
+}
+
+TEST(ILRewriterTest, KeepsAFatBodyWithLocals) {
+  const std::vector<BYTE> code = {CEE_RET};
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(FatBody(code, 0, kLocalVarSig), &exported), S_OK);
+  EXPECT_EQ(exported, FatBody(code, 0, kLocalVarSig));
+}
+
+TEST(ILRewriterTest, KeepsAFatBodyWithClauses) {
+  // try { nop; leave.s END } finally { endfinally } END: ret
+  const std::vector<BYTE> code = {CEE_NOP, CEE_LEAVE_S, 0x01, CEE_ENDFINALLY,
+                                  CEE_RET};
+  const auto body =
+      FatBody(code, 0, mdTokenNil,
+              {Clause(COR_ILEXCEPTION_CLAUSE_FINALLY, 0, 3, 3, 1)});
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(body, &exported), S_OK);
+  EXPECT_EQ(exported, body);
+}
+
+TEST(ILRewriterTest, WidensAShortBranchThatNoLongerFits) {
+  // br.s END; END: ret, then 200 nops are inserted after the branch
+  const auto body = TinyBody({CEE_BR_S, 0x00, CEE_RET});
+  const auto insert_nops = [](ILRewriter& rewriter) {
+    ILInstr* branch = rewriter.GetILList()->m_pNext;
+    for (int i = 0; i < 200; i++) {
+      ILInstr* nop = rewriter.NewILInstr();
+      nop->m_opcode = CEE_NOP;
+      rewriter.InsertAfter(branch, nop);
+    }
+  };
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(body, &exported, kVoidSignature, {}, insert_nops), S_OK);
+
+  std::vector<BYTE> code = {CEE_BR, 200, 0x00, 0x00, 0x00};
+  const auto nops = Nops(200);
+  code.insert(code.end(), nops.begin(), nops.end());
+  code.push_back(CEE_RET);
+  EXPECT_FALSE(IsTiny(exported));
+  EXPECT_EQ(GetCode(exported), code);
+}
+
+TEST(ILRewriterTest, ComputesTheMaxStackOfStraightLineCode) {
+  const std::vector<BYTE> code = {CEE_LDC_I4_1, CEE_LDC_I4_2, CEE_ADD,
+                                  CEE_LDC_I4_3, CEE_ADD,      CEE_POP,
+                                  CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack), S_OK);
+  EXPECT_EQ(max_stack, 2);
+}
+
+TEST(ILRewriterTest, AcceptsBranchesMergingWithTheSameDepth) {
+  // ldc.i4.0; brtrue.s A; ldc.i4.1; br.s B; A: ldc.i4.2; B: pop; ret
+  const std::vector<BYTE> code = {CEE_LDC_I4_0, CEE_BRTRUE_S, 0x03,
+                                  CEE_LDC_I4_1, CEE_BR_S,     0x01,
+                                  CEE_LDC_I4_2, CEE_POP,      CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack), S_OK);
+  EXPECT_EQ(max_stack, 1);
+}
+
+TEST(ILRewriterTest, RejectsBranchesMergingWithDifferentDepths) {
+  // ldc.i4.0; brtrue.s A; ldc.i4.1; A: ret
+  const std::vector<BYTE> code = {CEE_LDC_I4_0, CEE_BRTRUE_S, 0x01,
+                                  CEE_LDC_I4_1, CEE_RET};
+
+  unsigned max_stack = 0;
+  EXPECT_EQ(ComputeMaxStack(code, &max_stack), COR_E_INVALIDPROGRAM);
+}
+
+TEST(ILRewriterTest, FollowsTheSwitchTargets) {
+  // ldc.i4.0; switch (A, B); ldc.i4.1; pop; ret;
+  // A: ldc.i4.2; ldc.i4.3; pop; pop; ret; B: ret
+  const std::vector<BYTE> code = {
+      CEE_LDC_I4_0, CEE_SWITCH,   0x02,    0x00,    0x00,    0x00,
+      0x03,         0x00,         0x00,    0x00,    0x08,    0x00,
+      0x00,         0x00,         CEE_LDC_I4_1,     CEE_POP, CEE_RET,
+      CEE_LDC_I4_2, CEE_LDC_I4_3, CEE_POP, CEE_POP, CEE_RET, CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack), S_OK);
+  EXPECT_EQ(max_stack, 2);
+}
+
+TEST(ILRewriterTest, StartsCatchHandlersWithTheException) {
+  // try { nop; leave.s END } catch { pop; leave.s END } END: ret
+  const std::vector<BYTE> code = {CEE_NOP, CEE_LEAVE_S, 0x03, CEE_POP,
+                                  CEE_LEAVE_S, 0x00, CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack,
+                            {Clause(COR_ILEXCEPTION_CLAUSE_NONE, 0, 3, 3, 3,
+                                    kExceptionType)}),
+            S_OK);
+  EXPECT_EQ(max_stack, 1);
+}
+
+TEST(ILRewriterTest, StartsFiltersWithTheException) {
+  // try { nop; leave.s END } filter { pop; ldc.i4.1; endfilter }
+  // { pop; leave.s END } END: ret
+  const std::vector<BYTE> code = {
+      CEE_NOP, CEE_LEAVE_S, 0x07, CEE_POP,     CEE_LDC_I4_1, 0xFE,
+      0x11,    CEE_POP,     CEE_LEAVE_S, 0x00, CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack,
+                            {Clause(COR_ILEXCEPTION_CLAUSE_FILTER, 0, 3, 7, 3,
+                                    3)}),
+            S_OK);
+  EXPECT_EQ(max_stack, 1);
+}
+
+TEST(ILRewriterTest, StartsFinallyHandlersWithAnEmptyStack) {
+  // try { nop; leave.s END } finally { ldc.i4.0; ldc.i4.0; pop; pop;
+  // endfinally } END: ret
+  const std::vector<BYTE> code = {CEE_NOP,      CEE_LEAVE_S, 0x05,
+                                  CEE_LDC_I4_0, CEE_LDC_I4_0, CEE_POP,
+                                  CEE_POP,      CEE_ENDFINALLY, CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(
+                code, &max_stack,
+                {Clause(COR_ILEXCEPTION_CLAUSE_FINALLY, 0, 3, 3, 5)}),
+            S_OK);
+  EXPECT_EQ(max_stack, 2);
+}
+
+TEST(ILRewriterTest, EmptiesTheStackOnLeave) {
+  // try { ldc.i4.1; leave.s END } catch { pop; leave.s END } END: ret
+  const std::vector<BYTE> code = {CEE_LDC_I4_1, CEE_LEAVE_S, 0x03, CEE_POP,
+                                  CEE_LEAVE_S,  0x00,        CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack,
+                            {Clause(COR_ILEXCEPTION_CLAUSE_NONE, 0, 3, 3, 3,
+                                    kExceptionType)}),
+            S_OK);
+  EXPECT_EQ(max_stack, 1);
+}
+
+TEST(ILRewriterTest, RejectsReturningWithAValueFromAVoidMethod) {
+  const std::vector<BYTE> code = {CEE_LDC_I4_1, CEE_RET};
+
+  unsigned max_stack = 0;
+  EXPECT_EQ(ComputeMaxStack(code, &max_stack), COR_E_INVALIDPROGRAM);
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack, {},
+                            {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0,
+                             ELEMENT_TYPE_I4}),
+            S_OK);
+  EXPECT_EQ(max_stack, 1);
+}
+
+TEST(ILRewriterTest, ReadsTheStackEffectOfCallsFromTheSignature) {
+  // static int Add(int, int) and a constructor taking an int
+  const std::vector<FakeMethodDefinition> methods = {
+      {WStr("Add"),
+       {IMAGE_CEE_CS_CALLCONV_DEFAULT, 2, ELEMENT_TYPE_I4, ELEMENT_TYPE_I4,
+        ELEMENT_TYPE_I4},
+       {}},
+      {WStr(".ctor"),
+       {IMAGE_CEE_CS_CALLCONV_HASTHIS, 1, ELEMENT_TYPE_VOID, ELEMENT_TYPE_I4},
+       {}}};
+  // ldc.i4.1; ldc.i4.2; call Add; ldc.i4.3; newobj .ctor; pop; pop; ret
+  const std::vector<BYTE> code = {
+      CEE_LDC_I4_1, CEE_LDC_I4_2, CEE_CALL,   0x02,    0x00,    0x00,
+      0x06,         CEE_LDC_I4_3, CEE_NEWOBJ, 0x03,    0x00,    0x00,
+      0x06,         CEE_POP,      CEE_POP,    CEE_RET};
+
+  unsigned max_stack = 0;
+  ASSERT_EQ(ComputeMaxStack(code, &max_stack, {}, kVoidSignature, methods),
+            S_OK);
+  EXPECT_EQ(max_stack, 2);
+}
+
+TEST(ILRewriterTest, KeepsTheHeaderMaxStackForAnUnknownSignature) {
+  // the MemberRef doesn't exist, the body can't be made tiny then
+  const std::vector<BYTE> code = {CEE_CALL, 0xFF, 0x00, 0x00, 0x0A, CEE_RET};
+
+  std::vector<BYTE> exported;
+  ASSERT_EQ(Rewrite(FatBody(code, 8), &exported), S_OK);
+  COR_ILMETHOD_DECODER decoder((COR_ILMETHOD*)exported.data());
+  EXPECT_FALSE(IsTiny(exported));
+  EXPECT_GE(decoder.GetMaxStack(), 8);
+}
@@ -0,0 +1,82 @@
+#include "pch.h"
+
+#include <sstream>
+#include <string>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/integration_catalog.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/integration_loader.h"
+
+using namespace trace;
+
+namespace {
+
+std::vector<Integration> LoadTestIntegrations() {
+  std::stringstream str(R"TEXT(
+        [{
+            "name": "test-integration",
+            "method_replacements": [{
+                "caller": { },
+                "target": { "assembly": "Assembly.One", "type": "Type.One", "method": "Method.One", "signature_types": ["System.Void", "_"], "minimum_major": 1, "minimum_minor": 2, "maximum_major": 10, "maximum_minor": 99 },
+                "wrapper": { "assembly": "Assembly.Two, Version=1.0.0.0, Culture=neutral, PublicKeyToken=def86d061d0d2eeb", "type": "Type.Two", "method": "Method.Two", "signature": [0, 1, 1, 28], "action": "CallTargetModification" }
+            }]
+        },
+        {
+            "name": "other-integration",
+            "method_replacements": [{
+                "caller": { "assembly": "Assembly.One" },
+                "target": { "assembly": "Assembly.Three", "type": "Type.Three", "method": "Method.Three" },
+                "wrapper": { "assembly": "Assembly.Two", "type": "Type.Two", "method": "Method.Three", "signature": [0, 1, 1, 28] }
+            }]
+        }]
+    )TEXT");
+  return LoadIntegrationsFromStream(str);
+}
+
+}  // namespace
+
+TEST(IntegrationCatalogTest, RoundTripsIntegrations) {
+  const auto integrations = LoadTestIntegrations();
+  ASSERT_EQ(2, integrations.size());
+
+  const auto catalog = SerializeIntegrationCatalog(integrations);
+  const auto loaded = LoadIntegrationsFromCatalog(catalog.data(), catalog.size());
+
+  EXPECT_EQ(integrations, loaded);
+  EXPECT_EQ(integrations[0].method_replacements[0].target_method.signature_types,
+            loaded[0].method_replacements[0].target_method.signature_types);
+  EXPECT_EQ(integrations[0].method_replacements[0].wrapper_method.action,
+            loaded[0].method_replacements[0].wrapper_method.action);
+}
+
+TEST(IntegrationCatalogTest, HandlesEmptyCatalog) {
+  const auto catalog = SerializeIntegrationCatalog({});
+  const auto loaded = LoadIntegrationsFromCatalog(catalog.data(), catalog.size());
+  EXPECT_EQ(0, loaded.size());
+}
+
+TEST(IntegrationCatalogTest, RejectsMalformedCatalog) {
+  auto catalog = SerializeIntegrationCatalog(LoadTestIntegrations());
+
+  EXPECT_EQ(0, LoadIntegrationsFromCatalog(nullptr, 0).size());
+  EXPECT_EQ(0, LoadIntegrationsFromCatalog(catalog.data(), catalog.size() / 2).size());
+
+  catalog[0] = 0;
+  EXPECT_EQ(0, LoadIntegrationsFromCatalog(catalog.data(), catalog.size()).size());
+}
+
+TEST(IntegrationCatalogTest, OverridesIntegrationsByName) {
+  const auto base = LoadTestIntegrations();
+
+  std::stringstream str(R"TEXT(
+        [{ "name": "other-integration" }, { "name": "new-integration" }]
+    )TEXT");
+  const auto overrides = LoadIntegrationsFromStream(str);
+
+  const auto merged = ApplyIntegrationOverrides(base, overrides);
+  ASSERT_EQ(3, merged.size());
+  EXPECT_STREQ(L"test-integration", merged[0].integration_name.c_str());
+  EXPECT_EQ(1, merged[0].method_replacements.size());
+  EXPECT_STREQ(L"other-integration", merged[1].integration_name.c_str());
+  EXPECT_EQ(0, merged[1].method_replacements.size());
+  EXPECT_STREQ(L"new-integration", merged[2].integration_name.c_str());
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "../../src/Datadog.Trace.ClrProfiler.Native/integration.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/integration_index.h"
 
 using namespace trace;
 
@@ -43,4 +44,40 @@ TEST(IntegrationTest, AssemblyReferencePartialVersion) {
 TEST(IntegrationTest, AssemblyReferenceInvalidVersion) {
   AssemblyReference ref(L"Some.Assembly, Version=xyz");
   EXPECT_EQ(ref.version, Version(0, 0, 0, 0));
-}
\ No newline at end of file
+}
+
+TEST(IntegrationTest, IntegrationIndexLooksUpByTargetAssembly) {
+  MethodReference v1 = {L"Samples.Target", L"SomeType", L"SomeMethod", L"",
+                        Version(1, 0, 0, 0), Version(1, 65535, 65535, 0), {}, {}};
+  MethodReference v2 = {L"Samples.Target", L"SomeType", L"SomeMethod", L"",
+                        Version(2, 0, 0, 0), Version(2, 65535, 65535, 0), {}, {}};
+  MethodReference any = {L"Samples.Target", L"OtherType", L"SomeMethod", L"",
+                         Version(0, 0, 0, 0), Version(65535, 65535, 65535, 0), {}, {}};
+  MethodReference other = {L"Samples.Other", L"SomeType", L"SomeMethod", L"",
+                           Version(0, 0, 0, 0), Version(65535, 65535, 65535, 0), {}, {}};
+
+  IntegrationIndex index(std::make_shared<const std::vector<IntegrationMethod>>(
+      std::vector<IntegrationMethod>{{L"integration-1", {{}, v2, {}}},
+                                     {L"integration-2", {{}, v1, {}}},
+                                     {L"integration-3", {{}, any, {}}},
+                                     {L"integration-4", {{}, other, {}}}}));
+
+  EXPECT_TRUE(index.ContainsTargetAssembly(L"Samples.Target"));
+  EXPECT_TRUE(index.ContainsTargetAssembly(L"Samples.Other"));
+  EXPECT_FALSE(index.ContainsTargetAssembly(L"Samples.Missing"));
+  EXPECT_EQ(0, index.GetIntegrationsForTarget(L"Samples.Missing", Version(1, 0, 0, 0)).size());
+
+  auto v1_integrations = index.GetIntegrationsForTarget(L"Samples.Target", Version(1, 5, 0, 0));
+  ASSERT_EQ(2, v1_integrations.size());
+  EXPECT_EQ(L"integration-2", v1_integrations[0]->integration_name);
+  EXPECT_EQ(L"integration-3", v1_integrations[1]->integration_name);
+
+  auto v2_integrations = index.GetIntegrationsForTarget(L"Samples.Target", Version(2, 0, 0, 0));
+  ASSERT_EQ(2, v2_integrations.size());
+  EXPECT_EQ(L"integration-1", v2_integrations[0]->integration_name);
+  EXPECT_EQ(L"integration-3", v2_integrations[1]->integration_name);
+
+  auto v3_integrations = index.GetIntegrationsForTarget(L"Samples.Target", Version(3, 0, 0, 0));
+  ASSERT_EQ(1, v3_integrations.size());
+  EXPECT_EQ(L"integration-3", v3_integrations[0]->integration_name);
+}
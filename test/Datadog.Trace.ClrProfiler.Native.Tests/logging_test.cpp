@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/sinks/base_sink.h>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/logging.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/stats.h"
+
+using namespace trace;
+
+namespace {
+
+// Records the lines written by the logger, and keeps the writer blocked in
+// the sink while it is closed
+class RecordingSink : public spdlog::sinks::base_sink<std::mutex> {
+ public:
+  void SetOpen(bool open) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      open_ = open;
+    }
+    condition_.notify_all();
+  }
+
+  bool WaitForMessages(size_t count) {
+    std::unique_lock<std::mutex> lock(lock_);
+    return condition_.wait_for(lock, std::chrono::seconds(10), [&]() {
+      return messages_.size() >= count;
+    });
+  }
+
+  std::vector<std::string> Messages() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return messages_;
+  }
+
+ protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override {
+    std::unique_lock<std::mutex> lock(lock_);
+    messages_.emplace_back(msg.payload.data(), msg.payload.size());
+    condition_.notify_all();
+    condition_.wait(lock, [this]() { return open_; });
+  }
+
+  void flush_() override {}
+
+ private:
+  std::mutex lock_;
+  std::condition_variable condition_;
+  std::vector<std::string> messages_;
+  bool open_ = true;
+};
+
+std::shared_ptr<RecordingSink> AttachSink() {
+  // nothing is logged yet, the writer doesn't use the sinks
+  Logger::Instance();
+  auto sink = std::make_shared<RecordingSink>();
+  spdlog::get("Logger")->sinks().push_back(sink);
+  return sink;
+}
+
+size_t CountMessagesStartingWith(const std::vector<std::string>& messages,
+                                 const std::string& prefix) {
+  size_t count = 0;
+  for (const auto& message : messages) {
+    if (message.compare(0, prefix.size(), prefix) == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// The tests run in a new process: the logger is a singleton and Shutdown
+// can't be undone
+
+void WriteWithoutFlush() {
+  const auto sink = AttachSink();
+  Info("message");
+  fprintf(stderr, "%s\n", sink->WaitForMessages(1) ? "written" : "missing");
+  std::exit(0);
+}
+
+void FillTheBuffer() {
+  const auto sink = AttachSink();
+
+  // the writer holds the first message while it is blocked in the sink
+  sink->SetOpen(false);
+  Info("first");
+  sink->WaitForMessages(1);
+
+  const auto stats = Stats::Instance()->GetStatsBlock();
+  const uint64_t dropped_before = stats->log_messages_dropped.load();
+  for (int i = 0; i < 1100; i++) {
+    Info("message ", i);
+  }
+  const uint64_t dropped =
+      Stats::Instance()->GetStatsBlock()->log_messages_dropped.load() -
+      dropped_before;
+
+  sink->SetOpen(true);
+  Logger::Instance()->Flush();
+  const auto messages = sink->Messages();
+  fprintf(stderr, "%llu dropped, %zu written, %zu reported\n",
+          (unsigned long long)dropped,
+          CountMessagesStartingWith(messages, "message "),
+          CountMessagesStartingWith(
+              messages, "Logger: " + std::to_string(dropped) +
+                            " messages were dropped"));
+  std::exit(0);
+}
+
+void FlushFromThreads() {
+  const auto sink = AttachSink();
+
+  const int kThreads = 4;
+  const int kMessages = 200;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < kMessages; i++) {
+        Info("thread ", t, " message ", i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  Logger::Instance()->Flush();
+
+  // every message is written once Flush returns, in order for each thread
+  int next[kThreads] = {};
+  size_t in_order = 0;
+  for (const auto& message : sink->Messages()) {
+    int t = 0;
+    int i = 0;
+    if (sscanf(message.c_str(), "thread %d message %d", &t, &i) == 2 &&
+        next[t] == i) {
+      next[t]++;
+      in_order++;
+    }
+  }
+  fprintf(stderr, "%zu messages in order\n", in_order);
+  std::exit(0);
+}
+
+void LogAndShutdown() {
+  const auto sink = AttachSink();
+
+  // the writer is blocked, the messages stay in the buffer until Shutdown
+  sink->SetOpen(false);
+  Info("first");
+  sink->WaitForMessages(1);
+  for (int i = 0; i < 500; i++) {
+    Info("message ", i);
+  }
+  sink->SetOpen(true);
+  Logger::Shutdown();
+
+  // later messages are written right away
+  Info("message after shutdown");
+  fprintf(stderr, "%zu written\n",
+          CountMessagesStartingWith(sink->Messages(), "message "));
+  std::exit(0);
+}
+
+void LogALongMessage() {
+  const auto sink = AttachSink();
+  Info(std::string(100000, 'x'));
+  Logger::Instance()->Flush();
+
+  const auto messages = sink->Messages();
+  fprintf(stderr, "%zu bytes, %s\n", messages.empty() ? 0 : messages[0].size(),
+          messages.empty() ? "" : messages[0].c_str() + messages[0].size() - 11);
+  std::exit(0);
+}
+
+}  // namespace
+
+TEST(LoggerTest, WritesMessagesWithoutAFlush) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(WriteWithoutFlush(), ::testing::ExitedWithCode(0), "written");
+}
+
+TEST(LoggerTest, DropsAndCountsMessagesWhenTheBufferIsFull) {
+  // the first message holds a slot, 1023 fit with it
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(FillTheBuffer(), ::testing::ExitedWithCode(0),
+              "77 dropped, 1023 written, 1 reported");
+}
+
+TEST(LoggerTest, FlushWritesTheMessagesLoggedBefore) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(FlushFromThreads(), ::testing::ExitedWithCode(0),
+              "800 messages in order");
+}
+
+TEST(LoggerTest, ShutdownWritesThePendingMessages) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(LogAndShutdown(), ::testing::ExitedWithCode(0), "501 written");
+}
+
+TEST(LoggerTest, TruncatesLongMessages) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(LogALongMessage(), ::testing::ExitedWithCode(0),
+              std::to_string(Logger::kMaxMessageLength) +
+                  " bytes, \\(truncated\\)");
+}
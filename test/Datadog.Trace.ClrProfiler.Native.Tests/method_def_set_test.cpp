@@ -0,0 +1,39 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/method_def_set.h"
+
+using namespace trace;
+
+TEST(MethodDefSetTest, ContainsAddedMethods) {
+  const MethodDefSet methods(nullptr, {0x06000001, 0x06000040, 0x06001234});
+
+  EXPECT_FALSE(methods.IsEmpty());
+  EXPECT_TRUE(methods.Contains(0x06000001));
+  EXPECT_TRUE(methods.Contains(0x06000040));
+  EXPECT_TRUE(methods.Contains(0x06001234));
+
+  EXPECT_FALSE(methods.Contains(0x06000002));
+  EXPECT_FALSE(methods.Contains(0x06001235));
+  EXPECT_FALSE(methods.Contains(0x06100000));
+}
+
+TEST(MethodDefSetTest, IgnoresOtherTokenTypes) {
+  const MethodDefSet methods(nullptr, {0x0A000001, 0x06000001});
+
+  EXPECT_TRUE(methods.Contains(0x06000001));
+  EXPECT_FALSE(methods.Contains(0x0A000001));
+  EXPECT_FALSE(methods.Contains(0x02000001));
+}
+
+TEST(MethodDefSetTest, ExtendsBaseSet) {
+  const MethodDefSet empty;
+  EXPECT_TRUE(empty.IsEmpty());
+  EXPECT_FALSE(empty.Contains(0x06000001));
+
+  const MethodDefSet base(&empty, {0x06000010});
+  const MethodDefSet extended(&base, {0x06000200});
+
+  EXPECT_TRUE(extended.Contains(0x06000010));
+  EXPECT_TRUE(extended.Contains(0x06000200));
+  EXPECT_FALSE(base.Contains(0x06000200));
+}
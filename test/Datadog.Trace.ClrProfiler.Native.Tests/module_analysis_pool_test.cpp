@@ -0,0 +1,160 @@
+#include "pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/module_analysis_pool.h"
+
+using namespace trace;
+
+namespace {
+
+// Records the analyzed modules, and keeps the analyses blocked until it is
+// opened
+class AnalysisRecorder {
+ public:
+  std::mutex lock;
+  std::condition_variable condition;
+  bool open = true;
+  std::multiset<ModuleID> analyzed;
+  std::set<std::thread::id> threads;
+
+  void Analyze(ModuleID module_id) {
+    std::unique_lock<std::mutex> guard(lock);
+    condition.wait(guard, [this]() { return open; });
+    analyzed.insert(module_id);
+    threads.insert(std::this_thread::get_id());
+  }
+
+  void SetOpen(bool value) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      open = value;
+    }
+    condition.notify_all();
+  }
+
+  std::multiset<ModuleID> GetAnalyzed() {
+    std::lock_guard<std::mutex> guard(lock);
+    return analyzed;
+  }
+};
+
+}  // namespace
+
+TEST(ModuleAnalysisPoolTest, AnalyzesEveryModuleOnce) {
+  AnalysisRecorder recorder;
+  ModuleAnalysisPool pool(
+      4, [&](ModuleID module_id) { recorder.Analyze(module_id); });
+
+  std::multiset<ModuleID> expected;
+  for (ModuleID module_id = 1; module_id <= 100; module_id++) {
+    pool.Enqueue(module_id);
+    expected.insert(module_id);
+  }
+  pool.Drain();
+
+  EXPECT_EQ(expected, recorder.GetAnalyzed());
+  EXPECT_EQ(0, pool.GetQueueDepth());
+  EXPECT_EQ(0, recorder.threads.count(std::this_thread::get_id()));
+}
+
+TEST(ModuleAnalysisPoolTest, AnalyzesOnTheCallingThreadWithoutWorkers) {
+  AnalysisRecorder recorder;
+  ModuleAnalysisPool pool(
+      0, [&](ModuleID module_id) { recorder.Analyze(module_id); });
+
+  pool.Enqueue(1);
+
+  EXPECT_EQ(std::multiset<ModuleID>{1}, recorder.GetAnalyzed());
+  EXPECT_EQ(std::set<std::thread::id>{std::this_thread::get_id()},
+            recorder.threads);
+}
+
+TEST(ModuleAnalysisPoolTest, WaitAnalyzesAQueuedModuleOnTheCallingThread) {
+  AnalysisRecorder recorder;
+  std::atomic<bool> worker_busy{false};
+  ModuleAnalysisPool pool(1, [&](ModuleID module_id) {
+    if (module_id == 1) {
+      worker_busy = true;
+    }
+    recorder.Analyze(module_id);
+  });
+
+  // the only worker is stuck on the first module
+  recorder.SetOpen(false);
+  pool.Enqueue(1);
+  pool.Enqueue(2);
+  while (!worker_busy) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(1, pool.GetQueueDepth());
+
+  std::thread waiter([&]() { pool.Wait(2); });
+  while (pool.GetQueueDepth() != 0) {
+    std::this_thread::yield();
+  }
+  recorder.SetOpen(true);
+  waiter.join();
+  pool.Drain();
+
+  EXPECT_EQ((std::multiset<ModuleID>{1, 2}), recorder.GetAnalyzed());
+  EXPECT_EQ(2, recorder.threads.size());
+}
+
+TEST(ModuleAnalysisPoolTest, CancelledModulesAreNotAnalyzed) {
+  AnalysisRecorder recorder;
+  std::atomic<bool> worker_busy{false};
+  ModuleAnalysisPool pool(1, [&](ModuleID module_id) {
+    worker_busy = true;
+    recorder.Analyze(module_id);
+  });
+
+  recorder.SetOpen(false);
+  pool.Enqueue(1);
+  pool.Enqueue(2);
+  while (!worker_busy) {
+    std::this_thread::yield();
+  }
+
+  // a queued module is dropped, a running one is waited for
+  pool.Cancel(2);
+  std::thread canceller([&]() { pool.Cancel(1); });
+  recorder.SetOpen(true);
+  canceller.join();
+
+  EXPECT_EQ(std::multiset<ModuleID>{1}, recorder.GetAnalyzed());
+  pool.Drain();
+  EXPECT_EQ(std::multiset<ModuleID>{1}, recorder.GetAnalyzed());
+}
+
+TEST(ModuleAnalysisPoolTest, ShutdownDropsTheQueuedModules) {
+  AnalysisRecorder recorder;
+  std::atomic<bool> worker_busy{false};
+  ModuleAnalysisPool pool(1, [&](ModuleID module_id) {
+    worker_busy = true;
+    recorder.Analyze(module_id);
+  });
+
+  recorder.SetOpen(false);
+  pool.Enqueue(1);
+  pool.Enqueue(2);
+  while (!worker_busy) {
+    std::this_thread::yield();
+  }
+
+  std::thread stopper([&]() { pool.Shutdown(); });
+  while (pool.GetQueueDepth() != 0) {
+    std::this_thread::yield();
+  }
+  recorder.SetOpen(true);
+  stopper.join();
+
+  pool.Enqueue(3);
+  pool.Drain();
+  EXPECT_EQ(std::multiset<ModuleID>{1}, recorder.GetAnalyzed());
+}
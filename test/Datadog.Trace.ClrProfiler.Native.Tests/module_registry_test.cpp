@@ -0,0 +1,130 @@
+#include "pch.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/module_registry.h"
+
+using namespace trace;
+
+namespace {
+
+ModuleMetadata* CreateModuleMetadata(AppDomainID app_domain_id) {
+  return new ModuleMetadata({}, {}, {}, {}, L"Test.Assembly", app_domain_id,
+                            {}, nullptr, {}, nullptr);
+}
+
+}  // namespace
+
+TEST(ModuleRegistryTest, AddsAndRemovesModules) {
+  ModuleRegistry registry;
+  ModuleRegistry::ReadGuard guard(registry);
+
+  auto metadata = CreateModuleMetadata(1);
+  registry.Add(10, metadata);
+
+  EXPECT_EQ(metadata, registry.Get(10));
+  EXPECT_EQ(nullptr, registry.Get(20));
+  EXPECT_EQ(1, registry.Size());
+
+  // the removed metadata stays usable while the guard is alive
+  EXPECT_EQ(metadata, registry.Remove(10));
+  EXPECT_EQ(1, metadata->app_domain_id);
+  EXPECT_EQ(nullptr, registry.Get(10));
+  EXPECT_EQ(nullptr, registry.Remove(10));
+  EXPECT_EQ(0, registry.Size());
+}
+
+TEST(ModuleRegistryTest, SupportsNestedGuards) {
+  ModuleRegistry registry;
+  registry.Add(10, CreateModuleMetadata(1));
+
+  ModuleRegistry::ReadGuard outer(registry);
+  {
+    ModuleRegistry::ReadGuard inner(registry);
+    EXPECT_NE(nullptr, registry.Get(10));
+  }
+  EXPECT_NE(nullptr, registry.Get(10));
+}
+
+TEST(ModuleRegistryTest, SupportsMoreGuardsThanReaderSlots) {
+  ModuleRegistry registry;
+  registry.Add(10, CreateModuleMetadata(1));
+
+  // nested guards take a slot each, the extra ones must not wait for a slot
+  // this thread holds
+  std::vector<std::unique_ptr<ModuleRegistry::ReadGuard>> guards;
+  for (int i = 0; i < 300; i++) {
+    guards.push_back(std::make_unique<ModuleRegistry::ReadGuard>(registry));
+  }
+
+  auto metadata = registry.Remove(10);
+  ASSERT_NE(nullptr, metadata);
+  EXPECT_EQ(1, metadata->app_domain_id);
+
+  // an overflow guard pins the removed metadata as well
+  guards.erase(guards.begin(), guards.begin() + 200);
+  EXPECT_LT(0, registry.RetiredSize());
+  EXPECT_EQ(1, metadata->app_domain_id);
+
+  guards.clear();
+  EXPECT_EQ(0, registry.RetiredSize());
+}
+
+TEST(ModuleRegistryTest, ReclaimsWhenTheLastReaderLeaves) {
+  ModuleRegistry registry;
+  registry.Add(10, CreateModuleMetadata(1));
+
+  {
+    ModuleRegistry::ReadGuard guard(registry);
+    registry.Remove(10);
+    EXPECT_LT(0, registry.RetiredSize());
+  }
+
+  // no write is needed to free the metadata
+  EXPECT_EQ(0, registry.RetiredSize());
+}
+
+TEST(ModuleRegistryTest, ReadsWhileModulesLoadAndUnload) {
+  ModuleRegistry registry;
+  registry.Add(1, CreateModuleMetadata(1));
+
+  std::atomic_bool done{false};
+  std::atomic_int failures{0};
+  std::vector<std::thread> readers;
+
+  for (int i = 0; i < 8; i++) {
+    readers.emplace_back([&registry, &done, &failures]() {
+      while (!done) {
+        ModuleRegistry::ReadGuard guard(registry);
+        auto metadata = registry.Get(1);
+        if (metadata == nullptr || metadata->app_domain_id != 1) {
+          failures++;
+        }
+
+        for (ModuleID module_id = 2; module_id < 10; module_id++) {
+          metadata = registry.Get(module_id);
+          if (metadata != nullptr && metadata->app_domain_id != module_id) {
+            failures++;
+          }
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    const ModuleID module_id = 2 + (i % 8);
+    registry.Add(module_id, CreateModuleMetadata(module_id));
+    registry.Remove(module_id);
+  }
+
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(0, failures);
+  EXPECT_EQ(1, registry.Size());
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+
+#include <chrono>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/rejit_handler.h"
+#include "fake_profiler_info.h"
+
+using namespace trace;
+
+namespace {
+
+// Enqueues a request for the given number of methods of a module
+void Enqueue(RejitHandler& handler, ModuleID module_id, int methods) {
+  std::vector<ModuleID> module_ids(methods, module_id);
+  std::vector<mdMethodDef> method_defs;
+  for (int i = 0; i < methods; i++) {
+    method_defs.push_back(0x06000001 + i);
+  }
+  handler.EnqueueForRejit(module_ids, method_defs);
+}
+
+}  // namespace
+
+TEST(RejitHandlerTest, SendsALoneRequestWithoutWaitingForTheWindow) {
+  FakeProfilerInfo info;
+  RejitHandler handler(&info, nullptr, 60000, 1000);
+
+  const auto start = std::chrono::steady_clock::now();
+  Enqueue(handler, 1, 2);
+  info.WaitForReJITRequests(1);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  handler.Shutdown();
+  EXPECT_EQ(info.TakeReJITBatchSizes(), std::vector<size_t>({2}));
+}
+
+TEST(RejitHandlerTest, MergesTheRequestsArrivingWithinTheWindow) {
+  FakeProfilerInfo info;
+  RejitHandler handler(&info, nullptr, 100, 1000);
+
+  // the next requests queue up while the first one is in flight
+  info.HoldReJITRequests(true);
+  Enqueue(handler, 1, 1);
+  info.WaitForReJITRequests(1);
+  Enqueue(handler, 2, 1);
+  Enqueue(handler, 3, 2);
+  Enqueue(handler, 4, 1);
+  info.HoldReJITRequests(false);
+  info.WaitForReJITRequests(2);
+
+  handler.Shutdown();
+  EXPECT_EQ(info.TakeReJITBatchSizes(), std::vector<size_t>({1, 4}));
+  const auto requests = info.TakeReJITRequests();
+  ASSERT_EQ(requests.size(), 5);
+  EXPECT_EQ(requests[1].first, 2);
+  EXPECT_EQ(requests[2].first, 3);
+  EXPECT_EQ(requests[4].first, 4);
+}
+
+TEST(RejitHandlerTest, SplitsTheRequestsOverTheMaximumMethods) {
+  FakeProfilerInfo info;
+  RejitHandler handler(&info, nullptr, 100, 3);
+
+  info.HoldReJITRequests(true);
+  Enqueue(handler, 1, 1);
+  info.WaitForReJITRequests(1);
+  Enqueue(handler, 2, 2);
+  Enqueue(handler, 3, 4);
+  info.HoldReJITRequests(false);
+  info.WaitForReJITRequests(3);
+
+  handler.Shutdown();
+  EXPECT_EQ(info.TakeReJITBatchSizes(), std::vector<size_t>({1, 3, 3}));
+
+  // the request that doesn't fit is split in order, no method is lost
+  const std::vector<std::pair<ModuleID, mdMethodDef>> expected = {
+      {1, 0x06000001}, {2, 0x06000001}, {2, 0x06000002}, {3, 0x06000001},
+      {3, 0x06000002}, {3, 0x06000003}, {3, 0x06000004}};
+  EXPECT_EQ(info.TakeReJITRequests(), expected);
+}
+
+TEST(RejitHandlerTest, SendsThePendingBatchOnShutdown) {
+  FakeProfilerInfo info;
+  RejitHandler handler(&info, nullptr, 60000, 1000);
+
+  info.HoldReJITRequests(true);
+  Enqueue(handler, 1, 1);
+  info.WaitForReJITRequests(1);
+  Enqueue(handler, 2, 1);
+  Enqueue(handler, 3, 1);
+  info.HoldReJITRequests(false);
+
+  // the thread is waiting for the window to end when the exit request arrives
+  const auto start = std::chrono::steady_clock::now();
+  handler.Shutdown();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+  EXPECT_EQ(info.TakeReJITBatchSizes(), std::vector<size_t>({1, 2}));
+}
@@ -0,0 +1,52 @@
+#include "pch.h"
+
+#include <filesystem>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/rejit_plan_cache.h"
+
+using namespace trace;
+
+namespace {
+
+WSTRING GetPlanDirectory() {
+  auto directory = std::filesystem::temp_directory_path() / "dd-rejit-plan-cache-test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  return directory.wstring();
+}
+
+}  // namespace
+
+TEST(RejitPlanCacheTest, StoresAndLoadsPlans) {
+  RejitPlanCache cache(GetPlanDirectory(), 42);
+  GUID module_version_id{1, 2, 3, {4, 5, 6, 7, 8, 9, 10, 11}};
+  std::vector<RejitPlanEntry> entries;
+
+  EXPECT_FALSE(cache.TryLoad(module_version_id, entries));
+
+  cache.Store(module_version_id, {{0x06000001, 3}, {0x06000010, 7}});
+  ASSERT_TRUE(cache.TryLoad(module_version_id, entries));
+  ASSERT_EQ(2, entries.size());
+  EXPECT_EQ(0x06000001, entries[0].method_def);
+  EXPECT_EQ(3, entries[0].integration_index);
+  EXPECT_EQ(0x06000010, entries[1].method_def);
+  EXPECT_EQ(7, entries[1].integration_index);
+
+  // an empty plan is a valid plan, the module has nothing to instrument
+  cache.Store(module_version_id, {});
+  ASSERT_TRUE(cache.TryLoad(module_version_id, entries));
+  EXPECT_EQ(0, entries.size());
+}
+
+TEST(RejitPlanCacheTest, IgnoresPlansOfOtherIntegrations) {
+  const auto directory = GetPlanDirectory();
+  GUID module_version_id{1, 2, 3, {4, 5, 6, 7, 8, 9, 10, 11}};
+  RejitPlanCache(directory, 42).Store(module_version_id, {{0x06000001, 3}});
+
+  std::vector<RejitPlanEntry> entries;
+  EXPECT_FALSE(RejitPlanCache(directory, 43).TryLoad(module_version_id, entries));
+  EXPECT_TRUE(RejitPlanCache(directory, 42).TryLoad(module_version_id, entries));
+
+  GUID other_module_version_id{9, 2, 3, {4, 5, 6, 7, 8, 9, 10, 11}};
+  EXPECT_FALSE(RejitPlanCache(directory, 42).TryLoad(other_module_version_id, entries));
+}
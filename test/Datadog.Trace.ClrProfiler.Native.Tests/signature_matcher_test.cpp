@@ -0,0 +1,185 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/clr_helpers.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/signature_matcher.h"
+#include "fake_metadata.h"
+
+using namespace trace;
+
+namespace {
+
+class SignatureMatcherTest : public ::testing::Test {
+ protected:
+  ComPtr<IMetaDataImport2> metadata_import_;
+  ComPtr<IMetaDataAssemblyImport> assembly_import_;
+  mdTypeDef client_ = mdTypeDefNil;
+  mdTypeRef request_ = mdTypeRefNil;
+  mdTypeRef list_ = mdTypeRefNil;
+
+  void SetUp() override {
+    FakeModuleDefinition module;
+    module.assembly = {WStr("Samples.Client"), 1, 0, 0, 0};
+    module.references = {{WStr("System.Net.Http"), 4, 0, 0, 0},
+                         {WStr("System.Collections"), 4, 0, 0, 0}};
+    module.types = {{WStr("Samples.Client.HttpClient"), {}}};
+    metadata_import_.Attach(new FakeMetadata(module));
+    assembly_import_ = metadata_import_.As<IMetaDataAssemblyImport>(
+        IID_IMetaDataAssemblyImport);
+
+    metadata_import_->FindTypeDefByName(WStr("Samples.Client.HttpClient"),
+                                        mdTokenNil, &client_);
+
+    std::vector<mdAssemblyRef> references;
+    for (mdAssemblyRef reference : EnumAssemblyRefs(assembly_import_)) {
+      references.push_back(reference);
+    }
+    const auto metadata_emit =
+        metadata_import_.As<IMetaDataEmit2>(IID_IMetaDataEmit2);
+    metadata_emit->DefineTypeRefByName(
+        references[0], WStr("System.Net.Http.HttpRequestMessage"), &request_);
+    metadata_emit->DefineTypeRefByName(
+        references[1], WStr("System.Collections.Generic.List`1"), &list_);
+  }
+
+  // Appends a CLASS or VALUETYPE element for the token
+  static void AppendToken(std::vector<BYTE>& signature,
+                          CorElementType element_type, mdToken token) {
+    BYTE compressed[4];
+    signature.push_back(element_type);
+    const auto length = CorSigCompressToken(token, compressed);
+    signature.insert(signature.end(), compressed, compressed + length);
+  }
+
+  // Builds the signature of a method returning void with the given arguments
+  static std::vector<BYTE> MethodSignature(
+      const std::vector<std::vector<BYTE>>& arguments) {
+    std::vector<BYTE> signature = {IMAGE_CEE_CS_CALLCONV_DEFAULT,
+                                   (BYTE)arguments.size(), ELEMENT_TYPE_VOID};
+    for (const auto& argument : arguments) {
+      signature.insert(signature.end(), argument.begin(), argument.end());
+    }
+    return signature;
+  }
+
+  HRESULT Match(SignatureMatcher& matcher,
+                const std::vector<WSTRING>& signature_types,
+                const std::vector<BYTE>& signature) {
+    return matcher.Match(matcher.Compile(signature_types), signature.data(),
+                         (ULONG)signature.size());
+  }
+};
+
+}  // namespace
+
+TEST_F(SignatureMatcherTest, MatchesPrimitiveArguments) {
+  SignatureMatcher matcher(metadata_import_, assembly_import_);
+  const auto signature = MethodSignature({{ELEMENT_TYPE_I4},
+                                          {ELEMENT_TYPE_BYREF, ELEMENT_TYPE_STRING},
+                                          {ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_U1}});
+
+  EXPECT_EQ(S_OK, Match(matcher,
+                        {WStr("System.Void"), WStr("System.Int32"),
+                         WStr("System.String&"), WStr("System.Byte[]")},
+                        signature));
+  EXPECT_EQ(S_OK, Match(matcher,
+                        {WStr("System.Void"), WStr("_"), WStr("_"),
+                         WStr("System.Byte[]")},
+                        signature));
+  EXPECT_EQ(S_FALSE, Match(matcher,
+                           {WStr("System.Void"), WStr("System.Int32"),
+                            WStr("System.String"), WStr("System.Byte[]")},
+                           signature));
+  EXPECT_EQ(S_FALSE, Match(matcher,
+                           {WStr("System.Void"), WStr("System.Int64"),
+                            WStr("System.String&"), WStr("System.Byte[]")},
+                           signature));
+  EXPECT_EQ(S_FALSE, Match(matcher,
+                           {WStr("System.Void"), WStr("System.Int32"),
+                            WStr("System.String&")},
+                           signature));
+  EXPECT_EQ(S_FALSE, Match(matcher, {}, signature));
+}
+
+TEST_F(SignatureMatcherTest, MatchesClassArguments) {
+  SignatureMatcher matcher(metadata_import_, assembly_import_);
+  std::vector<BYTE> request;
+  AppendToken(request, ELEMENT_TYPE_CLASS, request_);
+  std::vector<BYTE> client = {ELEMENT_TYPE_SZARRAY};
+  AppendToken(client, ELEMENT_TYPE_VALUETYPE, client_);
+  const auto signature = MethodSignature({request, client});
+
+  EXPECT_EQ(S_OK, Match(matcher,
+                        {WStr("System.Void"),
+                         WStr("System.Net.Http.HttpRequestMessage"),
+                         WStr("Samples.Client.HttpClient[]")},
+                        signature));
+  EXPECT_EQ(S_FALSE, Match(matcher,
+                           {WStr("System.Void"),
+                            WStr("System.Net.Http.HttpResponseMessage"),
+                            WStr("Samples.Client.HttpClient[]")},
+                           signature));
+  EXPECT_EQ(S_FALSE, Match(matcher,
+                           {WStr("System.Void"),
+                            WStr("System.Net.Http.HttpRequestMessage"),
+                            WStr("Samples.Client.HttpClient")},
+                           signature));
+}
+
+TEST_F(SignatureMatcherTest, MatchesLikeTheArgumentTypeNames) {
+  std::vector<BYTE> request;
+  AppendToken(request, ELEMENT_TYPE_CLASS, request_);
+  std::vector<BYTE> request_list = {ELEMENT_TYPE_GENERICINST};
+  AppendToken(request_list, ELEMENT_TYPE_CLASS, list_);
+  request_list.push_back(1);
+  request_list.insert(request_list.end(), request.begin(), request.end());
+  std::vector<BYTE> client = {ELEMENT_TYPE_BYREF};
+  AppendToken(client, ELEMENT_TYPE_VALUETYPE, client_);
+
+  const std::vector<std::vector<BYTE>> arguments = {
+      {ELEMENT_TYPE_OBJECT},
+      {ELEMENT_TYPE_I},
+      {ELEMENT_TYPE_MVAR, 0},
+      {ELEMENT_TYPE_VAR, 1},
+      {ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_CHAR},
+      {ELEMENT_TYPE_BYREF, ELEMENT_TYPE_I8},
+      request,
+      request_list,
+      client};
+
+  // every argument matches its own type name, and only it
+  std::vector<WSTRING> type_names;
+  for (const auto& argument : arguments) {
+    FunctionMethodArgument method_argument{0, (ULONG)argument.size(),
+                                           argument.data()};
+    type_names.push_back(method_argument.GetTypeTokName(metadata_import_));
+  }
+  EXPECT_EQ(WStr("System.Collections.Generic.List`1[System.Net.Http.HttpRequestMessage]"),
+            type_names[7]);
+
+  SignatureMatcher matcher(metadata_import_, assembly_import_);
+  for (size_t i = 0; i < arguments.size(); i++) {
+    for (size_t j = 0; j < arguments.size(); j++) {
+      const std::vector<WSTRING> signature_types = {WStr("System.Void"),
+                                                    type_names[j]};
+      EXPECT_EQ(type_names[i] == type_names[j] ? S_OK : S_FALSE,
+                Match(matcher, signature_types,
+                      MethodSignature({arguments[i]})))
+          << "argument " << i << ", signature type " << j;
+    }
+  }
+}
+
+TEST_F(SignatureMatcherTest, FailsOnSignaturesThatCannotBeParsed) {
+  SignatureMatcher matcher(metadata_import_, assembly_import_);
+  const std::vector<WSTRING> signature_types = {WStr("System.Void"),
+                                                WStr("_")};
+
+  EXPECT_EQ(E_FAIL, Match(matcher, signature_types, {}));
+  EXPECT_EQ(E_FAIL, Match(matcher, signature_types,
+                          {IMAGE_CEE_CS_CALLCONV_DEFAULT, 1, ELEMENT_TYPE_VOID}));
+  EXPECT_EQ(E_FAIL, Match(matcher, signature_types,
+                          {IMAGE_CEE_CS_CALLCONV_DEFAULT, 1, ELEMENT_TYPE_VOID,
+                           ELEMENT_TYPE_TYPEDBYREF}));
+}
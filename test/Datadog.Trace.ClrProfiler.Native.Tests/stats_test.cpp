@@ -0,0 +1,147 @@
+#include "pch.h"
+
+#include <cstddef>
+#include <filesystem>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/stats.h"
+
+using namespace trace;
+
+TEST(LatencyHistogramTest, BucketBoundsContainTheirValues) {
+  const uint64_t values[] = {0, 1, 3, 4, 5, 7, 8, 15, 1000, 123456789, UINT64_MAX};
+  for (const auto value : values) {
+    const int index = LatencyHistogram::GetBucketIndex(value);
+    EXPECT_GE(index, 0);
+    EXPECT_LT(index, LatencyHistogram::kBuckets);
+    EXPECT_LE(LatencyHistogram::GetBucketLowerBound(index), value);
+    EXPECT_GE(LatencyHistogram::GetBucketUpperBound(index), value);
+  }
+
+  for (int i = 0; i + 1 < LatencyHistogram::kBuckets; i++) {
+    EXPECT_EQ(LatencyHistogram::GetBucketUpperBound(i) + 1,
+              LatencyHistogram::GetBucketLowerBound(i + 1));
+  }
+}
+
+TEST(LatencyHistogramTest, ComputesPercentiles) {
+  LatencyHistogram histogram;
+  for (uint64_t value = 1; value <= 1000; value++) {
+    histogram.Record(value * 1000);
+  }
+
+  const auto snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(1000, snapshot.count);
+  EXPECT_EQ(500500000, snapshot.sum);
+  EXPECT_EQ(1000000, snapshot.max);
+
+  // buckets are at most 25% wider than their values
+  EXPECT_GE(snapshot.Percentile(0.5), 500000);
+  EXPECT_LE(snapshot.Percentile(0.5), 625000);
+  EXPECT_GE(snapshot.Percentile(0.99), 990000);
+  EXPECT_LE(snapshot.Percentile(0.99), 1000000);
+  EXPECT_EQ(1000000, snapshot.Percentile(1));
+}
+
+TEST(LatencyHistogramTest, ExportsToTheStatsBlock) {
+  LatencyHistogram histogram;
+  histogram.Record(10);
+  histogram.Record(1000);
+
+  StatsBlock block;
+  InitializeStatsBlock(&block);
+  histogram.Export(&block.callbacks[0]);
+  histogram.Record(100);
+
+  EXPECT_EQ(kStatsBlockMagic, block.magic);
+  EXPECT_EQ(sizeof(StatsBlock), block.size);
+  EXPECT_EQ(2, block.callbacks[0].count);
+  EXPECT_EQ(1010, block.callbacks[0].total_ns);
+  EXPECT_EQ(1000, block.callbacks[0].max_ns);
+  EXPECT_EQ(1, block.callbacks[0].buckets[LatencyHistogram::GetBucketIndex(10)]);
+  EXPECT_EQ(1, block.callbacks[0].buckets[LatencyHistogram::GetBucketIndex(1000)]);
+  // the block is a snapshot, it only changes on the next export
+  EXPECT_EQ(0, block.callbacks[0].buckets[LatencyHistogram::GetBucketIndex(100)]);
+}
+
+TEST(StatsBlockTest, KeepsTheCountersBeforeTheHistograms) {
+  // a new callback only takes a free histogram, the other fields don't move
+  EXPECT_LT(offsetof(StatsBlock, log_messages_dropped),
+            offsetof(StatsBlock, callbacks));
+  EXPECT_EQ(offsetof(StatsBlock, callbacks) +
+                sizeof(StatsBlockHistogram) * kStatsBlockCallbacksCapacity,
+            sizeof(StatsBlock));
+
+  StatsBlock block;
+  InitializeStatsBlock(&block);
+  EXPECT_EQ(kStatsBlockCallbacks, block.callbacks_count);
+}
+
+TEST(StatsTest, DeletesTheStatsFileWhenClosed) {
+  const auto path =
+      std::filesystem::temp_directory_path() / "dd-stats-test.dat";
+  Stats stats;
+  ASSERT_TRUE(stats.ExportToFile(ToWSTRING(path.string())));
+  EXPECT_TRUE(std::filesystem::exists(path));
+  stats.AddLogMessagesDropped(3);
+
+  stats.Stop();
+  stats.CloseFile();
+  EXPECT_FALSE(std::filesystem::exists(path));
+
+  // the counters are kept in the process
+  EXPECT_EQ(3, stats.GetStatsBlock()->log_messages_dropped.load());
+}
+
+TEST(SlowestCallsTest, KeepsTheSlowestCalls) {
+  SlowestCalls slowest;
+  for (uint64_t duration = 1; duration <= 100; duration++) {
+    if (slowest.IsCandidate(duration)) {
+      slowest.Add(duration, "Test", WStr("Call"));
+    }
+  }
+
+  const auto entries = slowest.GetEntries();
+  ASSERT_EQ(10, entries.size());
+  EXPECT_EQ(100, entries.front().duration);
+  EXPECT_EQ(91, entries.back().duration);
+  EXPECT_FALSE(slowest.IsCandidate(91));
+  EXPECT_TRUE(slowest.IsCandidate(92));
+}
+
+TEST(SWStatTest, KeepsTheNameOfAScopedCall) {
+  LatencyHistogram histogram;
+  SlowestCalls slowest;
+  {
+    SWStat stat(&histogram, &slowest, "Test");
+    {
+      const WSTRING type_name = WStr("Type");
+      const WSTRING method_name = WStr("Method");
+      const auto name = stat.SetScopedName(type_name, method_name);
+    }
+  }
+
+  EXPECT_EQ(1, histogram.GetSnapshot().count);
+  const auto entries = slowest.GetEntries();
+  ASSERT_EQ(1, entries.size());
+  EXPECT_EQ(WStr("Type.Method"), entries.front().name);
+}
+
+TEST(SWStatTest, DoesNotNameTheFasterCalls) {
+  LatencyHistogram histogram;
+  SlowestCalls slowest;
+  for (uint64_t i = 0; i < 10; i++) {
+    slowest.Add(UINT64_MAX - i, "Test", WStr("Slow"));
+  }
+
+  const WSTRING type_name = WStr("Type");
+  const WSTRING method_name = WStr("Method");
+  {
+    SWStat stat(&histogram, &slowest, "Test");
+    stat.SetName(type_name, method_name);
+  }
+
+  EXPECT_EQ(1, histogram.GetSnapshot().count);
+  const auto entries = slowest.GetEntries();
+  ASSERT_EQ(10, entries.size());
+  EXPECT_EQ(WStr("Slow"), entries.back().name);
+}
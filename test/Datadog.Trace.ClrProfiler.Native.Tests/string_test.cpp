@@ -0,0 +1,139 @@
+#include "pch.h"
+
+#include <string>
+#include <vector>
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/miniutf.hpp"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/string.h"
+
+using namespace trace;
+
+namespace {
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/miniutfdata.h"
+
+WSTRING ToWSTRING(const std::u16string& value) {
+  return WSTRING(value.begin(), value.end());
+}
+
+std::u16string ToU16String(const WSTRING& value) {
+  return std::u16string(value.begin(), value.end());
+}
+
+// Checks the conversions of a UTF-8 string and of its UTF-16 conversion
+// against miniutf
+void ExpectSameAsMiniutf(const std::string& utf8) {
+  const auto utf16 = miniutf::to_utf16(utf8);
+  EXPECT_EQ(ToWSTRING(utf16), trace::ToWSTRING(utf8));
+  EXPECT_EQ(miniutf::to_utf8(utf16), trace::ToString(ToWSTRING(utf16)));
+}
+
+// Every code point of the miniutf tables, each one after a run of ASCII of
+// a different length so it lands on each offset of the vectorized loops
+std::vector<std::string> UnicodeSamples() {
+  std::vector<std::string> samples;
+  for (size_t i = 0; i < sizeof(xref) / sizeof(xref[0]); i++) {
+    std::string sample(i % 40, 'a' + i % 26);
+    miniutf::utf8_encode(xref[i], sample);
+    sample.append(i % 17, 'Z');
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+// ASCII characters from 0 to 0x7F, so the highest ASCII value lands on
+// every lane too
+std::string Ascii(size_t length) {
+  std::string ascii;
+  for (size_t i = 0; i < length; i++) {
+    ascii += (char)(i * 45 % 128);
+  }
+  return ascii;
+}
+
+}  // namespace
+
+TEST(StringTest, ConvertsAscii) {
+  std::string ascii;
+  for (int length = 0; length < 80; length++) {
+    const auto wide = trace::ToWSTRING(ascii);
+    ASSERT_EQ(ascii.size(), wide.size());
+    EXPECT_EQ(ascii, trace::ToString(wide));
+    ExpectSameAsMiniutf(ascii);
+    ascii += (char)(' ' + length);
+  }
+
+  EXPECT_EQ(WStr("System.Net.Http"), trace::ToWSTRING("System.Net.Http"));
+  EXPECT_EQ("System.Net.Http", trace::ToString(WStr("System.Net.Http")));
+  EXPECT_EQ(WStr("18446744073709551615"),
+            trace::ToWSTRING(UINT64_C(18446744073709551615)));
+}
+
+TEST(StringTest, ConvertsLikeMiniutf) {
+  std::string all;
+  for (const auto& sample : UnicodeSamples()) {
+    ExpectSameAsMiniutf(sample);
+    all += sample;
+  }
+  ExpectSameAsMiniutf(all);
+
+  // embedded nulls are part of the string
+  ExpectSameAsMiniutf(std::string("Assembly\0Name\xC3\xA9", 15));
+}
+
+TEST(StringTest, ConvertsNonAsciiAtEachLane) {
+  // the vectorized loops read 16 characters at a time: one non-ASCII
+  // character at every position of strings around one and two vectors long
+  const std::vector<std::string> utf8_characters = {
+      "\xC2\x80", "\xC3\xBF", "\xC4\x80", "\xE0\xA0\x80", "\xE8\x80\x80",
+      "\xEF\xBF\xBD", "\xF0\x9F\x98\x80"};
+  const std::vector<std::u16string> utf16_characters = {
+      {0x80}, {0xFF}, {0x100}, {0x800}, {0x8000}, {0xFFFD}, {0xD83D, 0xDE00}};
+
+  for (size_t length = 0; length < 34; length++) {
+    const auto ascii = Ascii(length);
+    const std::u16string wide_ascii(ascii.begin(), ascii.end());
+    for (size_t position = 0; position <= length; position++) {
+      for (const auto& character : utf8_characters) {
+        auto utf8 = ascii;
+        utf8.insert(position, character);
+        ExpectSameAsMiniutf(utf8);
+      }
+      for (const auto& character : utf16_characters) {
+        auto utf16 = wide_ascii;
+        utf16.insert(position, character);
+        EXPECT_EQ(miniutf::to_utf8(utf16), trace::ToString(ToWSTRING(utf16)));
+      }
+    }
+  }
+}
+
+#ifndef _WIN32
+// Windows converts with WideCharToMultiByte and MultiByteToWideChar, whose
+// replacements of invalid sequences differ from miniutf
+TEST(StringTest, ReplacesInvalidSequencesLikeMiniutf) {
+  const std::vector<std::string> utf8_sequences = {
+      "\x80",             "\xBF",             "\xC3",
+      "\xC3\x28",         "\xC0\x80",         "\xE2\x82",
+      "\xE2\x28\xA1",     "\xE0\x80\x80",     "\xED\xA0\x80",
+      "\xF0\x9F\x98",     "\xF0\x80\x80\x80", "\xF4\x90\x80\x80",
+      "\xF8\x88\x80\x80", "\xFF",             "\xF0\x9F\x98\x80\x80"};
+  const std::vector<std::u16string> utf16_sequences = {
+      {0xD800}, {0xDC00}, {0xDBFF, 0x41}, {0xDC00, 0xD800}, {0xD83D, 0xDE00}};
+
+  for (size_t offset = 0; offset < 34; offset++) {
+    const std::string padding(offset, 'x');
+    for (const auto& sequence : utf8_sequences) {
+      ExpectSameAsMiniutf(padding + sequence);
+      ExpectSameAsMiniutf(padding + sequence + padding);
+    }
+    const std::u16string utf16_padding(offset, u'x');
+    for (const auto& sequence : utf16_sequences) {
+      for (const auto& utf16 :
+           {utf16_padding + sequence, utf16_padding + sequence + utf16_padding}) {
+        EXPECT_EQ(miniutf::to_utf8(utf16), trace::ToString(ToWSTRING(utf16)));
+      }
+    }
+  }
+}
+#endif
@@ -5,6 +5,24 @@
 
 namespace trace {
 
+inline std::vector<const IntegrationMethod*> References(
+    const std::vector<IntegrationMethod>& integration_methods) {
+  std::vector<const IntegrationMethod*> references;
+  for (auto& integration_method : integration_methods) {
+    references.push_back(&integration_method);
+  }
+  return references;
+}
+
+inline std::vector<IntegrationMethod> Dereference(
+    const std::vector<const IntegrationMethod*>& integration_methods) {
+  std::vector<IntegrationMethod> values;
+  for (auto integration_method : integration_methods) {
+    values.push_back(*integration_method);
+  }
+  return values;
+}
+
 class CLRHelperTestBase : public ::testing::Test {
  protected:
   IMetaDataDispenser* metadata_dispenser_;
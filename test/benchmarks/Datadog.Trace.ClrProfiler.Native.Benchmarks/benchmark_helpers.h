@@ -0,0 +1,244 @@
+#pragma once
+
+#include <corhlpr.h>
+#include <corprof.h>
+
+#include <cstring>
+#include <vector>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/il_rewriter.h"
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/string.h"
+
+namespace benchmarks {
+
+// Stands in for the runtime when the rewriter exports a ReJIT body, it only keeps the size of the body.
+class FakeFunctionControl : public ICorProfilerFunctionControl {
+ public:
+  ULONG body_size = 0;
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void** ppvObject) override {
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+  ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+  HRESULT STDMETHODCALLTYPE SetCodegenFlags(DWORD flags) override {
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE SetILFunctionBody(
+      ULONG cbNewILMethodHeader, LPCBYTE pbNewILMethodHeader) override {
+    body_size = cbNewILMethodHeader;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE SetILInstrumentedCodeMap(
+      ULONG cILMapEntries, COR_IL_MAP rgILMapEntries[]) override {
+    return S_OK;
+  }
+};
+
+// Assembly metadata of a module: its own name and version, and the assemblies it references.
+class FakeAssemblyImport : public IMetaDataAssemblyImport {
+ public:
+  struct Assembly {
+    trace::WSTRING name;
+    USHORT major;
+    USHORT minor;
+  };
+
+  Assembly assembly;
+  std::vector<Assembly> references;
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void** ppvObject) override {
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+  ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+  HRESULT STDMETHODCALLTYPE GetAssemblyProps(
+      mdAssembly mda, const void** ppbPublicKey, ULONG* pcbPublicKey,
+      ULONG* pulHashAlgId, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      ASSEMBLYMETADATA* pMetaData, DWORD* pdwAssemblyFlags) override {
+    return GetProps(assembly, szName, cchName, pchName, pMetaData);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetAssemblyRefProps(
+      mdAssemblyRef mdar, const void** ppbPublicKeyOrToken,
+      ULONG* pcbPublicKeyOrToken, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      ASSEMBLYMETADATA* pMetaData, const void** ppbHashValue,
+      ULONG* pcbHashValue, DWORD* pdwAssemblyRefFlags) override {
+    const ULONG index = RidFromToken(mdar) - 1;
+    if (index >= references.size()) {
+      return E_INVALIDARG;
+    }
+    return GetProps(references[index], szName, cchName, pchName, pMetaData);
+  }
+
+  HRESULT STDMETHODCALLTYPE EnumAssemblyRefs(HCORENUM* phEnum,
+                                             mdAssemblyRef rAssemblyRefs[],
+                                             ULONG cMax,
+                                             ULONG* pcTokens) override {
+    // the enum handle is the index of the next reference
+    size_t next = (size_t)*phEnum;
+    ULONG count = 0;
+    while (count < cMax && next < references.size()) {
+      rAssemblyRefs[count++] = TokenFromRid((ULONG)++next, mdtAssemblyRef);
+    }
+    *phEnum = (HCORENUM)next;
+    *pcTokens = count;
+    return count > 0 ? S_OK : S_FALSE;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetAssemblyFromScope(
+      mdAssembly* ptkAssembly) override {
+    *ptkAssembly = TokenFromRid(1, mdtAssembly);
+    return S_OK;
+  }
+
+  void STDMETHODCALLTYPE CloseEnum(HCORENUM hEnum) override {}
+
+  HRESULT STDMETHODCALLTYPE GetFileProps(mdFile mdf, LPWSTR szName,
+                                         ULONG cchName, ULONG* pchName,
+                                         const void** ppbHashValue,
+                                         ULONG* pcbHashValue,
+                                         DWORD* pdwFileFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetExportedTypeProps(
+      mdExportedType mdct, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      mdToken* ptkImplementation, mdTypeDef* ptkTypeDef,
+      DWORD* pdwExportedTypeFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE GetManifestResourceProps(
+      mdManifestResource mdmr, LPWSTR szName, ULONG cchName, ULONG* pchName,
+      mdToken* ptkImplementation, DWORD* pdwOffset,
+      DWORD* pdwResourceFlags) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumFiles(HCORENUM* phEnum, mdFile rFiles[],
+                                      ULONG cMax, ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumExportedTypes(HCORENUM* phEnum,
+                                              mdExportedType rExportedTypes[],
+                                              ULONG cMax,
+                                              ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE EnumManifestResources(
+      HCORENUM* phEnum, mdManifestResource rManifestResources[], ULONG cMax,
+      ULONG* pcTokens) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindExportedTypeByName(
+      LPCWSTR szName, mdToken mdtExportedType,
+      mdExportedType* ptkExportedType) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindManifestResourceByName(
+      LPCWSTR szName, mdManifestResource* ptkManifestResource) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE FindAssembliesByName(LPCWSTR szAppBase,
+                                                 LPCWSTR szPrivateBin,
+                                                 LPCWSTR szAssemblyName,
+                                                 IUnknown* ppIUnk[], ULONG cMax,
+                                                 ULONG* pcAssemblies) override {
+    return E_NOTIMPL;
+  }
+
+ private:
+  static HRESULT GetProps(const Assembly& source, LPWSTR szName, ULONG cchName,
+                          ULONG* pchName, ASSEMBLYMETADATA* pMetaData) {
+    const ULONG length = (ULONG)source.name.size() + 1;
+    if (szName != nullptr && cchName >= length) {
+      memcpy(szName, source.name.c_str(), length * sizeof(WCHAR));
+    }
+    if (pchName != nullptr) {
+      *pchName = length;
+    }
+    if (pMetaData != nullptr) {
+      pMetaData->usMajorVersion = source.major;
+      pMetaData->usMinorVersion = source.minor;
+      pMetaData->usBuildNumber = 0;
+      pMetaData->usRevisionNumber = 0;
+    }
+    return S_OK;
+  }
+};
+
+// Builds a fat method body with the given number of straight-line blocks, a
+// try/catch every eh_interval blocks (0 for no EH clauses), ending in a throw
+// so the max stack can be computed without metadata.
+inline std::vector<BYTE> CreateMethodBody(unsigned blocks,
+                                          unsigned eh_interval) {
+  std::vector<BYTE> code;
+  std::vector<IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT> clauses;
+
+  auto add_block = [&code]() {
+    // local0 = local0 + 1; if (local0 != 0) goto next
+    const BYTE block[] = {CEE_LDLOC_0, CEE_LDC_I4_1, CEE_ADD, CEE_STLOC_0,
+                          CEE_LDLOC_0, CEE_BRTRUE_S, 0x00};
+    code.insert(code.end(), std::begin(block), std::end(block));
+  };
+
+  for (unsigned i = 0; i < blocks; i++) {
+    if (eh_interval == 0 || i % eh_interval != 0) {
+      add_block();
+      continue;
+    }
+
+    // try { block; leave end } catch (object) { pop; leave end } end:
+    IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT clause{};
+    clause.Flags = COR_ILEXCEPTION_CLAUSE_NONE;
+    clause.TryOffset = (DWORD)code.size();
+    add_block();
+    code.push_back(CEE_LEAVE_S);
+    code.push_back(3);
+    clause.TryLength = (DWORD)code.size() - clause.TryOffset;
+    clause.HandlerOffset = (DWORD)code.size();
+    code.push_back(CEE_POP);
+    code.push_back(CEE_LEAVE_S);
+    code.push_back(0);
+    clause.HandlerLength = (DWORD)code.size() - clause.HandlerOffset;
+    clause.ClassToken = TokenFromRid(1, mdtTypeRef);
+    clauses.push_back(clause);
+  }
+
+  code.push_back(CEE_LDNULL);
+  code.push_back(CEE_THROW);
+
+  const size_t aligned_code_size = (code.size() + 3) & ~3;
+  std::vector<BYTE> body(sizeof(IMAGE_COR_ILMETHOD_FAT) + aligned_code_size);
+
+  auto header = reinterpret_cast<IMAGE_COR_ILMETHOD_FAT*>(body.data());
+  header->Flags = CorILMethod_FatFormat | CorILMethod_InitLocals |
+                  (clauses.empty() ? 0 : CorILMethod_MoreSects);
+  header->Size = sizeof(IMAGE_COR_ILMETHOD_FAT) / sizeof(DWORD);
+  header->MaxStack = 8;
+  header->CodeSize = (DWORD)code.size();
+  header->LocalVarSigTok = TokenFromRid(1, mdtSignature);
+  memcpy(body.data() + sizeof(IMAGE_COR_ILMETHOD_FAT), code.data(),
+         code.size());
+
+  if (!clauses.empty()) {
+    const size_t sect_size =
+        sizeof(IMAGE_COR_ILMETHOD_SECT_FAT) +
+        sizeof(IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT) * clauses.size();
+    const size_t sect_offset = body.size();
+    body.resize(sect_offset + sect_size);
+
+    auto sect =
+        reinterpret_cast<IMAGE_COR_ILMETHOD_SECT_FAT*>(body.data() + sect_offset);
+    sect->Kind = CorILMethod_Sect_EHTable | CorILMethod_Sect_FatFormat;
+    sect->DataSize = (unsigned)sect_size;
+    memcpy(sect + 1, clauses.data(),
+           sizeof(IMAGE_COR_ILMETHOD_SECT_EH_CLAUSE_FAT) * clauses.size());
+  }
+
+  return body;
+}
+
+}  // namespace benchmarks
@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include <dlfcn.h>
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/callback_trace.h"
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/cor_profiler.h"
+#include "../../Datadog.Trace.ClrProfiler.Native.Tests/callback_replay.h"
+
+using namespace trace;
+
+namespace {
+
+// Replays the callback trace recorded with DD_CLR_CALLBACK_TRACE_PATH at this
+// path. The modules are opened from disk when DD_CLR_REPLAY_CORECLR_PATH
+// points to a libcoreclr.so providing the metadata dispenser, they get
+// synthetic metadata otherwise.
+const char* kTracePathVariable = "DD_CLR_REPLAY_TRACE_PATH";
+const char* kCoreClrPathVariable = "DD_CLR_REPLAY_CORECLR_PATH";
+
+typedef HRESULT(STDMETHODCALLTYPE* MetaDataGetDispenserFn)(REFCLSID, REFIID,
+                                                           LPVOID*);
+
+ComPtr<IMetaDataDispenser> GetDispenser() {
+  ComPtr<IMetaDataDispenser> dispenser;
+  const char* coreclr_path = std::getenv(kCoreClrPathVariable);
+  if (coreclr_path == nullptr) {
+    return dispenser;
+  }
+
+  void* coreclr = dlopen(coreclr_path, RTLD_NOW | RTLD_LOCAL);
+  if (coreclr == nullptr) {
+    return dispenser;
+  }
+
+  const auto get_dispenser = reinterpret_cast<MetaDataGetDispenserFn>(
+      dlsym(coreclr, "MetaDataGetDispenser"));
+  if (get_dispenser != nullptr) {
+    get_dispenser(CLSID_CorMetaDataDispenser, IID_IMetaDataDispenser,
+                  reinterpret_cast<LPVOID*>(dispenser.GetAddressOf()));
+  }
+  return dispenser;
+}
+
+struct ReplayRun {
+  FakeProfilerInfo info;
+  std::unique_ptr<CallbackReplay> replay;
+  CorProfiler* profiler = nullptr;
+};
+
+ReplayRun* run = nullptr;
+
+void SetUpReplayRun(const benchmark::State& state) {
+  run = new ReplayRun();
+
+  std::vector<CallbackTraceEvent> events;
+  const char* trace_path = std::getenv(kTracePathVariable);
+  if (trace_path == nullptr ||
+      !ReadCallbackTrace(ToWSTRING(trace_path), events)) {
+    return;
+  }
+
+  // the modules are registered before the profiler starts, outside of the
+  // measured time
+  const auto dispenser = GetDispenser();
+  run->replay =
+      std::make_unique<CallbackReplay>(std::move(events), run->info,
+                                       dispenser.Get());
+
+  run->profiler = new CorProfiler();
+  run->profiler->AddRef();
+  if (FAILED(run->profiler->Initialize(&run->info))) {
+    run->replay = nullptr;
+  }
+}
+
+void TearDownReplayRun(const benchmark::State& state) {
+  if (run->profiler != nullptr) {
+    run->profiler->Shutdown();
+    run->profiler->Release();
+  }
+  delete run;
+  run = nullptr;
+}
+
+}  // namespace
+
+// Runs a recorded startup against the profiler, to compare two builds of the
+// native library on the same sequence of callbacks. The latencies of each
+// callback are in the profiler stats written to the native log.
+static void BM_ReplayCallbackTrace(benchmark::State& state) {
+  if (run->replay == nullptr) {
+    state.SkipWithError("set DD_CLR_REPLAY_TRACE_PATH to a callback trace");
+    return;
+  }
+
+  for (auto _ : state) {
+    run->replay->Run(run->profiler);
+    // the modules are analyzed off the callbacks, the run ends with them
+    run->profiler->DrainModuleAnalysis();
+  }
+
+  state.SetItemsProcessed(run->replay->GetEventCount());
+}
+BENCHMARK(BM_ReplayCallbackTrace)
+    ->Setup(SetUpReplayRun)
+    ->Teardown(TearDownReplayRun)
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
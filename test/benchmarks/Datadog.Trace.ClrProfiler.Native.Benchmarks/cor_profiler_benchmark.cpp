@@ -0,0 +1,189 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/cor_profiler.h"
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/stats.h"
+#include "../../Datadog.Trace.ClrProfiler.Native.Tests/fake_profiler_info.h"
+
+using namespace trace;
+
+namespace {
+
+const int kModules = 2000;
+
+// One module in eight is targeted by the integration, in its own AppDomain
+const int kTargetEvery = 8;
+
+struct ModuleLoadRun {
+  FakeProfilerInfo info;
+  CorProfiler* profiler = nullptr;
+  std::vector<ModuleID> modules;
+  std::atomic<size_t> next_module{0};
+  StatsBlockHistogram baseline{};
+};
+
+ModuleLoadRun* run = nullptr;
+
+std::filesystem::path GetIntegrationsFile() {
+  return std::filesystem::temp_directory_path() /
+         "cor-profiler-benchmark.json";
+}
+
+FakeModuleDefinition CreateModule(int index) {
+  const bool is_target = index % kTargetEvery == 0;
+
+  FakeModuleDefinition module;
+  module.assembly.name =
+      is_target ? WStr("Samples.FakeClient")
+                : WStr("Samples.Module.") + ToWSTRING(std::to_string(index));
+  module.assembly.major = 1;
+  module.mvid.Data1 = index;
+  module.references = {{WStr("System.Runtime"), 5, 0, 0, 0}};
+
+  FakeTypeDefinition type;
+  type.name = is_target ? WStr("Samples.FakeClient.Client")
+                        : module.assembly.name + WStr(".Program");
+  for (int i = 0; i < 32; i++) {
+    type.methods.push_back(
+        {WStr("Method") + ToWSTRING(std::to_string(i)),
+         {IMAGE_CEE_CS_CALLCONV_HASTHIS, 0, ELEMENT_TYPE_VOID},
+         {}});
+  }
+  type.methods.push_back(
+      {WStr("Send"), {IMAGE_CEE_CS_CALLCONV_HASTHIS, 0, ELEMENT_TYPE_VOID}, {}});
+  module.types.push_back(type);
+  return module;
+}
+
+void CopyHistogram(const StatsBlockHistogram& source,
+                   StatsBlockHistogram& destination) {
+  destination.count.store(source.count.load());
+  destination.total_ns.store(source.total_ns.load());
+  destination.max_ns.store(source.max_ns.load());
+  for (uint32_t i = 0; i < kStatsBlockHistogramBuckets; i++) {
+    destination.buckets[i].store(source.buckets[i].load());
+  }
+}
+
+const StatsBlockHistogram& GetModuleLoadFinishedHistogram() {
+  return Stats::Instance()->GetStatsBlock()->callbacks[(
+      uint32_t)StatsCallback::ModuleLoadFinished];
+}
+
+// Upper bound of the given percentile of the callbacks recorded during the
+// run, in microseconds
+double GetRunPercentile(double percentile) {
+  const auto& histogram = GetModuleLoadFinishedHistogram();
+  const uint64_t count = histogram.count.load() - run->baseline.count.load();
+  if (count == 0) {
+    return 0;
+  }
+
+  const uint64_t rank = std::max<uint64_t>(1, std::ceil(percentile * count));
+
+  uint64_t seen = 0;
+  for (int i = 0; i < LatencyHistogram::kBuckets; i++) {
+    seen += histogram.buckets[i].load() - run->baseline.buckets[i].load();
+    if (seen >= rank) {
+      return LatencyHistogram::GetBucketUpperBound(i) / 1000.0;
+    }
+  }
+  return histogram.max_ns.load() / 1000.0;
+}
+
+void SetUpModuleLoadRun(const benchmark::State& state) {
+  std::ofstream f(GetIntegrationsFile());
+  f << R"TEXT(
+      [{
+          "name": "fake-client",
+          "method_replacements": [{
+              "caller": { },
+              "target": { "assembly": "Samples.FakeClient", "type": "Samples.FakeClient.Client", "method": "Send", "signature_types": ["System.Void"], "minimum_major": 1, "maximum_major": 1 },
+              "wrapper": { "assembly": "Datadog.Trace.ClrProfiler.Managed, Version=1.28.1.0, Culture=neutral, PublicKeyToken=def86d061d0d2eeb", "type": "Datadog.Trace.ClrProfiler.Integrations.FakeClientIntegration", "action": "CallTargetModification" }
+          }]
+      }]
+  )TEXT";
+  f.close();
+
+  setenv("DD_INTEGRATIONS", GetIntegrationsFile().string().c_str(), 1);
+  setenv("DD_TRACE_CALLTARGET_ENABLED", "true", 1);
+
+  run = new ModuleLoadRun();
+  for (int i = 0; i < kModules; i++) {
+    const AppDomainID app_domain_id = i % kTargetEvery == 0 ? 100 + i : 1;
+    run->modules.push_back(run->info.AddModule(CreateModule(i), app_domain_id));
+  }
+
+  run->profiler = new CorProfiler();
+  run->profiler->AddRef();
+  run->profiler->Initialize(&run->info);
+
+  FakeModuleDefinition corlib;
+  corlib.assembly = {WStr("System.Private.CoreLib"), 5, 0, 0, 0};
+  run->profiler->ModuleLoadFinished(run->info.AddModule(corlib), S_OK);
+
+  CopyHistogram(GetModuleLoadFinishedHistogram(), run->baseline);
+}
+
+void TearDownModuleLoadRun(const benchmark::State& state) {
+  run->profiler->Shutdown();
+  run->profiler->Release();
+  delete run;
+  run = nullptr;
+
+  unsetenv("DD_INTEGRATIONS");
+  unsetenv("DD_TRACE_CALLTARGET_ENABLED");
+  std::filesystem::remove(GetIntegrationsFile());
+}
+
+}  // namespace
+
+// Loads 2,000 modules through ModuleLoadFinished, split between the threads.
+// The wall time is the time to load all of them, the latency percentiles of the
+// callback grow with the contention between the threads. The targets are
+// analyzed in the background, analyzed_ms is the time until that is done.
+static void BM_ModuleLoadFinished(benchmark::State& state) {
+  // the loop starts and ends with every thread
+  std::chrono::steady_clock::time_point start;
+  for (auto _ : state) {
+    start = std::chrono::steady_clock::now();
+
+    size_t index;
+    while ((index = run->next_module.fetch_add(1)) < run->modules.size()) {
+      run->profiler->ModuleLoadFinished(run->modules[index], S_OK);
+    }
+  }
+
+  if (state.thread_index() == 0) {
+    state.counters["modules"] = kModules;
+    state.counters["wall_ms"] =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    state.counters["p50_us"] = GetRunPercentile(0.5);
+    state.counters["p99_us"] = GetRunPercentile(0.99);
+    state.counters["max_us"] = GetRunPercentile(1);
+
+    run->profiler->DrainModuleAnalysis();
+    state.counters["analyzed_ms"] =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+  }
+}
+BENCHMARK(BM_ModuleLoadFinished)
+    ->Setup(SetUpModuleLoadRun)
+    ->Teardown(TearDownModuleLoadRun)
+    ->Iterations(1)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(16)
+    ->UseRealTime();
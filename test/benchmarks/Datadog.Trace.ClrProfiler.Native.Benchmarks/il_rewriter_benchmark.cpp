@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/il_rewriter.h"
+#include "benchmark_helpers.h"
+
+using namespace benchmarks;
+
+namespace {
+
+// Arguments: number of blocks, one try/catch every N blocks (0 for none)
+void ILRewriterArguments(benchmark::internal::Benchmark* benchmark) {
+  for (const int blocks : {8, 64, 512, 4096}) {
+    for (const int eh_interval : {0, 16, 2}) {
+      benchmark->Args({blocks, eh_interval});
+    }
+  }
+}
+
+}  // namespace
+
+static void BM_ILRewriterImport(benchmark::State& state) {
+  const auto body = CreateMethodBody((unsigned)state.range(0),
+                                     (unsigned)state.range(1));
+  FakeFunctionControl function_control;
+
+  for (auto _ : state) {
+    ILRewriter rewriter(nullptr, &function_control, 0,
+                        TokenFromRid(1, mdtMethodDef));
+    if (FAILED(rewriter.Import(body.data()))) {
+      state.SkipWithError("Import failed");
+      break;
+    }
+    benchmark::DoNotOptimize(rewriter.GetILList());
+  }
+
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_ILRewriterImport)->Apply(ILRewriterArguments);
+
+static void BM_ILRewriterImportExport(benchmark::State& state) {
+  const auto body = CreateMethodBody((unsigned)state.range(0),
+                                     (unsigned)state.range(1));
+  FakeFunctionControl function_control;
+
+  for (auto _ : state) {
+    ILRewriter rewriter(nullptr, &function_control, 0,
+                        TokenFromRid(1, mdtMethodDef));
+    if (FAILED(rewriter.Import(body.data())) || FAILED(rewriter.Export())) {
+      state.SkipWithError("Import or Export failed");
+      break;
+    }
+    benchmark::DoNotOptimize(function_control.body_size);
+  }
+
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_ILRewriterImportExport)->Apply(ILRewriterArguments);
@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/clr_helpers.h"
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/integration_loader.h"
+#include "benchmark_helpers.h"
+
+using namespace benchmarks;
+using namespace trace;
+
+namespace {
+
+// the integrations.json of the repository, INTEGRATIONS_JSON_PATH is set by the build
+const std::string& GetIntegrationsJson() {
+  static const std::string json = []() {
+    std::ifstream stream(INTEGRATIONS_JSON_PATH);
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    return buffer.str();
+  }();
+  return json;
+}
+
+const std::vector<Integration>& GetIntegrations() {
+  static const std::vector<Integration> integrations = []() {
+    std::stringstream stream(GetIntegrationsJson());
+    return LoadIntegrationsFromStream(stream);
+  }();
+  return integrations;
+}
+
+const std::vector<IntegrationMethod>& GetIntegrationMethods() {
+  static const std::vector<IntegrationMethod> integration_methods =
+      FlattenIntegrations(GetIntegrations(), true);
+  return integration_methods;
+}
+
+// An application module referencing a few instrumented assemblies among the
+// given number of references
+void CreateAssemblyImport(FakeAssemblyImport& assembly_import,
+                          size_t references) {
+  const WSTRING instrumented[] = {WStr("System.Net.Http"),
+                                  WStr("System.Data"),
+                                  WStr("StackExchange.Redis"),
+                                  WStr("Npgsql")};
+
+  assembly_import.assembly = {WStr("Example.App"), 1, 0};
+  for (size_t i = 0; i < references; i++) {
+    if (i < sizeof(instrumented) / sizeof(instrumented[0])) {
+      assembly_import.references.push_back({instrumented[i], 4, 2});
+    } else {
+      assembly_import.references.push_back(
+          {WStr("Example.Dependency") + ToWSTRING(std::to_string(i)), 1, 0});
+    }
+  }
+}
+
+}  // namespace
+
+static void BM_LoadIntegrationsFromStream(benchmark::State& state) {
+  const auto& json = GetIntegrationsJson();
+  if (json.empty()) {
+    state.SkipWithError("integrations.json not found");
+    return;
+  }
+
+  for (auto _ : state) {
+    std::stringstream stream(json);
+    auto integrations = LoadIntegrationsFromStream(stream);
+    benchmark::DoNotOptimize(integrations.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_LoadIntegrationsFromStream);
+
+static void BM_FilterIntegrationsByName(benchmark::State& state) {
+  const auto& integrations = GetIntegrations();
+  const std::vector<WSTRING> disabled_integration_names{
+      WStr("AdoNet"), WStr("HttpMessageHandler"), WStr("StackExchangeRedis")};
+
+  for (auto _ : state) {
+    auto filtered =
+        FilterIntegrationsByName(integrations, disabled_integration_names);
+    benchmark::DoNotOptimize(filtered.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * integrations.size());
+}
+BENCHMARK(BM_FilterIntegrationsByName);
+
+static void BM_FilterIntegrationsByCaller(benchmark::State& state) {
+  const auto& integration_methods = GetIntegrationMethods();
+  const AssemblyInfo assembly(1, WStr("Example.App"), 1, 1,
+                              WStr("Example.App.Domain"));
+
+  for (auto _ : state) {
+    auto filtered = FilterIntegrationsByCaller(integration_methods, assembly);
+    benchmark::DoNotOptimize(filtered.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * integration_methods.size());
+}
+BENCHMARK(BM_FilterIntegrationsByCaller);
+
+static void BM_FilterIntegrationsByTarget(benchmark::State& state) {
+  const auto& integration_methods = GetIntegrationMethods();
+  std::vector<const IntegrationMethod*> methods;
+  for (const auto& integration_method : integration_methods) {
+    methods.push_back(&integration_method);
+  }
+
+  FakeAssemblyImport fake_assembly_import;
+  CreateAssemblyImport(fake_assembly_import, (size_t)state.range(0));
+  ComPtr<IMetaDataAssemblyImport> assembly_import;
+  assembly_import.Copy(&fake_assembly_import);
+
+  for (auto _ : state) {
+    auto filtered = FilterIntegrationsByTarget(methods, assembly_import);
+    benchmark::DoNotOptimize(filtered.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * methods.size());
+}
+BENCHMARK(BM_FilterIntegrationsByTarget)->Arg(4)->Arg(32)->Arg(256);
+
+static void BM_FilterIntegrationsByTargetAssemblyName(benchmark::State& state) {
+  const auto& integration_methods = GetIntegrationMethods();
+  const std::vector<WSTRING> excluded_assembly_names{
+      WStr("mscorlib"), WStr("netstandard"), WStr("System.Private.CoreLib")};
+
+  for (auto _ : state) {
+    auto filtered = FilterIntegrationsByTargetAssemblyName(
+        integration_methods, excluded_assembly_names);
+    benchmark::DoNotOptimize(filtered.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * integration_methods.size());
+}
+BENCHMARK(BM_FilterIntegrationsByTargetAssemblyName);
@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/module_registry.h"
+
+using namespace trace;
+
+namespace {
+
+const ModuleID kModules = 256;
+
+ModuleRegistry& GetRegistry() {
+  static ModuleRegistry* registry = []() {
+    auto registry = new ModuleRegistry();
+    for (ModuleID module_id = 1; module_id <= kModules; module_id++) {
+      registry->Add(module_id,
+                    new ModuleMetadata({}, {}, {}, {}, WStr("Example.App"),
+                                       module_id, {}, nullptr, {}, nullptr));
+    }
+    return registry;
+  }();
+  return *registry;
+}
+
+}  // namespace
+
+// The read path of every JIT callback: pin the registry and look up a module
+static void BM_ModuleRegistryGet(benchmark::State& state) {
+  auto& registry = GetRegistry();
+  ModuleID module_id = state.thread_index();
+
+  for (auto _ : state) {
+    ModuleRegistry::ReadGuard guard(registry);
+    module_id = module_id % kModules + 1;
+    benchmark::DoNotOptimize(registry.Get(module_id));
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ModuleRegistryGet)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/clr_helpers.h"
+
+using namespace trace;
+
+namespace {
+
+// instance void (string, int32)
+const COR_SIGNATURE kSimpleSignature[] = {
+    IMAGE_CEE_CS_CALLCONV_HASTHIS, 0x02, ELEMENT_TYPE_VOID, ELEMENT_TYPE_STRING,
+    ELEMENT_TYPE_I4};
+
+// instance class Task`1<!!0> <1>(class List`1<string>, valuetype
+// CancellationToken, object[], !0, int32&)
+const COR_SIGNATURE kGenericSignature[] = {
+    IMAGE_CEE_CS_CALLCONV_HASTHIS | IMAGE_CEE_CS_CALLCONV_GENERIC,
+    0x01,
+    0x05,
+    ELEMENT_TYPE_GENERICINST,
+    ELEMENT_TYPE_CLASS,
+    0x09,
+    0x01,
+    ELEMENT_TYPE_MVAR,
+    0x00,
+    ELEMENT_TYPE_GENERICINST,
+    ELEMENT_TYPE_CLASS,
+    0x0D,
+    0x01,
+    ELEMENT_TYPE_STRING,
+    ELEMENT_TYPE_VALUETYPE,
+    0x11,
+    ELEMENT_TYPE_SZARRAY,
+    ELEMENT_TYPE_OBJECT,
+    ELEMENT_TYPE_VAR,
+    0x00,
+    ELEMENT_TYPE_BYREF,
+    ELEMENT_TYPE_I4};
+
+}  // namespace
+
+static void BM_FunctionMethodSignatureTryParse(benchmark::State& state,
+                                               PCCOR_SIGNATURE signature,
+                                               unsigned signature_length) {
+  for (auto _ : state) {
+    FunctionMethodSignature method_signature(signature, signature_length);
+    if (FAILED(method_signature.TryParse())) {
+      state.SkipWithError("TryParse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(method_signature.NumberOfArguments());
+  }
+}
+BENCHMARK_CAPTURE(BM_FunctionMethodSignatureTryParse, Simple, kSimpleSignature,
+                  sizeof(kSimpleSignature));
+BENCHMARK_CAPTURE(BM_FunctionMethodSignatureTryParse, Generic,
+                  kGenericSignature, sizeof(kGenericSignature));
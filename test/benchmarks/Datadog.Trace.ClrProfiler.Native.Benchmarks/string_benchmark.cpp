@@ -0,0 +1,71 @@
+#include <benchmark/benchmark.h>
+
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/miniutf.hpp"
+#include "../../../src/Datadog.Trace.ClrProfiler.Native/string.h"
+
+using namespace trace;
+
+namespace {
+
+// an assembly name, a path logged on module load, and a name that isn't ASCII
+const std::string kAssemblyName = "System.Net.Http";
+const std::string kPath =
+    "/usr/share/dotnet/shared/Microsoft.NETCore.App/3.1.10/"
+    "System.Private.CoreLib.dll";
+const std::string kUnicode = "Samples.\xC3\x89v\xC3\xA9nements.\xE6\x97\xA5\xE6\x9C\xAC";
+
+}  // namespace
+
+static void BM_ToString(benchmark::State& state, const std::string& value) {
+  const auto wstr = ToWSTRING(value);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ToString(wstr));
+  }
+
+  state.SetBytesProcessed(state.iterations() * value.size());
+}
+BENCHMARK_CAPTURE(BM_ToString, AssemblyName, kAssemblyName);
+BENCHMARK_CAPTURE(BM_ToString, Path, kPath);
+BENCHMARK_CAPTURE(BM_ToString, Unicode, kUnicode);
+
+// ToString before it transcoded directly, through a std::u16string copy
+static void BM_ToStringMiniutf(benchmark::State& state,
+                               const std::string& value) {
+  const auto wstr = ToWSTRING(value);
+
+  for (auto _ : state) {
+    std::u16string ustr(wstr.begin(), wstr.end());
+    benchmark::DoNotOptimize(miniutf::to_utf8(ustr));
+  }
+
+  state.SetBytesProcessed(state.iterations() * value.size());
+}
+BENCHMARK_CAPTURE(BM_ToStringMiniutf, AssemblyName, kAssemblyName);
+BENCHMARK_CAPTURE(BM_ToStringMiniutf, Path, kPath);
+BENCHMARK_CAPTURE(BM_ToStringMiniutf, Unicode, kUnicode);
+
+static void BM_ToWSTRING(benchmark::State& state, const std::string& value) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ToWSTRING(value));
+  }
+
+  state.SetBytesProcessed(state.iterations() * value.size());
+}
+BENCHMARK_CAPTURE(BM_ToWSTRING, AssemblyName, kAssemblyName);
+BENCHMARK_CAPTURE(BM_ToWSTRING, Path, kPath);
+BENCHMARK_CAPTURE(BM_ToWSTRING, Unicode, kUnicode);
+
+// ToWSTRING before it transcoded directly, through miniutf and a copy
+static void BM_ToWSTRINGMiniutf(benchmark::State& state,
+                                const std::string& value) {
+  for (auto _ : state) {
+    const auto ustr = miniutf::to_utf16(value);
+    benchmark::DoNotOptimize(WSTRING(ustr.begin(), ustr.end()));
+  }
+
+  state.SetBytesProcessed(state.iterations() * value.size());
+}
+BENCHMARK_CAPTURE(BM_ToWSTRINGMiniutf, AssemblyName, kAssemblyName);
+BENCHMARK_CAPTURE(BM_ToWSTRINGMiniutf, Path, kPath);
+BENCHMARK_CAPTURE(BM_ToWSTRINGMiniutf, Unicode, kUnicode);